@@ -58,6 +58,9 @@
 #ifndef CEPHES_MCONF_H
 #define CEPHES_MCONF_H
 
+/* declare the system math functions before they are renamed below */
+#include <math.h>
+
 #include "cephes_names.h"
 #include "protos.h"
 #include "polevl.h"
@@ -1,49 +1,492 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <limits.h>
 
 #include "mg_idl_export.h"
+#include "mg_threads.h"
 #include "protos.h"
 
-static IDL_VPTR IDL_CDECL IDL_mg_fdtr(int argc, IDL_VPTR *argv) {
-  double a, b, x;
-  a = IDL_DoubleScalar(argv[0]);
-  b = IDL_DoubleScalar(argv[1]);
-  x = IDL_DoubleScalar(argv[2]);
-  return IDL_GettmpDouble(cephes_fdtr(a, b, x));
+
+/*
+  Bindings for the cephes special functions. Every routine is listed once in
+  MG_CEPHES_FUNCTIONS or MG_CEPHES_PROCEDURES below along with its calling
+  signature; the IDL entry points and registration tables are generated from
+  these lists.
+
+  Arguments are broadcast against each other: each dimension of an argument
+  must either match the result or be 1 (or missing, for trailing dimensions),
+  and scalars match anything. So a (n, m) array and an n-element vector
+  evaluate the (n, m) pairs using the vector for every column. Results are
+  float unless an argument is double or DOUBLE is set. Integer parameters of
+  a function, e.g., the degrees of freedom of MG_STDTR, are truncated; values
+  that do not fit in a C int give NaN.
+*/
+
+#define MG_CEPHES_MAX_ARGS       4
+#define MG_CEPHES_MAX_OUTPUTS    4
+
+// evaluating a special function takes much longer than reading the values
+#define MG_CEPHES_MIN_ELTS       4096
+
+// signatures: arguments, then outputs; I is a C int argument
+#define MG_CEPHES_D_D      0
+#define MG_CEPHES_DD_D     1
+#define MG_CEPHES_DDD_D    2
+#define MG_CEPHES_DDDD_D   3
+#define MG_CEPHES_ID_D     4
+#define MG_CEPHES_IID_D    5
+#define MG_CEPHES_D_DD     6
+#define MG_CEPHES_D_DDDD   7
+#define MG_CEPHES_DD_DDDD  8
+
+#define MG_CEPHES_ARGS_D_D       1
+#define MG_CEPHES_ARGS_DD_D      2
+#define MG_CEPHES_ARGS_DDD_D     3
+#define MG_CEPHES_ARGS_DDDD_D    4
+#define MG_CEPHES_ARGS_ID_D      2
+#define MG_CEPHES_ARGS_IID_D     3
+#define MG_CEPHES_ARGS_D_DD      1
+#define MG_CEPHES_ARGS_D_DDDD    1
+#define MG_CEPHES_ARGS_DD_DDDD   2
+
+#define MG_CEPHES_OUTPUTS_D_DD     2
+#define MG_CEPHES_OUTPUTS_D_DDDD   4
+#define MG_CEPHES_OUTPUTS_DD_DDDD  4
+
+typedef void (*mg_cephes_fn)(void);
+
+typedef struct {
+  mg_cephes_fn fn;
+  int signature;
+  int n_args;
+  int n_outputs;
+} mg_cephes_routine;
+
+
+//          name        IDL name         C function         signature
+#define MG_CEPHES_FUNCTIONS \
+  MG_CEPHES(bdtr,       "MG_BDTR",       cephes_bdtr,       IID_D) \
+  MG_CEPHES(bdtrc,      "MG_BDTRC",      cephes_bdtrc,      IID_D) \
+  MG_CEPHES(bdtri,      "MG_BDTRI",      cephes_bdtri,      IID_D) \
+  MG_CEPHES(beta,       "MG_BETA",       cephes_beta,       DD_D) \
+  MG_CEPHES(btdtr,      "MG_BTDTR",      cephes_btdtr,      DDD_D) \
+  MG_CEPHES(cbrt,       "MG_CBRT",       cephes_cbrt,       D_D) \
+  MG_CEPHES(chdtr,      "MG_CHDTR",      cephes_chdtr,      DD_D) \
+  MG_CEPHES(chdtrc,     "MG_CHDTRC",     cephes_chdtrc,     DD_D) \
+  MG_CEPHES(chdtri,     "MG_CHDTRI",     cephes_chdtri,     DD_D) \
+  MG_CEPHES(cosdg,      "MG_COSDG",      cephes_cosdg,      D_D) \
+  MG_CEPHES(cosm1,      "MG_COSM1",      cephes_cosm1,      D_D) \
+  MG_CEPHES(cotdg,      "MG_COTDG",      cephes_cotdg,      D_D) \
+  MG_CEPHES(dawsn,      "MG_DAWSN",      cephes_dawsn,      D_D) \
+  MG_CEPHES(ellie,      "MG_ELLIE",      cephes_ellie,      DD_D) \
+  MG_CEPHES(ellik,      "MG_ELLIK",      cephes_ellik,      DD_D) \
+  MG_CEPHES(ellpe,      "MG_ELLPE",      cephes_ellpe,      D_D) \
+  MG_CEPHES(ellpk,      "MG_ELLPK",      cephes_ellpk,      D_D) \
+  MG_CEPHES(erf,        "MG_ERF",        cephes_erf,        D_D) \
+  MG_CEPHES(erfc,       "MG_ERFC",       cephes_erfc,       D_D) \
+  MG_CEPHES(exp10,      "MG_EXP10",      cephes_exp10,      D_D) \
+  MG_CEPHES(exp2,       "MG_EXP2",       cephes_exp2,       D_D) \
+  MG_CEPHES(expm1,      "MG_EXPM1",      cephes_expm1,      D_D) \
+  MG_CEPHES(expn,       "MG_EXPN",       cephes_expn,       ID_D) \
+  MG_CEPHES(fdtr,       "MG_FDTR",       cephes_fdtr,       DDD_D) \
+  MG_CEPHES(fdtrc,      "MG_FDTRC",      cephes_fdtrc,      DDD_D) \
+  MG_CEPHES(fdtri,      "MG_FDTRI",      cephes_fdtri,      DDD_D) \
+  MG_CEPHES(gamma,      "MG_GAMMA",      cephes_Gamma,      D_D) \
+  MG_CEPHES(gdtr,       "MG_GDTR",       cephes_gdtr,       DDD_D) \
+  MG_CEPHES(gdtrc,      "MG_GDTRC",      cephes_gdtrc,      DDD_D) \
+  MG_CEPHES(gdtri,      "MG_GDTRI",      cephes_gdtri,      DDD_D) \
+  MG_CEPHES(hyp2f1,     "MG_HYP2F1",     cephes_hyp2f1,     DDDD_D) \
+  MG_CEPHES(hyperg,     "MG_HYPERG",     cephes_hyperg,     DDD_D) \
+  MG_CEPHES(i0,         "MG_I0",         cephes_i0,         D_D) \
+  MG_CEPHES(i0e,        "MG_I0E",        cephes_i0e,        D_D) \
+  MG_CEPHES(i1,         "MG_I1",         cephes_i1,         D_D) \
+  MG_CEPHES(i1e,        "MG_I1E",        cephes_i1e,        D_D) \
+  MG_CEPHES(igam,       "MG_IGAM",       cephes_igam,       DD_D) \
+  MG_CEPHES(igamc,      "MG_IGAMC",      cephes_igamc,      DD_D) \
+  MG_CEPHES(igami,      "MG_IGAMI",      cephes_igami,      DD_D) \
+  MG_CEPHES(incbet,     "MG_INCBET",     cephes_incbet,     DDD_D) \
+  MG_CEPHES(incbi,      "MG_INCBI",      cephes_incbi,      DDD_D) \
+  MG_CEPHES(iv,         "MG_IV",         cephes_iv,         DD_D) \
+  MG_CEPHES(j0,         "MG_J0",         cephes_j0,         D_D) \
+  MG_CEPHES(j1,         "MG_J1",         cephes_j1,         D_D) \
+  MG_CEPHES(jv,         "MG_JV",         cephes_jv,         DD_D) \
+  MG_CEPHES(k0,         "MG_K0",         cephes_k0,         D_D) \
+  MG_CEPHES(k0e,        "MG_K0E",        cephes_k0e,        D_D) \
+  MG_CEPHES(k1,         "MG_K1",         cephes_k1,         D_D) \
+  MG_CEPHES(k1e,        "MG_K1E",        cephes_k1e,        D_D) \
+  MG_CEPHES(kn,         "MG_KN",         cephes_kn,         ID_D) \
+  MG_CEPHES(kolmogi,    "MG_KOLMOGI",    cephes_kolmogi,    D_D) \
+  MG_CEPHES(kolmogorov, "MG_KOLMOGOROV", cephes_kolmogorov, D_D) \
+  MG_CEPHES(lbeta,      "MG_LBETA",      cephes_lbeta,      DD_D) \
+  MG_CEPHES(lgam,       "MG_LGAM",       cephes_lgam,       D_D) \
+  MG_CEPHES(log1p,      "MG_LOG1P",      cephes_log1p,      D_D) \
+  MG_CEPHES(log_ndtr,   "MG_LOG_NDTR",   log_ndtr,          D_D) \
+  MG_CEPHES(nbdtr,      "MG_NBDTR",      cephes_nbdtr,      IID_D) \
+  MG_CEPHES(nbdtrc,     "MG_NBDTRC",     cephes_nbdtrc,     IID_D) \
+  MG_CEPHES(nbdtri,     "MG_NBDTRI",     cephes_nbdtri,     IID_D) \
+  MG_CEPHES(ndtr,       "MG_NDTR",       cephes_ndtr,       D_D) \
+  MG_CEPHES(ndtri,      "MG_NDTRI",      cephes_ndtri,      D_D) \
+  MG_CEPHES(pdtr,       "MG_PDTR",       cephes_pdtr,       ID_D) \
+  MG_CEPHES(pdtrc,      "MG_PDTRC",      cephes_pdtrc,      ID_D) \
+  MG_CEPHES(pdtri,      "MG_PDTRI",      cephes_pdtri,      ID_D) \
+  MG_CEPHES(psi,        "MG_PSI",        cephes_psi,        D_D) \
+  MG_CEPHES(rgamma,     "MG_RGAMMA",     cephes_rgamma,     D_D) \
+  MG_CEPHES(sindg,      "MG_SINDG",      cephes_sindg,      D_D) \
+  MG_CEPHES(smirnov,    "MG_SMIRNOV",    cephes_smirnov,    ID_D) \
+  MG_CEPHES(smirnovi,   "MG_SMIRNOVI",   cephes_smirnovi,   ID_D) \
+  MG_CEPHES(spence,     "MG_SPENCE",     cephes_spence,     D_D) \
+  MG_CEPHES(stdtr,      "MG_STDTR",      cephes_stdtr,      ID_D) \
+  MG_CEPHES(stdtri,     "MG_STDTRI",     cephes_stdtri,     ID_D) \
+  MG_CEPHES(struve,     "MG_STRUVE",     cephes_struve,     DD_D) \
+  MG_CEPHES(tandg,      "MG_TANDG",      cephes_tandg,      D_D) \
+  MG_CEPHES(tukeylambdacdf, \
+                        "MG_TUKEYLAMBDACDF", \
+                                         tukeylambdacdf,    DD_D) \
+  MG_CEPHES(y0,         "MG_Y0",         cephes_y0,         D_D) \
+  MG_CEPHES(y1,         "MG_Y1",         cephes_y1,         D_D) \
+  MG_CEPHES(yn,         "MG_YN",         cephes_yn,         ID_D) \
+  MG_CEPHES(yv,         "MG_YV",         cephes_yv,         DD_D) \
+  MG_CEPHES(zeta,       "MG_ZETA",       cephes_zeta,       DD_D) \
+  MG_CEPHES(zetac,      "MG_ZETAC",      cephes_zetac,      D_D)
+
+// routines with more than one result return them in output parameters
+#define MG_CEPHES_PROCEDURES \
+  MG_CEPHES(airy,       "MG_AIRY",       cephes_airy,       D_DDDD) \
+  MG_CEPHES(ellpj,      "MG_ELLPJ",      cephes_ellpj,      DD_DDDD) \
+  MG_CEPHES(fresnl,     "MG_FRESNL",     cephes_fresnl,     D_DD) \
+  MG_CEPHES(shichi,     "MG_SHICHI",     cephes_shichi,     D_DD) \
+  MG_CEPHES(sici,       "MG_SICI",       cephes_sici,       D_DD)
+
+
+typedef struct {
+  const mg_cephes_routine *routine;
+  int n_args;
+  int n_outputs;
+
+  // broadcast result dimensions
+  int n_dim;
+  IDL_MEMINT dims[IDL_MAX_ARRAY_DIM];
+  IDL_MEMINT n;
+
+  // arguments and their strides, in elements, along the result dimensions
+  char *data[MG_CEPHES_MAX_ARGS];
+  int type[MG_CEPHES_MAX_ARGS];
+  IDL_MEMINT strides[MG_CEPHES_MAX_ARGS][IDL_MAX_ARRAY_DIM];
+
+  int is_double;
+  char *outputs[MG_CEPHES_MAX_OUTPUTS];
+} mg_cephes_info;
+
+
+static int mg_cephes_is_real(int type) {
+  switch (type) {
+    case IDL_TYP_BYTE:
+    case IDL_TYP_INT:
+    case IDL_TYP_LONG:
+    case IDL_TYP_FLOAT:
+    case IDL_TYP_DOUBLE:
+    case IDL_TYP_UINT:
+    case IDL_TYP_ULONG:
+    case IDL_TYP_LONG64:
+    case IDL_TYP_ULONG64:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+
+static inline double mg_cephes_get(char *data, int type, IDL_MEMINT i) {
+  switch (type) {
+    case IDL_TYP_BYTE: return ((UCHAR *) data)[i];
+    case IDL_TYP_INT: return ((IDL_INT *) data)[i];
+    case IDL_TYP_LONG: return ((IDL_LONG *) data)[i];
+    case IDL_TYP_FLOAT: return ((float *) data)[i];
+    case IDL_TYP_DOUBLE: return ((double *) data)[i];
+    case IDL_TYP_UINT: return ((IDL_UINT *) data)[i];
+    case IDL_TYP_ULONG: return ((IDL_ULONG *) data)[i];
+    case IDL_TYP_LONG64: return (double) ((IDL_LONG64 *) data)[i];
+    case IDL_TYP_ULONG64: return (double) ((IDL_ULONG64 *) data)[i];
+  }
+  return NAN;
+}
+
+
+// integer parameter, returns 0 if the value is not a valid C int
+static inline int mg_cephes_int(double value, int *result) {
+  if (!(value > (double) INT_MIN - 1.0 && value < (double) INT_MAX + 1.0)) return 0;
+  *result = (int) value;
+  return 1;
+}
+
+
+// evaluate a routine for one set of arguments
+static inline void mg_cephes_eval(const mg_cephes_routine *routine,
+                                  double *a, double *r) {
+  int k, n;
+
+  switch (routine->signature) {
+    case MG_CEPHES_D_D:
+      r[0] = ((double (*)(double)) routine->fn)(a[0]);
+      break;
+    case MG_CEPHES_DD_D:
+      r[0] = ((double (*)(double, double)) routine->fn)(a[0], a[1]);
+      break;
+    case MG_CEPHES_DDD_D:
+      r[0] = ((double (*)(double, double, double)) routine->fn)(a[0], a[1], a[2]);
+      break;
+    case MG_CEPHES_DDDD_D:
+      r[0] = ((double (*)(double, double, double, double)) routine->fn)(a[0], a[1], a[2], a[3]);
+      break;
+    case MG_CEPHES_ID_D:
+      r[0] = mg_cephes_int(a[0], &k)
+               ? ((double (*)(int, double)) routine->fn)(k, a[1])
+               : NAN;
+      break;
+    case MG_CEPHES_IID_D:
+      r[0] = mg_cephes_int(a[0], &k) && mg_cephes_int(a[1], &n)
+               ? ((double (*)(int, int, double)) routine->fn)(k, n, a[2])
+               : NAN;
+      break;
+    case MG_CEPHES_D_DD:
+      ((int (*)(double, double *, double *)) routine->fn)(a[0], &r[0], &r[1]);
+      break;
+    case MG_CEPHES_D_DDDD:
+      ((int (*)(double, double *, double *, double *, double *)) routine->fn)(a[0], &r[0], &r[1], &r[2], &r[3]);
+      break;
+    case MG_CEPHES_DD_DDDD:
+      ((int (*)(double, double, double *, double *, double *, double *)) routine->fn)(a[0], a[1], &r[0], &r[1], &r[2], &r[3]);
+      break;
+  }
+}
+
+
+// evaluate the elements [start, end) of the result
+static void mg_cephes_work(IDL_MEMINT start, IDL_MEMINT end,
+                           int thread_index, void *data) {
+  mg_cephes_info *info = (mg_cephes_info *) data;
+  IDL_MEMINT index[IDL_MAX_ARRAY_DIM], offsets[MG_CEPHES_MAX_ARGS], e, rest;
+  double a[MG_CEPHES_MAX_ARGS], r[MG_CEPHES_MAX_OUTPUTS];
+  int d, i, o;
+
+  // position of the first element in each argument
+  for (i = 0; i < info->n_args; i++) offsets[i] = 0;
+  for (d = 0, rest = start; d < info->n_dim; d++) {
+    index[d] = rest % info->dims[d];
+    rest /= info->dims[d];
+    for (i = 0; i < info->n_args; i++) offsets[i] += index[d] * info->strides[i][d];
+  }
+
+  for (e = start; e < end; e++) {
+    for (i = 0; i < info->n_args; i++) {
+      a[i] = mg_cephes_get(info->data[i], info->type[i], offsets[i]);
+    }
+    mg_cephes_eval(info->routine, a, r);
+    for (o = 0; o < info->n_outputs; o++) {
+      if (info->is_double) {
+        ((double *) info->outputs[o])[e] = r[o];
+      } else {
+        ((float *) info->outputs[o])[e] = (float) r[o];
+      }
+    }
+
+    // advance to the next element, carrying into slower dimensions
+    for (d = 0; d < info->n_dim; d++) {
+      for (i = 0; i < info->n_args; i++) offsets[i] += info->strides[i][d];
+      if (++index[d] < info->dims[d]) break;
+      for (i = 0; i < info->n_args; i++) offsets[i] -= index[d] * info->strides[i][d];
+      index[d] = 0;
+    }
+  }
 }
 
-static IDL_VPTR IDL_CDECL IDL_mg_fdtrc(int argc, IDL_VPTR *argv) {
-  double a, b, x;
-  a = IDL_DoubleScalar(argv[0]);
-  b = IDL_DoubleScalar(argv[1]);
-  x = IDL_DoubleScalar(argv[2]);
-  return IDL_GettmpDouble(cephes_fdtrc(a, b, x));
+
+/*
+  Check the arguments, broadcast their dimensions, and set up the results.
+  Returns the result variables in results.
+*/
+static void mg_cephes_setup(mg_cephes_info *info, IDL_VPTR *argv,
+                            int double_keyword, IDL_VPTR *results) {
+  IDL_VPTR arg;
+  IDL_MEMINT dim, stride;
+  int i, d, o, n_dim;
+
+  info->n_dim = 0;
+  info->is_double = double_keyword;
+  for (d = 0; d < IDL_MAX_ARRAY_DIM; d++) info->dims[d] = 1;
+
+  for (i = 0; i < info->n_args; i++) {
+    arg = argv[i];
+    IDL_ENSURE_SIMPLE(arg);
+    if (!mg_cephes_is_real(arg->type)) {
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "arguments must be non-complex numeric");
+    }
+    if (arg->type == IDL_TYP_DOUBLE) info->is_double = 1;
+    info->type[i] = arg->type;
+
+    if (!(arg->flags & IDL_V_ARR)) continue;
+    n_dim = arg->value.arr->n_dim;
+    for (d = 0; d < n_dim; d++) {
+      dim = arg->value.arr->dim[d];
+      if (dim == 1) continue;
+      if (info->dims[d] != 1 && info->dims[d] != dim) {
+        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                    "arguments have incompatible dimensions");
+      }
+      info->dims[d] = dim;
+    }
+    if (n_dim > info->n_dim) info->n_dim = n_dim;
+  }
+
+  // strides of each argument, 0 along broadcast dimensions
+  for (i = 0; i < info->n_args; i++) {
+    arg = argv[i];
+    if (arg->flags & IDL_V_ARR) {
+      info->data[i] = (char *) arg->value.arr->data;
+      for (d = 0, stride = 1; d < info->n_dim; d++) {
+        dim = d < arg->value.arr->n_dim ? arg->value.arr->dim[d] : 1;
+        info->strides[i][d] = dim == 1 ? 0 : stride;
+        stride *= dim;
+      }
+    } else {
+      info->data[i] = (char *) &arg->value;
+      for (d = 0; d < info->n_dim; d++) info->strides[i][d] = 0;
+    }
+  }
+
+  for (d = 0, info->n = 1; d < info->n_dim; d++) info->n *= info->dims[d];
+
+  for (o = 0; o < info->n_outputs; o++) {
+    if (info->n_dim == 0) {
+      // scalar arguments give a scalar result, evaluated in place
+      results[o] = IDL_Gettmp();
+      results[o]->type = info->is_double ? IDL_TYP_DOUBLE : IDL_TYP_FLOAT;
+      info->outputs[o] = (char *) &results[o]->value;
+    } else {
+      info->outputs[o] = IDL_MakeTempArray(info->is_double ? IDL_TYP_DOUBLE : IDL_TYP_FLOAT,
+                                           info->n_dim, info->dims,
+                                           IDL_ARR_INI_NOP, &results[o]);
+    }
+  }
 }
 
-static IDL_VPTR IDL_CDECL IDL_mg_fdtri(int argc, IDL_VPTR *argv) {
-  double a, b, x;
-  a = IDL_DoubleScalar(argv[0]);
-  b = IDL_DoubleScalar(argv[1]);
-  x = IDL_DoubleScalar(argv[2]);
-  return IDL_GettmpDouble(cephes_fdtri(a, b, x));
+
+static void mg_cephes_evaluate(const mg_cephes_routine *routine, int argc,
+                               IDL_VPTR *argv, char *argk, IDL_VPTR *results) {
+  mg_cephes_info info;
+  int nargs;
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_LONG double_keyword;
+    IDL_LONG n_threads;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "DOUBLE", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(double_keyword) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+
+  info.routine = routine;
+  info.n_args = routine->n_args;
+  info.n_outputs = routine->n_outputs;
+
+  mg_cephes_setup(&info, argv, kw.double_keyword, results);
+  mg_thread_run(mg_thread_count(info.n, MG_CEPHES_MIN_ELTS, kw.n_threads),
+                info.n, mg_cephes_work, &info);
+
+  IDL_KW_FREE;
+}
+
+
+static IDL_VPTR mg_cephes_function(const mg_cephes_routine *routine, int argc,
+                                   IDL_VPTR *argv, char *argk) {
+  IDL_VPTR result;
+  mg_cephes_evaluate(routine, argc, argv, argk, &result);
+  return result;
+}
+
+
+static void mg_cephes_procedure(const mg_cephes_routine *routine, int argc,
+                                IDL_VPTR *argv, char *argk) {
+  IDL_VPTR results[MG_CEPHES_MAX_OUTPUTS];
+  int o, n_present = argc - routine->n_args;
+
+  for (o = 0; o < n_present; o++) IDL_EXCLUDE_EXPR(argv[routine->n_args + o]);
+
+  mg_cephes_evaluate(routine, argc, argv, argk, results);
+
+  for (o = 0; o < routine->n_outputs; o++) {
+    if (o < n_present) {
+      IDL_VarCopy(results[o], argv[routine->n_args + o]);
+    } else {
+      IDL_Deltmp(results[o]);
+    }
+  }
 }
 
+
+// IDL entry points
+#define MG_CEPHES(NAME, IDL_NAME, FN, SIGNATURE) \
+  static IDL_VPTR IDL_CDECL IDL_mg_##NAME(int argc, IDL_VPTR *argv, char *argk) { \
+    static mg_cephes_routine routine = { (mg_cephes_fn) FN, MG_CEPHES_##SIGNATURE, \
+                                         MG_CEPHES_ARGS_##SIGNATURE, 1 }; \
+    return mg_cephes_function(&routine, argc, argv, argk); \
+  }
+MG_CEPHES_FUNCTIONS
+#undef MG_CEPHES
+
+#define MG_CEPHES(NAME, IDL_NAME, FN, SIGNATURE) \
+  static void IDL_CDECL IDL_mg_##NAME(int argc, IDL_VPTR *argv, char *argk) { \
+    static mg_cephes_routine routine = { (mg_cephes_fn) FN, MG_CEPHES_##SIGNATURE, \
+                                         MG_CEPHES_ARGS_##SIGNATURE, \
+                                         MG_CEPHES_OUTPUTS_##SIGNATURE }; \
+    mg_cephes_procedure(&routine, argc, argv, argk); \
+  }
+MG_CEPHES_PROCEDURES
+#undef MG_CEPHES
+
+
 int IDL_Load(void) {
   /*
    * These tables contain information on the functions and procedures
-   * that make up the analysis DLM. The information contained in these
-   * tables must be identical to that contained in mg_analysis.dlm.
+   * that make up the cephes DLM. The information contained in these
+   * tables must be identical to that contained in mg_cephes.dlm.
    */
+#define MG_CEPHES(NAME, IDL_NAME, FN, SIGNATURE) \
+    { IDL_mg_##NAME, IDL_NAME, \
+      MG_CEPHES_ARGS_##SIGNATURE, MG_CEPHES_ARGS_##SIGNATURE, \
+      IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
   static IDL_SYSFUN_DEF2 function_addr[] = {
-    { IDL_mg_fdtrc,       "MG_FDTR",        3, 3, 0, 0 },
-    { IDL_mg_fdtrc,       "MG_FDTRC",       3, 3, 0, 0 },
-    { IDL_mg_fdtrc,       "MG_FDTRI",       3, 3, 0, 0 },
+    MG_CEPHES_FUNCTIONS
+  };
+#undef MG_CEPHES
+
+#define MG_CEPHES(NAME, IDL_NAME, FN, SIGNATURE) \
+    { (IDL_SYSRTN_GENERIC) IDL_mg_##NAME, IDL_NAME, \
+      MG_CEPHES_ARGS_##SIGNATURE, \
+      MG_CEPHES_ARGS_##SIGNATURE + MG_CEPHES_OUTPUTS_##SIGNATURE, \
+      IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+  static IDL_SYSFUN_DEF2 procedure_addr[] = {
+    MG_CEPHES_PROCEDURES
   };
+#undef MG_CEPHES
 
   /*
    * Register our routines. The routines must be specified exactly the same
-   * as in mg_analysis.dlm.
+   * as in mg_cephes.dlm.
    */
-  return IDL_SysRtnAdd(function_addr, TRUE, IDL_CARRAY_ELTS(function_addr));
+  return IDL_SysRtnAdd(procedure_addr, FALSE, IDL_CARRAY_ELTS(procedure_addr))
+      && IDL_SysRtnAdd(function_addr, TRUE, IDL_CARRAY_ELTS(function_addr));
 }
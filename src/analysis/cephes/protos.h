@@ -55,7 +55,7 @@ extern double cephes_ellpe(double x);
 extern int    cephes_ellpj(double u, double m, double *sn, double *cn, double *dn, double *ph);
 extern double cephes_ellpk(double x);
 extern double exp(double x);
-extern double exp10(double x);
+extern double cephes_exp10(double x);
 extern double cephes_exp1m(double x);
 extern double cephes_exp2(double x);
 extern double cephes_expn(int n, double x);
@@ -73,6 +73,7 @@ extern double lgam_sgn(double x, int *sign);
 extern double lgam1p(double x);
 extern double cephes_gdtr(double a, double b, double x);
 extern double cephes_gdtrc(double a, double b, double x);
+extern double cephes_gdtri(double a, double b, double y);
 extern int    gels(double A[], double R[], int M, double EPS, double AUX[]);
 extern double cephes_hyp2f1(double a, double b, double c, double x);
 extern double cephes_hyperg(double a, double b, double x);
@@ -99,6 +100,8 @@ extern double cephes_k0e(double x);
 extern double cephes_k1(double x);
 extern double cephes_k1e(double x);
 extern double cephes_kn(int nn, double x);
+extern double cephes_kolmogorov(double y);
+extern double cephes_kolmogi(double p);
 
 //extern int levnsn ( int n, double r[], double a[], double e[], double refl[] );
 
@@ -117,6 +120,7 @@ extern double cephes_ndtr(double a);
 extern double cephes_erfc(double a);
 extern double cephes_erf(double x);
 extern double cephes_ndtri(double y0);
+extern double log_ndtr(double a);
 extern double cephes_pdtrc(int k, double m);
 extern double cephes_pdtr(int k, double m);
 extern double cephes_pdtri(int k, double y);
@@ -136,6 +140,8 @@ extern double cephes_sindg(double x);
 extern double cephes_cosdg(double x);
 extern double sinh(double x);
 extern double cephes_spence(double x);
+extern double cephes_smirnov(int n, double e);
+extern double cephes_smirnovi(int n, double p);
 extern double sqrt(double x);
 extern double cephes_stdtr(int k, double t);
 extern double cephes_stdtri(int k, double p);
@@ -145,6 +151,7 @@ extern double cephes_struve(double v, double x);
 extern double tan(double x);
 extern double cot(double x);
 extern double cephes_tandg(double x);
+extern double tukeylambdacdf(double x, double lmbda);
 extern double cephes_cotdg(double x);
 extern double tanh(double x);
 extern double cephes_log1p(double x);
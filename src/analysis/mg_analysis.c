@@ -1,134 +1,164 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #include "mg_idl_export.h"
+#include "mg_threads.h"
 
 /**************************************************************************
   Helper routines
 ***************************************************************************/
 
-#define MG_C_ABS(z) sqrt(z.r*z.r + z.i*z.i)
-#define MG_U_ABS(x) (x)
-
-#define MG_C_NAN(z) (z.r != z.r || z.i != z.i)
-#define MG_R_NAN(x) (x != x)
-
-#define MG_ARRAY_EQUAL_ARR2ARR(TYPE, TOLERANCE_TYPE, DIFFERENCE_EXPR, ABS, NAN) \
-  static int mg_array_equal_ ## TYPE ## _arr2arr(int n, 			\
-                                        TYPE *arr1, TYPE *arr2,                 \
-					TOLERANCE_TYPE tolerance, int nan) {    \
-  int i;                                                                        \
-  for (i = 0; i < n; i++) {                                                     \
-    TYPE d, a1 = arr1[i], a2 = arr2[i];                                         \
-    DIFFERENCE_EXPR;                                                            \
-    if (ABS(d) > tolerance || !nan * NAN(a1) || !nan * NAN(a2)) return 0;       \
-  }                                                                             \
-  return 1;                                                                     \
-}
-
-MG_ARRAY_EQUAL_ARR2ARR(UCHAR, UCHAR, d = a1 - a2, MG_U_ABS, MG_R_NAN)
-MG_ARRAY_EQUAL_ARR2ARR(IDL_INT, IDL_INT, d = a1 - a2, abs, MG_R_NAN)
-MG_ARRAY_EQUAL_ARR2ARR(IDL_LONG, IDL_LONG, d = a1 - a2, abs, MG_R_NAN)
-MG_ARRAY_EQUAL_ARR2ARR(float, float, d = a1 - a2, fabs, MG_R_NAN)
-MG_ARRAY_EQUAL_ARR2ARR(double, double, d = a1 - a2, fabs, MG_R_NAN)
-MG_ARRAY_EQUAL_ARR2ARR(IDL_COMPLEX, float, d.r = a1.r - a2.r; d.i = a1.i - a2.i, MG_C_ABS, MG_C_NAN)
-MG_ARRAY_EQUAL_ARR2ARR(IDL_DCOMPLEX, double, d.r = a1.r - a2.r; d.i = a1.i - a2.i, MG_C_ABS, MG_C_NAN)
-MG_ARRAY_EQUAL_ARR2ARR(IDL_UINT, IDL_UINT, d = a1 - a2, MG_U_ABS, MG_R_NAN)
-MG_ARRAY_EQUAL_ARR2ARR(IDL_ULONG, IDL_ULONG, d = a1 - a2, MG_U_ABS, MG_R_NAN)
-MG_ARRAY_EQUAL_ARR2ARR(IDL_LONG64, IDL_LONG64, d = a1 - a2, labs, MG_R_NAN)
-MG_ARRAY_EQUAL_ARR2ARR(IDL_ULONG64, IDL_ULONG64, d = a1 - a2, MG_U_ABS, MG_R_NAN)
-
-#define MG_ARRAY_EQUAL_SCALAR2ARR(TYPE, TOLERANCE_TYPE, DIFFERENCE_EXPR, ABS, NAN) \
-static int mg_array_equal_ ## TYPE ## _scalar2arr(int n,                           \
-                                                  TYPE scalar, TYPE *arr,          \
-     					          TOLERANCE_TYPE tolerance,        \
-                                                  int nan) {                       \
-  int i;                                                                           \
-  for (i = 0; i < n; i++) {                                                        \
-    TYPE d, a1 = scalar, a2 = arr[i];                                              \
-    DIFFERENCE_EXPR;                                                               \
-    if (ABS(d) > tolerance || !nan * NAN(a1) || !nan * NAN(a2)) return 0;	   \
-  }                                                                                \
-  return 1;                                                                        \
-}
-
-MG_ARRAY_EQUAL_SCALAR2ARR(UCHAR, UCHAR, d = a1 - a2, MG_U_ABS, MG_R_NAN)
-MG_ARRAY_EQUAL_SCALAR2ARR(IDL_INT, IDL_INT, d = a1 - a2, abs, MG_R_NAN)
-MG_ARRAY_EQUAL_SCALAR2ARR(IDL_LONG, IDL_LONG, d = a1 - a2, abs, MG_R_NAN)
-MG_ARRAY_EQUAL_SCALAR2ARR(float, float, d = a1 - a2, fabs, MG_R_NAN)
-MG_ARRAY_EQUAL_SCALAR2ARR(double, double, d = a1 - a2, fabs, MG_R_NAN)
-MG_ARRAY_EQUAL_SCALAR2ARR(IDL_COMPLEX, float, d.r = a1.r - a2.r; d.i = a1.i - a2.i, MG_C_ABS, MG_C_NAN)
-MG_ARRAY_EQUAL_SCALAR2ARR(IDL_DCOMPLEX, double, d.r = a1.r - a2.r; d.i = a1.i - a2.i, MG_C_ABS, MG_C_NAN)
-MG_ARRAY_EQUAL_SCALAR2ARR(IDL_UINT, IDL_UINT, d = a1 - a2, MG_U_ABS, MG_R_NAN)
-MG_ARRAY_EQUAL_SCALAR2ARR(IDL_ULONG, IDL_ULONG, d = a1 - a2, MG_U_ABS, MG_R_NAN)
-MG_ARRAY_EQUAL_SCALAR2ARR(IDL_LONG64, IDL_LONG64, d = a1 - a2, labs, MG_R_NAN)
-MG_ARRAY_EQUAL_SCALAR2ARR(IDL_ULONG64, IDL_ULONG64, d = a1 - a2, MG_U_ABS, MG_R_NAN)
-
-#define MG_ARRAY_EQUAL_SCALAR2SCALAR(TYPE, TOLERANCE_TYPE, DIFFERENCE_EXPR, ABS, NAN) \
-static int mg_array_equal_ ## TYPE ## _scalar2scalar(TYPE scalar1, TYPE scalar2,      \
-                                                     TOLERANCE_TYPE tolerance,        \
-						     int nan) {	                      \
-  int i;                                                                              \
-  TYPE d, a1 = scalar1, a2 = scalar2;                                                 \
-  DIFFERENCE_EXPR;                                                                    \
-  if (ABS(d) > tolerance || !nan * NAN(a2) || !nan * NAN(a2)) return 0;	              \
-  return 1;                                                                           \
-}
-
-MG_ARRAY_EQUAL_SCALAR2SCALAR(UCHAR, UCHAR, d = a1 - a2, MG_U_ABS, MG_R_NAN)
-MG_ARRAY_EQUAL_SCALAR2SCALAR(IDL_INT, IDL_INT, d = a1 - a2, abs, MG_R_NAN)
-MG_ARRAY_EQUAL_SCALAR2SCALAR(IDL_LONG, IDL_LONG, d = a1 - a2, abs, MG_R_NAN)
-MG_ARRAY_EQUAL_SCALAR2SCALAR(float, float, d = a1 - a2, fabs, MG_R_NAN)
-MG_ARRAY_EQUAL_SCALAR2SCALAR(double, double, d = a1 - a2, fabs, MG_R_NAN)
-MG_ARRAY_EQUAL_SCALAR2SCALAR(IDL_COMPLEX, float, d.r = a1.r - a2.r; d.i = a1.i - a2.i, MG_C_ABS, MG_C_NAN)
-MG_ARRAY_EQUAL_SCALAR2SCALAR(IDL_DCOMPLEX, double, d.r = a1.r - a2.r; d.i = a1.i - a2.i, MG_C_ABS, MG_C_NAN)
-MG_ARRAY_EQUAL_SCALAR2SCALAR(IDL_UINT, IDL_UINT, d = a1 - a2, MG_U_ABS, MG_R_NAN)
-MG_ARRAY_EQUAL_SCALAR2SCALAR(IDL_ULONG, IDL_ULONG, d = a1 - a2, MG_U_ABS, MG_R_NAN)
-MG_ARRAY_EQUAL_SCALAR2SCALAR(IDL_LONG64, IDL_LONG64, d = a1 - a2, labs, MG_R_NAN)
-MG_ARRAY_EQUAL_SCALAR2SCALAR(IDL_ULONG64, IDL_ULONG64, d = a1 - a2, MG_U_ABS, MG_R_NAN)
-
-
-#define MG_ARRAY_EQUAL_ARR2ARR_CASE(TYPE_VALUE, TYPE, TOLERANCE_TYPE, IDL_MEMBER, ZERO)          \
-    case TYPE_VALUE:                                                                             \
-      is_equal = mg_array_equal_ ## TYPE ## _arr2arr(argv[0]->value.arr->n_elts,                 \
-                                                     (TYPE *) argv[0]->value.arr->data,          \
-                                                     (TYPE *) argv[1]->value.arr->data,          \
-                                                     kw.tolerance_present ? kw.tolerance->value.IDL_MEMBER : ZERO, kw.nan); \
-      break;
+// absolute differences are computed in an unsigned type for integers so that
+// they cannot overflow
+#define MG_I_ABSDIFF(a1, a2, UTYPE) ((a1) > (a2) ? (UTYPE) ((UTYPE) (a1) - (UTYPE) (a2)) : (UTYPE) ((UTYPE) (a2) - (UTYPE) (a1)))
+#define MG_R_ABSDIFF(a1, a2, UTYPE) ((a1) > (a2) ? (a1) - (a2) : (a2) - (a1))
+#define MG_C_ABSDIFF(a1, a2, UTYPE) sqrt(((a1).r - (a2).r) * ((a1).r - (a2).r) + ((a1).i - (a2).i) * ((a1).i - (a2).i))
 
-#define MG_ARRAY_EQUAL_SCALAR2ARR_CASE(TYPE_VALUE, TYPE, SCALAR_ARG, ARR_ARG, TOLERANCE_TYPE, IDL_ARGMEMBER, IDL_TOLMEMBER, ZERO) \
-    case TYPE_VALUE:                                                                              \
-      is_equal = mg_array_equal_ ## TYPE ## _scalar2arr(ARR_ARG->value.arr->n_elts,               \
-                                                        (TYPE) SCALAR_ARG->value.IDL_ARGMEMBER,   \
-                                                        (TYPE *) ARR_ARG->value.arr->data,        \
-                                                        kw.tolerance_present ? kw.tolerance->value.IDL_TOLMEMBER : ZERO, kw.nan); \
-      break;
+#define MG_C_NAN(z) ((z).r != (z).r || (z).i != (z).i)
+#define MG_R_NAN(x) ((x) != (x))
+
+// number of elements checked between tests for early exit
+#define MG_ARRAY_EQUAL_BLOCK 1024
+
+typedef struct {
+  int find_all;              // if not set, stop after the first mismatch
+  IDL_MEMINT n_mismatches;
+  IDL_MEMINT first_index;
+  double max_abs_diff;
+} mg_array_equal_stats;
+
+/*
+  Compare n elements of arr1 to arr2, a block at a time. The loop over a block
+  has no branches, so the compiler can check a vector of elements at once.
+  Returns 1 if all elements are within tolerance. If stats is NULL, returns as
+  soon as a block has a mismatch; otherwise accumulates statistics in stats.
+  When SCALAR_INDEX is 0, arr1 is a single value compared to all of arr2.
+*/
+#define MG_ARRAY_EQUAL_COMPARE(TYPE, SUFFIX, SCALAR_INDEX, DIFF_TYPE, ABSDIFF, NAN) \
+static int mg_array_equal_ ## TYPE ## _ ## SUFFIX(IDL_MEMINT n,              \
+                                                  TYPE *arr1, TYPE *arr2,    \
+                                                  DIFF_TYPE tolerance,       \
+                                                  int nan,                   \
+                                                  mg_array_equal_stats *stats) { \
+  IDL_MEMINT start, end, i, nbad;                                            \
+  int check_nan = !nan;                                                      \
+  DIFF_TYPE max_diff = 0;                                                    \
+                                                                             \
+  for (start = 0; start < n; start += MG_ARRAY_EQUAL_BLOCK) {                \
+    end = start + MG_ARRAY_EQUAL_BLOCK < n ? start + MG_ARRAY_EQUAL_BLOCK : n; \
+    nbad = 0;                                                                \
+    for (i = start; i < end; i++) {                                          \
+      TYPE a1 = arr1[(SCALAR_INDEX) * i], a2 = arr2[i];                      \
+      DIFF_TYPE d = ABSDIFF(a1, a2, DIFF_TYPE);                              \
+      nbad += (d > tolerance) | (check_nan & (NAN(a1) | NAN(a2)));           \
+      max_diff = d > max_diff ? d : max_diff;                                \
+    }                                                                        \
+                                                                             \
+    if (nbad == 0) continue;                                                 \
+    if (stats == NULL) return 0;                                             \
+                                                                             \
+    if (stats->n_mismatches == 0) {                                          \
+      for (i = start; i < end; i++) {                                        \
+        TYPE a1 = arr1[(SCALAR_INDEX) * i], a2 = arr2[i];                    \
+        DIFF_TYPE d = ABSDIFF(a1, a2, DIFF_TYPE);                            \
+        if (d > tolerance || (check_nan && (NAN(a1) || NAN(a2)))) break;     \
+      }                                                                      \
+      stats->first_index = i;                                                \
+    }                                                                        \
+    stats->n_mismatches += nbad;                                             \
+    if (!stats->find_all) break;                                             \
+  }                                                                          \
+                                                                             \
+  if (stats != NULL) {                                                       \
+    stats->max_abs_diff = (double) max_diff;                                 \
+    return stats->n_mismatches == 0;                                         \
+  }                                                                          \
+  return 1;                                                                  \
+}
+
+#define MG_ARRAY_EQUAL_TYPE(TYPE, DIFF_TYPE, ABSDIFF, NAN)                   \
+  MG_ARRAY_EQUAL_COMPARE(TYPE, arr2arr, 1, DIFF_TYPE, ABSDIFF, NAN)          \
+  MG_ARRAY_EQUAL_COMPARE(TYPE, scalar2arr, 0, DIFF_TYPE, ABSDIFF, NAN)
 
-#define MG_ARRAY_EQUAL_SCALAR2SCALAR_CASE(TYPE_VALUE, TYPE, TOLERANCE_TYPE, IDL_ARGMEMBER, IDL_TOLMEMBER, ZERO)    \
-    case TYPE_VALUE:                                                                              \
-      is_equal = mg_array_equal_ ## TYPE ## _scalar2scalar((TYPE) argv[0]->value.IDL_ARGMEMBER,   \
-                                                           (TYPE) argv[1]->value.IDL_ARGMEMBER,   \
-                                                           kw.tolerance_present ? kw.tolerance->value.IDL_TOLMEMBER : ZERO, kw.nan); \
+MG_ARRAY_EQUAL_TYPE(UCHAR, UCHAR, MG_I_ABSDIFF, MG_R_NAN)
+MG_ARRAY_EQUAL_TYPE(IDL_INT, IDL_UINT, MG_I_ABSDIFF, MG_R_NAN)
+MG_ARRAY_EQUAL_TYPE(IDL_LONG, IDL_ULONG, MG_I_ABSDIFF, MG_R_NAN)
+MG_ARRAY_EQUAL_TYPE(float, float, MG_R_ABSDIFF, MG_R_NAN)
+MG_ARRAY_EQUAL_TYPE(double, double, MG_R_ABSDIFF, MG_R_NAN)
+MG_ARRAY_EQUAL_TYPE(IDL_COMPLEX, float, MG_C_ABSDIFF, MG_C_NAN)
+MG_ARRAY_EQUAL_TYPE(IDL_DCOMPLEX, double, MG_C_ABSDIFF, MG_C_NAN)
+MG_ARRAY_EQUAL_TYPE(IDL_UINT, IDL_UINT, MG_I_ABSDIFF, MG_R_NAN)
+MG_ARRAY_EQUAL_TYPE(IDL_ULONG, IDL_ULONG, MG_I_ABSDIFF, MG_R_NAN)
+MG_ARRAY_EQUAL_TYPE(IDL_LONG64, IDL_ULONG64, MG_I_ABSDIFF, MG_R_NAN)
+MG_ARRAY_EQUAL_TYPE(IDL_ULONG64, IDL_ULONG64, MG_I_ABSDIFF, MG_R_NAN)
+
+// scalars are compared as 1 element arrays
+#define MG_ARRAY_EQUAL_CASE(TYPE_VALUE, TYPE, DIFF_TYPE, IDL_TOLMEMBER)     \
+    case TYPE_VALUE:                                                         \
+      tolerance_value = kw.tolerance_present ? kw.tolerance->value.IDL_TOLMEMBER : 0; \
+      if (tolerance_value < 0) {                                             \
+        IDL_KW_FREE;                                                         \
+        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,                    \
+                    "TOLERANCE must be non-negative");                       \
+      }                                                                      \
+      if (n1 == n2) {                                                        \
+        is_equal = mg_array_equal_ ## TYPE ## _arr2arr(n1,                   \
+                                                       (TYPE *) data1,       \
+                                                       (TYPE *) data2,       \
+                                                       (DIFF_TYPE) tolerance_value, \
+                                                       kw.nan, stats);       \
+      } else if (n1 == 1) {                                                  \
+        is_equal = mg_array_equal_ ## TYPE ## _scalar2arr(n2,                \
+                                                          (TYPE *) data1,    \
+                                                          (TYPE *) data2,    \
+                                                          (DIFF_TYPE) tolerance_value, \
+                                                          kw.nan, stats);    \
+      } else {                                                               \
+        is_equal = mg_array_equal_ ## TYPE ## _scalar2arr(n1,                \
+                                                          (TYPE *) data2,    \
+                                                          (TYPE *) data1,    \
+                                                          (DIFF_TYPE) tolerance_value, \
+                                                          kw.nan, stats);    \
+      }                                                                      \
       break;
 
 
 static IDL_VPTR IDL_CDECL IDL_mg_array_equal(int argc, IDL_VPTR *argv, char *argk) {
-  int is_equal, nargs;
+  int is_equal = 0, nargs;
+  IDL_MEMINT n1, n2;
+  char *data1, *data2;
+  double tolerance_value;
+  mg_array_equal_stats all_stats, *stats = NULL;
+  IDL_ALLTYPES value;
 
   typedef struct {
     IDL_KW_RESULT_FIRST_FIELD;
+    IDL_VPTR first_index;
+    int first_index_present;
+    IDL_VPTR max_abs_diff;
+    int max_abs_diff_present;
     IDL_LONG nan;
     IDL_LONG no_typeconv;
+    IDL_VPTR n_mismatches;
+    int n_mismatches_present;
     IDL_VPTR tolerance;
     int tolerance_present;
   } KW_RESULT;
 
+  // make sure to list keyword in alphabetical order
   static IDL_KW_PAR kw_pars[] = {
+    { "FIRST_INDEX", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(first_index_present), IDL_KW_OFFSETOF(first_index) },
+    { "MAX_ABS_DIFF", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(max_abs_diff_present), IDL_KW_OFFSETOF(max_abs_diff) },
     { "NAN", IDL_TYP_LONG, 1, IDL_KW_ZERO,
       0, IDL_KW_OFFSETOF(nan) },
     { "NO_TYPECONV", IDL_TYP_LONG, 1, IDL_KW_ZERO,
       0, IDL_KW_OFFSETOF(no_typeconv) },
+    { "N_MISMATCHES", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(n_mismatches_present), IDL_KW_OFFSETOF(n_mismatches) },
     { "TOLERANCE", IDL_TYP_UNDEF, 1, IDL_KW_VIN | IDL_KW_OUT,
       IDL_KW_OFFSETOF(tolerance_present), IDL_KW_OFFSETOF(tolerance) },
     { NULL }
@@ -141,9 +171,19 @@ static IDL_VPTR IDL_CDECL IDL_mg_array_equal(int argc, IDL_VPTR *argv, char *arg
 
   nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
 
+  // statistics are only needed if one of the output keywords is present,
+  // only FIRST_INDEX can still stop at the first mismatch
+  all_stats.find_all = kw.n_mismatches_present || kw.max_abs_diff_present;
+  all_stats.n_mismatches = 0;
+  all_stats.first_index = -1;
+  all_stats.max_abs_diff = 0.0;
+  if (all_stats.find_all || kw.first_index_present) stats = &all_stats;
+
   if (kw.no_typeconv && (argv[0]->type != argv[1]->type)) {
-    IDL_KW_FREE;
-    return IDL_GettmpByte(0);
+    is_equal = 0;
+    all_stats.n_mismatches = -1;
+    all_stats.max_abs_diff = NAN;
+    goto done;
   }
 
   if (argv[0]->type != argv[1]->type) {
@@ -164,67 +204,47 @@ static IDL_VPTR IDL_CDECL IDL_mg_array_equal(int argc, IDL_VPTR *argv, char *arg
 
   // TODO: conversion between two different types
 
-  if (argv[0]->flags & IDL_V_ARR && argv[1]->flags & IDL_V_ARR) {
-    if (argv[0]->value.arr->n_elts != argv[1]->value.arr->n_elts) {
+  IDL_VarGetData(argv[0], &n1, &data1, TRUE);
+  IDL_VarGetData(argv[1], &n2, &data2, TRUE);
+
+  // arrays of different sizes are not equal; a scalar is compared to every
+  // element of an array
+  if ((argv[0]->flags & IDL_V_ARR) && (argv[1]->flags & IDL_V_ARR) && n1 != n2) {
+    is_equal = 0;
+    all_stats.n_mismatches = -1;
+    all_stats.max_abs_diff = NAN;
+    goto done;
+  }
+
+  switch (argv[0]->type) {
+    MG_ARRAY_EQUAL_CASE(IDL_TYP_BYTE, UCHAR, UCHAR, c)
+    MG_ARRAY_EQUAL_CASE(IDL_TYP_INT, IDL_INT, IDL_UINT, i)
+    MG_ARRAY_EQUAL_CASE(IDL_TYP_LONG, IDL_LONG, IDL_ULONG, l)
+    MG_ARRAY_EQUAL_CASE(IDL_TYP_FLOAT, float, float, f)
+    MG_ARRAY_EQUAL_CASE(IDL_TYP_DOUBLE, double, double, d)
+    MG_ARRAY_EQUAL_CASE(IDL_TYP_COMPLEX, IDL_COMPLEX, float, f)
+    MG_ARRAY_EQUAL_CASE(IDL_TYP_DCOMPLEX, IDL_DCOMPLEX, double, d)
+    MG_ARRAY_EQUAL_CASE(IDL_TYP_UINT, IDL_UINT, IDL_UINT, ui)
+    MG_ARRAY_EQUAL_CASE(IDL_TYP_ULONG, IDL_ULONG, IDL_ULONG, ul)
+    MG_ARRAY_EQUAL_CASE(IDL_TYP_LONG64, IDL_LONG64, IDL_ULONG64, l64)
+    MG_ARRAY_EQUAL_CASE(IDL_TYP_ULONG64, IDL_ULONG64, IDL_ULONG64, ul64)
+    default:
       IDL_KW_FREE;
-      return IDL_GettmpByte(0);
-    }
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "unsupported type");
+  }
 
-    switch (argv[0]->type) {
-      MG_ARRAY_EQUAL_ARR2ARR_CASE(1, UCHAR, UCHAR, c, 0)
-      MG_ARRAY_EQUAL_ARR2ARR_CASE(2, IDL_INT, IDL_INT, i, 0)
-      MG_ARRAY_EQUAL_ARR2ARR_CASE(3, IDL_LONG, IDL_LONG, l, 0)
-      MG_ARRAY_EQUAL_ARR2ARR_CASE(4, float, float, f, 0.0)
-      MG_ARRAY_EQUAL_ARR2ARR_CASE(5, double, double, d, 0.0)
-      MG_ARRAY_EQUAL_ARR2ARR_CASE(6, IDL_COMPLEX, float, f, 0.0)
-      MG_ARRAY_EQUAL_ARR2ARR_CASE(9, IDL_DCOMPLEX, double, d, 0.0)
-      MG_ARRAY_EQUAL_ARR2ARR_CASE(12, IDL_UINT, IDL_UINT, ui, 0)
-      MG_ARRAY_EQUAL_ARR2ARR_CASE(13, IDL_ULONG, IDL_ULONG, ul, 0)
-      MG_ARRAY_EQUAL_ARR2ARR_CASE(14, IDL_LONG64, IDL_LONG64, l64, 0)
-      MG_ARRAY_EQUAL_ARR2ARR_CASE(15, IDL_ULONG64, IDL_ULONG64, ul64, 0)
-    }
-  } else if (argv[0]->flags & IDL_V_ARR && !(argv[1]->flags & IDL_V_ARR)) {
-    switch (argv[0]->type) {
-      MG_ARRAY_EQUAL_SCALAR2ARR_CASE(1, UCHAR, argv[1], argv[0], UCHAR, c, c, 0)
-      MG_ARRAY_EQUAL_SCALAR2ARR_CASE(2, IDL_INT, argv[1], argv[0], IDL_INT, i, i, 0)
-      MG_ARRAY_EQUAL_SCALAR2ARR_CASE(3, IDL_LONG, argv[1], argv[0], IDL_LONG, l, l, 0)
-      MG_ARRAY_EQUAL_SCALAR2ARR_CASE(4, float, argv[1], argv[0], float, f, f, 0.0)
-      MG_ARRAY_EQUAL_SCALAR2ARR_CASE(5, double, argv[1], argv[0], double, d, d, 0.0)
-      MG_ARRAY_EQUAL_SCALAR2ARR_CASE(6, IDL_COMPLEX, argv[1], argv[0], float, cmp, f, 0.0)
-      MG_ARRAY_EQUAL_SCALAR2ARR_CASE(9, IDL_DCOMPLEX, argv[1], argv[0], double, dcmp, d, 0.0)
-      MG_ARRAY_EQUAL_SCALAR2ARR_CASE(12, IDL_UINT, argv[1], argv[0], IDL_UINT, ui, ui, 0);
-      MG_ARRAY_EQUAL_SCALAR2ARR_CASE(13, IDL_ULONG, argv[1], argv[0], IDL_ULONG, ul, ul, 0);
-      MG_ARRAY_EQUAL_SCALAR2ARR_CASE(14, IDL_LONG64, argv[1], argv[0], IDL_LONG64, l64, l64, 0);
-      MG_ARRAY_EQUAL_SCALAR2ARR_CASE(15, IDL_ULONG64, argv[1], argv[0], IDL_ULONG64, ul64, ul64, 0);
-    }
-  } else if (!(argv[0]->flags & IDL_V_ARR) && argv[1]->flags & IDL_V_ARR) {
-    switch (argv[0]->type) {
-      MG_ARRAY_EQUAL_SCALAR2ARR_CASE(1, UCHAR, argv[0], argv[1], UCHAR, c, c, 0)
-      MG_ARRAY_EQUAL_SCALAR2ARR_CASE(2, IDL_INT, argv[0], argv[1], IDL_INT, i, i, 0)
-      MG_ARRAY_EQUAL_SCALAR2ARR_CASE(3, IDL_LONG, argv[0], argv[1], IDL_LONG, l, l, 0)
-      MG_ARRAY_EQUAL_SCALAR2ARR_CASE(4, float, argv[0], argv[1], float, f, f, 0.0)
-      MG_ARRAY_EQUAL_SCALAR2ARR_CASE(5, double, argv[0], argv[1], double, d, d, 0.0)
-      MG_ARRAY_EQUAL_SCALAR2ARR_CASE(6, IDL_COMPLEX, argv[0], argv[1], float, cmp, f, 0.0)
-      MG_ARRAY_EQUAL_SCALAR2ARR_CASE(9, IDL_DCOMPLEX, argv[0], argv[1], double, dcmp, d, 0.0)
-      MG_ARRAY_EQUAL_SCALAR2ARR_CASE(12, IDL_UINT, argv[0], argv[1], IDL_UINT, ui, ui, 0)
-      MG_ARRAY_EQUAL_SCALAR2ARR_CASE(13, IDL_ULONG, argv[0], argv[1], IDL_ULONG, ul, ul, 0)
-      MG_ARRAY_EQUAL_SCALAR2ARR_CASE(14, IDL_LONG64, argv[0], argv[1], IDL_LONG64, l64, l64, 0)
-      MG_ARRAY_EQUAL_SCALAR2ARR_CASE(15, IDL_ULONG64, argv[0], argv[1], IDL_ULONG64, ul64, ul64, 0)
-    }
-  } else {
-    switch (argv[0]->type) {
-      MG_ARRAY_EQUAL_SCALAR2SCALAR_CASE(1, UCHAR, UCHAR, c, c, 0)
-      MG_ARRAY_EQUAL_SCALAR2SCALAR_CASE(2, IDL_INT, IDL_INT, i, i, 0)
-      MG_ARRAY_EQUAL_SCALAR2SCALAR_CASE(3, IDL_LONG, IDL_LONG, l, l, 0)
-      MG_ARRAY_EQUAL_SCALAR2SCALAR_CASE(4, float, float, f, f, 0.0)
-      MG_ARRAY_EQUAL_SCALAR2SCALAR_CASE(5, double, double, d, d, 0.0)
-      MG_ARRAY_EQUAL_SCALAR2SCALAR_CASE(6, IDL_COMPLEX, float, cmp, f, 0.0)
-      MG_ARRAY_EQUAL_SCALAR2SCALAR_CASE(9, IDL_DCOMPLEX, double, dcmp, d, 0.0)
-      MG_ARRAY_EQUAL_SCALAR2SCALAR_CASE(12, IDL_UINT, IDL_UINT, ui, ui, 0)
-      MG_ARRAY_EQUAL_SCALAR2SCALAR_CASE(13, IDL_ULONG, IDL_ULONG, ul, ul, 0)
-      MG_ARRAY_EQUAL_SCALAR2SCALAR_CASE(14, IDL_LONG64, IDL_LONG64, l64, l64, 0)
-      MG_ARRAY_EQUAL_SCALAR2SCALAR_CASE(15, IDL_ULONG64, IDL_ULONG64, ul64, ul64, 0)
-    }
+ done:
+  if (kw.n_mismatches_present) {
+    value.l64 = all_stats.n_mismatches;
+    IDL_StoreScalar(kw.n_mismatches, IDL_TYP_LONG64, &value);
+  }
+  if (kw.first_index_present) {
+    value.l64 = all_stats.first_index;
+    IDL_StoreScalar(kw.first_index, IDL_TYP_LONG64, &value);
+  }
+  if (kw.max_abs_diff_present) {
+    value.d = all_stats.max_abs_diff;
+    IDL_StoreScalar(kw.max_abs_diff, IDL_TYP_DOUBLE, &value);
   }
 
   IDL_KW_FREE;
@@ -233,197 +253,1690 @@ static IDL_VPTR IDL_CDECL IDL_mg_array_equal(int argc, IDL_VPTR *argv, char *arg
 }
 
 
-// Uses the Kahan summation algorithm:
-//
-//    http://en.wikipedia.org/wiki/Kahan_summation_algorithm
-#define IDL_MG_TOTAL_TYPE(TYPE, IDL_TYPE, INIT)                              \
-static IDL_VPTR IDL_CDECL IDL_mg_total_ ## IDL_TYPE (IDL_VPTR arg) {         \
-  TYPE sum = INIT, c = INIT, y = INIT, t = INIT;                             \
-  int i;                                                                     \
+/*
+  MG_TOTAL views its input as `inner` x `len` x `outer` real values and sums
+  along `len`; complex values are summed as interleaved real and imaginary
+  parts, i.e., with `inner` doubled.
+
+  When `inner` is 1 or 2, the values to sum are contiguous. They are summed in
+  fixed size blocks using several independent Kahan accumulators ("lanes")
+  that the compiler can keep in vector registers. Block sums are then combined
+  in block order, so the result does not depend on the number of threads.
+  Otherwise, each output element gets its own accumulator and rows of the
+  input are added a block of columns at a time; the rows are split into
+  fixed size blocks as well, so that summing a few long columns is still
+  spread across threads.
+
+  Floating point values are accumulated in double precision, integers in
+  64-bit integers. With INTEGER, floating point values outside of the range
+  of a 64-bit integer are clamped to it and NaN values are an error unless
+  NAN is set.
+*/
+
+#define MG_TOTAL_LANES     8
+#define MG_TOTAL_BLOCK     16384
+#define MG_TOTAL_COLUMNS   512
+#define MG_TOTAL_ROWS      4096
+#define MG_TOTAL_MIN_ELTS  65536
+
+#define MG_KAHAN_ADD(SUM, C, X) {                                            \
+  double _y = (X) - (C);                                                     \
+  double _t = (SUM) + _y;                                                    \
+  (C) = (_t - (SUM)) - _y;                                                   \
+  (SUM) = _t;                                                                \
+}
+
+// with the NAN keyword, NaN and infinite values are treated as 0
+#define MG_TOTAL_VALUE(X, NAN) (((NAN) && (X) - (X) != 0) ? 0 : (X))
+
+typedef struct {
+  UCHAR *data;
+  IDL_MEMINT inner;
+  IDL_MEMINT len;
+  IDL_MEMINT outer;
+  IDL_MEMINT nblocks;    // blocks per output
+  int nan;
+  int invalid[MG_THREADS_MAX];  // NaN found by a thread for INTEGER sums
+  double *fsums;         // partial sums for floating point accumulation
+  IDL_ULONG64 *isums;    // partial sums for integer accumulation
+} mg_total_info;
+
+
+// convert a floating point value to a 64-bit integer for INTEGER sums,
+// without the undefined behavior of casting NaN or out of range values
+static inline IDL_ULONG64 mg_total_real_to_int(double x, int nan,
+                                               int *invalid) {
+  if (x != x) {
+    if (!nan) *invalid = 1;
+    return 0;
+  }
+  if (nan && x - x != 0) return 0;
+  if (x >= 9223372036854775808.0) return 0x7fffffffffffffffULL;
+  if (x < -9223372036854775808.0) return 0x8000000000000000ULL;
+  return (IDL_ULONG64) (IDL_LONG64) x;
+}
+
+#define MG_TOTAL_I_INT(X, NAN, INVALID) ((IDL_ULONG64) (IDL_LONG64) (X))
+#define MG_TOTAL_R_INT(X, NAN, INVALID) mg_total_real_to_int((X), (NAN), (INVALID))
+
+#define MG_TOTAL_CONTIGUOUS(TYPE, TO_INT)                                    \
+static void mg_total_contiguous_ ## TYPE(IDL_MEMINT start, IDL_MEMINT end,   \
+                                         int thread_index, void *data) {     \
+  mg_total_info *info = (mg_total_info *) data;                              \
+  IDL_MEMINT t, k, m, first, last;                                           \
+  int l, c;                                                                  \
+                                                                             \
+  for (t = start; t < end; t++) {                                            \
+    double s[MG_TOTAL_LANES] = { 0.0 }, comp[MG_TOTAL_LANES] = { 0.0 };      \
+    IDL_MEMINT o = t / info->nblocks;                                        \
+    first = (t % info->nblocks) * MG_TOTAL_BLOCK;                            \
+    last = first + MG_TOTAL_BLOCK;                                           \
+    if (last > info->len) last = info->len;                                  \
+    TYPE *p = (TYPE *) info->data + (o * info->len + first) * info->inner;   \
+    m = (last - first) * info->inner;                                        \
                                                                              \
-  TYPE *arr = (TYPE *)arg->value.arr->data;                                  \
+    for (k = 0; k + MG_TOTAL_LANES <= m; k += MG_TOTAL_LANES) {              \
+      for (l = 0; l < MG_TOTAL_LANES; l++) {                                 \
+        double x = (double) p[k + l];                                        \
+        MG_KAHAN_ADD(s[l], comp[l], MG_TOTAL_VALUE(x, info->nan));           \
+      }                                                                      \
+    }                                                                        \
+    for (l = 0; k < m; k++, l++) {                                           \
+      double x = (double) p[k];                                              \
+      MG_KAHAN_ADD(s[l], comp[l], MG_TOTAL_VALUE(x, info->nan));             \
+    }                                                                        \
                                                                              \
-  for (i = 0; i < arg->value.arr->n_elts; i++) {                             \
-    y = arr[i] - c;                                                          \
-    t = sum + y;                                                             \
-    c = (t - sum) - y;                                                       \
-    sum = t;                                                                 \
+    /* lane l holds component l % inner of a complex value */                \
+    for (c = 0; c < info->inner; c++) {                                      \
+      double sum = 0.0, sum_comp = 0.0;                                      \
+      for (l = c; l < MG_TOTAL_LANES; l += info->inner) {                    \
+        MG_KAHAN_ADD(sum, sum_comp, s[l]);                                   \
+        MG_KAHAN_ADD(sum, sum_comp, - comp[l]);                              \
+      }                                                                      \
+      info->fsums[t * info->inner + c] = sum - sum_comp;                     \
+    }                                                                        \
   }                                                                          \
-  return(IDL_Gettmp ## IDL_TYPE (sum));                                      \
-}
-
-#define IDL_MG_TOTAL_CTYPE(TYPE, IDL_TYPE, INIT, FIELD, TYPE_CODE)           \
-static IDL_VPTR IDL_CDECL IDL_mg_total_ ## IDL_TYPE (IDL_VPTR arg) {         \
-  IDL_VPTR result;                                                           \
-  TYPE sum, c, y, t;                                                         \
-                                                                             \
-  int i;                                                                     \
-                                                                             \
-  TYPE *arr = (TYPE *)arg->value.arr->data;                                  \
-                                                                             \
-  sum.r = INIT;                                                              \
-  sum.i = INIT;                                                              \
-  c.r = INIT;                                                                \
-  c.i = INIT;                                                                \
-  y.r = INIT;                                                                \
-  y.i = INIT;                                                                \
-  t.r = INIT;                                                                \
-  t.i = INIT;                                                                \
-                                                                             \
-  for (i = 0; i < arg->value.arr->n_elts; i++) {                             \
-    y.r = arr[i].r - c.r;                                                    \
-    y.i = arr[i].i - c.i;                                                    \
-    t.r = sum.r + y.r;                                                       \
-    t.i = sum.i + y.i;                                                       \
-    c.r = (t.r - sum.r) - y.r;                                               \
-    c.i = (t.i - sum.i) - y.i;                                               \
-    sum.r = t.r;                                                             \
-    sum.i = t.i;                                                             \
+}                                                                            \
+                                                                             \
+static void mg_total_contiguous_int_ ## TYPE(IDL_MEMINT start, IDL_MEMINT end, \
+                                             int thread_index, void *data) { \
+  mg_total_info *info = (mg_total_info *) data;                              \
+  IDL_MEMINT t, k, m, first, last;                                           \
+  int l, c, invalid = 0;                                                     \
+                                                                             \
+  for (t = start; t < end; t++) {                                            \
+    IDL_ULONG64 s[MG_TOTAL_LANES] = { 0 };                                   \
+    IDL_MEMINT o = t / info->nblocks;                                        \
+    first = (t % info->nblocks) * MG_TOTAL_BLOCK;                            \
+    last = first + MG_TOTAL_BLOCK;                                           \
+    if (last > info->len) last = info->len;                                  \
+    TYPE *p = (TYPE *) info->data + (o * info->len + first) * info->inner;   \
+    m = (last - first) * info->inner;                                        \
+                                                                             \
+    for (k = 0; k + MG_TOTAL_LANES <= m; k += MG_TOTAL_LANES) {              \
+      for (l = 0; l < MG_TOTAL_LANES; l++) {                                 \
+        s[l] += TO_INT(p[k + l], info->nan, &invalid);                       \
+      }                                                                      \
+    }                                                                        \
+    for (l = 0; k < m; k++, l++) {                                           \
+      s[l] += TO_INT(p[k], info->nan, &invalid);                             \
+    }                                                                        \
+                                                                             \
+    for (c = 0; c < info->inner; c++) {                                      \
+      IDL_ULONG64 sum = 0;                                                   \
+      for (l = c; l < MG_TOTAL_LANES; l += info->inner) sum += s[l];         \
+      info->isums[t * info->inner + c] = sum;                                \
+    }                                                                        \
   }                                                                          \
+  if (invalid) info->invalid[thread_index] = 1;                              \
+}
+
+#define MG_TOTAL_STRIDED(TYPE, TO_INT)                                       \
+static void mg_total_strided_ ## TYPE(IDL_MEMINT start, IDL_MEMINT end,      \
+                                      int thread_index, void *data) {        \
+  mg_total_info *info = (mg_total_info *) data;                              \
+  IDL_MEMINT ncolblocks = (info->inner + MG_TOTAL_COLUMNS - 1) / MG_TOTAL_COLUMNS; \
+  IDL_MEMINT t, i, j, ni, first, last;                                       \
+  double s[MG_TOTAL_COLUMNS], comp[MG_TOTAL_COLUMNS];                        \
                                                                              \
-  result = IDL_Gettmp();                                                     \
-  result->type = TYPE_CODE;                                                  \
-  result->value.FIELD.r = sum.r;                                             \
-  result->value.FIELD.i = sum.i;                                             \
+  for (t = start; t < end; t++) {                                            \
+    IDL_MEMINT ob = t / ncolblocks, o = ob / info->nblocks;                  \
+    IDL_MEMINT i0 = (t % ncolblocks) * MG_TOTAL_COLUMNS;                     \
+    ni = info->inner - i0 < MG_TOTAL_COLUMNS ? info->inner - i0 : MG_TOTAL_COLUMNS; \
+    first = (ob % info->nblocks) * MG_TOTAL_ROWS;                            \
+    last = first + MG_TOTAL_ROWS < info->len ? first + MG_TOTAL_ROWS : info->len; \
+    for (i = 0; i < ni; i++) s[i] = comp[i] = 0.0;                           \
                                                                              \
-  return(result);                                                            \
+    for (j = first; j < last; j++) {                                         \
+      TYPE *row = (TYPE *) info->data + (o * info->len + j) * info->inner + i0; \
+      for (i = 0; i < ni; i++) {                                             \
+        double x = (double) row[i];                                          \
+        MG_KAHAN_ADD(s[i], comp[i], MG_TOTAL_VALUE(x, info->nan));           \
+      }                                                                      \
+    }                                                                        \
+                                                                             \
+    for (i = 0; i < ni; i++) {                                               \
+      info->fsums[ob * info->inner + i0 + i] = s[i] - comp[i];               \
+    }                                                                        \
+  }                                                                          \
+}                                                                            \
+                                                                             \
+static void mg_total_strided_int_ ## TYPE(IDL_MEMINT start, IDL_MEMINT end, \
+                                          int thread_index, void *data) {    \
+  mg_total_info *info = (mg_total_info *) data;                              \
+  IDL_MEMINT ncolblocks = (info->inner + MG_TOTAL_COLUMNS - 1) / MG_TOTAL_COLUMNS; \
+  IDL_MEMINT t, i, j, ni, first, last;                                       \
+  IDL_ULONG64 s[MG_TOTAL_COLUMNS];                                           \
+  int invalid = 0;                                                           \
+                                                                             \
+  for (t = start; t < end; t++) {                                            \
+    IDL_MEMINT ob = t / ncolblocks, o = ob / info->nblocks;                  \
+    IDL_MEMINT i0 = (t % ncolblocks) * MG_TOTAL_COLUMNS;                     \
+    ni = info->inner - i0 < MG_TOTAL_COLUMNS ? info->inner - i0 : MG_TOTAL_COLUMNS; \
+    first = (ob % info->nblocks) * MG_TOTAL_ROWS;                            \
+    last = first + MG_TOTAL_ROWS < info->len ? first + MG_TOTAL_ROWS : info->len; \
+    for (i = 0; i < ni; i++) s[i] = 0;                                       \
+                                                                             \
+    for (j = first; j < last; j++) {                                         \
+      TYPE *row = (TYPE *) info->data + (o * info->len + j) * info->inner + i0; \
+      for (i = 0; i < ni; i++) {                                             \
+        s[i] += TO_INT(row[i], info->nan, &invalid);                         \
+      }                                                                      \
+    }                                                                        \
+                                                                             \
+    for (i = 0; i < ni; i++) {                                               \
+      info->isums[ob * info->inner + i0 + i] = s[i];                         \
+    }                                                                        \
+  }                                                                          \
+  if (invalid) info->invalid[thread_index] = 1;                              \
+}
+
+MG_TOTAL_CONTIGUOUS(UCHAR, MG_TOTAL_I_INT)
+MG_TOTAL_CONTIGUOUS(IDL_INT, MG_TOTAL_I_INT)
+MG_TOTAL_CONTIGUOUS(IDL_LONG, MG_TOTAL_I_INT)
+MG_TOTAL_CONTIGUOUS(float, MG_TOTAL_R_INT)
+MG_TOTAL_CONTIGUOUS(double, MG_TOTAL_R_INT)
+MG_TOTAL_CONTIGUOUS(IDL_UINT, MG_TOTAL_I_INT)
+MG_TOTAL_CONTIGUOUS(IDL_ULONG, MG_TOTAL_I_INT)
+MG_TOTAL_CONTIGUOUS(IDL_LONG64, MG_TOTAL_I_INT)
+MG_TOTAL_CONTIGUOUS(IDL_ULONG64, MG_TOTAL_I_INT)
+
+MG_TOTAL_STRIDED(UCHAR, MG_TOTAL_I_INT)
+MG_TOTAL_STRIDED(IDL_INT, MG_TOTAL_I_INT)
+MG_TOTAL_STRIDED(IDL_LONG, MG_TOTAL_I_INT)
+MG_TOTAL_STRIDED(float, MG_TOTAL_R_INT)
+MG_TOTAL_STRIDED(double, MG_TOTAL_R_INT)
+MG_TOTAL_STRIDED(IDL_UINT, MG_TOTAL_I_INT)
+MG_TOTAL_STRIDED(IDL_ULONG, MG_TOTAL_I_INT)
+MG_TOTAL_STRIDED(IDL_LONG64, MG_TOTAL_I_INT)
+MG_TOTAL_STRIDED(IDL_ULONG64, MG_TOTAL_I_INT)
+
+#define MG_TOTAL_KERNEL_CASE(TYPE_VALUE, TYPE)                               \
+    case TYPE_VALUE:                                                         \
+      if (contiguous) {                                                      \
+        return int_accum ? mg_total_contiguous_int_ ## TYPE : mg_total_contiguous_ ## TYPE; \
+      } else {                                                               \
+        return int_accum ? mg_total_strided_int_ ## TYPE : mg_total_strided_ ## TYPE; \
+      }
+
+// find the kernel for the given element type, complex types use their parts
+static mg_thread_work mg_total_kernel(int type, int int_accum, int contiguous) {
+  switch (type) {
+    MG_TOTAL_KERNEL_CASE(IDL_TYP_BYTE, UCHAR)
+    MG_TOTAL_KERNEL_CASE(IDL_TYP_INT, IDL_INT)
+    MG_TOTAL_KERNEL_CASE(IDL_TYP_LONG, IDL_LONG)
+    MG_TOTAL_KERNEL_CASE(IDL_TYP_FLOAT, float)
+    MG_TOTAL_KERNEL_CASE(IDL_TYP_DOUBLE, double)
+    MG_TOTAL_KERNEL_CASE(IDL_TYP_COMPLEX, float)
+    MG_TOTAL_KERNEL_CASE(IDL_TYP_DCOMPLEX, double)
+    MG_TOTAL_KERNEL_CASE(IDL_TYP_UINT, IDL_UINT)
+    MG_TOTAL_KERNEL_CASE(IDL_TYP_ULONG, IDL_ULONG)
+    MG_TOTAL_KERNEL_CASE(IDL_TYP_LONG64, IDL_LONG64)
+    MG_TOTAL_KERNEL_CASE(IDL_TYP_ULONG64, IDL_ULONG64)
+  }
+  return NULL;
+}
+
+#define MG_TOTAL_STORE_CASE(TYPE_VALUE, TYPE)                                \
+    case TYPE_VALUE:                                                         \
+      for (i = 0; i < n; i++) {                                              \
+        ((TYPE *) dest)[i] = fsums ? (TYPE) fsums[i] : (TYPE) (IDL_LONG64) isums[i]; \
+      }                                                                      \
+      break;
+
+// convert n sums to the given type; complex types have 2 sums per element
+static void mg_total_store(int type, char *dest,
+                           double *fsums, IDL_ULONG64 *isums, IDL_MEMINT n) {
+  IDL_MEMINT i;
+  switch (type) {
+    MG_TOTAL_STORE_CASE(IDL_TYP_BYTE, UCHAR)
+    MG_TOTAL_STORE_CASE(IDL_TYP_INT, IDL_INT)
+    MG_TOTAL_STORE_CASE(IDL_TYP_LONG, IDL_LONG)
+    MG_TOTAL_STORE_CASE(IDL_TYP_FLOAT, float)
+    MG_TOTAL_STORE_CASE(IDL_TYP_DOUBLE, double)
+    MG_TOTAL_STORE_CASE(IDL_TYP_COMPLEX, float)
+    MG_TOTAL_STORE_CASE(IDL_TYP_DCOMPLEX, double)
+    MG_TOTAL_STORE_CASE(IDL_TYP_UINT, IDL_UINT)
+    MG_TOTAL_STORE_CASE(IDL_TYP_ULONG, IDL_ULONG)
+    MG_TOTAL_STORE_CASE(IDL_TYP_LONG64, IDL_LONG64)
+    MG_TOTAL_STORE_CASE(IDL_TYP_ULONG64, IDL_ULONG64)
+  }
 }
 
-IDL_MG_TOTAL_TYPE(UCHAR, Byte, 0)
-IDL_MG_TOTAL_TYPE(short int, Int, 0)
-IDL_MG_TOTAL_TYPE(int, Long, 0)
-IDL_MG_TOTAL_TYPE(float, Float, 0.0)
-IDL_MG_TOTAL_TYPE(double, Double, 0.0)
-IDL_MG_TOTAL_CTYPE(IDL_COMPLEX, Complex, 0.0, cmp, IDL_TYP_COMPLEX)
-IDL_MG_TOTAL_CTYPE(IDL_DCOMPLEX, DComplex, 0.0, dcmp, IDL_TYP_DCOMPLEX)
-IDL_MG_TOTAL_TYPE(IDL_UINT, UInt, 0)
-IDL_MG_TOTAL_TYPE(IDL_ULONG, ULong, 0)
-IDL_MG_TOTAL_TYPE(IDL_LONG64, Long64, 0)
-IDL_MG_TOTAL_TYPE(IDL_ULONG64, ULong64, 0)
 
 static IDL_VPTR IDL_CDECL IDL_mg_total(int argc, IDL_VPTR *argv, char *argk) {
+  IDL_VPTR result;
+  IDL_ARRAY *arr;
+  IDL_MEMINT dims[IDL_MAX_ARRAY_DIM];
+  IDL_MEMINT o, c, b, d, ntasks, npartial, nout, elts_per_task;
+  mg_total_info info;
+  mg_thread_work kernel;
+  double *fout = NULL;
+  IDL_ULONG64 *iout = NULL;
+  int nargs, type, result_type, is_complex, int_accum, contiguous;
+  int dimension, double_kw, integer, n_threads, nthreads, t, ndims = 0;
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_LONG dimension;
+    IDL_LONG double_kw;
+    IDL_LONG integer;
+    IDL_LONG nan;
+    IDL_LONG n_threads;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "DIMENSION", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(dimension) },
+    { "DOUBLE", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(double_kw) },
+    { "INTEGER", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(integer) },
+    { "NAN", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(nan) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+  dimension = kw.dimension;
+  double_kw = kw.double_kw;
+  integer = kw.integer;
+  n_threads = kw.n_threads;
+  info.nan = kw.nan;
+  IDL_KW_FREE;
+
+  IDL_ENSURE_SIMPLE(argv[0]);
   IDL_ENSURE_ARRAY(argv[0]);
-  switch (argv[0]->type) {
-    case IDL_TYP_BYTE:
-      return(IDL_mg_total_Byte(argv[0]));
-    case IDL_TYP_INT:
-      return(IDL_mg_total_Int(argv[0]));
-    case IDL_TYP_LONG:
-      return(IDL_mg_total_Long(argv[0]));
-    case IDL_TYP_FLOAT:
-      return(IDL_mg_total_Float(argv[0]));
-    case IDL_TYP_DOUBLE:
-      return(IDL_mg_total_Double(argv[0]));
-    case IDL_TYP_COMPLEX:
-      return(IDL_mg_total_Complex(argv[0]));
-    case IDL_TYP_DCOMPLEX:
-      return(IDL_mg_total_DComplex(argv[0]));
-    case IDL_TYP_UINT:
-      return(IDL_mg_total_UInt(argv[0]));
-    case IDL_TYP_ULONG:
-      return(IDL_mg_total_ULong(argv[0]));
-    case IDL_TYP_LONG64:
-      return(IDL_mg_total_Long64(argv[0]));
-    case IDL_TYP_ULONG64:
-      return(IDL_mg_total_ULong64(argv[0]));
-    default:
-      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "unknown type");
+
+  type = argv[0]->type;
+  arr = argv[0]->value.arr;
+  is_complex = type == IDL_TYP_COMPLEX || type == IDL_TYP_DCOMPLEX;
+
+  if (mg_total_kernel(type, 0, 0) == NULL) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "unknown type");
+  }
+
+  if (integer && double_kw) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "conflicting keywords, INTEGER and DOUBLE");
+  }
+
+  if (integer && is_complex) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "INTEGER not allowed for complex types");
   }
-  return(IDL_GettmpLong(0));  // needed to not get a compiler warning
+
+  if (dimension < 0 || dimension > arr->n_dim) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "illegal value for DIMENSION");
+  }
+
+  // accumulator and result types
+  if (integer) {
+    result_type = IDL_TYP_LONG64;
+    int_accum = 1;
+  } else if (double_kw) {
+    result_type = is_complex ? IDL_TYP_DCOMPLEX : IDL_TYP_DOUBLE;
+    int_accum = 0;
+  } else {
+    result_type = type;
+    int_accum = type != IDL_TYP_FLOAT && type != IDL_TYP_DOUBLE && !is_complex;
+  }
+
+  // view the array as inner x len x outer
+  info.data = arr->data;
+  info.inner = 1;
+  info.outer = 1;
+  if (dimension == 0) {
+    info.len = arr->n_elts;
+  } else {
+    for (d = 0; d < dimension - 1; d++) {
+      info.inner *= arr->dim[d];
+      dims[ndims++] = arr->dim[d];
+    }
+    info.len = arr->dim[dimension - 1];
+    for (d = dimension; d < arr->n_dim; d++) {
+      info.outer *= arr->dim[d];
+      dims[ndims++] = arr->dim[d];
+    }
+  }
+  if (is_complex) info.inner *= 2;
+
+  contiguous = info.inner <= 2;
+  if (contiguous) {
+    info.nblocks = (info.len + MG_TOTAL_BLOCK - 1) / MG_TOTAL_BLOCK;
+    ntasks = info.outer * info.nblocks;
+    npartial = ntasks * info.inner;
+    elts_per_task = MG_TOTAL_BLOCK * info.inner;
+  } else {
+    info.nblocks = (info.len + MG_TOTAL_ROWS - 1) / MG_TOTAL_ROWS;
+    ntasks = info.outer * info.nblocks
+               * ((info.inner + MG_TOTAL_COLUMNS - 1) / MG_TOTAL_COLUMNS);
+    npartial = info.outer * info.nblocks * info.inner;
+    elts_per_task = (info.len < MG_TOTAL_ROWS ? info.len : MG_TOTAL_ROWS)
+                      * (info.inner < MG_TOTAL_COLUMNS ? info.inner : MG_TOTAL_COLUMNS);
+  }
+  nout = info.outer * info.inner;
+
+  // partial sums, plus space for the combined sums if there is more than one
+  // block per output element
+  info.fsums = NULL;
+  info.isums = NULL;
+  if (int_accum) {
+    info.isums = (IDL_ULONG64 *) IDL_MemAlloc(npartial * sizeof(IDL_ULONG64),
+                                              "partial sums", IDL_MSG_LONGJMP);
+    iout = info.isums;
+    if (info.nblocks > 1) {
+      iout = (IDL_ULONG64 *) IDL_MemAlloc(nout * sizeof(IDL_ULONG64),
+                                          "sums", IDL_MSG_RET);
+    }
+  } else {
+    info.fsums = (double *) IDL_MemAlloc(npartial * sizeof(double),
+                                         "partial sums", IDL_MSG_LONGJMP);
+    fout = info.fsums;
+    if (info.nblocks > 1) {
+      fout = (double *) IDL_MemAlloc(nout * sizeof(double),
+                                     "sums", IDL_MSG_RET);
+    }
+  }
+
+  if (fout == NULL && iout == NULL) {
+    if (info.fsums) IDL_MemFree(info.fsums, NULL, IDL_MSG_RET);
+    if (info.isums) IDL_MemFree(info.isums, NULL, IDL_MSG_RET);
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unable to allocate memory for sums");
+  }
+
+  kernel = mg_total_kernel(type, int_accum, contiguous);
+  nthreads = mg_thread_count(ntasks, MG_TOTAL_MIN_ELTS / elts_per_task,
+                             n_threads);
+  for (t = 0; t < nthreads; t++) info.invalid[t] = 0;
+  mg_thread_run(nthreads, ntasks, kernel, &info);
+
+  for (t = 0; t < nthreads; t++) {
+    if (info.invalid[t]) {
+      if (iout != info.isums) IDL_MemFree(iout, NULL, IDL_MSG_RET);
+      IDL_MemFree(info.isums, NULL, IDL_MSG_RET);
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "INTEGER sums of NaN values require NAN");
+    }
+  }
+
+  // combine block sums in order
+  if (info.nblocks > 1) {
+    for (o = 0; o < info.outer; o++) {
+      for (c = 0; c < info.inner; c++) {
+        if (int_accum) {
+          IDL_ULONG64 sum = 0;
+          for (b = 0; b < info.nblocks; b++) {
+            sum += info.isums[(o * info.nblocks + b) * info.inner + c];
+          }
+          iout[o * info.inner + c] = sum;
+        } else {
+          double sum = 0.0, sum_comp = 0.0;
+          for (b = 0; b < info.nblocks; b++) {
+            MG_KAHAN_ADD(sum, sum_comp,
+                         info.fsums[(o * info.nblocks + b) * info.inner + c]);
+          }
+          fout[o * info.inner + c] = sum - sum_comp;
+        }
+      }
+    }
+  }
+
+  if (ndims == 0) {
+    result = IDL_Gettmp();
+    result->type = result_type;
+    mg_total_store(result_type, (char *) &result->value, fout, iout, nout);
+  } else {
+    char *result_data = IDL_MakeTempArray(result_type, ndims, dims,
+                                          IDL_ARR_INI_NOP, &result);
+    mg_total_store(result_type, result_data, fout, iout, nout);
+  }
+
+  if (fout != info.fsums) IDL_MemFree(fout, NULL, IDL_MSG_RET);
+  if (iout != info.isums) IDL_MemFree(iout, NULL, IDL_MSG_RET);
+  if (info.fsums) IDL_MemFree(info.fsums, NULL, IDL_MSG_RET);
+  if (info.isums) IDL_MemFree(info.isums, NULL, IDL_MSG_RET);
+
+  return result;
 }
 
-#define IDL_MG_MATRIX_VECTOR_MULTIPLY(TYPE)                                  \
-void IDL_mg_matrix_vector_multiply_ ## TYPE(TYPE *a_data, TYPE *b_data, TYPE *result_data, int n, int m) { \
-  int row, col;                                                              \
-  for (row = 0; row < m; row++) {                                            \
-    for (col = 0; col < n; col++) {                                          \
-      result_data[row] += a_data[row * n + col] * b_data[col];               \
+/*
+  Batched matrix products. For each batch, computes C = op(A) op(B) where A,
+  B, and C are stored in IDL's row-major "##" convention, i.e., a matrix with
+  m rows and k columns is an IDL array of dimensions (k, m). Transposes are
+  handled with strides:
+
+    op(A)[i, p] = a[i * sai + p * sap]
+    op(B)[p, j] = b[p * sbp + j * sbj]
+    C[i, j]     = c[i * n + j]
+
+  A matrix-vector product is the case n = 1.
+
+  Small matrices of common fixed sizes are computed by kernels where the
+  sizes are compile-time constants. These copy a tile of MG_BATCH_LANES
+  batches into structure-of-arrays buffers, so the innermost loop runs across
+  batches and vectorizes, while the loops over matrix elements unroll. Batches
+  are split across threads.
+*/
+
+#define MG_BATCH_LANES     8
+#define MG_BATCH_MIN_WORK  16384
+
+typedef struct {
+  UCHAR *a;
+  UCHAR *b;
+  UCHAR *c;
+  IDL_MEMINT m;
+  IDL_MEMINT k;
+  IDL_MEMINT n;
+  IDL_MEMINT sai;
+  IDL_MEMINT sap;
+  IDL_MEMINT sbp;
+  IDL_MEMINT sbj;
+} mg_batch_info;
+
+#define MG_R_MULADD(c, a, b) (c) += (a) * (b)
+#define MG_C_MULADD(c, a, b) {                                               \
+  (c).r += (a).r * (b).r - (a).i * (b).i;                                    \
+  (c).i += (a).r * (b).i + (a).i * (b).r;                                    \
+}
+
+// any size, any strides; c must be zeroed
+#define MG_BATCH_GENERIC(TYPE, MULADD)                                       \
+static void mg_batch_generic_ ## TYPE(IDL_MEMINT start, IDL_MEMINT end,      \
+                                      int thread_index, void *data) {        \
+  mg_batch_info *info = (mg_batch_info *) data;                              \
+  IDL_MEMINT batch, i, p, j;                                                 \
+  IDL_MEMINT a_size = info->m * info->k;                                     \
+  IDL_MEMINT b_size = info->k * info->n;                                     \
+  IDL_MEMINT c_size = info->m * info->n;                                     \
+                                                                             \
+  for (batch = start; batch < end; batch++) {                                \
+    TYPE *a = (TYPE *) info->a + batch * a_size;                             \
+    TYPE *b = (TYPE *) info->b + batch * b_size;                             \
+    TYPE *c = (TYPE *) info->c + batch * c_size;                             \
+    for (i = 0; i < info->m; i++) {                                          \
+      for (p = 0; p < info->k; p++) {                                        \
+        TYPE a_ip = a[i * info->sai + p * info->sap];                        \
+        for (j = 0; j < info->n; j++) {                                      \
+          MULADD(c[i * info->n + j], a_ip, b[p * info->sbp + j * info->sbj]); \
+        }                                                                    \
+      }                                                                      \
     }                                                                        \
   }                                                                          \
 }
 
-IDL_MG_MATRIX_VECTOR_MULTIPLY(UCHAR)
-IDL_MG_MATRIX_VECTOR_MULTIPLY(IDL_INT)
-IDL_MG_MATRIX_VECTOR_MULTIPLY(IDL_LONG)
-IDL_MG_MATRIX_VECTOR_MULTIPLY(float)
-IDL_MG_MATRIX_VECTOR_MULTIPLY(double)
-IDL_MG_MATRIX_VECTOR_MULTIPLY(IDL_UINT)
-IDL_MG_MATRIX_VECTOR_MULTIPLY(IDL_ULONG)
-IDL_MG_MATRIX_VECTOR_MULTIPLY(IDL_LONG64)
-IDL_MG_MATRIX_VECTOR_MULTIPLY(IDL_ULONG64)
-
-#define IDL_MG_BATCH_MATRIX_VECTOR_MULTIPLY(TYPE, IDL_TYPE)                   \
-IDL_VPTR IDL_mg_batch_matrix_vector_multiply_ ## TYPE(IDL_VPTR a, IDL_VPTR b, int n, int m, int n_multiplies) { \
-  IDL_VPTR result;                                                            \
-  int i;                                                                      \
-  IDL_MEMINT dims[] = { m, n_multiplies };                                    \
-  TYPE *result_data = (TYPE *) IDL_MakeTempArray(IDL_TYPE, 2, dims, IDL_ARR_INI_ZERO, &result); \
-  TYPE *a_data = (TYPE *)a->value.arr->data;                                  \
-  TYPE *b_data = (TYPE *)b->value.arr->data;                                  \
-  for (i = 0; i < n_multiplies; i++) {                                        \
-    IDL_mg_matrix_vector_multiply_ ## TYPE(a_data + n * m * i,                \
-                                           b_data + n * i,                    \
-                                           result_data + m * i,               \
-                                           n, m);                             \
-  }                                                                           \
-  return result;                                                              \
-}
-
-IDL_MG_BATCH_MATRIX_VECTOR_MULTIPLY(UCHAR, IDL_TYP_BYTE)
-IDL_MG_BATCH_MATRIX_VECTOR_MULTIPLY(IDL_INT, IDL_TYP_INT)
-IDL_MG_BATCH_MATRIX_VECTOR_MULTIPLY(IDL_LONG, IDL_TYP_LONG)
-IDL_MG_BATCH_MATRIX_VECTOR_MULTIPLY(float, IDL_TYP_FLOAT)
-IDL_MG_BATCH_MATRIX_VECTOR_MULTIPLY(double, IDL_TYP_DOUBLE)
-IDL_MG_BATCH_MATRIX_VECTOR_MULTIPLY(IDL_UINT, IDL_TYP_UINT)
-IDL_MG_BATCH_MATRIX_VECTOR_MULTIPLY(IDL_ULONG, IDL_TYP_ULONG)
-IDL_MG_BATCH_MATRIX_VECTOR_MULTIPLY(IDL_LONG64, IDL_TYP_LONG64)
-IDL_MG_BATCH_MATRIX_VECTOR_MULTIPLY(IDL_ULONG64, IDL_TYP_ULONG64)
-
-static IDL_VPTR IDL_mg_batched_matrix_vector_multiply(int argc, IDL_VPTR *argv) {
-  IDL_VPTR a = argv[0];
-  IDL_VPTR b = argv[1];
-  IDL_LONG n = IDL_LongScalar(argv[2]);
-  IDL_LONG m = IDL_LongScalar(argv[3]);
-  IDL_LONG n_multiplies = IDL_LongScalar(argv[4]);
-  IDL_VPTR result;
+MG_BATCH_GENERIC(UCHAR, MG_R_MULADD)
+MG_BATCH_GENERIC(IDL_INT, MG_R_MULADD)
+MG_BATCH_GENERIC(IDL_LONG, MG_R_MULADD)
+MG_BATCH_GENERIC(float, MG_R_MULADD)
+MG_BATCH_GENERIC(double, MG_R_MULADD)
+MG_BATCH_GENERIC(IDL_COMPLEX, MG_C_MULADD)
+MG_BATCH_GENERIC(IDL_DCOMPLEX, MG_C_MULADD)
+MG_BATCH_GENERIC(IDL_UINT, MG_R_MULADD)
+MG_BATCH_GENERIC(IDL_ULONG, MG_R_MULADD)
+MG_BATCH_GENERIC(IDL_LONG64, MG_R_MULADD)
+MG_BATCH_GENERIC(IDL_ULONG64, MG_R_MULADD)
 
-  switch (a->type) {
-    case IDL_TYP_BYTE:
-      result = IDL_mg_batch_matrix_vector_multiply_UCHAR(a, b, n, m, n_multiplies);
-      break;
-    case IDL_TYP_INT:
-      result = IDL_mg_batch_matrix_vector_multiply_IDL_INT(a, b, n, m, n_multiplies);
-      break;
-    case IDL_TYP_LONG:
-      result = IDL_mg_batch_matrix_vector_multiply_IDL_LONG(a, b, n, m, n_multiplies);
-      break;
+// fixed size M x K times K x N, no transposes, real types
+#define MG_BATCH_FIXED(TYPE, M, K, N)                                        \
+static void mg_batch_fixed_ ## TYPE ## _ ## M ## _ ## K ## _ ## N(IDL_MEMINT start, \
+                                                                   IDL_MEMINT end, \
+                                                                   int thread_index, \
+                                                                   void *data) { \
+  mg_batch_info *info = (mg_batch_info *) data;                              \
+  TYPE as[M * K][MG_BATCH_LANES];                                            \
+  TYPE bs[K * N][MG_BATCH_LANES];                                            \
+  TYPE cs[M * N][MG_BATCH_LANES];                                            \
+  IDL_MEMINT batch;                                                          \
+  int e, i, p, j, l;                                                         \
+                                                                             \
+  for (batch = start; batch + MG_BATCH_LANES <= end; batch += MG_BATCH_LANES) { \
+    TYPE *a = (TYPE *) info->a + batch * (M * K);                            \
+    TYPE *b = (TYPE *) info->b + batch * (K * N);                            \
+    TYPE *c = (TYPE *) info->c + batch * (M * N);                            \
+                                                                             \
+    for (l = 0; l < MG_BATCH_LANES; l++) {                                   \
+      for (e = 0; e < M * K; e++) as[e][l] = a[l * (M * K) + e];             \
+      for (e = 0; e < K * N; e++) bs[e][l] = b[l * (K * N) + e];             \
+    }                                                                        \
+                                                                             \
+    for (i = 0; i < M; i++) {                                                \
+      for (j = 0; j < N; j++) {                                              \
+        for (l = 0; l < MG_BATCH_LANES; l++) cs[i * N + j][l] = 0;           \
+        for (p = 0; p < K; p++) {                                            \
+          for (l = 0; l < MG_BATCH_LANES; l++) {                             \
+            cs[i * N + j][l] += as[i * K + p][l] * bs[p * N + j][l];         \
+          }                                                                  \
+        }                                                                    \
+      }                                                                      \
+    }                                                                        \
+                                                                             \
+    for (l = 0; l < MG_BATCH_LANES; l++) {                                   \
+      for (e = 0; e < M * N; e++) c[l * (M * N) + e] = cs[e][l];             \
+    }                                                                        \
+  }                                                                          \
+                                                                             \
+  /* leftover batches that do not fill a tile */                             \
+  mg_batch_generic_ ## TYPE(batch, end, thread_index, data);                 \
+}
+
+#define MG_BATCH_FIXED_SIZES(TYPE)                                           \
+  MG_BATCH_FIXED(TYPE, 2, 2, 1)                                              \
+  MG_BATCH_FIXED(TYPE, 3, 3, 1)                                              \
+  MG_BATCH_FIXED(TYPE, 4, 4, 1)                                              \
+  MG_BATCH_FIXED(TYPE, 6, 6, 1)                                              \
+  MG_BATCH_FIXED(TYPE, 2, 2, 2)                                              \
+  MG_BATCH_FIXED(TYPE, 3, 3, 3)                                              \
+  MG_BATCH_FIXED(TYPE, 4, 4, 4)                                              \
+  MG_BATCH_FIXED(TYPE, 6, 6, 6)
+
+MG_BATCH_FIXED_SIZES(float)
+MG_BATCH_FIXED_SIZES(double)
+
+#define MG_BATCH_FIXED_CASE(TYPE, M, K, N)                                   \
+  if (m == M && k == K && n == N) return mg_batch_fixed_ ## TYPE ## _ ## M ## _ ## K ## _ ## N;
+
+#define MG_BATCH_FIXED_CASES(TYPE)                                           \
+  MG_BATCH_FIXED_CASE(TYPE, 2, 2, 1)                                         \
+  MG_BATCH_FIXED_CASE(TYPE, 3, 3, 1)                                         \
+  MG_BATCH_FIXED_CASE(TYPE, 4, 4, 1)                                         \
+  MG_BATCH_FIXED_CASE(TYPE, 6, 6, 1)                                         \
+  MG_BATCH_FIXED_CASE(TYPE, 2, 2, 2)                                         \
+  MG_BATCH_FIXED_CASE(TYPE, 3, 3, 3)                                         \
+  MG_BATCH_FIXED_CASE(TYPE, 4, 4, 4)                                         \
+  MG_BATCH_FIXED_CASE(TYPE, 6, 6, 6)
+
+// find the kernel for the given type and sizes, NULL for unsupported types
+static mg_thread_work mg_batch_kernel(int type,
+                                      IDL_MEMINT m, IDL_MEMINT k, IDL_MEMINT n,
+                                      int transposed) {
+  switch (type) {
+    case IDL_TYP_BYTE:     return mg_batch_generic_UCHAR;
+    case IDL_TYP_INT:      return mg_batch_generic_IDL_INT;
+    case IDL_TYP_LONG:     return mg_batch_generic_IDL_LONG;
     case IDL_TYP_FLOAT:
-      result = IDL_mg_batch_matrix_vector_multiply_float(a, b, n, m, n_multiplies);
-      break;
+      if (!transposed) {
+        MG_BATCH_FIXED_CASES(float)
+      }
+      return mg_batch_generic_float;
     case IDL_TYP_DOUBLE:
-      result = IDL_mg_batch_matrix_vector_multiply_double(a, b, n, m, n_multiplies);
-      break;
-    case IDL_TYP_UINT:
-      result = IDL_mg_batch_matrix_vector_multiply_IDL_UINT(a, b, n, m, n_multiplies);
-      break;
-    case IDL_TYP_ULONG:
-      result = IDL_mg_batch_matrix_vector_multiply_IDL_ULONG(a, b, n, m, n_multiplies);
-      break;
-    case IDL_TYP_LONG64:
-      result = IDL_mg_batch_matrix_vector_multiply_IDL_LONG64(a, b, n, m, n_multiplies);
-      break;
-    case IDL_TYP_ULONG64:
-      result = IDL_mg_batch_matrix_vector_multiply_IDL_ULONG64(a, b, n, m, n_multiplies);
-      break;
+      if (!transposed) {
+        MG_BATCH_FIXED_CASES(double)
+      }
+      return mg_batch_generic_double;
+    case IDL_TYP_COMPLEX:  return mg_batch_generic_IDL_COMPLEX;
+    case IDL_TYP_DCOMPLEX: return mg_batch_generic_IDL_DCOMPLEX;
+    case IDL_TYP_UINT:     return mg_batch_generic_IDL_UINT;
+    case IDL_TYP_ULONG:    return mg_batch_generic_IDL_ULONG;
+    case IDL_TYP_LONG64:   return mg_batch_generic_IDL_LONG64;
+    case IDL_TYP_ULONG64:  return mg_batch_generic_IDL_ULONG64;
+  }
+  return NULL;
+}
+
+
+/*
+  Check inputs and compute n_batches products of op(A) (m x k) and op(B)
+  (k x n), returning an array with the given dimensions.
+*/
+static IDL_VPTR mg_batched_multiply(IDL_VPTR a, IDL_VPTR b,
+                                    IDL_MEMINT m, IDL_MEMINT k, IDL_MEMINT n,
+                                    int transpose_a, int transpose_b,
+                                    IDL_MEMINT n_batches,
+                                    int n_dims, IDL_MEMINT *dims,
+                                    int n_threads) {
+  IDL_VPTR result;
+  mg_batch_info info;
+  mg_thread_work kernel;
+  IDL_MEMINT work;
+
+  IDL_ENSURE_SIMPLE(a);
+  IDL_ENSURE_ARRAY(a);
+  IDL_ENSURE_SIMPLE(b);
+  IDL_ENSURE_ARRAY(b);
+
+  if (a->type != b->type) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "input arrays must be of the same type");
+  }
+
+  kernel = mg_batch_kernel(a->type, m, k, n, transpose_a || transpose_b);
+  if (kernel == NULL) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "unsupported type");
+  }
+
+  if (m < 1 || k < 1 || n < 1 || n_batches < 0) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "invalid matrix dimensions");
+  }
+
+  if (a->value.arr->n_elts < m * k * n_batches
+        || b->value.arr->n_elts < k * n * n_batches) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "input arrays too small for the given dimensions");
+  }
+
+  info.a = a->value.arr->data;
+  info.b = b->value.arr->data;
+  info.c = (UCHAR *) IDL_MakeTempArray(a->type, n_dims, dims,
+                                       IDL_ARR_INI_ZERO, &result);
+  info.m = m;
+  info.k = k;
+  info.n = n;
+  info.sai = transpose_a ? 1 : k;
+  info.sap = transpose_a ? m : 1;
+  info.sbp = transpose_b ? 1 : n;
+  info.sbj = transpose_b ? k : 1;
+
+  work = m * k * n;
+  mg_thread_run(mg_thread_count(n_batches, MG_BATCH_MIN_WORK / work, n_threads),
+                n_batches, kernel, &info);
+
+  return result;
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_batched_matrix_vector_multiply(int argc, IDL_VPTR *argv, char *argk) {
+  IDL_LONG n, m, n_multiplies;
+  IDL_MEMINT dims[2];
+  int n_threads, nargs;
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_LONG n_threads;
+  } KW_RESULT;
+
+  static IDL_KW_PAR kw_pars[] = {
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+  n_threads = kw.n_threads;
+  IDL_KW_FREE;
+
+  n = IDL_LongScalar(argv[2]);
+  m = IDL_LongScalar(argv[3]);
+  n_multiplies = IDL_LongScalar(argv[4]);
+
+  dims[0] = m;
+  dims[1] = n_multiplies;
+
+  return mg_batched_multiply(argv[0], argv[1], m, n, 1, 0, 0, n_multiplies,
+                             2, dims, n_threads);
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_batched_matrix_multiply(int argc, IDL_VPTR *argv, char *argk) {
+  IDL_VPTR a = argv[0], b = argv[1];
+  IDL_MEMINT m, k, n, b_rows, n_batches, dims[IDL_MAX_ARRAY_DIM];
+  int d, n_dims, n_threads, transpose_a, transpose_b, nargs;
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_LONG n_threads;
+    IDL_LONG transpose_a;
+    IDL_LONG transpose_b;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { "TRANSPOSE_A", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(transpose_a) },
+    { "TRANSPOSE_B", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(transpose_b) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+  n_threads = kw.n_threads;
+  transpose_a = kw.transpose_a != 0;
+  transpose_b = kw.transpose_b != 0;
+  IDL_KW_FREE;
+
+  IDL_ENSURE_SIMPLE(a);
+  IDL_ENSURE_ARRAY(a);
+  IDL_ENSURE_SIMPLE(b);
+  IDL_ENSURE_ARRAY(b);
+
+  if (a->value.arr->n_dim < 2 || b->value.arr->n_dim < 2) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "input arrays must have at least 2 dimensions");
+  }
+
+  // an IDL array of dimensions (cols, rows, ...) holds matrices with rows x
+  // cols elements
+  m = transpose_a ? a->value.arr->dim[0] : a->value.arr->dim[1];
+  k = transpose_a ? a->value.arr->dim[1] : a->value.arr->dim[0];
+  b_rows = transpose_b ? b->value.arr->dim[0] : b->value.arr->dim[1];
+  n = transpose_b ? b->value.arr->dim[1] : b->value.arr->dim[0];
+
+  if (k != b_rows) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "incompatible matrix dimensions");
+  }
+
+  n_batches = a->value.arr->n_elts / (m * k);
+  if (b->value.arr->n_elts / (k * n) != n_batches) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "input arrays must have the same number of matrices");
+  }
+
+  // result has dimensions (n, m, ...) with the batch dimensions of a
+  n_dims = a->value.arr->n_dim;
+  dims[0] = n;
+  dims[1] = m;
+  for (d = 2; d < n_dims; d++) dims[d] = a->value.arr->dim[d];
+
+  return mg_batched_multiply(a, b, m, k, n, transpose_a, transpose_b,
+                             n_batches, n_dims, dims, n_threads);
+}
+
+
+/*
+  Stable LSD radix sort returning the sorting permutation.
+
+  Values are first mapped to unsigned keys that sort in the same order as the
+  values: the sign bit of signed integers is flipped, and for floating point
+  values the sign bit is flipped for positive values and all bits are flipped
+  for negative values (the same transform as `MG_SORT_BASE`). Only the bits
+  needed for the range max - min are sorted on, using as few passes of up to
+  MG_SORT_DIGIT_BITS bits as possible, or a single pass of up to 16 bits for
+  large arrays. A pass where all keys have the same digit is skipped.
+
+  Each pass computes a histogram of digits per thread over a contiguous chunk
+  of the array, then each thread scatters its chunk to offsets computed from
+  the histograms, which keeps the sort stable. Keys and indices ping-pong
+  between the result, the key array, and a single scratch allocation.
+
+  Strings are sorted by character, from the last position to the first, with
+  characters past the end of a string sorting before any other character.
+*/
+
+#define MG_SORT_DIGIT_BITS  11
+#define MG_SORT_MIN_ELTS    65536
+#define MG_SORT_ALIGN(x)    (((x) + 7) & ~((IDL_MEMINT) 7))
+
+typedef struct {
+  IDL_MEMINT n;
+  int nthreads;
+  IDL_MEMINT *counts;   // nthreads x nbuckets histograms, then offsets
+  IDL_MEMINT nbuckets;
+  int shift;
+  IDL_ULONG64 min;
+  void *src_keys;
+  void *dst_keys;
+  void *src_index;      // NULL for the identity permutation
+  void *dst_index;
+  IDL_ULONG64 mins[MG_THREADS_MAX];
+  IDL_ULONG64 maxs[MG_THREADS_MAX];
+  // for strings
+  IDL_STRING *strings;
+  int pos;
+  void *data;
+} mg_sort_info;
+
+
+// compute keys of a chunk of the data along with the chunk's min and max key
+#define MG_SORT_KEYS(TYPE, KEY, TRANSFORM)                                   \
+static void mg_sort_keys_ ## TYPE(IDL_MEMINT start, IDL_MEMINT end,          \
+                                  int thread_index, void *data) {            \
+  mg_sort_info *info = (mg_sort_info *) data;                                \
+  TYPE *values = (TYPE *) info->data;                                        \
+  KEY *keys = (KEY *) info->src_keys;                                        \
+  KEY key, min = (KEY) -1, max = 0;                                          \
+  IDL_MEMINT i;                                                              \
+                                                                             \
+  for (i = start; i < end; i++) {                                            \
+    key = TRANSFORM(values[i]);                                              \
+    keys[i] = key;                                                           \
+    if (key < min) min = key;                                                \
+    if (key > max) max = key;                                                \
+  }                                                                          \
+  info->mins[thread_index] = min;                                            \
+  info->maxs[thread_index] = max;                                            \
+}
+
+static inline IDL_ULONG mg_sort_float_key(float x) {
+  IDL_ULONG u;
+  memcpy(&u, &x, sizeof(u));
+  return (u & 0x80000000UL) ? ~u : u ^ 0x80000000UL;
+}
+
+static inline IDL_ULONG64 mg_sort_double_key(double x) {
+  IDL_ULONG64 u;
+  memcpy(&u, &x, sizeof(u));
+  return (u & 0x8000000000000000ULL) ? ~u : u ^ 0x8000000000000000ULL;
+}
+
+#define MG_SORT_KEY_UNSIGNED(x) (x)
+#define MG_SORT_KEY_INT(x)      ((IDL_ULONG) (IDL_UINT) (x) ^ 0x8000UL)
+#define MG_SORT_KEY_LONG(x)     ((IDL_ULONG) (x) ^ 0x80000000UL)
+#define MG_SORT_KEY_LONG64(x)   ((IDL_ULONG64) (x) ^ 0x8000000000000000ULL)
+
+MG_SORT_KEYS(UCHAR, IDL_ULONG, MG_SORT_KEY_UNSIGNED)
+MG_SORT_KEYS(IDL_INT, IDL_ULONG, MG_SORT_KEY_INT)
+MG_SORT_KEYS(IDL_LONG, IDL_ULONG, MG_SORT_KEY_LONG)
+MG_SORT_KEYS(float, IDL_ULONG, mg_sort_float_key)
+MG_SORT_KEYS(double, IDL_ULONG64, mg_sort_double_key)
+MG_SORT_KEYS(IDL_UINT, IDL_ULONG, MG_SORT_KEY_UNSIGNED)
+MG_SORT_KEYS(IDL_ULONG, IDL_ULONG, MG_SORT_KEY_UNSIGNED)
+MG_SORT_KEYS(IDL_LONG64, IDL_ULONG64, MG_SORT_KEY_LONG64)
+MG_SORT_KEYS(IDL_ULONG64, IDL_ULONG64, MG_SORT_KEY_UNSIGNED)
+
+
+#define MG_SORT_DIGIT(key) ((IDL_MEMINT) (((key) - min) >> info->shift) & mask)
+
+// histogram the digits of a chunk of keys
+#define MG_SORT_HISTOGRAM(KEY)                                               \
+static void mg_sort_histogram_ ## KEY(IDL_MEMINT start, IDL_MEMINT end,      \
+                                      int thread_index, void *data) {        \
+  mg_sort_info *info = (mg_sort_info *) data;                                \
+  KEY *keys = (KEY *) info->src_keys;                                        \
+  KEY min = (KEY) info->min;                                                 \
+  IDL_MEMINT mask = info->nbuckets - 1;                                      \
+  IDL_MEMINT *counts = info->counts + thread_index * info->nbuckets;         \
+  IDL_MEMINT i;                                                              \
+                                                                             \
+  for (i = 0; i < info->nbuckets; i++) counts[i] = 0;                        \
+  for (i = start; i < end; i++) counts[MG_SORT_DIGIT(keys[i])]++;            \
+}
+
+MG_SORT_HISTOGRAM(IDL_ULONG)
+MG_SORT_HISTOGRAM(IDL_ULONG64)
+
+
+// move a chunk of keys and indices to their positions for the current digit
+#define MG_SORT_SCATTER(KEY, INDEX)                                          \
+static void mg_sort_scatter_ ## KEY ## _ ## INDEX(IDL_MEMINT start,          \
+                                                  IDL_MEMINT end,            \
+                                                  int thread_index,          \
+                                                  void *data) {              \
+  mg_sort_info *info = (mg_sort_info *) data;                                \
+  KEY *src_keys = (KEY *) info->src_keys;                                    \
+  KEY *dst_keys = (KEY *) info->dst_keys;                                    \
+  INDEX *src_index = (INDEX *) info->src_index;                              \
+  INDEX *dst_index = (INDEX *) info->dst_index;                              \
+  KEY min = (KEY) info->min;                                                 \
+  IDL_MEMINT mask = info->nbuckets - 1;                                      \
+  IDL_MEMINT *offsets = info->counts + thread_index * info->nbuckets;        \
+  IDL_MEMINT i, j;                                                           \
+                                                                             \
+  for (i = start; i < end; i++) {                                            \
+    j = offsets[MG_SORT_DIGIT(src_keys[i])]++;                               \
+    if (dst_keys) dst_keys[j] = src_keys[i];                                 \
+    dst_index[j] = src_index ? src_index[i] : (INDEX) i;                     \
+  }                                                                          \
+}
+
+MG_SORT_SCATTER(IDL_ULONG, IDL_LONG)
+MG_SORT_SCATTER(IDL_ULONG, IDL_LONG64)
+MG_SORT_SCATTER(IDL_ULONG64, IDL_LONG)
+MG_SORT_SCATTER(IDL_ULONG64, IDL_LONG64)
+
+
+#define MG_SORT_CHAR(index)                                                  \
+  (info->pos < info->strings[index].slen                                     \
+     ? (UCHAR) info->strings[index].s[info->pos]                             \
+     : 0)
+
+#define MG_SORT_STRINGS(INDEX)                                               \
+static void mg_sort_string_histogram_ ## INDEX(IDL_MEMINT start,             \
+                                               IDL_MEMINT end,               \
+                                               int thread_index,             \
+                                               void *data) {                 \
+  mg_sort_info *info = (mg_sort_info *) data;                                \
+  INDEX *src_index = (INDEX *) info->src_index;                              \
+  IDL_MEMINT *counts = info->counts + thread_index * info->nbuckets;         \
+  IDL_MEMINT i;                                                              \
+                                                                             \
+  for (i = 0; i < info->nbuckets; i++) counts[i] = 0;                        \
+  for (i = start; i < end; i++) {                                            \
+    counts[MG_SORT_CHAR(src_index ? src_index[i] : i)]++;                    \
+  }                                                                          \
+}                                                                            \
+                                                                             \
+static void mg_sort_string_scatter_ ## INDEX(IDL_MEMINT start,               \
+                                             IDL_MEMINT end,                 \
+                                             int thread_index,               \
+                                             void *data) {                   \
+  mg_sort_info *info = (mg_sort_info *) data;                                \
+  INDEX *src_index = (INDEX *) info->src_index;                              \
+  INDEX *dst_index = (INDEX *) info->dst_index;                              \
+  IDL_MEMINT *offsets = info->counts + thread_index * info->nbuckets;        \
+  IDL_MEMINT i;                                                              \
+  INDEX index;                                                               \
+                                                                             \
+  for (i = start; i < end; i++) {                                            \
+    index = src_index ? src_index[i] : (INDEX) i;                            \
+    dst_index[offsets[MG_SORT_CHAR(index)]++] = index;                       \
+  }                                                                          \
+}
+
+MG_SORT_STRINGS(IDL_LONG)
+MG_SORT_STRINGS(IDL_LONG64)
+
+
+/*
+  Convert per-thread histograms into per-thread starting offsets. Returns 0 if
+  all items have the same digit, i.e., the pass can be skipped.
+*/
+static int mg_sort_offsets(mg_sort_info *info) {
+  IDL_MEMINT b, total, offset = 0;
+  int t;
+
+  for (b = 0; b < info->nbuckets; b++) {
+    total = 0;
+    for (t = 0; t < info->nthreads; t++) {
+      IDL_MEMINT count = info->counts[t * info->nbuckets + b];
+      info->counts[t * info->nbuckets + b] = offset + total;
+      total += count;
+    }
+    if (total == info->n) return 0;
+    offset += total;
+  }
+
+  return 1;
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_radix_sort(int argc, IDL_VPTR *argv, char *argk) {
+  IDL_VPTR data = argv[0], result;
+  IDL_MEMINT n, scratch_size, index_size, key_size = 0, counts_size;
+  IDL_MEMINT b;
+  int nargs, n_threads, wide_index, wide_key = 0, npasses = 0, bits, width;
+  int p, t, max_slen = 0;
+  char *values, *scratch;
+  void *index, *keys = NULL;
+  mg_sort_info info;
+  mg_thread_work keys_work = NULL, histogram_work, scatter_work;
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_LONG n_threads;
+  } KW_RESULT;
+
+  static IDL_KW_PAR kw_pars[] = {
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+  n_threads = kw.n_threads;
+  IDL_KW_FREE;
+
+  IDL_ENSURE_SIMPLE(data);
+  IDL_VarGetData(data, &n, &values, FALSE);
+
+  switch (data->type) {
+    case IDL_TYP_BYTE:    keys_work = mg_sort_keys_UCHAR; break;
+    case IDL_TYP_INT:     keys_work = mg_sort_keys_IDL_INT; break;
+    case IDL_TYP_LONG:    keys_work = mg_sort_keys_IDL_LONG; break;
+    case IDL_TYP_FLOAT:   keys_work = mg_sort_keys_float; break;
+    case IDL_TYP_DOUBLE:  keys_work = mg_sort_keys_double; wide_key = 1; break;
+    case IDL_TYP_UINT:    keys_work = mg_sort_keys_IDL_UINT; break;
+    case IDL_TYP_ULONG:   keys_work = mg_sort_keys_IDL_ULONG; break;
+    case IDL_TYP_LONG64:  keys_work = mg_sort_keys_IDL_LONG64; wide_key = 1; break;
+    case IDL_TYP_ULONG64: keys_work = mg_sort_keys_IDL_ULONG64; wide_key = 1; break;
+    case IDL_TYP_STRING:  break;
     default:
       IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "unsupported type");
-      break;
   }
-  
+
+  // indices are returned as LONG unless there are too many elements
+  wide_index = n > 2147483647;
+  index_size = wide_index ? sizeof(IDL_LONG64) : sizeof(IDL_LONG);
+  index = IDL_MakeTempVector(wide_index ? IDL_TYP_LONG64 : IDL_TYP_LONG, n,
+                             IDL_ARR_INI_NOP, &result);
+
+  info.n = n;
+  info.nthreads = mg_thread_count(n, MG_SORT_MIN_ELTS, n_threads);
+  info.data = values;
+  info.min = 0;
+
+  if (data->type == IDL_TYP_STRING) {
+    IDL_STRING *strings = (IDL_STRING *) values;
+    for (b = 0; b < n; b++) {
+      if (strings[b].slen > max_slen) max_slen = strings[b].slen;
+    }
+    info.strings = strings;
+    info.nbuckets = 256;
+    npasses = max_slen;
+    histogram_work = wide_index ? mg_sort_string_histogram_IDL_LONG64 : mg_sort_string_histogram_IDL_LONG;
+    scatter_work = wide_index ? mg_sort_string_scatter_IDL_LONG64 : mg_sort_string_scatter_IDL_LONG;
+  } else {
+    key_size = wide_key ? sizeof(IDL_ULONG64) : sizeof(IDL_ULONG);
+    histogram_work = wide_key ? mg_sort_histogram_IDL_ULONG64 : mg_sort_histogram_IDL_ULONG;
+    if (wide_key) {
+      scatter_work = wide_index ? mg_sort_scatter_IDL_ULONG64_IDL_LONG64 : mg_sort_scatter_IDL_ULONG64_IDL_LONG;
+    } else {
+      scatter_work = wide_index ? mg_sort_scatter_IDL_ULONG_IDL_LONG64 : mg_sort_scatter_IDL_ULONG_IDL_LONG;
+    }
+    info.nbuckets = (IDL_MEMINT) 1 << 16;
+  }
+
+  // single scratch buffer: histograms, indices, and two sets of keys
+  counts_size = MG_SORT_ALIGN(info.nthreads * info.nbuckets * sizeof(IDL_MEMINT));
+  scratch_size = counts_size
+                   + MG_SORT_ALIGN(n * index_size)
+                   + 2 * MG_SORT_ALIGN(n * key_size);
+  scratch = (char *) IDL_MemAlloc(scratch_size, "sort scratch space", IDL_MSG_RET);
+  if (scratch == NULL) {
+    IDL_Deltmp(result);
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unable to allocate memory for sort");
+  }
+  info.counts = (IDL_MEMINT *) scratch;
+  info.src_index = NULL;
+
+  if (data->type != IDL_TYP_STRING) {
+    IDL_ULONG64 min, max, range;
+
+    keys = scratch + counts_size + MG_SORT_ALIGN(n * index_size);
+    info.src_keys = keys;
+    mg_thread_run(info.nthreads, n, keys_work, &info);
+
+    min = info.mins[0];
+    max = info.maxs[0];
+    for (t = 1; t < info.nthreads; t++) {
+      if (info.mins[t] < min) min = info.mins[t];
+      if (info.maxs[t] > max) max = info.maxs[t];
+    }
+    info.min = min;
+
+    // choose digit widths from the number of bits in the range of keys
+    range = max - min;
+    for (bits = 0; bits < 64 && range >> bits; bits++);
+    if (bits == 0) {
+      npasses = 0;
+      width = 0;
+    } else if (bits <= 8 || (bits <= 16 && n >= 4 * ((IDL_MEMINT) 1 << bits))) {
+      npasses = 1;
+      width = bits;
+    } else {
+      npasses = (bits + MG_SORT_DIGIT_BITS - 1) / MG_SORT_DIGIT_BITS;
+      width = (bits + npasses - 1) / npasses;
+    }
+    info.nbuckets = (IDL_MEMINT) 1 << width;
+  }
+
+  for (p = 0; p < npasses; p++) {
+    if (data->type == IDL_TYP_STRING) {
+      info.pos = max_slen - 1 - p;
+    } else {
+      info.shift = p * width;
+      info.dst_keys = p == npasses - 1
+                        ? NULL
+                        : (char *) keys + (info.src_keys == keys ? MG_SORT_ALIGN(n * key_size) : 0);
+    }
+
+    mg_thread_run(info.nthreads, n, histogram_work, &info);
+    if (!mg_sort_offsets(&info)) continue;
+
+    info.dst_index = info.src_index == index ? scratch + counts_size : index;
+    mg_thread_run(info.nthreads, n, scatter_work, &info);
+
+    info.src_index = info.dst_index;
+    if (info.dst_keys) info.src_keys = info.dst_keys;
+  }
+
+  if (info.src_index == NULL) {
+    for (b = 0; b < n; b++) {
+      if (wide_index) {
+        ((IDL_LONG64 *) index)[b] = b;
+      } else {
+        ((IDL_LONG *) index)[b] = (IDL_LONG) b;
+      }
+    }
+  } else if (info.src_index != index) {
+    memcpy(index, info.src_index, n * index_size);
+  }
+
+  IDL_MemFree(scratch, NULL, IDL_MSG_RET);
+
+  return result;
+}
+
+/**************************************************************************
+  MG_GLCM_MATRIX and MG_GLCM_FEATURES
+***************************************************************************/
+
+/*
+  Grey-level co-occurrence matrices for a list of offsets at once. The image
+  is quantized once, with the same rule as MG_GLCM, i.e., level
+  floor((v - min) * (n_levels - 0.5) / (max - min)), and NaNs are marked so
+  that pairs containing them are skipped. Element [j, i] of the matrix for
+  offset [dx, dy] counts the reference pixels [x, y] of level i whose
+  neighbor [x + dx, y + dy] has level j.
+
+  For a window, the reference pixels with a neighbor in the window form a
+  rectangle of columns and rows for each offset. Moving a window right by
+  the step only removes the columns leaving that rectangle and adds the
+  columns entering it, so sliding windows cost O(step * height) per window
+  and offset plus the O(n_levels^2) of the features. Threads work on
+  separate rows of windows, or separate rows of the image for a single
+  matrix, each with private matrices.
+*/
+
+#define MG_GLCM_MAX_LEVELS  4096
+#define MG_GLCM_N_FEATURES  5
+#define MG_GLCM_INVALID     0xFFFF
+#define MG_GLCM_MIN_PIXELS  65536
+
+typedef struct {
+  char *data;
+  IDL_UINT *levels;
+  IDL_MEMINT nx;
+  IDL_MEMINT ny;
+  IDL_MEMINT n_levels;
+  IDL_MEMINT n_offsets;
+  IDL_MEMINT *offsets;     // dx, dy for each offset
+  int symmetric;
+  double min;
+  double scale;
+  int n_threads;
+  IDL_LONG *counts;        // n_levels^2 * n_offsets per thread
+  IDL_MEMINT per_thread;   // size of the counts of each thread
+  IDL_LONG *result;        // merged matrices
+  IDL_MEMINT wx;           // window size and step
+  IDL_MEMINT wy;
+  IDL_MEMINT sx;
+  IDL_MEMINT sy;
+  IDL_MEMINT n_wx;         // number of windows in each direction
+  IDL_MEMINT n_wy;
+  double *features;        // MG_GLCM_N_FEATURES * n_offsets per window
+} mg_glcm_info;
+
+
+#define MG_GLCM_QUANTIZE(TYPE)                                               \
+static void mg_glcm_quantize_ ## TYPE(IDL_MEMINT start, IDL_MEMINT end,      \
+                                      int thread_index, void *data) {        \
+  mg_glcm_info *info = (mg_glcm_info *) data;                                \
+  TYPE *src = (TYPE *) info->data;                                           \
+  IDL_MEMINT i, level;                                                       \
+  double x;                                                                  \
+                                                                             \
+  for (i = start; i < end; i++) {                                            \
+    x = (double) src[i];                                                     \
+    if (x != x) {                                                            \
+      info->levels[i] = MG_GLCM_INVALID;                                     \
+      continue;                                                              \
+    }                                                                        \
+    level = (IDL_MEMINT) floor((x - info->min) * info->scale);               \
+    if (level < 0) level = 0;                                                \
+    if (level >= info->n_levels) level = info->n_levels - 1;                 \
+    info->levels[i] = (IDL_UINT) level;                                      \
+  }                                                                          \
+}                                                                            \
+                                                                             \
+static void mg_glcm_range_ ## TYPE(char *data, IDL_MEMINT n,                 \
+                                   double *lo, double *hi) {                 \
+  TYPE *src = (TYPE *) data;                                                 \
+  IDL_MEMINT i;                                                              \
+  double x;                                                                  \
+                                                                             \
+  *lo = 0.0;                                                                 \
+  *hi = -1.0;                                                                \
+  for (i = 0; i < n; i++) {                                                  \
+    x = (double) src[i];                                                     \
+    if (x != x) continue;                                                    \
+    if (*lo > *hi) {                                                         \
+      *lo = *hi = x;                                                         \
+    } else if (x < *lo) {                                                    \
+      *lo = x;                                                               \
+    } else if (x > *hi) {                                                    \
+      *hi = x;                                                               \
+    }                                                                        \
+  }                                                                          \
+}
+
+MG_GLCM_QUANTIZE(UCHAR)
+MG_GLCM_QUANTIZE(IDL_INT)
+MG_GLCM_QUANTIZE(IDL_LONG)
+MG_GLCM_QUANTIZE(float)
+MG_GLCM_QUANTIZE(double)
+MG_GLCM_QUANTIZE(IDL_UINT)
+MG_GLCM_QUANTIZE(IDL_ULONG)
+MG_GLCM_QUANTIZE(IDL_LONG64)
+MG_GLCM_QUANTIZE(IDL_ULONG64)
+
+typedef void (*mg_glcm_range)(char *data, IDL_MEMINT n, double *lo, double *hi);
+
+#define MG_GLCM_QUANTIZE_CASE(TYPE_VALUE, TYPE)                              \
+  case TYPE_VALUE:                                                           \
+    *range = mg_glcm_range_ ## TYPE;                                         \
+    return mg_glcm_quantize_ ## TYPE;
+
+static mg_thread_work mg_glcm_quantize_kernel(int type, mg_glcm_range *range) {
+  switch (type) {
+    MG_GLCM_QUANTIZE_CASE(IDL_TYP_BYTE, UCHAR)
+    MG_GLCM_QUANTIZE_CASE(IDL_TYP_INT, IDL_INT)
+    MG_GLCM_QUANTIZE_CASE(IDL_TYP_LONG, IDL_LONG)
+    MG_GLCM_QUANTIZE_CASE(IDL_TYP_FLOAT, float)
+    MG_GLCM_QUANTIZE_CASE(IDL_TYP_DOUBLE, double)
+    MG_GLCM_QUANTIZE_CASE(IDL_TYP_UINT, IDL_UINT)
+    MG_GLCM_QUANTIZE_CASE(IDL_TYP_ULONG, IDL_ULONG)
+    MG_GLCM_QUANTIZE_CASE(IDL_TYP_LONG64, IDL_LONG64)
+    MG_GLCM_QUANTIZE_CASE(IDL_TYP_ULONG64, IDL_ULONG64)
+  }
+  return NULL;
+}
+
+
+// add (sign 1) or remove (sign -1) the pairs of reference pixels in column
+// x, rows y0 to y1, for offset dx, dy
+static inline void mg_glcm_column(mg_glcm_info *info, IDL_LONG *m,
+                                  IDL_MEMINT dx, IDL_MEMINT dy, IDL_MEMINT x,
+                                  IDL_MEMINT y0, IDL_MEMINT y1, int sign) {
+  IDL_UINT *ref = info->levels + y0 * info->nx + x;
+  IDL_UINT *nbr = ref + dy * info->nx + dx;
+  IDL_MEMINT y, a, b, n_levels = info->n_levels;
+
+  for (y = y0; y <= y1; y++, ref += info->nx, nbr += info->nx) {
+    a = *ref;
+    b = *nbr;
+    if (a == MG_GLCM_INVALID || b == MG_GLCM_INVALID) continue;
+    m[a * n_levels + b] += sign;
+    if (info->symmetric) m[b * n_levels + a] += sign;
+  }
+}
+
+
+// accumulate the matrices of reference rows [start, end) of the whole image
+static void mg_glcm_rows(IDL_MEMINT start, IDL_MEMINT end,
+                         int thread_index, void *data) {
+  mg_glcm_info *info = (mg_glcm_info *) data;
+  IDL_MEMINT size = info->n_levels * info->n_levels;
+  IDL_LONG *counts = info->counts + thread_index * info->per_thread;
+  IDL_MEMINT k, dx, dy, x, y0, y1;
+
+  for (k = 0; k < info->n_offsets; k++) {
+    dx = info->offsets[2 * k];
+    dy = info->offsets[2 * k + 1];
+    y0 = start > -dy ? start : -dy;
+    y1 = end - 1 < info->ny - 1 - dy ? end - 1 : info->ny - 1 - dy;
+    if (y0 > y1) continue;
+    for (x = dx < 0 ? -dx : 0; x < info->nx - (dx > 0 ? dx : 0); x++) {
+      mg_glcm_column(info, counts + k * size, dx, dy, x, y0, y1, 1);
+    }
+  }
+}
+
+
+// merge the private matrices of the threads for entries [start, end)
+static void mg_glcm_merge(IDL_MEMINT start, IDL_MEMINT end,
+                          int thread_index, void *data) {
+  mg_glcm_info *info = (mg_glcm_info *) data;
+  IDL_MEMINT i;
+  IDL_LONG sum;
+  int t;
+
+  for (i = start; i < end; i++) {
+    for (t = 0, sum = 0; t < info->n_threads; t++) sum += info->counts[t * info->per_thread + i];
+    info->result[i] = sum;
+  }
+}
+
+
+/*
+  Haralick features of a co-occurrence matrix: contrast, correlation,
+  energy (angular second moment), homogeneity (inverse difference moment),
+  and entropy (natural log). Correlation is 1 if either marginal has no
+  variance; all features are NaN for an empty matrix. Everything comes from
+  one pass over the counts since levels are small integers.
+*/
+static void mg_glcm_features(IDL_LONG *m, IDL_MEMINT n_levels, double *features) {
+  double total = 0.0, c, d2, si = 0.0, sj = 0.0, sii = 0.0, sjj = 0.0, sij = 0.0;
+  double contrast = 0.0, energy = 0.0, homogeneity = 0.0, clogc = 0.0;
+  double mx, my, vx, vy;
+  IDL_MEMINT i, j;
+
+  for (i = 0; i < n_levels; i++) {
+    for (j = 0; j < n_levels; j++) {
+      if (m[i * n_levels + j] == 0) continue;
+      c = (double) m[i * n_levels + j];
+      d2 = (double) (i - j) * (i - j);
+      total += c;
+      si += i * c;
+      sj += j * c;
+      sii += (double) i * i * c;
+      sjj += (double) j * j * c;
+      sij += (double) i * j * c;
+      contrast += d2 * c;
+      energy += c * c;
+      homogeneity += c / (1.0 + d2);
+      clogc += c * log(c);
+    }
+  }
+
+  if (total == 0.0) {
+    for (i = 0; i < MG_GLCM_N_FEATURES; i++) features[i] = NAN;
+    return;
+  }
+
+  mx = si / total;
+  my = sj / total;
+  vx = sii / total - mx * mx;
+  vy = sjj / total - my * my;
+
+  features[0] = contrast / total;
+  features[1] = vx > 0.0 && vy > 0.0 ? (sij / total - mx * my) / sqrt(vx * vy) : 1.0;
+  features[2] = energy / (total * total);
+  features[3] = homogeneity / total;
+  features[4] = log(total) - clogc / total;
+}
+
+
+// features of each window in rows of windows [start, end)
+static void mg_glcm_windows(IDL_MEMINT start, IDL_MEMINT end,
+                            int thread_index, void *data) {
+  mg_glcm_info *info = (mg_glcm_info *) data;
+  IDL_MEMINT size = info->n_levels * info->n_levels;
+  IDL_LONG *counts = info->counts + thread_index * info->per_thread;
+  IDL_MEMINT wi, wj, k, x, dx, dy, x0, y0, xa, xb, ya, yb;
+  IDL_LONG *m;
+
+  for (wj = start; wj < end; wj++) {
+    y0 = wj * info->sy;
+    for (k = 0; k < info->n_offsets; k++) {
+      dx = info->offsets[2 * k];
+      dy = info->offsets[2 * k + 1];
+      m = counts + k * size;
+      memset(m, 0, size * sizeof(IDL_LONG));
+
+      // rectangle of reference pixels with neighbors in the window
+      ya = y0 + (dy < 0 ? -dy : 0);
+      yb = y0 + info->wy - 1 - (dy > 0 ? dy : 0);
+      xa = dx < 0 ? -dx : 0;
+      xb = info->wx - 1 - (dx > 0 ? dx : 0);
+
+      for (wi = 0; wi < info->n_wx; wi++) {
+        x0 = wi * info->sx;
+        if (ya <= yb && xa <= xb) {
+          if (wi == 0 || info->sx > xb - xa) {
+            if (wi > 0) memset(m, 0, size * sizeof(IDL_LONG));
+            for (x = x0 + xa; x <= x0 + xb; x++) {
+              mg_glcm_column(info, m, dx, dy, x, ya, yb, 1);
+            }
+          } else {
+            for (x = x0 - info->sx + xa; x < x0 + xa; x++) {
+              mg_glcm_column(info, m, dx, dy, x, ya, yb, -1);
+            }
+            for (x = x0 - info->sx + xb + 1; x <= x0 + xb; x++) {
+              mg_glcm_column(info, m, dx, dy, x, ya, yb, 1);
+            }
+          }
+        }
+        mg_glcm_features(m, info->n_levels,
+                         info->features
+                           + MG_GLCM_N_FEATURES * (k + info->n_offsets * (wi + info->n_wx * wj)));
+      }
+    }
+  }
+}
+
+
+// read a scalar or 2-element integer keyword
+static int mg_glcm_pair(IDL_VPTR var, IDL_MEMINT *pair) {
+  IDL_VPTR lng;
+  IDL_MEMINT n;
+  IDL_LONG64 *v;
+
+  if (var == NULL || var->type == IDL_TYP_UNDEF) return 0;
+  IDL_ENSURE_SIMPLE(var);
+  lng = var->type == IDL_TYP_LONG64 ? var : IDL_CvtLng64(1, &var, NULL);
+  IDL_VarGetData(lng, &n, (char **) &v, FALSE);
+  pair[0] = v[0];
+  pair[1] = v[n > 1 ? 1 : 0];
+  if (lng != var) IDL_Deltmp(lng);
+
+  return 1;
+}
+
+
+static IDL_VPTR mg_glcm(int argc, IDL_VPTR *argv, char *argk, int features) {
+  IDL_VPTR image = argv[0], offsets_var, result;
+  IDL_ARRAY *arr;
+  mg_glcm_info info;
+  mg_thread_work quantize;
+  mg_glcm_range range;
+  IDL_MEMINT n_offset_values, i, size, n_work, dims[4], window[2], step[2];
+  IDL_LONG64 *offset_values;
+  double lo, hi;
+  int nargs, n_dims = 0, offsets_array, have_window;
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    double max;
+    int max_present;
+    double min;
+    int min_present;
+    IDL_LONG n_levels;
+    int n_levels_present;
+    IDL_LONG n_threads;
+    IDL_VPTR step;
+    IDL_LONG symmetric;
+    IDL_VPTR window_size;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR matrix_kw_pars[] = {
+    { "MAX", IDL_TYP_DOUBLE, 1, 0,
+      IDL_KW_OFFSETOF(max_present), IDL_KW_OFFSETOF(max) },
+    { "MIN", IDL_TYP_DOUBLE, 1, 0,
+      IDL_KW_OFFSETOF(min_present), IDL_KW_OFFSETOF(min) },
+    { "N_LEVELS", IDL_TYP_LONG, 1, 0,
+      IDL_KW_OFFSETOF(n_levels_present), IDL_KW_OFFSETOF(n_levels) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { "SYMMETRIC", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(symmetric) },
+    { NULL }
+  };
+
+  static IDL_KW_PAR features_kw_pars[] = {
+    { "MAX", IDL_TYP_DOUBLE, 1, 0,
+      IDL_KW_OFFSETOF(max_present), IDL_KW_OFFSETOF(max) },
+    { "MIN", IDL_TYP_DOUBLE, 1, 0,
+      IDL_KW_OFFSETOF(min_present), IDL_KW_OFFSETOF(min) },
+    { "N_LEVELS", IDL_TYP_LONG, 1, 0,
+      IDL_KW_OFFSETOF(n_levels_present), IDL_KW_OFFSETOF(n_levels) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { "STEP", IDL_TYP_UNDEF, 1, IDL_KW_VIN | IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(step) },
+    { "SYMMETRIC", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(symmetric) },
+    { "WINDOW_SIZE", IDL_TYP_UNDEF, 1, IDL_KW_VIN | IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(window_size) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  kw.min_present = kw.max_present = kw.n_levels_present = 0;
+  kw.step = kw.window_size = NULL;
+  nargs = IDL_KWProcessByOffset(argc, argv, argk,
+                                features ? features_kw_pars : matrix_kw_pars,
+                                (IDL_VPTR *) NULL, 1, &kw);
+
+  IDL_ENSURE_SIMPLE(image);
+  IDL_ENSURE_ARRAY(image);
+  arr = image->value.arr;
+  quantize = mg_glcm_quantize_kernel(image->type, &range);
+  if (quantize == NULL || arr->n_dim != 2) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "image must be a 2-dimensional array of a non-complex numeric type");
+  }
+  info.nx = arr->dim[0];
+  info.ny = arr->dim[1];
+  info.data = (char *) arr->data;
+  info.symmetric = kw.symmetric != 0;
+
+  // offsets are dx, dy pairs
+  IDL_ENSURE_SIMPLE(argv[1]);
+  offsets_array = (argv[1]->flags & IDL_V_ARR) && argv[1]->value.arr->n_dim > 1;
+  offsets_var = argv[1]->type == IDL_TYP_LONG64 ? argv[1] : IDL_CvtLng64(1, &argv[1], NULL);
+  IDL_VarGetData(offsets_var, &n_offset_values, (char **) &offset_values, FALSE);
+  if (n_offset_values % 2 != 0) {
+    if (offsets_var != argv[1]) IDL_Deltmp(offsets_var);
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "offsets must be [dx, dy] pairs");
+  }
+  info.n_offsets = n_offset_values / 2;
+
+  // window covers the whole image by default
+  have_window = features && mg_glcm_pair(kw.window_size, window);
+  if (!have_window) {
+    window[0] = info.nx;
+    window[1] = info.ny;
+  }
+  if (!(features && mg_glcm_pair(kw.step, step))) {
+    step[0] = step[1] = 1;
+  }
+  if (window[0] < 1 || window[1] < 1 || window[0] > info.nx || window[1] > info.ny
+        || step[0] < 1 || step[1] < 1) {
+    if (offsets_var != argv[1]) IDL_Deltmp(offsets_var);
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "invalid WINDOW_SIZE or STEP");
+  }
+  info.wx = window[0];
+  info.wy = window[1];
+  info.sx = step[0];
+  info.sy = step[1];
+  info.n_wx = (info.nx - info.wx) / info.sx + 1;
+  info.n_wy = (info.ny - info.wy) / info.sy + 1;
+
+  // quantization range and number of levels
+  if (!kw.min_present || !kw.max_present) range(info.data, arr->n_elts, &lo, &hi);
+  info.min = kw.min_present ? kw.min : lo;
+  hi = kw.max_present ? kw.max : hi;
+  info.n_levels = kw.n_levels_present
+                    ? kw.n_levels
+                    : (hi >= info.min ? (IDL_MEMINT) floor(hi - info.min) + 1 : 1);
+  if (info.n_levels < 1 || info.n_levels > MG_GLCM_MAX_LEVELS) {
+    if (offsets_var != argv[1]) IDL_Deltmp(offsets_var);
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "number of levels must be between 1 and %d", MG_GLCM_MAX_LEVELS);
+  }
+  info.scale = hi > info.min ? (info.n_levels - 0.5) / (hi - info.min) : 0.0;
+
+  // result
+  size = info.n_levels * info.n_levels;
+  if (features) {
+    dims[n_dims++] = MG_GLCM_N_FEATURES;
+  } else {
+    dims[n_dims++] = info.n_levels;
+    dims[n_dims++] = info.n_levels;
+  }
+  if (offsets_array) dims[n_dims++] = info.n_offsets;
+  if (have_window) {
+    dims[n_dims++] = info.n_wx;
+    dims[n_dims++] = info.n_wy;
+  }
+  if (features) {
+    info.features = (double *) IDL_MakeTempArray(IDL_TYP_DOUBLE, n_dims, dims,
+                                                 IDL_ARR_INI_NOP, &result);
+  } else {
+    info.result = (IDL_LONG *) IDL_MakeTempArray(IDL_TYP_LONG, n_dims, dims,
+                                                 IDL_ARR_INI_NOP, &result);
+  }
+
+  // levels, offsets, then private matrices per thread
+  n_work = features ? info.n_wy : info.ny;
+  info.n_threads = mg_thread_count(features ? info.n_wx * info.n_wy * info.wx * info.wy
+                                            : arr->n_elts,
+                                   MG_GLCM_MIN_PIXELS, kw.n_threads);
+  if (info.n_threads > n_work) info.n_threads = (int) n_work;
+  info.per_thread = size * info.n_offsets;
+  info.levels = (IDL_UINT *) IDL_MemAlloc(MG_SORT_ALIGN(arr->n_elts * sizeof(IDL_UINT))
+                                            + 2 * info.n_offsets * sizeof(IDL_MEMINT)
+                                            + info.n_threads * info.per_thread * sizeof(IDL_LONG),
+                                          "GLCM", IDL_MSG_RET);
+  if (info.levels == NULL) {
+    if (offsets_var != argv[1]) IDL_Deltmp(offsets_var);
+    IDL_Deltmp(result);
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unable to allocate memory for GLCM");
+  }
+  info.offsets = (IDL_MEMINT *) ((char *) info.levels
+                                   + MG_SORT_ALIGN(arr->n_elts * sizeof(IDL_UINT)));
+  for (i = 0; i < 2 * info.n_offsets; i++) info.offsets[i] = offset_values[i];
+  if (offsets_var != argv[1]) IDL_Deltmp(offsets_var);
+  info.counts = (IDL_LONG *) (info.offsets + 2 * info.n_offsets);
+
+  mg_thread_run(mg_thread_count(arr->n_elts, MG_GLCM_MIN_PIXELS, kw.n_threads),
+                arr->n_elts, quantize, &info);
+
+  if (features) {
+    mg_thread_run(info.n_threads, info.n_wy, mg_glcm_windows, &info);
+  } else {
+    memset(info.counts, 0, info.n_threads * info.per_thread * sizeof(IDL_LONG));
+    mg_thread_run(info.n_threads, info.ny, mg_glcm_rows, &info);
+    mg_thread_run(mg_thread_count(size * info.n_offsets, MG_GLCM_MIN_PIXELS, kw.n_threads),
+                  size * info.n_offsets, mg_glcm_merge, &info);
+  }
+
+  IDL_MemFree(info.levels, NULL, IDL_MSG_RET);
+  IDL_KW_FREE;
+
   return result;
 }
 
 
+static IDL_VPTR IDL_CDECL IDL_mg_glcm_matrix(int argc, IDL_VPTR *argv, char *argk) {
+  return mg_glcm(argc, argv, argk, 0);
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_glcm_features(int argc, IDL_VPTR *argv, char *argk) {
+  return mg_glcm(argc, argv, argk, 1);
+}
+
+
 int IDL_Load(void) {
   /*
    * These tables contain information on the functions and procedures
@@ -432,10 +1945,18 @@ int IDL_Load(void) {
    */
   static IDL_SYSFUN_DEF2 function_addr[] = {
     { IDL_mg_array_equal, "MG_ARRAY_EQUAL", 2, 2, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
-    { IDL_mg_total,       "MG_TOTAL",       1, 1, 0, 0 },
+    { IDL_mg_total,       "MG_TOTAL",       1, 1, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
     { IDL_mg_batched_matrix_vector_multiply,
                           "MG_BATCHED_MATRIX_VECTOR_MULTIPLY",
-                                            5, 5, 0, 0 },
+                                            5, 5, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+    { IDL_mg_batched_matrix_multiply,
+                          "MG_BATCHED_MATRIX_MULTIPLY",
+                                            2, 2, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+    { IDL_mg_radix_sort,  "MG_RADIX_SORT",  1, 1, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+    { IDL_mg_glcm_matrix, "MG_GLCM_MATRIX", 2, 2, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+    { IDL_mg_glcm_features,
+                          "MG_GLCM_FEATURES",
+                                            2, 2, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
 
   };
 
@@ -3,7 +3,9 @@
 
 ;+
 ; Computes the grey-level co-occurence matrix as defined
-; `here <http://en.wikipedia.org/wiki/Co-occurrence_matrix>`.
+; `here <http://en.wikipedia.org/wiki/Co-occurrence_matrix>`. Uses
+; `MG_GLCM_MATRIX` of the `mg_analysis` DLM when it is available; see
+; `MG_GLCM_FEATURES` for texture features of many offsets or sliding windows.
 ;
 ; :Returns:
 ;   2-dimensional matrix
@@ -26,20 +28,26 @@
 ;-
 function mg_glcm, m, x, y, symmetric=symmetric, n_levels=n_levels
   compile_opt strictarr
+  on_error, 2
+
+  _x = n_elements(x) eq 0L ? 1L : x
+  _y = n_elements(y) eq 0L ? 0L : y
+
+  if (mg_hasroutine('mg_glcm_matrix')) then begin
+    return, mg_glcm_matrix(m, [_x, _y], n_levels=n_levels, symmetric=symmetric)
+  endif
 
   dims = size(m, /dimensions)
 
   range = mg_range(m)
   r = range[1] - range[0]
-  _x = n_elements(x) eq 0L ? 1L : x
-  _y = n_elements(x) eq 0L ? 0L : y
   _n_levels = n_elements(n_levels) eq 0L ? (r + 1L) : n_levels
   result = lonarr(_n_levels, _n_levels)
 
-  for row = 0L, dims[1] - 1L do begin
-    if (row + y lt dims[1]) then begin
-      for col = 0L, dims[0] - 1L do begin
-        if (col + x lt dims[0]) then begin
+  for row = 0L > (- _y), dims[1] - 1L do begin
+    if (row + _y lt dims[1]) then begin
+      for col = 0L > (- _x), dims[0] - 1L do begin
+        if (col + _x lt dims[0]) then begin
           i = m[col, row]
           j = m[col + _x, row + _y]
 
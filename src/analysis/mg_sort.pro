@@ -3,7 +3,9 @@
 ;+
 ; An alternative to IDL's SORT function that employs a
 ; `radix-sort algorithm <http://en.wikipedia.org/wiki/Radix_sort>`. This
-; algorithm is stable but slower than the
+; algorithm is stable. If the `MG_RADIX_SORT` routine from the `mg_analysis`
+; DLM is available and `RADIX` is not specified, it is used to do the sorting;
+; otherwise, the sort is done in IDL code, which is slower than the
 ; `quicksort algorithm <http://en.wikipedia.org/wiki/Quicksort>` used in IDL's
 ; `SORT` function.
 ;
@@ -58,11 +60,17 @@ end
 ;
 ; :Keywords:
 ;   radix : in, optional, type=int, default=256
-;     radix to use for sort
+;     radix to use for sort, the DLM routine is not used if specified
 ;-
 function mg_sort_base, data, radix=radix
   compile_opt idl2, logical_predicate
 
+  if (n_elements(radix) eq 0L && mg_hasroutine('mg_radix_sort')) then begin
+    return, mg_radix_sort(data)
+  endif
+
+  _radix = n_elements(radix) eq 0L ? 256 : radix
+
   ; support signed ints
   case size(data, /type) of
     2: sorted = uint(data) + ishft(1us, 15) ; +/- are equivalent here
@@ -90,19 +98,19 @@ function mg_sort_base, data, radix=radix
 
   ; implement a slight speed improvement for small data ranges
   rng = mx - mn
-  if (rng lt mn / radix) then begin
+  if (rng lt mn / _radix) then begin
     sorted -= mn
     mx -= mn
   endif
 
   factor = 1ull
   while (mx gt 0) do begin
-    mx /= radix
+    mx /= _radix
     rem = sorted / factor
-    digit = rem mod radix
-    factor = factor * radix
-    h = histogram(digit, min=0, max=radix-1, binsize=1, reverse_indices=ri)
-    ind = ri[radix + 1:*]
+    digit = rem mod _radix
+    factor = factor * _radix
+    h = histogram(digit, min=0, max=_radix-1, binsize=1, reverse_indices=ri)
+    ind = ri[_radix + 1:*]
     sorted = sorted[ind]
     indices = indices[ind]
   endwhile
@@ -127,25 +135,22 @@ end
 ;
 ; :Keywords:
 ;   radix : in, optional, type=int, default=256
-;     radix to use for sort
+;     radix to use for sort, the DLM routine is not used if specified
 ;-
 function mg_sort, key1, key2, key3, radix=radix
   compile_opt strictarr
 
-  ; default radix if not specified
-  _radix = n_elements(radix) eq 0L ? 256 : radix
-
   if (n_elements(key3) gt 0L) then begin
-    ind3 = mg_sort_base(key3, radix=_radix)
-    ind2 = mg_sort_base(key2[ind3], radix=_radix)
-    ind1 = mg_sort_base(key1[ind3[ind2]], radix=_radix)
+    ind3 = mg_sort_base(key3, radix=radix)
+    ind2 = mg_sort_base(key2[ind3], radix=radix)
+    ind1 = mg_sort_base(key1[ind3[ind2]], radix=radix)
     ind = ind3[ind2[ind1]]
   endif else if (n_elements(key2) gt 0L) then begin 
-    ind2 = mg_sort_base(key2, radix=_radix)
-    ind1 = mg_sort_base(key1[ind2], radix=_radix)
+    ind2 = mg_sort_base(key2, radix=radix)
+    ind1 = mg_sort_base(key1[ind2], radix=radix)
     ind = ind2[ind1]
   endif else begin
-    ind = mg_sort_base(key1, radix=_radix)
+    ind = mg_sort_base(key1, radix=radix)
   endelse
 
 
@@ -0,0 +1,134 @@
+/*
+  Minimal thread helpers shared by the mglib DLMs.
+
+  Work is described as a range of items [0, n) which is split into
+  contiguous pieces, one per thread; the calling thread does the first piece.
+  Workers must not call any IDL API routines (no messages, no temporary
+  variables, no memory from IDL_MemAlloc), so allocate everything needed
+  before calling mg_thread_run and check for errors after it returns.
+
+  Requires mg_idl_export.h to be included first. On platforms without
+  pthreads everything runs on the calling thread.
+*/
+
+#ifndef MG_THREADS_H
+#define MG_THREADS_H
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define MG_THREADS_MAX 256
+
+// work routine: process items [start, end) as thread number thread_index
+typedef void (*mg_thread_work)(IDL_MEMINT start, IDL_MEMINT end,
+                               int thread_index, void *data);
+
+typedef struct {
+  mg_thread_work work;
+  void *data;
+  IDL_MEMINT start;
+  IDL_MEMINT end;
+  int thread_index;
+} mg_thread_task;
+
+
+// number of processors available to the process
+static inline int mg_thread_ncpus(void) {
+#if defined(_WIN32)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (int) info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+  long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return ncpus < 1 ? 1 : (int) ncpus;
+#else
+  return 1;
+#endif
+}
+
+
+/*
+  Number of threads to use for n items when each thread should get at least
+  min_items items. A positive requested value (usually from an N_THREADS
+  keyword) overrides the number of processors, but not the minimum.
+*/
+static inline int mg_thread_count(IDL_MEMINT n, IDL_MEMINT min_items,
+                                  int requested) {
+  IDL_MEMINT nthreads = requested > 0 ? requested : mg_thread_ncpus();
+
+  if (min_items < 1) min_items = 1;
+  if (nthreads > n / min_items) nthreads = n / min_items;
+  if (nthreads > MG_THREADS_MAX) nthreads = MG_THREADS_MAX;
+  if (nthreads < 1) nthreads = 1;
+
+  return (int) nthreads;
+}
+
+
+#ifndef _WIN32
+static void *mg_thread_main(void *arg) {
+  mg_thread_task *task = (mg_thread_task *) arg;
+  task->work(task->start, task->end, task->thread_index, task->data);
+  return NULL;
+}
+#endif
+
+
+/*
+  Split items [0, n) into nthreads contiguous ranges and process them
+  concurrently, returning when all are done. Ranges differ in size by at most
+  one item. If a thread cannot be started, its range is done by the caller.
+*/
+static inline void mg_thread_run(int nthreads, IDL_MEMINT n,
+                                 mg_thread_work work, void *data) {
+  mg_thread_task tasks[MG_THREADS_MAX];
+#ifndef _WIN32
+  pthread_t threads[MG_THREADS_MAX];
+  int started[MG_THREADS_MAX];
+#endif
+  IDL_MEMINT chunk, extra, start = 0;
+  int t;
+
+  if (n <= 0) return;
+  if (nthreads > n) nthreads = (int) n;
+  if (nthreads > MG_THREADS_MAX) nthreads = MG_THREADS_MAX;
+  if (nthreads < 1) nthreads = 1;
+
+  chunk = n / nthreads;
+  extra = n % nthreads;
+  for (t = 0; t < nthreads; t++) {
+    tasks[t].work = work;
+    tasks[t].data = data;
+    tasks[t].thread_index = t;
+    tasks[t].start = start;
+    tasks[t].end = start + chunk + (t < extra ? 1 : 0);
+    start = tasks[t].end;
+  }
+
+#ifdef _WIN32
+  for (t = 0; t < nthreads; t++) {
+    work(tasks[t].start, tasks[t].end, t, data);
+  }
+#else
+  for (t = 1; t < nthreads; t++) {
+    started[t] = pthread_create(&threads[t], NULL,
+                                mg_thread_main, &tasks[t]) == 0;
+  }
+
+  work(tasks[0].start, tasks[0].end, 0, data);
+
+  for (t = 1; t < nthreads; t++) {
+    if (started[t]) {
+      pthread_join(threads[t], NULL);
+    } else {
+      work(tasks[t].start, tasks[t].end, t, data);
+    }
+  }
+#endif
+}
+
+#endif
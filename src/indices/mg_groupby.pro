@@ -1,7 +1,56 @@
 ; docformat = 'rst'
 
 ;+
-; Group a vector array by equal values.
+; Call `MG_HASH_GROUPBY` with a key array, or the arrays of a list of at most
+; 8 keys as separate arguments.
+;
+; :Private:
+;
+; :Returns:
+;   `lonarr` of indices, as from `MG_HASH_GROUPBY`
+;
+; :Params:
+;   keys : in, required, type=numeric, string, or list
+;     key array or list of key arrays
+;
+; :Keywords:
+;   _ref_extra : in, out, optional, type=keywords
+;     keywords to `MG_HASH_GROUPBY`
+;-
+function mg_groupby_keys, keys, _ref_extra=e
+  compile_opt strictarr
+  on_error, 2
+
+  if (~isa(keys, 'list')) then return, mg_hash_groupby(keys, _strict_extra=e)
+
+  case n_elements(keys) of
+    1: return, mg_hash_groupby(keys[0], _strict_extra=e)
+    2: return, mg_hash_groupby(keys[0], keys[1], _strict_extra=e)
+    3: return, mg_hash_groupby(keys[0], keys[1], keys[2], _strict_extra=e)
+    4: return, mg_hash_groupby(keys[0], keys[1], keys[2], keys[3], $
+                               _strict_extra=e)
+    5: return, mg_hash_groupby(keys[0], keys[1], keys[2], keys[3], $
+                               keys[4], _strict_extra=e)
+    6: return, mg_hash_groupby(keys[0], keys[1], keys[2], keys[3], $
+                               keys[4], keys[5], _strict_extra=e)
+    7: return, mg_hash_groupby(keys[0], keys[1], keys[2], keys[3], $
+                               keys[4], keys[5], keys[6], _strict_extra=e)
+    8: return, mg_hash_groupby(keys[0], keys[1], keys[2], keys[3], $
+                               keys[4], keys[5], keys[6], keys[7], $
+                               _strict_extra=e)
+    else: message, 'no keys to group by'
+  endcase
+end
+
+
+;+
+; Group a vector array by equal values, or by equal combinations of values of
+; several arrays.
+;
+; Groups are in order of value (lexicographic order for several keys) and the
+; indices within each group are increasing. If the `mg_indices` DLM is
+; available, groups are found in linear time by hashing and reductions of
+; `values` over each group are computed in the same pass.
 ;
 ; :Examples:
 ;   Given the following call of `MG_GROUPBY`::
@@ -16,8 +65,9 @@
 ;   `lonarr` with same length as `x` representing indices into `x`
 ;
 ; :Params:
-;   x : in, required, type=numeric or string
-;     input to group
+;   x : in, required, type=numeric, string, or list
+;     input to group, or a list of arrays with the same number of elements to
+;     group by the combination of their values
 ;
 ; :Keywords:
 ;   n_groups : out, optional, type=long
@@ -25,9 +75,60 @@
 ;   group_starts : out, optional, type="lonarr(n_groups + 1)"
 ;     set to a named variable to retrieve indices into the group indices return
 ;     value indicating the beginning index of each group
+;   group_ids : out, optional, type=lonarr
+;     set to a named variable to retrieve the group number of each element
+;   count : out, optional, type="lonarr(n_groups)"
+;     set to a named variable to retrieve the number of elements in each group
+;   values : in, optional, type="numeric array(n) or (n, m)"
+;     values to reduce over each group, or `m` columns of values to reduce
+;     separately; reductions have dimensions `n_groups` or `(n_groups, m)`
+;   total : out, optional, type=dblarr
+;     set to a named variable to retrieve the sum of `values` in each group
+;   mean : out, optional, type=dblarr
+;     set to a named variable to retrieve the mean of `values` in each group
+;   variance : out, optional, type=dblarr
+;     set to a named variable to retrieve the sample variance of `values` in
+;     each group, NaN for groups of one element
+;   min : out, optional, type=same as values
+;     set to a named variable to retrieve the minimum of `values` in each group
+;   max : out, optional, type=same as values
+;     set to a named variable to retrieve the maximum of `values` in each group
+;   first : out, optional, type=same as values
+;     set to a named variable to retrieve the first of `values` in each group
+;   last : out, optional, type=same as values
+;     set to a named variable to retrieve the last of `values` in each group
 ;-
-function mg_groupby, x, n_groups=n_groups, group_starts=group_starts
+function mg_groupby, x, n_groups=n_groups, group_starts=group_starts, $
+                     group_ids=group_ids, count=count, values=values, $
+                     total=total, mean=mean, variance=variance, $
+                     min=min, max=max, first=first, last=last
   compile_opt strictarr
+  on_error, 2
+
+  if (mg_hasroutine('mg_hash_groupby')) then begin
+    ; MG_HASH_GROUPBY takes up to 8 keys; combine more keys into one by group
+    ; number of the keys so far and of the next key, which keeps the
+    ; lexicographic order of the keys
+    keys = x
+    if (isa(x, 'list') && n_elements(x) gt 8L) then begin
+      !null = mg_groupby_keys(x[0:7], group_ids=keys)
+      for k = 8L, n_elements(x) - 1L do begin
+        !null = mg_hash_groupby(x[k], group_ids=ids, n_groups=n_ids)
+        !null = mg_hash_groupby(long64(keys) * n_ids + ids, group_ids=keys)
+      endfor
+    endif
+
+    return, mg_groupby_keys(keys, $
+                            n_groups=n_groups, group_starts=group_starts, $
+                            group_ids=group_ids, count=count, $
+                            values=values, total=total, mean=mean, $
+                            variance=variance, min=min, max=max, $
+                            first=first, last=last)
+  endif
+
+  if (isa(x, 'list') || n_elements(values) gt 0L) then begin
+    message, 'multiple keys and reductions require the mg_indices DLM'
+  endif
 
   indices = uniq(x, sort(x))
 
@@ -36,9 +137,9 @@ function mg_groupby, x, n_groups=n_groups, group_starts=group_starts
   group_starts = lonarr(n_groups + 1)
 
   for i = 0L, n_groups - 1L do begin
-    ind = where(x eq x[indices[i]], count)
+    ind = where(x eq x[indices[i]], n_matches)
     group_indices[group_starts[i]] = ind
-    group_starts[i + 1L] = count + group_starts[i]
+    group_starts[i + 1L] = n_matches + group_starts[i]
   endfor
 
   return, group_indices
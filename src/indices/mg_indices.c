@@ -0,0 +1,1249 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "mg_idl_export.h"
+
+
+/**************************************************************************
+  Hashing helpers
+***************************************************************************/
+
+// integer keys with a range of values at most this many times the number of
+// keys use direct addressing instead of hashing
+#define MG_DENSE_FACTOR 4
+
+// 64-bit finalizer from splitmix64
+static inline IDL_ULONG64 mg_hash_int(IDL_ULONG64 x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+
+// FNV-1a of the characters of a string, finalized like integers
+static inline IDL_ULONG64 mg_hash_string(IDL_STRING *s) {
+  IDL_ULONG64 h = 0xcbf29ce484222325ULL;
+  int i;
+
+  for (i = 0; i < s->slen; i++) {
+    h ^= (UCHAR) s->s[i];
+    h *= 0x100000001b3ULL;
+  }
+  return mg_hash_int(h);
+}
+
+
+// smallest power of 2 at least twice n
+static IDL_MEMINT mg_hash_size(IDL_MEMINT n) {
+  IDL_MEMINT size = 16;
+  while (size < 2 * n) size <<= 1;
+  return size;
+}
+
+
+#define MG_INT_HASH(x)     mg_hash_int((IDL_ULONG64) (x))
+#define MG_INT_EQUAL(x, y) ((x) == (y))
+#define MG_STR_HASH(x)     mg_hash_string(&(x))
+#define MG_STR_EQUAL(x, y) ((x).slen == (y).slen                            \
+                            && ((x).slen == 0                                \
+                                || memcmp((x).s, (y).s, (x).slen) == 0))
+
+#define MG_IS_INTEGER(type) ((type) == IDL_TYP_BYTE                          \
+                             || (type) == IDL_TYP_INT                        \
+                             || (type) == IDL_TYP_LONG                       \
+                             || (type) == IDL_TYP_UINT                       \
+                             || (type) == IDL_TYP_ULONG                      \
+                             || (type) == IDL_TYP_LONG64                     \
+                             || (type) == IDL_TYP_ULONG64)
+
+
+/**************************************************************************
+  MG_HASH_MATCH
+***************************************************************************/
+
+/*
+  Table of the values of one array (the smaller one), the "build" array. Each
+  slot holds the first index of the build array with a given value. In
+  multiple mode, the indices with the same value are chained in increasing
+  order through next. Integer keys with a small range are stored directly by
+  value - min instead of hashing.
+*/
+typedef struct {
+  IDL_MEMINT size;
+  int dense;
+  IDL_ULONG64 min;
+  int multiple;
+  IDL_MEMINT *head;    // first build index of each slot, -1 if empty
+  IDL_MEMINT *tail;    // last build index of each slot, multiple mode only
+  IDL_MEMINT *count;   // number of build indices in slot, multiple mode only
+  IDL_MEMINT *next;    // next build index with same value, multiple mode only
+  UCHAR *matched;      // slot has been reported, single mode only
+} mg_match_table;
+
+
+/*
+  For each type: mg_match_slot_NAME finds the slot for a key, i.e., where it
+  is or where it would be inserted, or -1 if the key is out of the range of
+  a dense table. mg_match_build_NAME fills the table from the build array and
+  mg_match_probe_NAME looks up each element of the probe array, counting the
+  pairs found (if probe_indices is NULL) or storing them.
+*/
+#define MG_MATCH(TYPE, NAME, HASH, EQUAL, IS_INT)                            \
+static inline IDL_MEMINT mg_match_slot_ ## NAME(TYPE *build,                 \
+                                                mg_match_table *t,           \
+                                                TYPE key) {                  \
+  IDL_MEMINT i, mask = t->size - 1;                                          \
+                                                                             \
+  if (IS_INT && t->dense) {                                                  \
+    IDL_ULONG64 k = (IDL_ULONG64) MG_KEY_ ## NAME(key) - t->min;             \
+    return k < (IDL_ULONG64) t->size ? (IDL_MEMINT) k : -1;                  \
+  }                                                                          \
+                                                                             \
+  i = (IDL_MEMINT) (HASH(key) & mask);                                       \
+  while (t->head[i] != -1 && !EQUAL(build[t->head[i]], key)) {               \
+    i = (i + 1) & mask;                                                      \
+  }                                                                          \
+  return i;                                                                  \
+}                                                                            \
+                                                                             \
+static void mg_match_build_ ## NAME(TYPE *build, IDL_MEMINT n,               \
+                                    mg_match_table *t) {                     \
+  IDL_MEMINT j, s;                                                           \
+                                                                             \
+  for (j = 0; j < n; j++) {                                                  \
+    s = mg_match_slot_ ## NAME(build, t, build[j]);                          \
+    if (t->head[s] == -1) {                                                  \
+      t->head[s] = j;                                                        \
+      if (t->multiple) {                                                     \
+        t->tail[s] = j;                                                      \
+        t->count[s] = 1;                                                     \
+      }                                                                      \
+    } else if (t->multiple) {                                                \
+      t->next[t->tail[s]] = j;                                               \
+      t->tail[s] = j;                                                        \
+      t->count[s]++;                                                         \
+    }                                                                        \
+    if (t->multiple) t->next[j] = -1;                                        \
+  }                                                                          \
+}                                                                            \
+                                                                             \
+static IDL_MEMINT mg_match_probe_ ## NAME(TYPE *build, TYPE *probe,          \
+                                          IDL_MEMINT n, mg_match_table *t,   \
+                                          IDL_MEMINT *probe_indices,         \
+                                          IDL_MEMINT *build_indices) {       \
+  IDL_MEMINT i, j, s, n_pairs = 0;                                           \
+                                                                             \
+  for (i = 0; i < n; i++) {                                                  \
+    s = mg_match_slot_ ## NAME(build, t, probe[i]);                          \
+    if (s < 0 || t->head[s] == -1) continue;                                 \
+    if (t->multiple) {                                                       \
+      if (probe_indices == NULL) {                                           \
+        n_pairs += t->count[s];                                              \
+      } else {                                                               \
+        for (j = t->head[s]; j != -1; j = t->next[j]) {                      \
+          probe_indices[n_pairs] = i;                                        \
+          build_indices[n_pairs++] = j;                                      \
+        }                                                                    \
+      }                                                                      \
+    } else if (!t->matched[s]) {                                             \
+      t->matched[s] = 1;                                                     \
+      probe_indices[n_pairs] = i;                                            \
+      build_indices[n_pairs++] = t->head[s];                                 \
+    }                                                                        \
+  }                                                                          \
+                                                                             \
+  return n_pairs;                                                            \
+}                                                                            \
+                                                                             \
+/* range of values if they are integers, 0 otherwise */                      \
+static IDL_ULONG64 mg_match_range_ ## NAME(TYPE *build, IDL_MEMINT n,        \
+                                           IDL_ULONG64 *min) {               \
+  IDL_ULONG64 key, lo, hi;                                                   \
+  IDL_MEMINT j;                                                              \
+                                                                             \
+  if (!IS_INT) return 0;                                                     \
+  lo = hi = (IDL_ULONG64) MG_KEY_ ## NAME(build[0]);                         \
+  for (j = 1; j < n; j++) {                                                  \
+    key = (IDL_ULONG64) MG_KEY_ ## NAME(build[j]);                           \
+    if (MG_LESS_ ## NAME(key, lo)) lo = key;                                 \
+    if (MG_LESS_ ## NAME(hi, key)) hi = key;                                 \
+  }                                                                          \
+  *min = lo;                                                                 \
+  return hi - lo;                                                            \
+}
+
+// keys of signed types are compared as signed values, the others unsigned
+#define MG_SIGNED_LESS(x, y)   ((IDL_LONG64) (x) < (IDL_LONG64) (y))
+#define MG_UNSIGNED_LESS(x, y) ((x) < (y))
+
+#define MG_KEY_UCHAR(x)        (x)
+#define MG_KEY_IDL_INT(x)      ((IDL_LONG64) (x))
+#define MG_KEY_IDL_LONG(x)     ((IDL_LONG64) (x))
+#define MG_KEY_IDL_UINT(x)     (x)
+#define MG_KEY_IDL_ULONG(x)    (x)
+#define MG_KEY_IDL_LONG64(x)   (x)
+#define MG_KEY_IDL_ULONG64(x)  (x)
+#define MG_KEY_string(x)       0
+
+#define MG_LESS_UCHAR          MG_UNSIGNED_LESS
+#define MG_LESS_IDL_INT        MG_SIGNED_LESS
+#define MG_LESS_IDL_LONG       MG_SIGNED_LESS
+#define MG_LESS_IDL_UINT       MG_UNSIGNED_LESS
+#define MG_LESS_IDL_ULONG      MG_UNSIGNED_LESS
+#define MG_LESS_IDL_LONG64     MG_SIGNED_LESS
+#define MG_LESS_IDL_ULONG64    MG_UNSIGNED_LESS
+#define MG_LESS_string         MG_UNSIGNED_LESS
+
+MG_MATCH(UCHAR, UCHAR, MG_INT_HASH, MG_INT_EQUAL, 1)
+MG_MATCH(IDL_INT, IDL_INT, MG_INT_HASH, MG_INT_EQUAL, 1)
+MG_MATCH(IDL_LONG, IDL_LONG, MG_INT_HASH, MG_INT_EQUAL, 1)
+MG_MATCH(IDL_UINT, IDL_UINT, MG_INT_HASH, MG_INT_EQUAL, 1)
+MG_MATCH(IDL_ULONG, IDL_ULONG, MG_INT_HASH, MG_INT_EQUAL, 1)
+MG_MATCH(IDL_LONG64, IDL_LONG64, MG_INT_HASH, MG_INT_EQUAL, 1)
+MG_MATCH(IDL_ULONG64, IDL_ULONG64, MG_INT_HASH, MG_INT_EQUAL, 1)
+MG_MATCH(IDL_STRING, string, MG_STR_HASH, MG_STR_EQUAL, 0)
+
+
+#define MG_MATCH_CASE(TYPE_VALUE, TYPE, NAME)                                \
+  case TYPE_VALUE:                                                           \
+    range = mg_match_range_ ## NAME((TYPE *) build, n_build, &table.min);    \
+    table.dense = (TYPE_VALUE != IDL_TYP_STRING)                             \
+                    && range < (IDL_ULONG64) (MG_DENSE_FACTOR * n_build);    \
+    table.size = table.dense ? (IDL_MEMINT) range + 1 : mg_hash_size(n_build); \
+    mg_match_alloc(&table, n_build);                                         \
+    mg_match_build_ ## NAME((TYPE *) build, n_build, &table);                \
+    if (table.multiple) {                                                    \
+      n_pairs = mg_match_probe_ ## NAME((TYPE *) build, (TYPE *) probe,      \
+                                        n_probe, &table, NULL, NULL);        \
+    } else {                                                                 \
+      n_pairs = n_build;                                                     \
+    }                                                                        \
+    probe_indices = (IDL_MEMINT *) IDL_MemAlloc(2 * (n_pairs > 0 ? n_pairs : 1) \
+                                                  * sizeof(IDL_MEMINT),      \
+                                                "matches", IDL_MSG_RET);     \
+    if (probe_indices == NULL) {                                             \
+      mg_match_free(&table);                                                 \
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,                      \
+                  "unable to allocate memory for matches");                  \
+    }                                                                        \
+    build_indices = probe_indices + (n_pairs > 0 ? n_pairs : 1);             \
+    n_pairs = mg_match_probe_ ## NAME((TYPE *) build, (TYPE *) probe,        \
+                                      n_probe, &table,                       \
+                                      probe_indices, build_indices);         \
+    break;
+
+
+static void mg_match_alloc(mg_match_table *t, IDL_MEMINT n_build) {
+  IDL_MEMINT i, n = t->size * (t->multiple ? 3 : 1) + (t->multiple ? n_build : 0);
+
+  t->head = (IDL_MEMINT *) IDL_MemAlloc(n * sizeof(IDL_MEMINT)
+                                          + (t->multiple ? 0 : t->size),
+                                        "match table", IDL_MSG_LONGJMP);
+  for (i = 0; i < t->size; i++) t->head[i] = -1;
+  if (t->multiple) {
+    t->tail = t->head + t->size;
+    t->count = t->tail + t->size;
+    t->next = t->count + t->size;
+  } else {
+    t->matched = (UCHAR *) (t->head + t->size);
+    memset(t->matched, 0, t->size);
+  }
+}
+
+
+static void mg_match_free(mg_match_table *t) {
+  IDL_MemFree(t->head, NULL, IDL_MSG_RET);
+}
+
+
+// store indices in an output keyword as LONG or LONG64, or -1L if none
+static void mg_match_store(IDL_VPTR var, IDL_MEMINT *indices, IDL_MEMINT n,
+                           int wide) {
+  IDL_VPTR result;
+  IDL_MEMINT i;
+
+  if (n == 0) {
+    IDL_VarCopy(IDL_GettmpLong(-1), var);
+    return;
+  }
+
+  if (wide) {
+    IDL_LONG64 *data = (IDL_LONG64 *) IDL_MakeTempVector(IDL_TYP_LONG64, n,
+                                                         IDL_ARR_INI_NOP,
+                                                         &result);
+    for (i = 0; i < n; i++) data[i] = indices[i];
+  } else {
+    IDL_LONG *data = (IDL_LONG *) IDL_MakeTempVector(IDL_TYP_LONG, n,
+                                                     IDL_ARR_INI_NOP,
+                                                     &result);
+    for (i = 0; i < n; i++) data[i] = (IDL_LONG) indices[i];
+  }
+  IDL_VarCopy(result, var);
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_hash_match(int argc, IDL_VPTR *argv, char *argk) {
+  IDL_VPTR a = argv[0], b = argv[1], a_var = a, b_var = b;
+  IDL_MEMINT n_a, n_b, n_build, n_probe, n_pairs = 0, i;
+  IDL_MEMINT *probe_indices, *build_indices, *a_indices, *b_indices, *counts;
+  IDL_ULONG64 range;
+  char *a_data, *b_data, *build, *probe;
+  mg_match_table table;
+  int nargs, build_a, wide;
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_VPTR a_matches;
+    int a_matches_present;
+    IDL_VPTR b_matches;
+    int b_matches_present;
+    IDL_LONG multiple;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "A_MATCHES", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(a_matches_present), IDL_KW_OFFSETOF(a_matches) },
+    { "B_MATCHES", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(b_matches_present), IDL_KW_OFFSETOF(b_matches) },
+    { "MULTIPLE", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(multiple) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+
+  IDL_ENSURE_SIMPLE(a);
+  IDL_ENSURE_SIMPLE(b);
+
+  if (a->type == IDL_TYP_STRING || b->type == IDL_TYP_STRING) {
+    if (a->type != b->type) {
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "cannot match strings with other types");
+    }
+  } else if (!MG_IS_INTEGER(a->type) || !MG_IS_INTEGER(b->type)) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "only integer and string types are supported");
+  } else if (a->type != b->type) {
+    // compare different integer types as LONG64
+    a_var = a->type == IDL_TYP_LONG64 ? a : IDL_CvtLng64(1, &a, NULL);
+    b_var = b->type == IDL_TYP_LONG64 ? b : IDL_CvtLng64(1, &b, NULL);
+  }
+
+  IDL_VarGetData(a_var, &n_a, &a_data, FALSE);
+  IDL_VarGetData(b_var, &n_b, &b_data, FALSE);
+
+  // build the table from the smaller array
+  build_a = n_a < n_b;
+  build = build_a ? a_data : b_data;
+  probe = build_a ? b_data : a_data;
+  n_build = build_a ? n_a : n_b;
+  n_probe = build_a ? n_b : n_a;
+
+  table.multiple = kw.multiple;
+  switch (a_var->type) {
+    MG_MATCH_CASE(IDL_TYP_BYTE, UCHAR, UCHAR)
+    MG_MATCH_CASE(IDL_TYP_INT, IDL_INT, IDL_INT)
+    MG_MATCH_CASE(IDL_TYP_LONG, IDL_LONG, IDL_LONG)
+    MG_MATCH_CASE(IDL_TYP_UINT, IDL_UINT, IDL_UINT)
+    MG_MATCH_CASE(IDL_TYP_ULONG, IDL_ULONG, IDL_ULONG)
+    MG_MATCH_CASE(IDL_TYP_LONG64, IDL_LONG64, IDL_LONG64)
+    MG_MATCH_CASE(IDL_TYP_ULONG64, IDL_ULONG64, IDL_ULONG64)
+    MG_MATCH_CASE(IDL_TYP_STRING, IDL_STRING, string)
+  }
+  mg_match_free(&table);
+
+  if (a_var != a) IDL_Deltmp(a_var);
+  if (b_var != b) IDL_Deltmp(b_var);
+
+  // pairs are ordered by index of the probe array; order them by index of a
+  // with a stable counting sort if the table was built from a
+  if (build_a && n_pairs > 0) {
+    counts = (IDL_MEMINT *) IDL_MemAlloc((n_a + 1 + 2 * n_pairs) * sizeof(IDL_MEMINT),
+                                         "match order", IDL_MSG_RET);
+    if (counts == NULL) {
+      IDL_MemFree(probe_indices, NULL, IDL_MSG_RET);
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "unable to allocate memory for matches");
+    }
+    a_indices = counts + n_a + 1;
+    b_indices = a_indices + n_pairs;
+    memset(counts, 0, (n_a + 1) * sizeof(IDL_MEMINT));
+    for (i = 0; i < n_pairs; i++) counts[build_indices[i] + 1]++;
+    for (i = 0; i < n_a; i++) counts[i + 1] += counts[i];
+    for (i = 0; i < n_pairs; i++) {
+      IDL_MEMINT pos = counts[build_indices[i]]++;
+      a_indices[pos] = build_indices[i];
+      b_indices[pos] = probe_indices[i];
+    }
+  } else {
+    counts = NULL;
+    a_indices = build_a ? build_indices : probe_indices;
+    b_indices = build_a ? probe_indices : build_indices;
+  }
+
+  wide = n_a > 2147483647 || n_b > 2147483647;
+  if (kw.a_matches_present) mg_match_store(kw.a_matches, a_indices, n_pairs, wide);
+  if (kw.b_matches_present) mg_match_store(kw.b_matches, b_indices, n_pairs, wide);
+
+  if (counts) IDL_MemFree(counts, NULL, IDL_MSG_RET);
+  IDL_MemFree(probe_indices, NULL, IDL_MSG_RET);
+
+  IDL_KW_FREE;
+
+  return IDL_GettmpMEMINT(n_pairs);
+}
+
+
+/**************************************************************************
+  Set operations
+***************************************************************************/
+
+#define MG_SET_UNION        0
+#define MG_SET_INTERSECTION 1
+#define MG_SET_DIFFERENCE   2
+
+// set of LONG64 values by open addressing
+typedef struct {
+  IDL_MEMINT mask;
+  IDL_LONG64 *keys;
+  UCHAR *used;
+} mg_hash_set;
+
+
+static void mg_hash_set_add(mg_hash_set *set, IDL_LONG64 key) {
+  IDL_MEMINT i = (IDL_MEMINT) (mg_hash_int((IDL_ULONG64) key) & set->mask);
+
+  while (set->used[i] && set->keys[i] != key) i = (i + 1) & set->mask;
+  set->used[i] = 1;
+  set->keys[i] = key;
+}
+
+
+static int mg_hash_set_contains(mg_hash_set *set, IDL_LONG64 key) {
+  IDL_MEMINT i = (IDL_MEMINT) (mg_hash_int((IDL_ULONG64) key) & set->mask);
+
+  while (set->used[i]) {
+    if (set->keys[i] == key) return 1;
+    i = (i + 1) & set->mask;
+  }
+  return 0;
+}
+
+
+static int mg_compare_long64(const void *a, const void *b) {
+  IDL_LONG64 x = *(const IDL_LONG64 *) a, y = *(const IDL_LONG64 *) b;
+  return x < y ? -1 : x > y;
+}
+
+
+/*
+  Sets of indices are arrays of non-negative integers where a scalar -1L
+  indicates the empty set. If the values are in a range that is small
+  compared to the number of elements, bitsets are used and the result comes
+  out sorted. Otherwise, the elements of the result are found with a hash
+  set: for a union, the elements of both sets not already in the hash set,
+  else, the elements of the first set that are, or are not, in a hash set of
+  the second set. Only the result is sorted, to match the order of the
+  bitset case.
+*/
+static IDL_VPTR mg_set_operation(int argc, IDL_VPTR *argv, char *argk, int op) {
+  IDL_VPTR vars[2], result;
+  IDL_LONG64 *ind[2], *out, lo = 0, hi = -1, x;
+  IDL_MEMINT n[2], n_out = 0, i, k, range, n_words, size;
+  IDL_ULONG64 *bits[2], word;
+  mg_hash_set set;
+  char *data;
+  int nargs, s, wide = 0;
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_VPTR count;
+    int count_present;
+  } KW_RESULT;
+
+  static IDL_KW_PAR kw_pars[] = {
+    { "COUNT", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(count_present), IDL_KW_OFFSETOF(count) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+
+  for (s = 0; s < 2; s++) {
+    IDL_ENSURE_SIMPLE(argv[s]);
+    if (!MG_IS_INTEGER(argv[s]->type)) {
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "index sets must be of an integer type");
+    }
+    if (argv[s]->type == IDL_TYP_LONG64 || argv[s]->type == IDL_TYP_ULONG64) wide = 1;
+  }
+
+  // ULONG64 values are compared as LONG64 values below
+  for (s = 0; s < 2; s++) {
+    if (argv[s]->type != IDL_TYP_ULONG64) continue;
+    IDL_VarGetData(argv[s], &n[s], &data, FALSE);
+    for (i = 0; i < n[s]; i++) {
+      if (((IDL_ULONG64 *) data)[i] > (IDL_ULONG64) 0x7fffffffffffffffULL) {
+        IDL_KW_FREE;
+        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                    "index sets must have values less than 2^63");
+      }
+    }
+  }
+
+  for (s = 0; s < 2; s++) {
+    vars[s] = argv[s]->type == IDL_TYP_LONG64 ? argv[s] : IDL_CvtLng64(1, &argv[s], NULL);
+    IDL_VarGetData(vars[s], &n[s], &data, FALSE);
+    ind[s] = (IDL_LONG64 *) data;
+    if (ind[s][0] < 0) n[s] = 0;
+    for (i = 0; i < n[s]; i++) {
+      if (lo > hi) {
+        lo = hi = ind[s][i];
+      } else {
+        if (ind[s][i] < lo) lo = ind[s][i];
+        if (ind[s][i] > hi) hi = ind[s][i];
+      }
+    }
+  }
+
+  // the result has at most n[0] + n[1] elements
+  out = (IDL_LONG64 *) IDL_MemAlloc((n[0] + n[1] + 1) * sizeof(IDL_LONG64),
+                                    "set result", IDL_MSG_RET);
+  if (out == NULL) goto memory_error;
+
+  range = lo > hi ? 0 : (IDL_MEMINT) (hi - lo + 1);
+  if (range > 0 && range <= MG_DENSE_FACTOR * 16 * (n[0] + n[1])) {
+    n_words = (range + 63) / 64;
+    bits[0] = (IDL_ULONG64 *) IDL_MemAlloc(2 * n_words * sizeof(IDL_ULONG64),
+                                           "bitsets", IDL_MSG_RET);
+    if (bits[0] == NULL) goto memory_error;
+    bits[1] = bits[0] + n_words;
+    memset(bits[0], 0, 2 * n_words * sizeof(IDL_ULONG64));
+    for (s = 0; s < 2; s++) {
+      for (i = 0; i < n[s]; i++) {
+        k = (IDL_MEMINT) (ind[s][i] - lo);
+        bits[s][k >> 6] |= (IDL_ULONG64) 1 << (k & 63);
+      }
+    }
+    for (i = 0; i < n_words; i++) {
+      switch (op) {
+        case MG_SET_UNION:        word = bits[0][i] | bits[1][i]; break;
+        case MG_SET_INTERSECTION: word = bits[0][i] & bits[1][i]; break;
+        default:                  word = bits[0][i] & ~bits[1][i]; break;
+      }
+      for (k = 0; word; k++, word >>= 1) {
+        if (word & 1) out[n_out++] = lo + 64 * i + k;
+      }
+    }
+    IDL_MemFree(bits[0], NULL, IDL_MSG_RET);
+  } else if (range > 0) {
+    size = mg_hash_size(op == MG_SET_UNION ? n[0] + n[1] : n[1]);
+    set.mask = size - 1;
+    set.keys = (IDL_LONG64 *) IDL_MemAlloc(size * (sizeof(IDL_LONG64) + 1),
+                                           "hash set", IDL_MSG_RET);
+    if (set.keys == NULL) goto memory_error;
+    set.used = (UCHAR *) (set.keys + size);
+    memset(set.used, 0, size);
+    if (op == MG_SET_UNION) {
+      for (s = 0; s < 2; s++) {
+        for (i = 0; i < n[s]; i++) {
+          x = ind[s][i];
+          if (!mg_hash_set_contains(&set, x)) {
+            mg_hash_set_add(&set, x);
+            out[n_out++] = x;
+          }
+        }
+      }
+    } else {
+      for (i = 0; i < n[1]; i++) mg_hash_set_add(&set, ind[1][i]);
+      for (i = 0; i < n[0]; i++) {
+        x = ind[0][i];
+        if (mg_hash_set_contains(&set, x) == (op == MG_SET_INTERSECTION)) {
+          out[n_out++] = x;
+        }
+      }
+    }
+    IDL_MemFree(set.keys, NULL, IDL_MSG_RET);
+
+    qsort(out, n_out, sizeof(IDL_LONG64), mg_compare_long64);
+    for (i = 0, k = 0; i < n_out; i++) {
+      if (k == 0 || out[i] != out[k - 1]) out[k++] = out[i];
+    }
+    n_out = k;
+  }
+
+  for (s = 0; s < 2; s++) {
+    if (vars[s] != argv[s]) IDL_Deltmp(vars[s]);
+  }
+
+  // COUNT is a LONG like N_ELEMENTS, unless it does not fit
+  if (kw.count_present) {
+    IDL_VarCopy(n_out > 2147483647
+                  ? IDL_GettmpMEMINT(n_out)
+                  : IDL_GettmpLong((IDL_LONG) n_out),
+                kw.count);
+  }
+  IDL_KW_FREE;
+
+  if (n_out == 0) {
+    result = IDL_GettmpLong(-1);
+  } else if (wide) {
+    IDL_LONG64 *result_data = (IDL_LONG64 *) IDL_MakeTempVector(IDL_TYP_LONG64, n_out,
+                                                                IDL_ARR_INI_NOP,
+                                                                &result);
+    memcpy(result_data, out, n_out * sizeof(IDL_LONG64));
+  } else {
+    IDL_LONG *result_data = (IDL_LONG *) IDL_MakeTempVector(IDL_TYP_LONG, n_out,
+                                                            IDL_ARR_INI_NOP,
+                                                            &result);
+    for (i = 0; i < n_out; i++) result_data[i] = (IDL_LONG) out[i];
+  }
+
+  IDL_MemFree(out, NULL, IDL_MSG_RET);
+
+  return result;
+
+memory_error:
+  if (out) IDL_MemFree(out, NULL, IDL_MSG_RET);
+  for (s = 0; s < 2; s++) {
+    if (vars[s] != argv[s]) IDL_Deltmp(vars[s]);
+  }
+  IDL_KW_FREE;
+  IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+              "unable to allocate memory for set operation");
+  return NULL;
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_hash_union(int argc, IDL_VPTR *argv, char *argk) {
+  return mg_set_operation(argc, argv, argk, MG_SET_UNION);
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_hash_intersection(int argc, IDL_VPTR *argv, char *argk) {
+  return mg_set_operation(argc, argv, argk, MG_SET_INTERSECTION);
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_hash_difference(int argc, IDL_VPTR *argv, char *argk) {
+  return mg_set_operation(argc, argv, argk, MG_SET_DIFFERENCE);
+}
+
+/**************************************************************************
+  MG_HASH_GROUPBY
+***************************************************************************/
+
+// floating point keys: -0.0 equals 0.0 and all NaNs are equal and sort last
+static inline IDL_ULONG64 mg_hash_double(double x) {
+  IDL_ULONG64 bits;
+
+  if (x == 0.0) x = 0.0;
+  if (x != x) return 0;
+  memcpy(&bits, &x, sizeof(bits));
+  return mg_hash_int(bits);
+}
+
+
+static inline int mg_string_less(IDL_STRING *x, IDL_STRING *y) {
+  int len = x->slen < y->slen ? x->slen : y->slen;
+  int cmp = len == 0 ? 0 : memcmp(x->s, y->s, len);
+  return cmp < 0 || (cmp == 0 && x->slen < y->slen);
+}
+
+
+#define MG_FLOAT_HASH(x)     mg_hash_double((double) (x))
+#define MG_FLOAT_EQUAL(x, y) ((x) == (y) || ((x) != (x) && (y) != (y)))
+#define MG_FLOAT_LESS(x, y)  ((x) < (y) || ((y) != (y) && (x) == (x)))
+#define MG_INT_LESS(x, y)    ((x) < (y))
+#define MG_STR_LESS(x, y)    mg_string_less(&(x), &(y))
+
+#define MG_KEY_float(x)      0
+#define MG_KEY_double(x)     0
+#define MG_LESS_float        MG_UNSIGNED_LESS
+#define MG_LESS_double       MG_UNSIGNED_LESS
+
+typedef int (*mg_group_compare)(void *data, IDL_MEMINT i, IDL_MEMINT j);
+
+
+/*
+  For each key type: mg_group_ids_NAME sets ids to a group number for each
+  element and returns the number of groups. If the keys are integers in a
+  range no larger than the size of table, the group numbers are assigned by
+  direct lookup in order of value and sorted is set. Otherwise, equal keys
+  are found with a hash table in table, growing up to size as groups are
+  found, the groups are numbered in order of first appearance, and repr is
+  set to the first index of each group.
+*/
+#define MG_GROUP_IDS(TYPE, NAME, HASH, EQUAL, LESS, IS_INT)                  \
+static int mg_group_compare_ ## NAME(void *data, IDL_MEMINT i, IDL_MEMINT j) { \
+  TYPE *d = (TYPE *) data;                                                   \
+  return LESS(d[i], d[j]) ? -1 : (LESS(d[j], d[i]) ? 1 : 0);                 \
+}                                                                            \
+                                                                             \
+static IDL_MEMINT mg_group_ids_ ## NAME(TYPE *data, IDL_MEMINT n,            \
+                                        IDL_MEMINT *ids, IDL_MEMINT *repr,   \
+                                        IDL_MEMINT *table, IDL_MEMINT size,  \
+                                        int *sorted) {                       \
+  IDL_MEMINT i, g, h, mask, n_groups = 0;                                    \
+                                                                             \
+  if (IS_INT) {                                                              \
+    IDL_ULONG64 key, lo, hi;                                                 \
+    lo = hi = (IDL_ULONG64) MG_KEY_ ## NAME(data[0]);                        \
+    for (i = 1; i < n; i++) {                                                \
+      key = (IDL_ULONG64) MG_KEY_ ## NAME(data[i]);                          \
+      if (MG_LESS_ ## NAME(key, lo)) lo = key;                               \
+      if (MG_LESS_ ## NAME(hi, key)) hi = key;                               \
+    }                                                                        \
+    if (hi - lo < (IDL_ULONG64) size) {                                      \
+      memset(table, 0, (hi - lo + 1) * sizeof(IDL_MEMINT));                  \
+      for (i = 0; i < n; i++) {                                              \
+        table[(IDL_ULONG64) MG_KEY_ ## NAME(data[i]) - lo] = 1;              \
+      }                                                                      \
+      for (h = 0; h <= (IDL_MEMINT) (hi - lo); h++) {                        \
+        if (table[h]) table[h] = n_groups++;                                 \
+      }                                                                      \
+      for (i = 0; i < n; i++) {                                              \
+        ids[i] = table[(IDL_ULONG64) MG_KEY_ ## NAME(data[i]) - lo];         \
+      }                                                                      \
+      *sorted = 1;                                                           \
+      return n_groups;                                                       \
+    }                                                                        \
+  }                                                                          \
+                                                                             \
+  /* start small and grow, the number of groups is often much less than n */ \
+  mask = (size < 1024 ? size : 1024) - 1;                                    \
+  for (h = 0; h <= mask; h++) table[h] = -1;                                 \
+  for (i = 0; i < n; i++) {                                                  \
+    h = (IDL_MEMINT) (HASH(data[i]) & mask);                                 \
+    while (table[h] != -1 && !EQUAL(data[repr[table[h]]], data[i])) {        \
+      h = (h + 1) & mask;                                                    \
+    }                                                                        \
+    if (table[h] == -1) {                                                    \
+      table[h] = n_groups;                                                   \
+      repr[n_groups++] = i;                                                  \
+      if (2 * n_groups > mask + 1 && mask + 1 < size) {                      \
+        mask = 2 * mask + 1;                                                 \
+        for (h = 0; h <= mask; h++) table[h] = -1;                           \
+        for (g = 0; g < n_groups; g++) {                                     \
+          h = (IDL_MEMINT) (HASH(data[repr[g]]) & mask);                     \
+          while (table[h] != -1) h = (h + 1) & mask;                         \
+          table[h] = g;                                                      \
+        }                                                                    \
+        h = (IDL_MEMINT) (HASH(data[i]) & mask);                             \
+        while (table[h] != n_groups - 1) h = (h + 1) & mask;                 \
+      }                                                                      \
+    }                                                                        \
+    ids[i] = table[h];                                                       \
+  }                                                                          \
+                                                                             \
+  *sorted = 0;                                                               \
+  return n_groups;                                                           \
+}
+
+MG_GROUP_IDS(UCHAR, UCHAR, MG_INT_HASH, MG_INT_EQUAL, MG_INT_LESS, 1)
+MG_GROUP_IDS(IDL_INT, IDL_INT, MG_INT_HASH, MG_INT_EQUAL, MG_INT_LESS, 1)
+MG_GROUP_IDS(IDL_LONG, IDL_LONG, MG_INT_HASH, MG_INT_EQUAL, MG_INT_LESS, 1)
+MG_GROUP_IDS(float, float, MG_FLOAT_HASH, MG_FLOAT_EQUAL, MG_FLOAT_LESS, 0)
+MG_GROUP_IDS(double, double, MG_FLOAT_HASH, MG_FLOAT_EQUAL, MG_FLOAT_LESS, 0)
+MG_GROUP_IDS(IDL_STRING, string, MG_STR_HASH, MG_STR_EQUAL, MG_STR_LESS, 0)
+MG_GROUP_IDS(IDL_UINT, IDL_UINT, MG_INT_HASH, MG_INT_EQUAL, MG_INT_LESS, 1)
+MG_GROUP_IDS(IDL_ULONG, IDL_ULONG, MG_INT_HASH, MG_INT_EQUAL, MG_INT_LESS, 1)
+MG_GROUP_IDS(IDL_LONG64, IDL_LONG64, MG_INT_HASH, MG_INT_EQUAL, MG_INT_LESS, 1)
+MG_GROUP_IDS(IDL_ULONG64, IDL_ULONG64, MG_INT_HASH, MG_INT_EQUAL, MG_INT_LESS, 1)
+
+
+/*
+  Stable bottom-up merge sort of the groups by their first element, using
+  order and tmp alternately; returns the one holding the sorted groups.
+*/
+static IDL_MEMINT *mg_group_sort(IDL_MEMINT *order, IDL_MEMINT *tmp, IDL_MEMINT n,
+                          mg_group_compare compare, void *data,
+                          IDL_MEMINT *repr) {
+  IDL_MEMINT width, lo, mid, hi, i, j, k, *t;
+
+  for (i = 0; i < n; i++) order[i] = i;
+  for (width = 1; width < n; width *= 2) {
+    for (lo = 0; lo < n; lo += 2 * width) {
+      mid = lo + width < n ? lo + width : n;
+      hi = lo + 2 * width < n ? lo + 2 * width : n;
+      for (i = lo, j = mid, k = lo; k < hi; k++) {
+        if (i < mid && (j >= hi
+                        || compare(data, repr[order[j]], repr[order[i]]) >= 0)) {
+          tmp[k] = order[i++];
+        } else {
+          tmp[k] = order[j++];
+        }
+      }
+    }
+    t = order;
+    order = tmp;
+    tmp = t;
+  }
+
+  return order;
+}
+
+
+#define MG_GROUP_CASE(TYPE_VALUE, TYPE, NAME)                                \
+  case TYPE_VALUE:                                                           \
+    n_groups_key = mg_group_ids_ ## NAME((TYPE *) data, n, dst, repr,        \
+                                         table, size, &sorted);              \
+    compare = mg_group_compare_ ## NAME;                                     \
+    break;
+
+
+/*
+  Number the groups of one key in order of value, given the groups numbered
+  in order of first appearance.
+*/
+static void mg_group_rank(IDL_MEMINT *ids, IDL_MEMINT n, IDL_MEMINT n_groups,
+                          IDL_MEMINT *repr, IDL_MEMINT *table,
+                          mg_group_compare compare, void *data) {
+  IDL_MEMINT g, i, *order;
+
+  order = mg_group_sort(table, table + n_groups, n_groups, compare, data, repr);
+
+  for (g = 0; g < n_groups; g++) repr[order[g]] = g;
+  for (i = 0; i < n; i++) ids[i] = repr[ids[i]];
+}
+
+
+// store a LONG or LONG64 scalar in an output keyword
+static void mg_group_store_scalar(IDL_VPTR var, IDL_MEMINT value, int wide) {
+  IDL_ALLTYPES v;
+
+  if (wide) {
+    v.l64 = value;
+    IDL_StoreScalar(var, IDL_TYP_LONG64, &v);
+  } else {
+    v.l = (IDL_LONG) value;
+    IDL_StoreScalar(var, IDL_TYP_LONG, &v);
+  }
+}
+
+
+// make a LONG or LONG64 vector from an array of IDL_MEMINT
+static IDL_VPTR mg_group_indices(IDL_MEMINT *indices, IDL_MEMINT n, int wide) {
+  IDL_VPTR result;
+  IDL_MEMINT i;
+
+  if (wide) {
+    IDL_LONG64 *data = (IDL_LONG64 *) IDL_MakeTempVector(IDL_TYP_LONG64, n,
+                                                         IDL_ARR_INI_NOP,
+                                                         &result);
+    for (i = 0; i < n; i++) data[i] = indices[i];
+  } else {
+    IDL_LONG *data = (IDL_LONG *) IDL_MakeTempVector(IDL_TYP_LONG, n,
+                                                     IDL_ARR_INI_NOP,
+                                                     &result);
+    for (i = 0; i < n; i++) data[i] = (IDL_LONG) indices[i];
+  }
+
+  return result;
+}
+
+
+// copy the element of values at index[g] for each group into an output
+static void mg_group_gather(IDL_VPTR var, IDL_VPTR values, int n_dim,
+                            IDL_MEMINT *dims, IDL_MEMINT n, IDL_MEMINT *index,
+                            IDL_MEMINT stride) {
+  IDL_VPTR result;
+  char *src, *dst;
+  IDL_MEMINT g, c, n_values;
+  int elt_size = IDL_TypeSizeFunc(values->type);
+
+  IDL_VarGetData(values, &n_values, &src, FALSE);
+  dst = IDL_MakeTempArray(values->type, n_dim, dims, IDL_ARR_INI_NOP, &result);
+  for (c = 0; c < dims[1]; c++) {
+    for (g = 0; g < dims[0]; g++) {
+      memcpy(dst + (c * dims[0] + g) * elt_size,
+             src + (c * n + index[c * stride + g]) * elt_size,
+             elt_size);
+    }
+  }
+  IDL_VarCopy(result, var);
+}
+
+
+#define MG_GROUP_MAX_KEYS 8
+
+// running reductions of one group, kept together for locality
+typedef struct {
+  double total;
+  double comp;
+  double mean;
+  double m2;
+  double min;
+  double max;
+  IDL_MEMINT count;
+  IDL_MEMINT arg_min;
+  IDL_MEMINT arg_max;
+} mg_group_stats;
+
+static IDL_VPTR IDL_CDECL IDL_mg_hash_groupby(int argc, IDL_VPTR *argv, char *argk) {
+  IDL_VPTR values_var = NULL, result;
+  IDL_MEMINT n, n_key, n_groups = 0, n_groups_key, size, i, g, c, k;
+  IDL_MEMINT *buffer, *ids, *key_ids, *repr, *table, *starts, *indices;
+  IDL_MEMINT n_values, m = 1, dims[2], *arg_min = NULL, *arg_max = NULL;
+  IDL_ULONG64 *combined;
+  mg_group_stats *stats;
+  double *vd, y, t, delta;
+  mg_group_compare compare = NULL;
+  char *data;
+  int nargs, sorted, wide, n_dim = 1, reduce;
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_VPTR count;
+    int count_present;
+    IDL_VPTR first;
+    int first_present;
+    IDL_VPTR group_ids;
+    int group_ids_present;
+    IDL_VPTR group_starts;
+    int group_starts_present;
+    IDL_VPTR last;
+    int last_present;
+    IDL_VPTR max;
+    int max_present;
+    IDL_VPTR mean;
+    int mean_present;
+    IDL_VPTR min;
+    int min_present;
+    IDL_VPTR n_groups;
+    int n_groups_present;
+    IDL_VPTR total;
+    int total_present;
+    IDL_VPTR values;
+    int values_present;
+    IDL_VPTR variance;
+    int variance_present;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "COUNT", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(count_present), IDL_KW_OFFSETOF(count) },
+    { "FIRST", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(first_present), IDL_KW_OFFSETOF(first) },
+    { "GROUP_IDS", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(group_ids_present), IDL_KW_OFFSETOF(group_ids) },
+    { "GROUP_STARTS", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(group_starts_present), IDL_KW_OFFSETOF(group_starts) },
+    { "LAST", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(last_present), IDL_KW_OFFSETOF(last) },
+    { "MAX", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(max_present), IDL_KW_OFFSETOF(max) },
+    { "MEAN", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(mean_present), IDL_KW_OFFSETOF(mean) },
+    { "MIN", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(min_present), IDL_KW_OFFSETOF(min) },
+    { "N_GROUPS", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(n_groups_present), IDL_KW_OFFSETOF(n_groups) },
+    { "TOTAL", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(total_present), IDL_KW_OFFSETOF(total) },
+    { "VALUES", IDL_TYP_UNDEF, 1, IDL_KW_VIN | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(values_present), IDL_KW_OFFSETOF(values) },
+    { "VARIANCE", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(variance_present), IDL_KW_OFFSETOF(variance) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+
+  n = 0;
+  for (k = 0; k < nargs; k++) {
+    IDL_ENSURE_SIMPLE(argv[k]);
+    if (argv[k]->type == IDL_TYP_COMPLEX || argv[k]->type == IDL_TYP_DCOMPLEX) {
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "complex keys are not supported");
+    }
+    IDL_VarGetData(argv[k], &n_key, &data, FALSE);
+    if (k > 0 && n_key != n) {
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "keys must have the same number of elements");
+    }
+    n = n_key;
+  }
+
+  // reductions are only done if there are values, so that a wrapper can pass
+  // through all keywords
+  if (kw.values_present && kw.values->type == IDL_TYP_UNDEF) kw.values_present = 0;
+  reduce = kw.values_present
+             && (kw.total_present || kw.mean_present || kw.variance_present
+                 || kw.min_present || kw.max_present || kw.first_present
+                 || kw.last_present);
+  if (kw.values_present) {
+    IDL_ENSURE_SIMPLE(kw.values);
+    if (kw.values->type == IDL_TYP_STRING
+          || kw.values->type == IDL_TYP_COMPLEX
+          || kw.values->type == IDL_TYP_DCOMPLEX) {
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "VALUES must be of a non-complex numeric type");
+    }
+    IDL_VarGetData(kw.values, &n_values, &data, FALSE);
+    if ((kw.values->flags & IDL_V_ARR) ? kw.values->value.arr->dim[0] != n : n != 1) {
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "VALUES must have dimensions (n) or (n, m) for n keys");
+    }
+    m = n_values / n;
+    n_dim = (kw.values->flags & IDL_V_ARR) && kw.values->value.arr->n_dim > 1 ? 2 : 1;
+  }
+
+  // combined keys, then ids, key_ids, repr, starts and the hash table
+  size = mg_hash_size(n);
+  buffer = (IDL_MEMINT *) IDL_MemAlloc(n * sizeof(IDL_ULONG64)
+                                         + (4 * n + 1 + size) * sizeof(IDL_MEMINT),
+                                       "groups", IDL_MSG_RET);
+  if (buffer == NULL) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unable to allocate memory for groups");
+  }
+  combined = (IDL_ULONG64 *) buffer;
+  ids = (IDL_MEMINT *) (combined + n);
+  key_ids = ids + n;
+  repr = key_ids + n;
+  starts = repr + n;
+  table = starts + n + 1;
+
+  /*
+    Number the groups of each key in order of value, then combine with the
+    groups of the previous keys, i.e., group by the pairs (previous group,
+    key group) which sort in lexicographic order of the keys.
+  */
+  for (k = 0; k < nargs; k++) {
+    IDL_MEMINT *dst = k == 0 ? ids : key_ids;
+
+    IDL_VarGetData(argv[k], &n_key, &data, FALSE);
+    switch (argv[k]->type) {
+      MG_GROUP_CASE(IDL_TYP_BYTE, UCHAR, UCHAR)
+      MG_GROUP_CASE(IDL_TYP_INT, IDL_INT, IDL_INT)
+      MG_GROUP_CASE(IDL_TYP_LONG, IDL_LONG, IDL_LONG)
+      MG_GROUP_CASE(IDL_TYP_FLOAT, float, float)
+      MG_GROUP_CASE(IDL_TYP_DOUBLE, double, double)
+      MG_GROUP_CASE(IDL_TYP_STRING, IDL_STRING, string)
+      MG_GROUP_CASE(IDL_TYP_UINT, IDL_UINT, IDL_UINT)
+      MG_GROUP_CASE(IDL_TYP_ULONG, IDL_ULONG, IDL_ULONG)
+      MG_GROUP_CASE(IDL_TYP_LONG64, IDL_LONG64, IDL_LONG64)
+      MG_GROUP_CASE(IDL_TYP_ULONG64, IDL_ULONG64, IDL_ULONG64)
+    }
+    if (!sorted) mg_group_rank(dst, n, n_groups_key, repr, table, compare, data);
+
+    if (k == 0) {
+      n_groups = n_groups_key;
+    } else {
+      for (i = 0; i < n; i++) {
+        combined[i] = (IDL_ULONG64) ids[i] * n_groups_key + key_ids[i];
+      }
+      n_groups = mg_group_ids_IDL_ULONG64(combined, n, ids, repr, table, size,
+                                          &sorted);
+      if (!sorted) {
+        mg_group_rank(ids, n, n_groups, repr, table,
+                      mg_group_compare_IDL_ULONG64, combined);
+      }
+    }
+  }
+
+  // counting sort of the indices by group, stable so in order within groups
+  memset(starts, 0, (n_groups + 1) * sizeof(IDL_MEMINT));
+  for (i = 0; i < n; i++) starts[ids[i] + 1]++;
+  for (g = 0; g < n_groups; g++) starts[g + 1] += starts[g];
+  indices = key_ids;
+  memcpy(table, starts, n_groups * sizeof(IDL_MEMINT));
+  for (i = 0; i < n; i++) indices[table[ids[i]]++] = i;
+
+  wide = n > 2147483647;
+  dims[0] = n_groups;
+  dims[1] = m;
+
+  if (reduce) {
+    double *out_total = NULL, *out_mean = NULL, *out_variance = NULL;
+    IDL_VPTR total_var, mean_var, variance_var;
+    IDL_MEMINT *lasts = (IDL_MEMINT *) combined;
+
+    if (kw.total_present) {
+      out_total = (double *) IDL_MakeTempArray(IDL_TYP_DOUBLE, n_dim, dims,
+                                               IDL_ARR_INI_NOP, &total_var);
+    }
+    if (kw.mean_present) {
+      out_mean = (double *) IDL_MakeTempArray(IDL_TYP_DOUBLE, n_dim, dims,
+                                              IDL_ARR_INI_NOP, &mean_var);
+    }
+    if (kw.variance_present) {
+      out_variance = (double *) IDL_MakeTempArray(IDL_TYP_DOUBLE, n_dim, dims,
+                                                  IDL_ARR_INI_NOP, &variance_var);
+    }
+
+    // extreme values are found by index, in the hash table if it is big enough
+    arg_min = table;
+    if (2 * n_groups * m > size) {
+      arg_min = (IDL_MEMINT *) IDL_MemAlloc(2 * n_groups * m * sizeof(IDL_MEMINT),
+                                            "extremes", IDL_MSG_RET);
+    }
+    stats = (mg_group_stats *) IDL_MemAlloc(n_groups * sizeof(mg_group_stats),
+                                            "reductions", IDL_MSG_RET);
+    if (arg_min == NULL || stats == NULL) {
+      if (arg_min && arg_min != table) IDL_MemFree(arg_min, NULL, IDL_MSG_RET);
+      if (stats) IDL_MemFree(stats, NULL, IDL_MSG_RET);
+      IDL_MemFree(buffer, NULL, IDL_MSG_RET);
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "unable to allocate memory for reductions");
+    }
+    arg_max = arg_min + n_groups * m;
+
+    values_var = kw.values->type == IDL_TYP_DOUBLE
+                   ? kw.values
+                   : IDL_CvtDbl(1, &kw.values, NULL);
+    IDL_VarGetData(values_var, &n_values, &data, FALSE);
+    vd = (double *) data;
+
+    for (c = 0; c < m; c++) {
+      double *v = vd + c * n;
+
+      for (g = 0; g < n_groups; g++) {
+        mg_group_stats *st = stats + g;
+        st->total = st->comp = st->mean = st->m2 = 0.0;
+        st->count = 0;
+        st->arg_min = st->arg_max = indices[starts[g]];
+        st->min = st->max = v[st->arg_min];
+      }
+
+      // compensated sums, Welford's running mean and variance, and extremes
+      // where NaNs are only kept if there is nothing else
+      for (i = 0; i < n; i++) {
+        mg_group_stats *st = stats + ids[i];
+        double x = v[i];
+
+        y = x - st->comp;
+        t = st->total + y;
+        st->comp = (t - st->total) - y;
+        st->total = t;
+
+        delta = x - st->mean;
+        st->mean += delta / ++st->count;
+        st->m2 += delta * (x - st->mean);
+
+        if (x < st->min || st->min != st->min) {
+          st->min = x;
+          st->arg_min = i;
+        }
+        if (x > st->max || st->max != st->max) {
+          st->max = x;
+          st->arg_max = i;
+        }
+      }
+
+      for (g = 0; g < n_groups; g++) {
+        mg_group_stats *st = stats + g;
+        if (out_total) out_total[c * n_groups + g] = st->total;
+        if (out_mean) out_mean[c * n_groups + g] = st->mean;
+        if (out_variance) {
+          out_variance[c * n_groups + g] = st->count > 1
+                                             ? st->m2 / (st->count - 1)
+                                             : NAN;
+        }
+        arg_min[c * n_groups + g] = st->arg_min;
+        arg_max[c * n_groups + g] = st->arg_max;
+      }
+    }
+
+    if (values_var != kw.values) IDL_Deltmp(values_var);
+    IDL_MemFree(stats, NULL, IDL_MSG_RET);
+
+    if (kw.total_present) IDL_VarCopy(total_var, kw.total);
+    if (kw.mean_present) IDL_VarCopy(mean_var, kw.mean);
+    if (kw.variance_present) IDL_VarCopy(variance_var, kw.variance);
+
+    if (kw.min_present) {
+      mg_group_gather(kw.min, kw.values, n_dim, dims, n, arg_min, n_groups);
+    }
+    if (kw.max_present) {
+      mg_group_gather(kw.max, kw.values, n_dim, dims, n, arg_max, n_groups);
+    }
+    if (arg_min != table) IDL_MemFree(arg_min, NULL, IDL_MSG_RET);
+
+    // first and last elements of each group are the same for every column
+    for (g = 0; g < n_groups; g++) {
+      repr[g] = indices[starts[g]];
+      lasts[g] = indices[starts[g + 1] - 1];
+    }
+    if (kw.first_present) {
+      mg_group_gather(kw.first, kw.values, n_dim, dims, n, repr, 0);
+    }
+    if (kw.last_present) {
+      mg_group_gather(kw.last, kw.values, n_dim, dims, n, lasts, 0);
+    }
+  }
+
+  if (kw.count_present) {
+    for (g = 0; g < n_groups; g++) repr[g] = starts[g + 1] - starts[g];
+    IDL_VarCopy(mg_group_indices(repr, n_groups, wide), kw.count);
+  }
+  if (kw.group_starts_present) {
+    IDL_VarCopy(mg_group_indices(starts, n_groups + 1, wide), kw.group_starts);
+  }
+  if (kw.group_ids_present) {
+    IDL_VarCopy(mg_group_indices(ids, n, wide), kw.group_ids);
+  }
+  if (kw.n_groups_present) {
+    mg_group_store_scalar(kw.n_groups, n_groups, wide);
+  }
+
+  result = mg_group_indices(indices, n, wide);
+
+  IDL_KW_FREE;
+  IDL_MemFree(buffer, NULL, IDL_MSG_RET);
+
+  return result;
+}
+
+
+int IDL_Load(void) {
+  /*
+   * These tables contain information on the functions and procedures
+   * that make up the indices DLM. The information contained in these
+   * tables must be identical to that contained in mg_indices.dlm.
+   */
+  static IDL_SYSFUN_DEF2 function_addr[] = {
+    { IDL_mg_hash_match,  "MG_HASH_MATCH",  2, 2, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+    { IDL_mg_hash_union,  "MG_HASH_UNION",  2, 2, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+    { IDL_mg_hash_intersection,
+                          "MG_HASH_INTERSECTION",
+                                            2, 2, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+    { IDL_mg_hash_difference,
+                          "MG_HASH_DIFFERENCE",
+                                            2, 2, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+    { IDL_mg_hash_groupby,
+                          "MG_HASH_GROUPBY",
+                                            1, MG_GROUP_MAX_KEYS,
+                                            IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+  };
+
+  /*
+   * Register our routines. The routines must be specified exactly the same
+   * as in mg_indices.dlm.
+   */
+  return IDL_SysRtnAdd(function_addr, TRUE, IDL_CARRAY_ELTS(function_addr));
+}
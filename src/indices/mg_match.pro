@@ -2,7 +2,12 @@
 
 ;+
 ; Routine to match values between two arrays. Note: does not find multiple
-; matches.
+; matches unless `MULTIPLE` is set.
+;
+; Integer and string arrays are matched in linear time by the `MG_HASH_MATCH`
+; routine of the `mg_indices` DLM when it is available; then each value
+; common to both arrays is reported once, as the pair of the first indices
+; in `a` and `b` with that value, ordered by index in `a`.
 ;
 ; :Returns:
 ;   long, number of matches found
@@ -22,9 +27,34 @@
 ;     `i = 0...n_matches - 1` then::
 ;
 ;       a[a_matches[i]] eq b[b_matches[i]]
+;
+;   multiple : in, optional, type=boolean
+;     set to report every pair of indices with equal values, ordered by index
+;     in `a`, then by index in `b`; requires the `mg_indices` DLM
 ;-
-function mg_match, a, b, a_matches=a_matches, b_matches=b_matches
+function mg_match, a, b, a_matches=a_matches, b_matches=b_matches, $
+                   multiple=multiple
   compile_opt strictarr
+  on_error, 2
+
+  ; integer types and strings
+  hash_types = [1, 2, 3, 7, 12, 13, 14, 15]
+  if (mg_hasroutine('mg_hash_match') $
+        && (total(size(a, /type) eq hash_types) gt 0) $
+        && (total(size(b, /type) eq hash_types) gt 0)) then begin
+    n_matches = mg_hash_match(a, b, $
+                              a_matches=a_matches, b_matches=b_matches, $
+                              multiple=multiple)
+    if (n_matches eq 0L) then begin
+      a_matches = !null
+      b_matches = !null
+    endif
+    return, n_matches
+  endif
+
+  if (keyword_set(multiple)) then begin
+    message, 'MULTIPLE requires the mg_indices DLM and integer or string arrays'
+  endif
 
   na = n_elements(a)
   nb = n_elements(b)
@@ -28,6 +28,14 @@
 function mg_setdifference, ind1, ind2, count=count
   compile_opt strictarr
 
+  ; linear time with bitsets or hashing if the mg_indices DLM is available
+  int_types = [1, 2, 3, 12, 13, 14, 15]
+  if (mg_hasroutine('mg_hash_difference') $
+        && (total(size(ind1, /type) eq int_types) gt 0) $
+        && (total(size(ind2, /type) eq int_types) gt 0)) then begin
+    return, mg_hash_difference(ind1, ind2, count=count)
+  endif
+
   min1 = min(ind1, max=max1)
   min2 = min(ind2, max=max2)
 
@@ -28,6 +28,14 @@
 function mg_setintersection, ind1, ind2, count=count
   compile_opt strictarr
 
+  ; linear time with bitsets or hashing if the mg_indices DLM is available
+  int_types = [1, 2, 3, 12, 13, 14, 15]
+  if (mg_hasroutine('mg_hash_intersection') $
+        && (total(size(ind1, /type) eq int_types) gt 0) $
+        && (total(size(ind2, /type) eq int_types) gt 0)) then begin
+    return, mg_hash_intersection(ind1, ind2, count=count)
+  endif
+
   min12 = min(ind1, max=max1) > min(ind2, max=max2)
   max12 = max1 < max2
 
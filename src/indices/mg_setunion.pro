@@ -26,6 +26,14 @@
 function mg_setunion, ind1, ind2, count=count
   compile_opt strictarr
 
+  ; linear time with bitsets or hashing if the mg_indices DLM is available
+  int_types = [1, 2, 3, 12, 13, 14, 15]
+  if (mg_hasroutine('mg_hash_union') $
+        && (total(size(ind1, /type) eq int_types) gt 0) $
+        && (total(size(ind2, /type) eq int_types) gt 0)) then begin
+    return, mg_hash_union(ind1, ind2, count=count)
+  endif
+
   if (ind1[0] lt 0L) then begin
     count = ind2[0] lt 0L ? 0L : n_elements(ind2)
     return, ind2
@@ -16,6 +16,15 @@
 ;     the best of the fits, i.e., the one which minimizes the sum of the
 ;     variances of distances of the points in a cluster to their center;
 ;     default=10
+;   init : type=string
+;     initialization method with the `mg_stats` DLM: "k-means++", "k-means||",
+;     or "random"; default="k-means++"
+;   batch_size : type=integer
+;     set to use mini-batch k-means with batches of this size, requires the
+;     `mg_stats` DLM
+;   inertia : type=double
+;     sum of the squared distances of the samples to their centers after `fit`
+;     with the `mg_stats` DLM
 ;-
 
 ;= API
@@ -38,12 +47,78 @@ pro mg_kmeans::fit, x, y, seed=seed
 
   self->mg_classifier::fit, x, y
 
-  *self._centers = mg_kmeans_centers(x, $
-                                     n_clusters=self.n_clusters, $
-                                     n_iterations=self.n_iterations, $
-                                     n_initializations=self.n_initializations, $
-                                     double=self.double, $
-                                     seed=seed)
+  if (mg_hasroutine('mg_kmeans_fit')) then begin
+    batch = self.batch_size gt 0L ? {batch_size: self.batch_size} : !null
+    *self._centers = mg_kmeans_fit(x, self.n_clusters, $
+                                   counts=counts, $
+                                   double=self.double, $
+                                   inertia=inertia, $
+                                   init=self.init, $
+                                   max_iterations=self.n_iterations, $
+                                   n_init=self.n_initializations, $
+                                   seed=seed, $
+                                   _extra=batch)
+    *self._counts = counts
+    self.inertia = inertia
+  endif else begin
+    *self._centers = mg_kmeans_centers(x, $
+                                       n_clusters=self.n_clusters, $
+                                       n_iterations=self.n_iterations, $
+                                       n_initializations=self.n_initializations, $
+                                       double=self.double, $
+                                       seed=seed)
+  endelse
+end
+
+
+;+
+; Update the model with another chunk of data `x` using mini-batch k-means,
+; so that data too large for memory can be fit a chunk at a time. Requires the
+; `mg_stats` DLM.
+;
+; :Params:
+;   x : in, required, type="fltarr(n_features, n_samples)"
+;     data to learn on
+;   y : in, required, type=lonarr(n_samples)
+;     unused
+;
+; :Keywords:
+;   seed : in, out, optional, type=integer
+;     random number generator seed, used to initialize the centers on the
+;     first chunk
+;-
+pro mg_kmeans::partial_fit, x, y, seed=seed
+  compile_opt strictarr
+  on_error, 2
+
+  if (~mg_hasroutine('mg_kmeans_fit')) then message, 'mg_stats DLM required'
+
+  dims = size(x, /dimensions)
+  batch_size = self.batch_size gt 0L ? self.batch_size : dims[1]
+
+  if (n_elements(*self._counts) eq 0L) then begin
+    self->mg_classifier::fit, x, y
+    *self._centers = mg_kmeans_fit(x, self.n_clusters, $
+                                   batch_size=batch_size, $
+                                   counts=counts, $
+                                   double=self.double, $
+                                   inertia=inertia, $
+                                   init=self.init, $
+                                   max_iterations=1L, $
+                                   seed=seed)
+  endif else begin
+    counts = *self._counts
+    *self._centers = mg_kmeans_fit(x, self.n_clusters, $
+                                   batch_size=batch_size, $
+                                   counts=counts, $
+                                   double=self.double, $
+                                   inertia=inertia, $
+                                   init=*self._centers, $
+                                   seed=seed)
+  endelse
+
+  *self._counts = counts
+  self.inertia = inertia
 end
 
 
@@ -66,6 +141,10 @@ end
 function mg_kmeans::predict, x, y, score=score
   compile_opt strictarr
 
+  if (mg_hasroutine('mg_kmeans_predict')) then begin
+    return, mg_kmeans_predict(x, *self._centers)
+  endif
+
   return, reform(cluster(x, *self._centers, n_clusters=self.n_clusters, double=self.double))
 end
 
@@ -87,6 +166,9 @@ pro mg_kmeans::getProperty, n_clusters=n_clusters, $
                             n_iterations=n_iterations, $
                             n_initializations=n_initializations, $
                             double=double, $
+                            init=init, $
+                            batch_size=batch_size, $
+                            inertia=inertia, $
                             centers=centers, $
                             fit_parameters=fit_parameters, $
                             _ref_extra=e
@@ -96,6 +178,9 @@ pro mg_kmeans::getProperty, n_clusters=n_clusters, $
   if (arg_present(n_iterations)) then n_iterations = self.n_iterations
   if (arg_present(n_initializations)) then n_initializations = self.n_initializations
   if (arg_present(double)) then double = self.double
+  if (arg_present(init)) then init = self.init
+  if (arg_present(batch_size)) then batch_size = self.batch_size
+  if (arg_present(inertia)) then inertia = self.inertia
   if (arg_present(centers)) then centers = *self._centers
   if (arg_present(fit_parameters)) then fit_parameters = *self._centers
 
@@ -103,10 +188,19 @@ pro mg_kmeans::getProperty, n_clusters=n_clusters, $
 end
 
 
-pro mg_kmeans::setProperty, fit_parameters=fit_parameters, _extra=e
+pro mg_kmeans::setProperty, init=init, $
+                            batch_size=batch_size, $
+                            fit_parameters=fit_parameters, $
+                            _extra=e
   compile_opt strictarr
 
-  if (n_elements(fit_parameters) gt 0L) then *self._centers = fit_parameters
+  if (n_elements(init) gt 0L) then self.init = init
+  if (n_elements(batch_size) gt 0L) then self.batch_size = batch_size
+  if (n_elements(fit_parameters) gt 0L) then begin
+    *self._centers = fit_parameters
+    ptr_free, self._counts
+    self._counts = ptr_new(/allocate_heap)
+  endif
 
   if (n_elements(e) gt 0L) then self->mg_classifier::setProperty, _extra=e
 end
@@ -117,7 +211,7 @@ end
 pro mg_kmeans::cleanup
   compile_opt strictarr
 
-  ptr_free, self._centers
+  ptr_free, self._centers, self._counts
   self->mg_classifier::cleanup
 end
 
@@ -126,6 +220,8 @@ function mg_kmeans::init, n_clusters=n_clusters, $
                           n_iterations=n_iterations, $
                           n_initializations=n_initializations, $
                           double=double, $
+                          init=init, $
+                          batch_size=batch_size, $
                           _extra=e
   compile_opt strictarr
 
@@ -138,8 +234,11 @@ function mg_kmeans::init, n_clusters=n_clusters, $
   self.n_iterations = mg_default(n_iterations, 20)
   self.n_initializations = mg_default(n_initializations, 10)
   self.double = keyword_set(double)
+  self.init = mg_default(init, 'k-means++')
+  self.batch_size = mg_default(batch_size, 0L)
 
   self._centers = ptr_new(/allocate_heap)
+  self._counts = ptr_new(/allocate_heap)
 
   return, 1
 end
@@ -153,7 +252,11 @@ pro mg_kmeans__define
            n_iterations: 0L, $
            n_initializations: 0L, $
            double: 0B, $
-           _centers: ptr_new() $
+           init: '', $
+           batch_size: 0L, $
+           inertia: 0.0D, $
+           _centers: ptr_new(), $
+           _counts: ptr_new() $
           }
 end
 
@@ -9,6 +9,8 @@
 ; :Properties:
 ;   n_neighbors : type=integer
 ;     number of neighbors to find, defaults to 1
+;   metric : type=string
+;     distance to use: euclidean (the default), manhattan, or chebyshev
 ;-
 
 ;= API
@@ -29,6 +31,9 @@ pro mg_kneighborsclassifier::fit, x, y
 
   *self._x = x
   *self._y = y
+
+  ; index the training data once so predictions do not use brute force
+  if (mg_hasroutine('mg_kdtree_build')) then *self._tree = mg_kdtree_build(x)
 end
 
 
@@ -56,7 +61,13 @@ function mg_kneighborsclassifier::predict, x, y, score=score
   y_predict = lonarr(n_samples_predict)
 
   ; find indices of nearest self.n_neighbors neighbors in *self._x...
-  neighbor_indices = mg_kneighbors(*self._x, x, self.n_neighbors)
+  if (n_elements(*self._tree) gt 0L) then begin
+    neighbor_indices = mg_kdtree_query(*self._tree, x, self.n_neighbors, $
+                                       metric=self.metric)
+  endif else begin
+    neighbor_indices = mg_kneighbors(*self._x, x, self.n_neighbors, $
+                                     metric=self.metric)
+  endelse
 
   for s = 0L, dims[1] - 1L do begin
     ; ...and look up the *self._y values for them, selecting the most common
@@ -85,13 +96,19 @@ end
 ;= property access
 
 pro mg_kneighborsclassifier::getProperty, n_neighbors=n_neighbors, $
+                                          metric=metric, $
                                           fit_parameters=fit_parameters, $
                                           _ref_extra=e
   compile_opt strictarr
 
   if (arg_present(n_neighbors)) then n_neighbors = self.n_neighbors
+  if (arg_present(metric)) then metric = self.metric
   if (arg_present(fit_parameters)) then begin
-    fit_parameters = {x: *self._x, y: *self._y}
+    if (n_elements(*self._tree) gt 0L) then begin
+      fit_parameters = {x: *self._x, y: *self._y, tree: *self._tree}
+    endif else begin
+      fit_parameters = {x: *self._x, y: *self._y}
+    endelse
   endif
 
   if (n_elements(e) gt 0L) then self->mg_classifier::getProperty, _extra=e
@@ -104,6 +121,11 @@ pro mg_kneighborsclassifier::setProperty, fit_parameters=fit_parameters, _extra=
   if (n_elements(fit_parameters) gt 0L) then begin
     *self._x = fit_parameters.x
     *self._y = fit_parameters.y
+    if (total(tag_names(fit_parameters) eq 'TREE', /integer) gt 0L) then begin
+      *self._tree = fit_parameters.tree
+    endif else if (mg_hasroutine('mg_kdtree_build')) then begin
+      *self._tree = mg_kdtree_build(*self._x)
+    endif
   endif
 
   if (n_elements(e) gt 0L) then self->mg_classifier::setProperty, _extra=e
@@ -115,12 +137,13 @@ end
 pro mg_kneighborsclassifier::cleanup
   compile_opt strictarr
 
-  ptr_free, self._x, self._y
+  ptr_free, self._x, self._y, self._tree
   self->mg_classifier::cleanup
 end
 
 
-function mg_kneighborsclassifier::init, n_neighbors=n_neighbors, _extra=e
+function mg_kneighborsclassifier::init, n_neighbors=n_neighbors, metric=metric, $
+                                        _extra=e
   compile_opt strictarr
 
   if (~self->mg_classifier::init(_extra=e)) then return, 0
@@ -129,8 +152,10 @@ function mg_kneighborsclassifier::init, n_neighbors=n_neighbors, _extra=e
   self.name = 'KNeighborsClassifier'
 
   self.n_neighbors = mg_default(n_neighbors, 1)
+  self.metric = mg_default(metric, 'euclidean')
   self._x = ptr_new(/allocate_heap)
   self._y = ptr_new(/allocate_heap)
+  self._tree = ptr_new(/allocate_heap)
 
   return, 1
 end
@@ -141,8 +166,10 @@ pro mg_kneighborsclassifier__define
 
   !null = {mg_kneighborsclassifier, inherits mg_classifier, $
            n_neighbors: 0L, $
+           metric: '', $
            _x: ptr_new(), $
-           _y: ptr_new() $
+           _y: ptr_new(), $
+           _tree: ptr_new() $
           }
 end
 
@@ -16,7 +16,9 @@
 function mg_deserialize, str
   compile_opt strictarr
 
-  bytes = idl_base64(str)
+  bytes = mg_hasroutine('mg_base64_decode') $
+            ? mg_base64_decode(str) $
+            : idl_base64(str)
 
   typecode = ulong(bytes[0])
   dims = ulong64(bytes[1:64], 0, 8)
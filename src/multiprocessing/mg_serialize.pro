@@ -34,6 +34,8 @@ function mg_serialize, var
   ; tack on dims and type to the beginning of every serialization byte stream
   bytes = [typecode, byte(dims, 0, 64), bytes]
 
-  return, idl_base64(bytes)
+  return, mg_hasroutine('mg_base64_encode') $
+            ? mg_base64_encode(bytes) $
+            : idl_base64(bytes)
 end
 
@@ -0,0 +1,768 @@
+/*
+  DLM for base64 encoding and decoding of byte arrays and strings, with the
+  standard and URL-safe alphabets. Large inputs are split across threads,
+  streams can be processed in chunks by passing a STATE variable between
+  calls, and results can be written directly into an existing byte array.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mg_idl_export.h"
+#include "mg_threads.h"
+
+// minimum number of 3 byte groups (or 4 character quads) per thread
+#define MG_BASE64_MIN_GROUPS   65536
+
+// value in the scalar decode table for characters that are not in an alphabet
+#define MG_BASE64_INVALID      -1
+#define MG_BASE64_WHITESPACE   -2
+#define MG_BASE64_PAD          -3
+
+// bit set in the fast decode tables for characters not in an alphabet
+#define MG_BASE64_BAD          0x80000000
+
+/*
+  Leftover bytes of an encoding, or 6-bit values of a partial quad of a
+  decoding, between chunks of a stream. In IDL, the state is a `bytarr(6)`:
+  `[n, n_pad, v[0], v[1], v[2], v[3]]`.
+*/
+typedef struct {
+  int n;
+  int n_pad;
+  UCHAR v[4];
+} mg_base64_state;
+
+#define MG_BASE64_STATE_SIZE   6
+
+static const char *mg_base64_alphabets[2] = {
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/",
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"
+};
+
+// the two characters encoding each 12-bit value, for each alphabet
+static UCHAR mg_base64_pairs[2][4096][2];
+
+// value of each character shifted into place for each position in a quad
+static IDL_ULONG mg_base64_quad[4][256];
+
+// value of each character, or one of the codes above; both alphabets decode
+static signed char mg_base64_values[256];
+
+
+static void mg_base64_init_tables(void) {
+  int a, i, c, p;
+
+  for (a = 0; a < 2; a++) {
+    for (i = 0; i < 4096; i++) {
+      mg_base64_pairs[a][i][0] = mg_base64_alphabets[a][i >> 6];
+      mg_base64_pairs[a][i][1] = mg_base64_alphabets[a][i & 63];
+    }
+  }
+
+  for (c = 0; c < 256; c++) mg_base64_values[c] = MG_BASE64_INVALID;
+  for (a = 0; a < 2; a++) {
+    for (i = 0; i < 64; i++) {
+      mg_base64_values[(UCHAR) mg_base64_alphabets[a][i]] = i;
+    }
+  }
+  mg_base64_values[' '] = MG_BASE64_WHITESPACE;
+  mg_base64_values['\t'] = MG_BASE64_WHITESPACE;
+  mg_base64_values['\r'] = MG_BASE64_WHITESPACE;
+  mg_base64_values['\n'] = MG_BASE64_WHITESPACE;
+  mg_base64_values['='] = MG_BASE64_PAD;
+
+  for (c = 0; c < 256; c++) {
+    for (p = 0; p < 4; p++) {
+      mg_base64_quad[p][c] = mg_base64_values[c] >= 0
+                               ? (IDL_ULONG) mg_base64_values[c] << (18 - 6 * p)
+                               : MG_BASE64_BAD;
+    }
+  }
+}
+
+
+/**************************************************************************
+  Encoding
+***************************************************************************/
+
+// encode n_groups groups of 3 bytes as 4 characters each
+static void mg_base64_encode_groups(const UCHAR *in, IDL_MEMINT n_groups,
+                                    UCHAR *out, UCHAR (*pairs)[2]) {
+  IDL_MEMINT i;
+  IDL_ULONG x;
+
+  for (i = 0; i < n_groups; i++, in += 3, out += 4) {
+    x = ((IDL_ULONG) in[0] << 16) | ((IDL_ULONG) in[1] << 8) | in[2];
+    memcpy(out, pairs[x >> 12], 2);
+    memcpy(out + 2, pairs[x & 0xfff], 2);
+  }
+}
+
+
+// encode the last 1 or 2 bytes of a stream, returns the number of characters
+static int mg_base64_encode_last(const UCHAR *in, int n, UCHAR *out,
+                                 const char *alphabet, int pad) {
+  IDL_ULONG x = ((IDL_ULONG) in[0] << 16) | (n > 1 ? (IDL_ULONG) in[1] << 8 : 0);
+
+  out[0] = alphabet[x >> 18];
+  out[1] = alphabet[(x >> 12) & 63];
+  if (n > 1) out[2] = alphabet[(x >> 6) & 63];
+  if (!pad) return n + 1;
+  if (n == 1) out[2] = '=';
+  out[3] = '=';
+  return 4;
+}
+
+
+typedef struct {
+  const UCHAR *in;
+  UCHAR *out;
+  UCHAR (*pairs)[2];
+} mg_base64_encode_info;
+
+
+static void mg_base64_encode_work(IDL_MEMINT start, IDL_MEMINT end,
+                                  int thread_index, void *data) {
+  mg_base64_encode_info *info = (mg_base64_encode_info *) data;
+  mg_base64_encode_groups(info->in + 3 * start, end - start,
+                          info->out + 4 * start, info->pairs);
+}
+
+
+/*
+  Number of characters produced by encoding n more bytes of a stream in the
+  given state, flushing the stream if final is set.
+*/
+static IDL_MEMINT mg_base64_encode_size(const mg_base64_state *state,
+                                        IDL_MEMINT n, int final, int pad) {
+  IDL_MEMINT total = state->n + n;
+  int r = (int) (total % 3);
+
+  return 4 * (total / 3) + (final && r > 0 ? (pad ? 4 : r + 1) : 0);
+}
+
+
+/*
+  Encode n bytes into out, which must hold mg_base64_encode_size characters,
+  leaving the last bytes of an incomplete group in the state unless final is
+  set.
+*/
+static void mg_base64_encode(mg_base64_state *state, const UCHAR *in,
+                             IDL_MEMINT n, UCHAR *out, int url, int final,
+                             int pad, int n_threads) {
+  mg_base64_encode_info info;
+  IDL_MEMINT n_groups;
+
+  // complete a group with the bytes left from the last chunk
+  while (state->n > 0 && state->n < 3 && n > 0) {
+    state->v[state->n++] = *in++;
+    n--;
+  }
+  if (state->n == 3) {
+    mg_base64_encode_groups(state->v, 1, out, mg_base64_pairs[url]);
+    out += 4;
+    state->n = 0;
+  }
+
+  n_groups = n / 3;
+  info.in = in;
+  info.out = out;
+  info.pairs = mg_base64_pairs[url];
+  mg_thread_run(mg_thread_count(n_groups, MG_BASE64_MIN_GROUPS, n_threads),
+                n_groups, mg_base64_encode_work, &info);
+  in += 3 * n_groups;
+  out += 4 * n_groups;
+
+  for (n -= 3 * n_groups; n > 0; n--) state->v[state->n++] = *in++;
+
+  if (final && state->n > 0) {
+    mg_base64_encode_last(state->v, state->n, out,
+                          mg_base64_alphabets[url], pad);
+    state->n = 0;
+  }
+}
+
+
+/**************************************************************************
+  Decoding
+***************************************************************************/
+
+/*
+  Decode n_quads quads of 4 characters into 3 bytes each, returning a value
+  with MG_BASE64_BAD set if any character is not in an alphabet (including
+  whitespace and padding).
+*/
+static IDL_ULONG mg_base64_decode_quads(const UCHAR *in, IDL_MEMINT n_quads,
+                                        UCHAR *out) {
+  IDL_MEMINT i;
+  IDL_ULONG x, bad = 0;
+
+  for (i = 0; i < n_quads; i++, in += 4, out += 3) {
+    x = mg_base64_quad[0][in[0]] | mg_base64_quad[1][in[1]]
+          | mg_base64_quad[2][in[2]] | mg_base64_quad[3][in[3]];
+    bad |= x;
+    out[0] = (UCHAR) (x >> 16);
+    out[1] = (UCHAR) (x >> 8);
+    out[2] = (UCHAR) x;
+  }
+
+  return bad & MG_BASE64_BAD;
+}
+
+
+// write the bytes of the complete quad in the state, returns their number
+static int mg_base64_decode_emit(mg_base64_state *state, UCHAR *out) {
+  IDL_ULONG x = 0;
+  int i, n_bytes = (state->n + state->n_pad) == 4 ? 3 - state->n_pad : state->n - 1;
+
+  for (i = 0; i < state->n; i++) x |= (IDL_ULONG) state->v[i] << (18 - 6 * i);
+  for (i = 0; i < n_bytes; i++) out[i] = (UCHAR) (x >> (16 - 8 * i));
+
+  state->n = 0;
+  state->n_pad = 0;
+
+  return n_bytes;
+}
+
+
+/*
+  Decode n characters one at a time, skipping whitespace, into out, which
+  must hold 3 * ((state->n + state->n_pad + n) / 4) bytes. Returns the number of bytes
+  written, or -1 and sets *error_pos to the index of an invalid character.
+*/
+static IDL_MEMINT mg_base64_decode_scalar(mg_base64_state *state,
+                                          const UCHAR *in, IDL_MEMINT n,
+                                          UCHAR *out, IDL_MEMINT *error_pos) {
+  IDL_MEMINT i, n_out = 0;
+  int value;
+
+  for (i = 0; i < n; i++) {
+    value = mg_base64_values[in[i]];
+    if (value == MG_BASE64_WHITESPACE) continue;
+    if (value == MG_BASE64_PAD) {
+      if (state->n < 2) break;
+      state->n_pad++;
+    } else if (value == MG_BASE64_INVALID || state->n_pad > 0) {
+      break;
+    } else {
+      state->v[state->n++] = (UCHAR) value;
+    }
+    if (state->n + state->n_pad == 4) n_out += mg_base64_decode_emit(state, out + n_out);
+  }
+
+  if (i < n) {
+    *error_pos = i;
+    return -1;
+  }
+
+  return n_out;
+}
+
+
+// flush a partial quad at the end of a stream, returns -1 if it is invalid
+static int mg_base64_decode_last(mg_base64_state *state, UCHAR *out) {
+  if (state->n == 0) return 0;
+  if (state->n == 1) return -1;
+  return mg_base64_decode_emit(state, out);
+}
+
+
+typedef struct {
+  const UCHAR *in;
+  UCHAR *out;
+  IDL_ULONG bad[MG_THREADS_MAX];
+} mg_base64_decode_info;
+
+
+static void mg_base64_decode_work(IDL_MEMINT start, IDL_MEMINT end,
+                                  int thread_index, void *data) {
+  mg_base64_decode_info *info = (mg_base64_decode_info *) data;
+  info->bad[thread_index] = mg_base64_decode_quads(info->in + 4 * start,
+                                                   end - start,
+                                                   info->out + 3 * start);
+}
+
+
+/*
+  Decoding is done in three pieces: the characters that complete a quad left
+  in the state, the following whole quads, decoded across threads without
+  checking each character, and the last (possibly padded) quad. The first
+  and last pieces are decoded into small buffers up front, so the exact size
+  of the output is known if the quads in between are valid.
+*/
+typedef struct {
+  mg_base64_state state;   // state at the start of the chunk
+  mg_base64_state final_state;
+  UCHAR head[3];
+  int n_head;
+  IDL_MEMINT head_length;  // number of characters in the first piece
+  IDL_MEMINT n_quads;
+  UCHAR tail[6];
+  int n_tail;
+} mg_base64_decode_plan;
+
+
+// returns -1 and sets *error_pos if the first or last piece is invalid
+static IDL_MEMINT mg_base64_decode_prepare(mg_base64_decode_plan *plan,
+                                           const UCHAR *in, IDL_MEMINT n,
+                                           int final, IDL_MEMINT *error_pos) {
+  mg_base64_state state = plan->state;
+  IDL_MEMINT i, n_bytes, end, tail_start;
+  int n_last;
+
+  plan->n_head = 0;
+  for (i = 0; i < n && (state.n > 0 || state.n_pad > 0); i++) {
+    n_bytes = mg_base64_decode_scalar(&state, in + i, 1, plan->head + plan->n_head,
+                                      error_pos);
+    if (n_bytes < 0) {
+      *error_pos += i;
+      return -1;
+    }
+    plan->n_head += (int) n_bytes;
+  }
+  plan->head_length = i;
+
+  // leave at least one character and any trailing whitespace for the last
+  // piece
+  for (end = n; end > i && mg_base64_values[in[end - 1]] == MG_BASE64_WHITESPACE; end--);
+  plan->n_quads = end - i > 0 ? (end - i - 1) / 4 : 0;
+  tail_start = i + 4 * plan->n_quads;
+
+  n_bytes = mg_base64_decode_scalar(&state, in + tail_start, n - tail_start,
+                                    plan->tail, error_pos);
+  if (n_bytes < 0) {
+    *error_pos += tail_start;
+    return -1;
+  }
+  plan->n_tail = (int) n_bytes;
+
+  if (final) {
+    n_last = mg_base64_decode_last(&state, plan->tail + plan->n_tail);
+    if (n_last < 0) {
+      *error_pos = n;
+      return -1;
+    }
+    plan->n_tail += n_last;
+  }
+  plan->final_state = state;
+
+  return plan->n_head + 3 * plan->n_quads + plan->n_tail;
+}
+
+
+// returns 0 if a character in the whole quads was not valid
+static int mg_base64_decode_planned(mg_base64_decode_plan *plan,
+                                    const UCHAR *in, UCHAR *out,
+                                    int n_threads) {
+  mg_base64_decode_info info;
+  int t, nthreads = mg_thread_count(plan->n_quads, MG_BASE64_MIN_GROUPS,
+                                    n_threads);
+
+  memcpy(out, plan->head, plan->n_head);
+  out += plan->n_head;
+
+  info.in = in + plan->head_length;
+  info.out = out;
+  for (t = 0; t < nthreads; t++) info.bad[t] = 0;
+  mg_thread_run(nthreads, plan->n_quads, mg_base64_decode_work, &info);
+  for (t = 0; t < nthreads; t++) {
+    if (info.bad[t]) return 0;
+  }
+
+  memcpy(out + 3 * plan->n_quads, plan->tail, plan->n_tail);
+
+  return 1;
+}
+
+
+/*
+  Decode characters with whitespace or padding before the last quad one at a
+  time into a new buffer; returns the number of bytes in *out, or -1 and sets
+  *error_pos, or -2 if memory is not available.
+*/
+static IDL_MEMINT mg_base64_decode_slow(mg_base64_state *state,
+                                        const UCHAR *in, IDL_MEMINT n,
+                                        int final, UCHAR **out,
+                                        IDL_MEMINT *error_pos) {
+  IDL_MEMINT n_bytes;
+  int n_last = 0;
+
+  *out = (UCHAR *) malloc(3 * ((state->n + state->n_pad + n) / 4) + 3);
+  if (*out == NULL) return -2;
+
+  n_bytes = mg_base64_decode_scalar(state, in, n, *out, error_pos);
+  if (n_bytes >= 0 && final) {
+    n_last = mg_base64_decode_last(state, *out + n_bytes);
+    if (n_last < 0) *error_pos = n;
+  }
+  if (n_bytes < 0 || n_last < 0) {
+    free(*out);
+    *out = NULL;
+    return -1;
+  }
+
+  return n_bytes + n_last;
+}
+
+
+/**************************************************************************
+  IDL interface
+***************************************************************************/
+
+// returns 0 if the variable does not hold a valid state
+static int mg_base64_get_state(IDL_VPTR var, mg_base64_state *state) {
+  UCHAR *bytes;
+  int i;
+
+  memset(state, 0, sizeof(mg_base64_state));
+  if (var == NULL || var->type == IDL_TYP_UNDEF) return 1;
+
+  if (var->type != IDL_TYP_BYTE || !(var->flags & IDL_V_ARR)
+        || var->value.arr->n_elts != MG_BASE64_STATE_SIZE) {
+    return 0;
+  }
+  bytes = var->value.arr->data;
+  if (bytes[0] > 3 || bytes[1] > 2 || bytes[0] + bytes[1] > 3) return 0;
+
+  state->n = bytes[0];
+  state->n_pad = bytes[1];
+  for (i = 0; i < 4; i++) state->v[i] = bytes[i + 2];
+
+  return 1;
+}
+
+
+static void mg_base64_set_state(IDL_VPTR var, mg_base64_state *state) {
+  IDL_VPTR tmp;
+  UCHAR *bytes = (UCHAR *) IDL_MakeTempVector(IDL_TYP_BYTE, MG_BASE64_STATE_SIZE,
+                                              IDL_ARR_INI_ZERO, &tmp);
+  int i;
+
+  bytes[0] = (UCHAR) state->n;
+  bytes[1] = (UCHAR) state->n_pad;
+  for (i = 0; i < 4; i++) bytes[i + 2] = state->v[i];
+
+  IDL_VarCopy(tmp, var);
+}
+
+
+/*
+  Returns a pointer to n bytes at offset in the byte array var, or NULL with
+  a message in msg.
+*/
+static UCHAR *mg_base64_get_output(IDL_VPTR var, IDL_LONG64 offset,
+                                   IDL_MEMINT n, char *msg, size_t msg_size) {
+  if (var->type != IDL_TYP_BYTE || !(var->flags & IDL_V_ARR)) {
+    snprintf(msg, msg_size, "OUTPUT must be a byte array");
+    return NULL;
+  }
+  if (offset < 0 || offset > var->value.arr->n_elts) {
+    snprintf(msg, msg_size, "OFFSET out of range");
+    return NULL;
+  }
+  if (n > var->value.arr->n_elts - offset) {
+    snprintf(msg, msg_size, "OUTPUT too small, %lld bytes needed",
+             (long long) (offset + n));
+    return NULL;
+  }
+
+  return var->value.arr->data + offset;
+}
+
+
+// returns 0 if the input is not a string or array of bytes
+static int mg_base64_get_input(IDL_VPTR input, int bytes_only,
+                               UCHAR **data, IDL_MEMINT *n) {
+  if (input->type == IDL_TYP_STRING) {
+    if (input->flags & IDL_V_ARR) return 0;
+    *data = (UCHAR *) IDL_STRING_STR(&input->value.str);
+    *n = input->value.str.slen;
+    return 1;
+  }
+
+  if (input->type == IDL_TYP_PTR || input->type == IDL_TYP_OBJREF
+        || input->type == IDL_TYP_STRUCT) {
+    return 0;
+  }
+  if (bytes_only && input->type != IDL_TYP_BYTE) return 0;
+
+  IDL_VarGetData(input, n, (char **) data, FALSE);
+  *n *= IDL_TypeSizeGet(input->type);
+
+  return 1;
+}
+
+
+// IDL strings are limited to 2^31 - 1 characters
+static IDL_VPTR mg_base64_make_string(const UCHAR *data, IDL_MEMINT n,
+                                      char **chars) {
+  IDL_VPTR result = IDL_StrToSTRING("");
+
+  *chars = NULL;
+  if (n > 0) {
+    IDL_StrEnsureLength(&result->value.str, (int) n);
+    *chars = result->value.str.s;
+    if (data) memcpy(*chars, data, n);
+    (*chars)[n] = '\0';
+    result->value.str.slen = (IDL_STRING_SLEN_T) n;
+  }
+
+  return result;
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_base64_encode(int argc, IDL_VPTR *argv, char *argk) {
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_VPTR count;
+    int count_present;
+    IDL_LONG flush;
+    IDL_LONG n_threads;
+    IDL_LONG no_padding;
+    IDL_LONG64 offset;
+    IDL_VPTR output;
+    int output_present;
+    IDL_VPTR state;
+    int state_present;
+    IDL_LONG url;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "COUNT", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(count_present), IDL_KW_OFFSETOF(count) },
+    { "FLUSH", IDL_TYP_LONG, 1, IDL_KW_ZERO | IDL_KW_VALUE | 1,
+      0, IDL_KW_OFFSETOF(flush) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { "NO_PADDING", IDL_TYP_LONG, 1, IDL_KW_ZERO | IDL_KW_VALUE | 1,
+      0, IDL_KW_OFFSETOF(no_padding) },
+    { "OFFSET", IDL_TYP_LONG64, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(offset) },
+    { "OUTPUT", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(output_present), IDL_KW_OFFSETOF(output) },
+    { "STATE", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(state_present), IDL_KW_OFFSETOF(state) },
+    { "URL", IDL_TYP_LONG, 1, IDL_KW_ZERO | IDL_KW_VALUE | 1,
+      0, IDL_KW_OFFSETOF(url) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  IDL_VPTR result;
+  mg_base64_state state;
+  UCHAR *in, *out;
+  char *chars, msg[256];
+  IDL_MEMINT n, n_chars;
+  int nargs, final;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+
+  IDL_ENSURE_SIMPLE(argv[0]);
+
+  if (!mg_base64_get_input(argv[0], FALSE, &in, &n)) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "input must be a scalar string or a numeric array");
+  }
+  if (!mg_base64_get_state(kw.state_present ? kw.state : NULL, &state)
+        || state.n_pad > 0 || state.n > 2) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "invalid STATE");
+  }
+
+  final = !kw.state_present || kw.flush;
+  n_chars = mg_base64_encode_size(&state, n, final, !kw.no_padding);
+
+  if (kw.output_present) {
+    out = mg_base64_get_output(kw.output, kw.offset, n_chars, msg, sizeof(msg));
+    if (out == NULL) {
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "%s", msg);
+    }
+    result = IDL_GettmpLong64(n_chars);
+  } else {
+    if (n_chars > 2147483647) {
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "result too long for a string, use OUTPUT");
+    }
+    result = mg_base64_make_string(NULL, n_chars, &chars);
+    out = (UCHAR *) chars;
+  }
+
+  mg_base64_encode(&state, in, n, out, kw.url, final, !kw.no_padding,
+                   kw.n_threads);
+
+  if (kw.state_present) mg_base64_set_state(kw.state, &state);
+  if (kw.count_present) IDL_VarCopy(IDL_GettmpLong64(n_chars), kw.count);
+
+  IDL_KW_FREE;
+
+  return result;
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_base64_decode(int argc, IDL_VPTR *argv, char *argk) {
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_VPTR count;
+    int count_present;
+    IDL_LONG flush;
+    IDL_LONG n_threads;
+    IDL_LONG64 offset;
+    IDL_VPTR output;
+    int output_present;
+    IDL_VPTR state;
+    int state_present;
+    IDL_LONG string;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "COUNT", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(count_present), IDL_KW_OFFSETOF(count) },
+    { "FLUSH", IDL_TYP_LONG, 1, IDL_KW_ZERO | IDL_KW_VALUE | 1,
+      0, IDL_KW_OFFSETOF(flush) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { "OFFSET", IDL_TYP_LONG64, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(offset) },
+    { "OUTPUT", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(output_present), IDL_KW_OFFSETOF(output) },
+    { "STATE", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(state_present), IDL_KW_OFFSETOF(state) },
+    { "STRING", IDL_TYP_LONG, 1, IDL_KW_ZERO | IDL_KW_VALUE | 1,
+      0, IDL_KW_OFFSETOF(string) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  IDL_VPTR result = NULL;
+  mg_base64_decode_plan plan;
+  mg_base64_state state;
+  UCHAR *in, *out = NULL, *slow = NULL;
+  char *chars, msg[256];
+  IDL_MEMINT n, n_bytes, error_pos;
+  int nargs, final;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+
+  IDL_ENSURE_SIMPLE(argv[0]);
+
+  if (!mg_base64_get_input(argv[0], TRUE, &in, &n)) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "input must be a scalar string or a byte array");
+  }
+  if (!mg_base64_get_state(kw.state_present ? kw.state : NULL, &plan.state)) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "invalid STATE");
+  }
+
+  final = !kw.state_present || kw.flush;
+  n_bytes = mg_base64_decode_prepare(&plan, in, n, final, &error_pos);
+  state = plan.final_state;
+
+  // try decoding the whole quads, assuming they are valid, into the result;
+  // OUTPUT is only written once the decoding has succeeded, so it goes
+  // through a buffer
+  if (n_bytes >= 0) {
+    if (kw.output_present) {
+      out = slow = (UCHAR *) malloc(n_bytes > 0 ? n_bytes : 1);
+    } else if (kw.string) {
+      result = n_bytes > 2147483647 ? NULL : mg_base64_make_string(NULL, n_bytes, &chars);
+      out = (UCHAR *) chars;
+    } else if (n_bytes > 0) {
+      out = (UCHAR *) IDL_MakeTempVector(IDL_TYP_BYTE, n_bytes,
+                                         IDL_ARR_INI_NOP, &result);
+    }
+
+    // the size is too large if there are invalid quads, so check them first
+    if ((out == NULL && n_bytes > 0)
+          || !mg_base64_decode_planned(&plan, in, out, kw.n_threads)) {
+      if (result) IDL_Deltmp(result);
+      result = NULL;
+      free(slow);
+      slow = NULL;
+      n_bytes = -1;
+    }
+  }
+
+  if (n_bytes < 0) {
+    state = plan.state;
+    n_bytes = mg_base64_decode_slow(&state, in, n, final, &slow, &error_pos);
+    if (n_bytes == -2) {
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "unable to allocate memory");
+    }
+    if (n_bytes < 0) {
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  error_pos < n ? "invalid base64 character at position %lld"
+                                : "incomplete base64 input",
+                  (long long) error_pos);
+    }
+
+    if (kw.output_present) {
+      // OUTPUT is filled from the buffer below
+    } else if (kw.string) {
+      result = n_bytes > 2147483647 ? NULL : mg_base64_make_string(slow, n_bytes, &chars);
+    } else if (n_bytes > 0) {
+      out = (UCHAR *) IDL_MakeTempVector(IDL_TYP_BYTE, n_bytes,
+                                         IDL_ARR_INI_NOP, &result);
+      memcpy(out, slow, n_bytes);
+    }
+  }
+
+  if (kw.output_present) {
+    out = mg_base64_get_output(kw.output, kw.offset, n_bytes, msg, sizeof(msg));
+    if (out) memcpy(out, slow, n_bytes);
+  }
+  free(slow);
+
+  if (kw.output_present && out == NULL) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "%s", msg);
+  }
+  if (kw.string && !kw.output_present && result == NULL) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "result too long for a string, use OUTPUT");
+  }
+
+  if (kw.output_present) {
+    result = IDL_GettmpLong64(n_bytes);
+  } else if (result == NULL) {
+    result = IDL_GettmpByte(0);
+  }
+
+  if (kw.state_present) mg_base64_set_state(kw.state, &state);
+  if (kw.count_present) IDL_VarCopy(IDL_GettmpLong64(n_bytes), kw.count);
+
+  IDL_KW_FREE;
+
+  return result;
+}
+
+
+/*
+  Register the routines available for IDL; they must be specified exactly as
+  in mg_base64.dlm.
+*/
+
+// functions to register
+static IDL_SYSFUN_DEF2 function_addr[] = {
+  { IDL_mg_base64_decode, "MG_BASE64_DECODE", 1, 1, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+  { IDL_mg_base64_encode, "MG_BASE64_ENCODE", 1, 1, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+};
+
+int IDL_Load(void) {
+  mg_base64_init_tables();
+  return IDL_SysRtnAdd(function_addr, TRUE, IDL_CARRAY_ELTS(function_addr));
+}
@@ -0,0 +1,769 @@
+/*
+  DLM for message digests and hashes: MD5, SHA-1, SHA-256, and the
+  non-cryptographic XXH64. Strings, string arrays (one digest per element),
+  the bytes of numeric arrays, and files are hashed; files are read in large
+  chunks, never loaded into IDL memory, and can be hashed concurrently.
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mg_idl_export.h"
+#include "mg_threads.h"
+
+// size of the buffer used to read files
+#define MG_HASH_CHUNK_SIZE   (1024 * 1024)
+
+// minimum number of strings per thread
+#define MG_HASH_MIN_ELTS     256
+
+#define MG_HASH_MAX_DIGEST   32
+
+// longest algorithm name reported in an error message
+#define MG_HASH_MAX_NAME     63
+
+#define MG_ROTL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define MG_ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define MG_ROTL64(x, n) (((x) << (n)) | ((x) >> (64 - (n))))
+
+typedef struct {
+  IDL_ULONG h[8];          // MD5, SHA-1, SHA-256 state
+  IDL_ULONG64 v[4];        // XXH64 accumulators
+  IDL_ULONG64 seed;
+  IDL_ULONG64 length;      // number of bytes hashed
+  UCHAR buffer[64];        // partial block
+  int n_buffer;
+} mg_hash_state;
+
+typedef struct {
+  char *name;
+  int digest_size;
+  int block_size;
+  void (*init)(mg_hash_state *state);
+  void (*blocks)(mg_hash_state *state, const UCHAR *data, size_t n_blocks);
+  void (*final)(mg_hash_state *state, UCHAR *digest);
+} mg_hash_algorithm;
+
+
+static IDL_ULONG mg_hash_load32le(const UCHAR *p) {
+  return (IDL_ULONG) p[0] | ((IDL_ULONG) p[1] << 8)
+           | ((IDL_ULONG) p[2] << 16) | ((IDL_ULONG) p[3] << 24);
+}
+
+
+static IDL_ULONG mg_hash_load32be(const UCHAR *p) {
+  return ((IDL_ULONG) p[0] << 24) | ((IDL_ULONG) p[1] << 16)
+           | ((IDL_ULONG) p[2] << 8) | (IDL_ULONG) p[3];
+}
+
+
+static IDL_ULONG64 mg_hash_load64le(const UCHAR *p) {
+  return (IDL_ULONG64) mg_hash_load32le(p)
+           | ((IDL_ULONG64) mg_hash_load32le(p + 4) << 32);
+}
+
+
+static void mg_hash_store32le(UCHAR *p, IDL_ULONG x) {
+  p[0] = (UCHAR) x;
+  p[1] = (UCHAR) (x >> 8);
+  p[2] = (UCHAR) (x >> 16);
+  p[3] = (UCHAR) (x >> 24);
+}
+
+
+static void mg_hash_store32be(UCHAR *p, IDL_ULONG x) {
+  p[0] = (UCHAR) (x >> 24);
+  p[1] = (UCHAR) (x >> 16);
+  p[2] = (UCHAR) (x >> 8);
+  p[3] = (UCHAR) x;
+}
+
+
+// pad the last block with 0x80, zeros, and the bit length in 8 bytes
+static void mg_hash_pad(mg_hash_state *state, const mg_hash_algorithm *algorithm,
+                        int big_endian) {
+  IDL_ULONG64 bits = state->length * 8;
+  int i;
+
+  state->buffer[state->n_buffer++] = 0x80;
+  if (state->n_buffer > 56) {
+    memset(state->buffer + state->n_buffer, 0, 64 - state->n_buffer);
+    algorithm->blocks(state, state->buffer, 1);
+    state->n_buffer = 0;
+  }
+  memset(state->buffer + state->n_buffer, 0, 56 - state->n_buffer);
+  for (i = 0; i < 8; i++) {
+    state->buffer[big_endian ? 63 - i : 56 + i] = (UCHAR) (bits >> (8 * i));
+  }
+  algorithm->blocks(state, state->buffer, 1);
+}
+
+
+/**************************************************************************
+  MD5 (RFC 1321)
+***************************************************************************/
+
+static const IDL_ULONG mg_md5_k[64] = {
+  0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a,
+  0xa8304613, 0xfd469501, 0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+  0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821, 0xf61e2562, 0xc040b340,
+  0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+  0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8,
+  0x676f02d9, 0x8d2a4c8a, 0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+  0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70, 0x289b7ec6, 0xeaa127fa,
+  0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+  0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92,
+  0xffeff47d, 0x85845dd1, 0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+  0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const int mg_md5_r[64] = {
+  7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+  5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+  4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+  6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+
+static void mg_md5_init(mg_hash_state *state) {
+  state->h[0] = 0x67452301;
+  state->h[1] = 0xefcdab89;
+  state->h[2] = 0x98badcfe;
+  state->h[3] = 0x10325476;
+}
+
+
+static void mg_md5_blocks(mg_hash_state *state, const UCHAR *data,
+                          size_t n_blocks) {
+  IDL_ULONG m[16], a, b, c, d, f, t;
+  int i, g;
+
+  for ( ; n_blocks > 0; n_blocks--, data += 64) {
+    for (i = 0; i < 16; i++) m[i] = mg_hash_load32le(data + 4 * i);
+
+    a = state->h[0];
+    b = state->h[1];
+    c = state->h[2];
+    d = state->h[3];
+
+    for (i = 0; i < 64; i++) {
+      if (i < 16) {
+        f = (b & c) | (~b & d);
+        g = i;
+      } else if (i < 32) {
+        f = (d & b) | (~d & c);
+        g = (5 * i + 1) & 15;
+      } else if (i < 48) {
+        f = b ^ c ^ d;
+        g = (3 * i + 5) & 15;
+      } else {
+        f = c ^ (b | ~d);
+        g = (7 * i) & 15;
+      }
+      t = d;
+      d = c;
+      c = b;
+      b = b + MG_ROTL32(a + f + mg_md5_k[i] + m[g], mg_md5_r[i]);
+      a = t;
+    }
+
+    state->h[0] += a;
+    state->h[1] += b;
+    state->h[2] += c;
+    state->h[3] += d;
+  }
+}
+
+
+static const mg_hash_algorithm mg_md5_algorithm;
+
+static void mg_md5_final(mg_hash_state *state, UCHAR *digest) {
+  int i;
+
+  mg_hash_pad(state, &mg_md5_algorithm, 0);
+  for (i = 0; i < 4; i++) mg_hash_store32le(digest + 4 * i, state->h[i]);
+}
+
+
+static const mg_hash_algorithm mg_md5_algorithm = {
+  "md5", 16, 64, mg_md5_init, mg_md5_blocks, mg_md5_final
+};
+
+
+/**************************************************************************
+  SHA-1 and SHA-256 (FIPS 180-4)
+***************************************************************************/
+
+static void mg_sha1_init(mg_hash_state *state) {
+  state->h[0] = 0x67452301;
+  state->h[1] = 0xefcdab89;
+  state->h[2] = 0x98badcfe;
+  state->h[3] = 0x10325476;
+  state->h[4] = 0xc3d2e1f0;
+}
+
+
+static void mg_sha1_blocks(mg_hash_state *state, const UCHAR *data,
+                           size_t n_blocks) {
+  IDL_ULONG w[80], a, b, c, d, e, f, k, t;
+  int i;
+
+  for ( ; n_blocks > 0; n_blocks--, data += 64) {
+    for (i = 0; i < 16; i++) w[i] = mg_hash_load32be(data + 4 * i);
+    for (i = 16; i < 80; i++) {
+      t = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+      w[i] = MG_ROTL32(t, 1);
+    }
+
+    a = state->h[0];
+    b = state->h[1];
+    c = state->h[2];
+    d = state->h[3];
+    e = state->h[4];
+
+    for (i = 0; i < 80; i++) {
+      if (i < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5a827999;
+      } else if (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ed9eba1;
+      } else if (i < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8f1bbcdc;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xca62c1d6;
+      }
+      t = MG_ROTL32(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = MG_ROTL32(b, 30);
+      b = a;
+      a = t;
+    }
+
+    state->h[0] += a;
+    state->h[1] += b;
+    state->h[2] += c;
+    state->h[3] += d;
+    state->h[4] += e;
+  }
+}
+
+
+static const mg_hash_algorithm mg_sha1_algorithm;
+
+static void mg_sha1_final(mg_hash_state *state, UCHAR *digest) {
+  int i;
+
+  mg_hash_pad(state, &mg_sha1_algorithm, 1);
+  for (i = 0; i < 5; i++) mg_hash_store32be(digest + 4 * i, state->h[i]);
+}
+
+
+static const mg_hash_algorithm mg_sha1_algorithm = {
+  "sha1", 20, 64, mg_sha1_init, mg_sha1_blocks, mg_sha1_final
+};
+
+
+static const IDL_ULONG mg_sha256_k[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+  0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+  0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+  0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+  0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+  0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+
+static void mg_sha256_init(mg_hash_state *state) {
+  state->h[0] = 0x6a09e667;
+  state->h[1] = 0xbb67ae85;
+  state->h[2] = 0x3c6ef372;
+  state->h[3] = 0xa54ff53a;
+  state->h[4] = 0x510e527f;
+  state->h[5] = 0x9b05688c;
+  state->h[6] = 0x1f83d9ab;
+  state->h[7] = 0x5be0cd19;
+}
+
+
+static void mg_sha256_blocks(mg_hash_state *state, const UCHAR *data,
+                             size_t n_blocks) {
+  IDL_ULONG w[64], s[8], s0, s1, t1, t2;
+  int i;
+
+  for ( ; n_blocks > 0; n_blocks--, data += 64) {
+    for (i = 0; i < 16; i++) w[i] = mg_hash_load32be(data + 4 * i);
+    for (i = 16; i < 64; i++) {
+      s0 = MG_ROTR32(w[i - 15], 7) ^ MG_ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      s1 = MG_ROTR32(w[i - 2], 17) ^ MG_ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    memcpy(s, state->h, sizeof(s));
+
+    for (i = 0; i < 64; i++) {
+      s1 = MG_ROTR32(s[4], 6) ^ MG_ROTR32(s[4], 11) ^ MG_ROTR32(s[4], 25);
+      t1 = s[7] + s1 + ((s[4] & s[5]) ^ (~s[4] & s[6])) + mg_sha256_k[i] + w[i];
+      s0 = MG_ROTR32(s[0], 2) ^ MG_ROTR32(s[0], 13) ^ MG_ROTR32(s[0], 22);
+      t2 = s0 + ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+      s[7] = s[6];
+      s[6] = s[5];
+      s[5] = s[4];
+      s[4] = s[3] + t1;
+      s[3] = s[2];
+      s[2] = s[1];
+      s[1] = s[0];
+      s[0] = t1 + t2;
+    }
+
+    for (i = 0; i < 8; i++) state->h[i] += s[i];
+  }
+}
+
+
+static const mg_hash_algorithm mg_sha256_algorithm;
+
+static void mg_sha256_final(mg_hash_state *state, UCHAR *digest) {
+  int i;
+
+  mg_hash_pad(state, &mg_sha256_algorithm, 1);
+  for (i = 0; i < 8; i++) mg_hash_store32be(digest + 4 * i, state->h[i]);
+}
+
+
+static const mg_hash_algorithm mg_sha256_algorithm = {
+  "sha256", 32, 64, mg_sha256_init, mg_sha256_blocks, mg_sha256_final
+};
+
+
+/**************************************************************************
+  XXH64, a fast non-cryptographic hash (https://github.com/Cyan4973/xxHash)
+***************************************************************************/
+
+#define MG_XXH_P1 11400714785074694791ULL
+#define MG_XXH_P2 14029467366897019727ULL
+#define MG_XXH_P3  1609587929392839161ULL
+#define MG_XXH_P4  9650029242287828579ULL
+#define MG_XXH_P5  2870177450012600261ULL
+
+
+static IDL_ULONG64 mg_xxh64_round(IDL_ULONG64 acc, IDL_ULONG64 input) {
+  acc += input * MG_XXH_P2;
+  acc = MG_ROTL64(acc, 31);
+  return acc * MG_XXH_P1;
+}
+
+
+static IDL_ULONG64 mg_xxh64_merge(IDL_ULONG64 acc, IDL_ULONG64 v) {
+  acc ^= mg_xxh64_round(0, v);
+  return acc * MG_XXH_P1 + MG_XXH_P4;
+}
+
+
+static void mg_xxh64_init(mg_hash_state *state) {
+  state->v[0] = state->seed + MG_XXH_P1 + MG_XXH_P2;
+  state->v[1] = state->seed + MG_XXH_P2;
+  state->v[2] = state->seed;
+  state->v[3] = state->seed - MG_XXH_P1;
+}
+
+
+// a block is a 32 byte stripe
+static void mg_xxh64_blocks(mg_hash_state *state, const UCHAR *data,
+                            size_t n_blocks) {
+  IDL_ULONG64 v0 = state->v[0], v1 = state->v[1];
+  IDL_ULONG64 v2 = state->v[2], v3 = state->v[3];
+
+  for ( ; n_blocks > 0; n_blocks--, data += 32) {
+    v0 = mg_xxh64_round(v0, mg_hash_load64le(data));
+    v1 = mg_xxh64_round(v1, mg_hash_load64le(data + 8));
+    v2 = mg_xxh64_round(v2, mg_hash_load64le(data + 16));
+    v3 = mg_xxh64_round(v3, mg_hash_load64le(data + 24));
+  }
+
+  state->v[0] = v0;
+  state->v[1] = v1;
+  state->v[2] = v2;
+  state->v[3] = v3;
+}
+
+
+// the digest is the hash in big-endian order, like XXH64's canonical form
+static void mg_xxh64_final(mg_hash_state *state, UCHAR *digest) {
+  const UCHAR *p = state->buffer, *end = state->buffer + state->n_buffer;
+  IDL_ULONG64 h;
+  int i;
+
+  if (state->length >= 32) {
+    h = MG_ROTL64(state->v[0], 1) + MG_ROTL64(state->v[1], 7)
+          + MG_ROTL64(state->v[2], 12) + MG_ROTL64(state->v[3], 18);
+    for (i = 0; i < 4; i++) h = mg_xxh64_merge(h, state->v[i]);
+  } else {
+    h = state->seed + MG_XXH_P5;
+  }
+  h += state->length;
+
+  for ( ; p + 8 <= end; p += 8) {
+    h ^= mg_xxh64_round(0, mg_hash_load64le(p));
+    h = MG_ROTL64(h, 27) * MG_XXH_P1 + MG_XXH_P4;
+  }
+  if (p + 4 <= end) {
+    h ^= (IDL_ULONG64) mg_hash_load32le(p) * MG_XXH_P1;
+    h = MG_ROTL64(h, 23) * MG_XXH_P2 + MG_XXH_P3;
+    p += 4;
+  }
+  for ( ; p < end; p++) {
+    h ^= *p * MG_XXH_P5;
+    h = MG_ROTL64(h, 11) * MG_XXH_P1;
+  }
+
+  h ^= h >> 33;
+  h *= MG_XXH_P2;
+  h ^= h >> 29;
+  h *= MG_XXH_P3;
+  h ^= h >> 32;
+
+  mg_hash_store32be(digest, (IDL_ULONG) (h >> 32));
+  mg_hash_store32be(digest + 4, (IDL_ULONG) h);
+}
+
+
+static const mg_hash_algorithm mg_xxh64_algorithm = {
+  "xxh64", 8, 32, mg_xxh64_init, mg_xxh64_blocks, mg_xxh64_final
+};
+
+
+/**************************************************************************
+  Streaming interface
+***************************************************************************/
+
+static const mg_hash_algorithm *mg_hash_algorithms[] = {
+  &mg_md5_algorithm, &mg_sha1_algorithm, &mg_sha256_algorithm,
+  &mg_xxh64_algorithm, NULL
+};
+
+
+// index of the algorithm with the given case-insensitive name, or of the NULL
+// at the end of mg_hash_algorithms if there is none
+static int mg_hash_find_algorithm(const char *name) {
+  const char *c, *n;
+  int a;
+
+  for (a = 0; mg_hash_algorithms[a]; a++) {
+    for (c = name, n = mg_hash_algorithms[a]->name;
+         *c && tolower((unsigned char) *c) == *n;
+         c++, n++);
+    if (*c == '\0' && *n == '\0') break;
+  }
+
+  return a;
+}
+
+
+static void mg_hash_init(mg_hash_state *state,
+                         const mg_hash_algorithm *algorithm,
+                         IDL_ULONG64 seed) {
+  memset(state, 0, sizeof(mg_hash_state));
+  state->seed = seed;
+  algorithm->init(state);
+}
+
+
+static void mg_hash_update(mg_hash_state *state,
+                           const mg_hash_algorithm *algorithm,
+                           const UCHAR *data, size_t n) {
+  size_t b = algorithm->block_size, m;
+
+  state->length += n;
+
+  // fill the partial block first
+  if (state->n_buffer > 0) {
+    m = b - state->n_buffer < n ? b - state->n_buffer : n;
+    memcpy(state->buffer + state->n_buffer, data, m);
+    state->n_buffer += (int) m;
+    data += m;
+    n -= m;
+    if (state->n_buffer < (int) b) return;
+    algorithm->blocks(state, state->buffer, 1);
+    state->n_buffer = 0;
+  }
+
+  algorithm->blocks(state, data, n / b);
+  memcpy(state->buffer, data + n / b * b, n % b);
+  state->n_buffer = (int) (n % b);
+}
+
+
+static void mg_hash_bytes(const mg_hash_algorithm *algorithm, IDL_ULONG64 seed,
+                          const UCHAR *data, size_t n, UCHAR *digest) {
+  mg_hash_state state;
+
+  mg_hash_init(&state, algorithm, seed);
+  mg_hash_update(&state, algorithm, data, n);
+  algorithm->final(&state, digest);
+}
+
+
+// returns 0, or 1 if the file could not be opened, 2 if it could not be read
+static int mg_hash_file(const mg_hash_algorithm *algorithm, IDL_ULONG64 seed,
+                        const char *filename, UCHAR *buffer, UCHAR *digest) {
+  mg_hash_state state;
+  size_t n;
+  FILE *fp = fopen(filename, "rb");
+
+  if (fp == NULL) return 1;
+
+  mg_hash_init(&state, algorithm, seed);
+  while ((n = fread(buffer, 1, MG_HASH_CHUNK_SIZE, fp)) > 0) {
+    mg_hash_update(&state, algorithm, buffer, n);
+  }
+  if (ferror(fp)) {
+    fclose(fp);
+    return 2;
+  }
+  fclose(fp);
+
+  algorithm->final(&state, digest);
+
+  return 0;
+}
+
+
+/**************************************************************************
+  IDL interface
+***************************************************************************/
+
+typedef struct {
+  const mg_hash_algorithm *algorithm;
+  IDL_ULONG64 seed;
+  IDL_STRING *strings;
+  int file;
+  UCHAR *digests;          // digest_size bytes per string
+  int *status;             // for files, see mg_hash_file
+} mg_hash_info;
+
+
+static void mg_hash_work(IDL_MEMINT start, IDL_MEMINT end,
+                         int thread_index, void *data) {
+  mg_hash_info *info = (mg_hash_info *) data;
+  int size = info->algorithm->digest_size;
+  UCHAR *buffer = NULL;
+  IDL_MEMINT i;
+
+  if (info->file) {
+    buffer = (UCHAR *) malloc(MG_HASH_CHUNK_SIZE);
+    if (buffer == NULL) {
+      for (i = start; i < end; i++) info->status[i] = 3;
+      return;
+    }
+  }
+
+  for (i = start; i < end; i++) {
+    if (info->file) {
+      info->status[i] = mg_hash_file(info->algorithm, info->seed,
+                                     IDL_STRING_STR(&info->strings[i]),
+                                     buffer, info->digests + i * size);
+    } else {
+      mg_hash_bytes(info->algorithm, info->seed,
+                    (UCHAR *) IDL_STRING_STR(&info->strings[i]),
+                    info->strings[i].slen, info->digests + i * size);
+    }
+  }
+
+  if (buffer) free(buffer);
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_hash(int argc, IDL_VPTR *argv, char *argk) {
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_STRING algorithm;
+    int algorithm_present;
+    IDL_LONG file;
+    IDL_LONG n_threads;
+    IDL_LONG raw;
+    IDL_ULONG64 seed;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "ALGORITHM", IDL_TYP_STRING, 1, 0,
+      IDL_KW_OFFSETOF(algorithm_present), IDL_KW_OFFSETOF(algorithm) },
+    { "FILE", IDL_TYP_LONG, 1, IDL_KW_ZERO | IDL_KW_VALUE | 1,
+      0, IDL_KW_OFFSETOF(file) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { "RAW", IDL_TYP_LONG, 1, IDL_KW_ZERO | IDL_KW_VALUE | 1,
+      0, IDL_KW_OFFSETOF(raw) },
+    { "SEED", IDL_TYP_ULONG64, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(seed) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  IDL_VPTR input = argv[0];
+  const mg_hash_algorithm *algorithm = &mg_sha256_algorithm;
+  mg_hash_info info;
+  IDL_MEMINT i, n, n_bytes, dims[IDL_MAX_ARRAY_DIM];
+  int a, d, n_dim, size, nthreads;
+  UCHAR *bytes, *digests;
+  IDL_VPTR digests_vptr, result;
+  IDL_STRING *hex;
+  char hex_digest[2 * MG_HASH_MAX_DIGEST + 1];
+  char name[MG_HASH_MAX_NAME + 1];
+  static const char *hex_digits = "0123456789abcdef";
+
+  IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+
+  IDL_ENSURE_SIMPLE(input);
+
+  if (kw.algorithm_present) {
+    a = mg_hash_find_algorithm(IDL_STRING_STR(&kw.algorithm));
+    if (mg_hash_algorithms[a] == NULL) {
+      // copy the name for the message, it is freed with the keywords
+      strncpy(name, IDL_STRING_STR(&kw.algorithm), MG_HASH_MAX_NAME);
+      name[MG_HASH_MAX_NAME] = '\0';
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "unknown algorithm: %s", name);
+    }
+    algorithm = mg_hash_algorithms[a];
+  }
+  size = algorithm->digest_size;
+
+  if (kw.file && input->type != IDL_TYP_STRING) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "filenames must be strings");
+  }
+  if (input->type == IDL_TYP_PTR || input->type == IDL_TYP_OBJREF) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unable to hash pointers or object references");
+  }
+
+  // one digest per string, or one digest of the bytes of a numeric array
+  if (input->type == IDL_TYP_STRING && (input->flags & IDL_V_ARR)) {
+    n = input->value.arr->n_elts;
+    n_dim = input->value.arr->n_dim;
+    for (d = 0; d < n_dim; d++) dims[d] = input->value.arr->dim[d];
+  } else {
+    n = 1;
+    n_dim = 0;
+  }
+
+  // the raw digests have an extra leading dimension
+  IDL_MEMINT raw_dims[IDL_MAX_ARRAY_DIM];
+  raw_dims[0] = size;
+  if (n_dim < IDL_MAX_ARRAY_DIM) {
+    for (d = 0; d < n_dim; d++) raw_dims[d + 1] = dims[d];
+  } else {
+    raw_dims[1] = n;
+    n_dim = 1;
+  }
+  digests = (UCHAR *) IDL_MakeTempArray(IDL_TYP_BYTE, n_dim + 1, raw_dims,
+                                        IDL_ARR_INI_NOP, &digests_vptr);
+
+  if (input->type == IDL_TYP_STRING) {
+    memset(&info, 0, sizeof(info));
+    info.algorithm = algorithm;
+    info.seed = kw.seed;
+    info.strings = (input->flags & IDL_V_ARR)
+                     ? (IDL_STRING *) input->value.arr->data
+                     : &input->value.str;
+    info.file = kw.file;
+    info.digests = digests;
+
+    if (kw.file) {
+      info.status = (int *) calloc(n, sizeof(int));
+      if (info.status == NULL) {
+        IDL_Deltmp(digests_vptr);
+        IDL_KW_FREE;
+        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                    "unable to allocate memory");
+      }
+    }
+
+    nthreads = mg_thread_count(n, kw.file ? 1 : MG_HASH_MIN_ELTS, kw.n_threads);
+    mg_thread_run(nthreads, n, mg_hash_work, &info);
+
+    if (kw.file) {
+      for (i = 0; i < n && info.status[i] == 0; i++);
+      if (i < n) {
+        int status = info.status[i];
+        char filename[1024];
+        strncpy(filename, IDL_STRING_STR(&info.strings[i]), sizeof(filename) - 1);
+        filename[sizeof(filename) - 1] = '\0';
+        free(info.status);
+        IDL_Deltmp(digests_vptr);
+        IDL_KW_FREE;
+        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "%s: %s",
+                    status == 1 ? "unable to open file"
+                      : (status == 2 ? "unable to read file" : "unable to allocate memory"),
+                    filename);
+      }
+      free(info.status);
+    }
+  } else {
+    IDL_VarGetData(input, &n_bytes, (char **) &bytes, FALSE);
+    n_bytes *= IDL_TypeSizeGet(input->type);
+    mg_hash_bytes(algorithm, kw.seed, bytes, n_bytes, digests);
+  }
+
+  int raw = kw.raw;
+  IDL_KW_FREE;
+
+  if (raw) return digests_vptr;
+
+  // hexadecimal digests
+  if (input->type != IDL_TYP_STRING || !(input->flags & IDL_V_ARR)) {
+    for (d = 0; d < size; d++) {
+      hex_digest[2 * d] = hex_digits[digests[d] >> 4];
+      hex_digest[2 * d + 1] = hex_digits[digests[d] & 15];
+    }
+    hex_digest[2 * size] = '\0';
+    result = IDL_StrToSTRING(hex_digest);
+  } else {
+    hex = (IDL_STRING *) IDL_MakeTempArray(IDL_TYP_STRING,
+                                           input->value.arr->n_dim,
+                                           input->value.arr->dim,
+                                           IDL_ARR_INI_ZERO, &result);
+    for (i = 0; i < n; i++) {
+      for (d = 0; d < size; d++) {
+        hex_digest[2 * d] = hex_digits[digests[i * size + d] >> 4];
+        hex_digest[2 * d + 1] = hex_digits[digests[i * size + d] & 15];
+      }
+      hex_digest[2 * size] = '\0';
+      IDL_StrStore(&hex[i], hex_digest);
+    }
+  }
+  IDL_Deltmp(digests_vptr);
+
+  return result;
+}
+
+
+/*
+  Register the routines available for IDL; they must be specified exactly as
+  in mg_hash.dlm.
+*/
+
+// functions to register
+static IDL_SYSFUN_DEF2 function_addr[] = {
+  { IDL_mg_hash,    "MG_HASH",    1, 1, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+};
+
+int IDL_Load(void) {
+  return IDL_SysRtnAdd(function_addr, TRUE, IDL_CARRAY_ELTS(function_addr));
+}
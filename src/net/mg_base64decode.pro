@@ -2,7 +2,8 @@
 
 ;+
 ; Decode a string in Base64, performs the inverse operation as
-; `MG_BASE64ENCODE`.
+; `MG_BASE64ENCODE`. Uses the `MG_BASE64_DECODE` DLM routine when available,
+; which also accepts the URL-safe alphabet, whitespace, and missing padding.
 ;
 ; :Examples:
 ;    Try::
@@ -23,10 +24,18 @@
 ; :Params:
 ;    s : in, required, type=string
 ;       string to decode
+;
+; :Keywords:
+;    bytes : in, optional, type=boolean
+;       set to return the decoded bytes instead of a string
 ;-
-function mg_base64decode, s
+function mg_base64decode, s, bytes=bytes
   compile_opt strictarr
 
+  if (mg_hasroutine('mg_base64_decode')) then begin
+    return, mg_base64_decode(s, string=~keyword_set(bytes))
+  endif
+
   _translate = bytarr(123)
   _translate[bindgen(26) + 65B] = bindgen(26)       ; A-Z
   _translate[bindgen(26) + 97B] = bindgen(26) + 26  ; a-z
@@ -42,7 +51,7 @@ function mg_base64decode, s
   reads, string(ind, format='(' + strtrim(n_elements(ind), 2) + 'B06)'), b, $
          format='(' + strtrim(3 * (ns - npadding) / 4, 2) + 'B8)'
 
-  return, string(b)
+  return, keyword_set(bytes) ? b : string(b)
 end
 
 
@@ -2,7 +2,7 @@
 
 ;+
 ; Encode a string using Base64, performs the inverse operation as
-; `MG_BASE64DECODE`.
+; `MG_BASE64DECODE`. Uses the `MG_BASE64_ENCODE` DLM routine when available.
 ;
 ; :Examples:
 ;    Try::
@@ -21,17 +21,29 @@
 ;    string
 ;
 ; :Params:
-;    s : in, required, type=string
-;       string to encode
+;    s : in, required, type=string/bytarr
+;       string to encode, or bytes if the `MG_BASE64_ENCODE` DLM routine is
+;       available
+;
+; :Keywords:
+;    no_padding : in, optional, type=boolean
+;       set to not pad the result with "=" to a multiple of 4 characters
+;    url : in, optional, type=boolean
+;       set to use the URL and filename safe alphabet, with "-" and "_"
+;       instead of "+" and "/"
 ;-
-function mg_base64encode, s
+function mg_base64encode, s, no_padding=no_padding, url=url
   compile_opt strictarr
 
+  if (mg_hasroutine('mg_base64_encode')) then begin
+    return, mg_base64_encode(s, no_padding=no_padding, url=url)
+  endif
+
   _translate = [bindgen(26) + (byte('A'))[0], $   ; A-Z
                 bindgen(26) + (byte('a'))[0], $   ; a-z
                 bindgen(10) + (byte('0'))[0], $   ; 0-9
-                (byte('+'))[0], $                 ; +
-                (byte('/'))[0]]                   ; /
+                (byte(keyword_set(url) ? '-' : '+'))[0], $   ; + or -
+                (byte(keyword_set(url) ? '_' : '/'))[0]]     ; / or _
 
   npadding = 3 - strlen(s) mod 3
   npadding = npadding eq 3L ? 0L : npadding
@@ -45,7 +57,9 @@ function mg_base64encode, s
          format='(' + strtrim(4 * n / 3, 2) + 'B6)'
 
   return, string(_translate[ind[0:n_elements(ind) - npadding - 1L]]) $
-            + (npadding gt 0L ? strjoin(strarr(npadding) + '=') : '')
+            + (npadding gt 0L && ~keyword_set(no_padding) $
+                 ? strjoin(strarr(npadding) + '=') $
+                 : '')
 end
 
 
@@ -3,6 +3,8 @@
 ;+
 ; Hash the input string using MD5.
 ;
+; Requires the `MG_HASH` DLM.
+;
 ; :Examples:
 ;    For example, try::
 ;
@@ -10,47 +12,26 @@
 ;       d17d014489c31038dee48b6d5132297f
 ;
 ; :Returns:
-;    string
+;    string, or `strarr` for a string array
 ;
 ; :Params:
-;    s : in, required, type=string
-;       string to hash
+;    s : in, required, type=string/strarr
+;       string to hash, or filename if `FILE` is set
 ;
 ; :Keywords:
+;    file : in, optional, type=boolean
+;       set to hash the contents of the file `s`
 ;    hexidecimal : in, optional, type=boolean
-;       return result hash in hexadecimal string
+;       return result hash in hexadecimal string; the result is always
+;       hexadecimal, this keyword is kept for compatibility
 ;-
-function mg_md5, s, hexidecimal=hexidecimal
+function mg_md5, s, file=file, hexidecimal=hexidecimal
   compile_opt strictarr
+  on_error, 2
 
-  ; convert string to ASCII representation
-  _s = byte(s)
-  ns = strlen(_s)
-
-  ; append padding bytes
-  npad = (56L - ns) mod 64L
-  npad = npad lt 0 ? (64L + npad) : npad
-  npad = npad eq 0 ? 64L : npad
-
-  pad = bytarr(npad)
-  pad[0] = '10000000'b
-
-  _s = ns eq 0L ? pad : [_s, pad]
-  _s = ulong(_s, 0, n_elements(_s) / 4)
-
-  ; appending long of original string
-  _s = [_s, long(ulong64(ns), 0, 2)]
-
-  ; initialize MD buffer
-  a = '67452301'xu
-  b = 'efcdab89'xu
-  c = '98badcfe'xu
-  d = '10325476'xu
-
-  ; process message
-  ; TODO: implement this processing (http://www.freesoft.org/CIE/RFC/1321/7.htm)
+  if (~mg_hasroutine('mg_hash')) then message, 'MG_HASH DLM not found'
 
-  return, string([a, b, c, d], format='(4Z0)')
+  return, mg_hash(s, algorithm='md5', file=keyword_set(file))
 end
 
 
@@ -93,6 +93,11 @@ function mg_sha1, input, string=string, file=file
 
   is_file = (file_test(input) || keyword_set(file)) && ~keyword_set(string)
 
+  if (mg_hasroutine('mg_hash')) then begin
+    if (is_file && ~file_test(input, /read)) then message, 'file unreadable'
+    return, mg_hash(input, algorithm='sha1', file=is_file)
+  endif
+
   if (is_file) then begin
     is_empty = file_test(input, /zero_length)
     is_readable = file_test(input, /read)
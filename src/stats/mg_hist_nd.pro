@@ -47,7 +47,9 @@
 ;       IDL> .run mg_hist_nd
 ;
 ; :Returns:
-;    histogram of size `n_1` by `n_2` by .... by `n_n`
+;    histogram of size `n_1` by `n_2` by .... by `n_n`; with the `mg_stats`
+;    DLM, more than 8 dimensions are allowed and then the histogram is
+;    returned as a vector of `n_1 * n_2 * ... * n_n` bins in the same order
 ;
 ; :Params:
 ;    array : in, required, type=numeric array
@@ -92,6 +94,14 @@
 ;       set to a named variable to get the unweighted histogram
 ;    l64 : in, optional, type=boolean
 ;       set to return long64 results
+;    edges : in, optional, type=fltarr or list
+;       non-uniform bin edges, used instead of `BIN_SIZE`, `NBINS`, `MINIMUM`,
+;       and `MAXIMUM`; either a list of increasing edges for each dimension,
+;       or an array of edges to use for every dimension; the last bin of a
+;       dimension includes its upper edge; requires the `mg_stats` DLM
+;    n_threads : in, optional, type=long
+;       number of threads to use with the `mg_stats` DLM, default is the
+;       number of processors
 ;-
 function mg_hist_nd, array, $
                      bin_size=binsize, nbins=nbins, $
@@ -99,8 +109,45 @@ function mg_hist_nd, array, $
                      omin=_minimum, omax=_maximum, $
                      reverse_indices=ri, $
                      weights=weights, unweighted=unweighted, $
-                     l64=l64
+                     l64=l64, edges=edges, n_threads=n_threads
   compile_opt strictarr
+  on_error, 2
+
+  ; bins are computed and counted in one threaded pass by the DLM
+  if (mg_hasroutine('mg_histogram_nd')) then begin
+    n_dims = size(array, /n_dimensions) eq 2L ? (size(array, /dimensions))[0] : 1L
+    if (isa(edges, 'list')) then begin
+      _nbins = lonarr(n_elements(edges))
+      _edges = !null
+      foreach e, edges, d do begin
+        _nbins[d] = n_elements(e) - 1L
+        _edges = [_edges, double(e)]
+      endforeach
+    endif else if (n_elements(edges) gt 0L) then begin
+      _nbins = replicate(n_elements(edges) - 1L, n_dims)
+      _edges = rebin(reform(double(edges), n_elements(edges)), $
+                     n_elements(edges), n_dims)
+    endif else _nbins = nbins
+
+    if (arg_present(ri)) then begin
+      h = mg_histogram_nd(array, bin_size=binsize, nbins=_nbins, $
+                          min=minimum, max=maximum, edges=_edges, $
+                          omin=_minimum, omax=_maximum, $
+                          weights=weights, unweighted=unweighted, $
+                          l64=l64, n_threads=n_threads, $
+                          reverse_indices=ri)
+    endif else begin
+      h = mg_histogram_nd(array, bin_size=binsize, nbins=_nbins, $
+                          min=minimum, max=maximum, edges=_edges, $
+                          omin=_minimum, omax=_maximum, $
+                          weights=weights, unweighted=unweighted, $
+                          l64=l64, n_threads=n_threads)
+    endelse
+
+    return, h
+  endif
+
+  if (n_elements(edges) gt 0L) then message, 'EDGES requires the mg_stats DLM'
 
   dims = size(array, /dimensions)
   n = dims[0]
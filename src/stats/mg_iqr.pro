@@ -10,10 +10,40 @@
 ; :Params:
 ;   x : in, required, type=fltarr
 ;     data to calculate IQR of
+;
+; :Keywords:
+;   dimension : in, optional, type=long
+;     dimension to compute the IQR along, 1-based
+;   interpolation : in, optional, type=string, default=rank
+;     interpolation mode, see `MG_PERCENTILES`
+;   nan : in, optional, type=boolean
+;     set to ignore NaNs
+;   n_threads : in, optional, type=long
+;     number of threads to use
 ;-
-function mg_iqr, x
+function mg_iqr, x, dimension=dimension, interpolation=interpolation, $
+                 nan=nan, n_threads=n_threads
   compile_opt strictarr
 
-  percentiles = mg_percentiles(x, percentiles=[0.25, 0.75])
-  return, percentiles[1] - percentiles[0]
+  percentiles = mg_percentiles(x, percentiles=[0.25, 0.75], $
+                               dimension=dimension, $
+                               interpolation=interpolation, $
+                               nan=nan, $
+                               n_threads=n_threads)
+
+  if (n_elements(dimension) eq 0L || dimension eq 0L) then begin
+    return, percentiles[1] - percentiles[0]
+  endif
+
+  ; percentiles has the quantiles in place of the given dimension
+  dims = size(x, /dimensions)
+  inner = dimension eq 1L ? 1L : product(dims[0:dimension - 2L], /integer)
+  outer = n_elements(x) / inner / dims[dimension - 1L]
+  percentiles = reform(percentiles, inner, 2, outer)
+  iqr = percentiles[*, 1, *] - percentiles[*, 0, *]
+
+  result_dims = n_elements(dims) eq 1L $
+                  ? 1L $
+                  : dims[where(lindgen(n_elements(dims)) ne dimension - 1L)]
+  return, reform(iqr, result_dims)
 end
@@ -0,0 +1,182 @@
+; docformat = 'rst'
+
+;+
+; Spatial index for nearest neighbor searches, built once from a set of
+; samples and queried any number of times. Requires the `mg_stats` DLM.
+;
+; :Examples:
+;   Find the 3 nearest samples to some query points::
+;
+;     IDL> x = randomu(seed, 2, 1000)
+;     IDL> tree = mg_kdtree(x)
+;     IDL> ind = tree->query(randomu(seed, 2, 5), 3, distances=d)
+;
+;   The `tree` property is a byte array which can be saved and passed to
+;   `init` later to recreate the index without rebuilding it.
+;
+; :Properties:
+;   tree : type=bytarr
+;     serialized tree, as returned by `MG_KDTREE_BUILD`
+;   n_features : type=long
+;     number of features of each sample
+;   n_samples : type=long
+;     number of samples in the tree
+;-
+
+
+;= API
+
+;+
+; Find the `k` nearest samples to each query point.
+;
+; :Returns:
+;   `lonarr(k, n_queries)` of indices into the samples
+;
+; :Params:
+;   xi : in, required, type="fltarr(n_features, n_queries)"
+;     query points
+;   k : in, optional, type=integer, default=1
+;     number of neighbors to find
+;
+; :Keywords:
+;   _extra : in, optional, type=keywords
+;     keywords to `MG_KDTREE_QUERY`, i.e., `DISTANCES`, `METRIC`, and
+;     `N_THREADS`
+;-
+function mg_kdtree::query, xi, k, _ref_extra=e
+  compile_opt strictarr
+  on_error, 2
+
+  return, mg_kdtree_query(*self._tree, xi, mg_default(k, 1L), _extra=e)
+end
+
+
+;+
+; Find the samples within a given distance of each query point.
+;
+; :Returns:
+;   `lonarr` of indices into the samples for all queries, `-1L` if none
+;
+; :Params:
+;   xi : in, required, type="fltarr(n_features, n_queries)"
+;     query points
+;   radius : in, required, type=float
+;     maximum distance of a neighbor
+;
+; :Keywords:
+;   _extra : in, optional, type=keywords
+;     keywords to `MG_KDTREE_QUERY_RADIUS`, i.e., `COUNT`, `DISTANCES`,
+;     `METRIC`, `N_THREADS`, and `OFFSETS`
+;-
+function mg_kdtree::query_radius, xi, radius, _ref_extra=e
+  compile_opt strictarr
+  on_error, 2
+
+  return, mg_kdtree_query_radius(*self._tree, xi, radius, _extra=e)
+end
+
+
+;= overload methods
+
+function mg_kdtree::_overloadHelp, varname
+  compile_opt strictarr
+
+  self->getProperty, n_features=n_features, n_samples=n_samples
+  _type = 'KDTREE'
+  _specs = string(n_samples, n_features, $
+                  format='(%"<%d samples of %d features>")')
+  return, string(varname, _type, _specs, format='(%"%-15s %-9s = %s")')
+end
+
+
+;= property access
+
+pro mg_kdtree::getProperty, tree=tree, n_features=n_features, $
+                            n_samples=n_samples
+  compile_opt strictarr
+
+  if (arg_present(tree)) then tree = *self._tree
+
+  ; the header of the tree is LONG64 values: magic number, version, number of
+  ; features, and number of samples
+  header = long64(*self._tree, 0, 4)
+  if (arg_present(n_features)) then n_features = long(header[2])
+  if (arg_present(n_samples)) then n_samples = header[3]
+end
+
+
+;= lifecycle methods
+
+pro mg_kdtree::cleanup
+  compile_opt strictarr
+
+  ptr_free, self._tree
+end
+
+
+;+
+; Create a tree.
+;
+; :Returns:
+;   1 for success, 0 for failure
+;
+; :Params:
+;   x : in, optional, type="fltarr(n_features, n_samples)"
+;     samples to index; either `x` or `TREE` is required
+;
+; :Keywords:
+;   tree : in, optional, type=bytarr
+;     tree from the `tree` property of another `mg_kdtree` or from
+;     `MG_KDTREE_BUILD`
+;   leaf_size : in, optional, type=long, default=16
+;     maximum number of samples in a leaf
+;   n_threads : in, optional, type=long
+;     number of threads to use to build the tree
+;-
+function mg_kdtree::init, x, tree=tree, leaf_size=leaf_size, n_threads=n_threads
+  compile_opt strictarr
+  on_error, 2
+
+  if (~mg_hasroutine('mg_kdtree_build')) then message, 'mg_stats DLM required'
+
+  case 1 of
+    n_elements(tree) gt 0L: self._tree = ptr_new(tree)
+    n_elements(x) gt 0L: begin
+        self._tree = ptr_new(mg_kdtree_build(x, $
+                                             leaf_size=leaf_size, $
+                                             n_threads=n_threads))
+      end
+    else: message, 'samples or tree required'
+  endcase
+
+  return, 1
+end
+
+
+pro mg_kdtree__define
+  compile_opt strictarr
+
+  !null = {mg_kdtree, inherits IDL_Object, $
+           _tree: ptr_new() $
+          }
+end
+
+
+; main-level example program
+
+x = randomu(seed, 2, 100000)
+xi = randomu(seed, 2, 10)
+
+tree = mg_kdtree(x)
+help, tree
+
+ind = tree->query(xi, 3, distances=distances)
+print, distances
+
+ind = tree->query_radius(xi, 0.01, offsets=offsets)
+print, 'Number of neighbors within 0.01:'
+print, offsets[1:*] - offsets[0:-2]
+
+obj_destroy, tree
+
+end
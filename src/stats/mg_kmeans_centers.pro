@@ -3,8 +3,9 @@
 ;+
 ; K-Means clustering centers.
 ;
-; This uses the algorithm from `CLUST_WTS`, but I would like to change this to a
-; more robust implementation.
+; Uses `MG_KMEANS_FIT` of the `mg_stats` DLM when it is available and
+; `feature_weights` is not given, i.e., Lloyd's algorithm with k-means++
+; initialization. Otherwise, this uses the algorithm from `CLUST_WTS`.
 ;
 ; :Returns:
 ;   fltarr/dblarr(n_features, n_clusters)
@@ -52,6 +53,15 @@ function mg_kmeans_centers, x, $
   _n_clusters = mg_default(n_clusters, n_samples)
   _n_iterations = mg_default(n_iterations, 20)
   _n_initializations = mg_default(n_initializations, 10)
+
+  if (n_elements(feature_weights) eq 0L && mg_hasroutine('mg_kmeans_fit')) then begin
+    return, mg_kmeans_fit(x, _n_clusters, $
+                          double=_double, $
+                          max_iterations=_n_iterations, $
+                          n_init=_n_initializations, $
+                          seed=seed)
+  endif
+
   _feature_weights = mg_default(feature_weights, fltarr(n_features) + 1.0 + zero)
 
   learning = [0.5, 0.1] + zero
@@ -1,7 +1,9 @@
 ; docformat = 'rst'
 
 ;+
-; Naive nearest neighbor implementation. This should work reasonably for 
+; Nearest neighbor search. Uses a k-d tree from the `mg_stats` DLM, see
+; `mg_kdtree`, when it is available; otherwise, a naive implementation
+; computing the distance from each query point to every sample is used.
 ;
 ; :Returns:
 ;   `lonarr(k, predict)` where values are indices into the rows of `x`
@@ -16,15 +18,30 @@
 ;
 ; :Keywords:
 ;   metric : in, optional, type=string, default='euclidean'
-;     metric to use: euclidean or manhattan
+;     metric to use: euclidean, manhattan, or chebyshev
+;   distances : out, optional, type="dblarr(k, n_predict)"
+;     set to a named variable to retrieve the distances to the neighbors;
+;     requires the `mg_stats` DLM
+;   n_threads : in, optional, type=long
+;     number of threads to use with the `mg_stats` DLM, default is the
+;     number of processors
 ;-
-function mg_kneighbors, x, xi, k, metric=metric
+function mg_kneighbors, x, xi, k, metric=metric, distances=distances, $
+                        n_threads=n_threads
   compile_opt strictarr
   on_error, 2
 
   _k = mg_default(k, 1L)
   _metric = strlowcase(mg_default(metric, 'euclidean'))
 
+  if (mg_hasroutine('mg_kdtree_build')) then begin
+    tree = mg_kdtree_build(x, n_threads=n_threads)
+    return, mg_kdtree_query(tree, xi, _k, metric=_metric, $
+                            distances=distances, n_threads=n_threads)
+  endif
+
+  if (arg_present(distances)) then message, 'DISTANCES requires the mg_stats DLM'
+
   x_dims = size(x, /dimensions)
   xi_dims = size(xi, /dimensions)
 
@@ -34,6 +51,7 @@ function mg_kneighbors, x, xi, k, metric=metric
     case _metric of
       'euclidean': d = total((x - rebin(xi[*, i], xi_dims[0], x_dims[1]))^2, 1)
       'manhattan': d = total(abs(x - rebin(xi[*, i], xi_dims[0], x_dims[1])), 1)
+      'chebyshev': d = max(abs(x - rebin(xi[*, i], xi_dims[0], x_dims[1])), dimension=1)
       else: message, 'unknown metric ' + _metric
     endcase
     ind[*, i] = mg_n_smallest(d, k)
@@ -3,6 +3,11 @@
 ;+
 ; Computes the local moments for an array with a given window size.
 ;
+; Uses `MG_WINDOW_MOMENTS` of the `mg_stats` DLM when it is available, which
+; computes all the moments in a few passes whose cost does not depend on the
+; window size. Then windows containing NaN or infinite values are NaN unless
+; `NAN` is set, in which case the moments are of the remaining values.
+;
 ; :Examples:
 ;    Try the main-level example program at the end of this file::
 ;
@@ -35,11 +40,14 @@
 ;    edge_truncate : in, optional, type=boolean
 ;       set to compute edge values by repeating
 ;    edge_wrap : in, optional, type=boolean
-;       set to compute edge values by padding array with zeros
-;    edge_zero : in, optional, type=boolean
 ;       set to compute edge values by wrapping
+;    edge_zero : in, optional, type=boolean
+;       set to compute edge values by padding array with zeros
 ;    nan : in, optional, type=boolean
 ;       set to treat NaN as missing data
+;    n_threads : in, optional, type=long
+;       number of threads to use with the `mg_stats` DLM, default is the
+;       number of processors
 ;
 ; :Requires:
 ;    IDL 8.1
@@ -51,13 +59,48 @@ function mg_local_moment, image, width, double=double, $
                           edge_truncate=edge_truncate, $
                           edge_wrap=edge_wrap, $
                           edge_zero=edge_zero, $
-                          nan=nan
+                          nan=nan, n_threads=n_threads
   compile_opt strictarr
   on_error, 2
 
   ; sanity checking on arguments
   if (n_params() ne 2) then message, 'incorrect number of arguments'
 
+  if (mg_hasroutine('mg_window_moments')) then begin
+    ; only ask for the moments needed, higher moments require more sums
+    if (arg_present(kurtosis)) then begin
+      return, mg_window_moments(image, width, double=double, $
+                                sdev=sdev, variance=variance, $
+                                skewness=skewness, kurtosis=kurtosis, $
+                                edge_mirror=edge_mirror, $
+                                edge_truncate=edge_truncate, $
+                                edge_wrap=edge_wrap, edge_zero=edge_zero, $
+                                nan=nan, n_threads=n_threads)
+    endif
+    if (arg_present(skewness)) then begin
+      return, mg_window_moments(image, width, double=double, $
+                                sdev=sdev, variance=variance, $
+                                skewness=skewness, $
+                                edge_mirror=edge_mirror, $
+                                edge_truncate=edge_truncate, $
+                                edge_wrap=edge_wrap, edge_zero=edge_zero, $
+                                nan=nan, n_threads=n_threads)
+    endif
+    if (arg_present(sdev) || arg_present(variance)) then begin
+      return, mg_window_moments(image, width, double=double, $
+                                sdev=sdev, variance=variance, $
+                                edge_mirror=edge_mirror, $
+                                edge_truncate=edge_truncate, $
+                                edge_wrap=edge_wrap, edge_zero=edge_zero, $
+                                nan=nan, n_threads=n_threads)
+    endif
+    return, mg_window_moments(image, width, double=double, $
+                              edge_mirror=edge_mirror, $
+                              edge_truncate=edge_truncate, $
+                              edge_wrap=edge_wrap, edge_zero=edge_zero, $
+                              nan=nan, n_threads=n_threads)
+  endif
+
   ; convert to double precision if DOUBLE keyword is set
   _image = keyword_set(double) ? double(image) : image
 
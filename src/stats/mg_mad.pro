@@ -8,12 +8,34 @@
 ; :Returns:
 ;   float
 ;
+; Uses the `MG_MEDIAN_DEVIATION` routine from the `mg_stats` DLM if it is
+; available, which is required for the `DIMENSION` and `N_THREADS` keywords.
+;
 ; :Params:
 ;   x : in, required, type=fltarr
 ;     array to calculate MAD of
+;
+; :Keywords:
+;   dimension : in, optional, type=long
+;     dimension to compute the MAD along, 1-based
+;   even : in, optional, type=boolean
+;     set to average the middle values for an even number of elements, as
+;     with `MEDIAN`
+;   n_threads : in, optional, type=long
+;     number of threads to use
 ;-
-function mg_mad, x
+function mg_mad, x, dimension=dimension, even=even, n_threads=n_threads
   compile_opt strictarr
+  on_error, 2
+
+  if (mg_hasroutine('mg_median_deviation')) then begin
+    return, mg_median_deviation(x, dimension=dimension, even=even, $
+                                n_threads=n_threads)
+  endif
+
+  if (n_elements(dimension) gt 0L) then begin
+    message, 'DIMENSION requires the mg_stats DLM'
+  endif
 
-  return, median(abs(median(x) - x))
+  return, median(abs(median(x, even=even) - x), even=even)
 end
@@ -1,7 +1,9 @@
 ; docformat = 'rst'
 
 ;+
-; Finds the `n` smallest elements of a data array. This algorithm works
+; Finds the `n` smallest elements of a data array. If the `mg_stats` DLM is
+; available, `MG_SMALLEST` is used to find them by selection in linear time.
+; Otherwise, a histogram is used to find candidates. This algorithm works
 ; fastest on uniformly distributed data. The worst case for it is a single
 ; smallest data element and all other elements with another value. This will
 ; be nearly equivalent to just sorting all the elements and choosing the first
@@ -31,14 +33,23 @@
 ; :Keywords:
 ;    largest : in, optional, type=boolean
 ;       set to find `n` largest elements
+;    nan : in, optional, type=boolean
+;       set to skip NaNs; requires the `mg_stats` DLM
 ;-
-function mg_n_smallest, data, n, largest=largest
+function mg_n_smallest, data, n, largest=largest, nan=nan
   compile_opt strictarr
   on_error, 2
 
   ; both parameters are required
   if (n_params() ne 2) then message, 'required parameters are missing'
 
+  ; use selection in the mg_stats DLM if available
+  if (mg_hasroutine('mg_smallest')) then begin
+    return, mg_smallest(data, n, largest=largest, nan=nan)
+  endif
+
+  if (keyword_set(nan)) then message, 'NAN requires the mg_stats DLM'
+
   ; use histogram to find a set with more elements than n of smallest elements
   nData = n_elements(data)
   nBins = nData / n
@@ -3,6 +3,11 @@
 ;+
 ; Calculates given percentiles of a data set.
 ;
+; If the `MG_QUANTILES` routine from the `mg_stats` DLM is available, the
+; percentiles are found by selection instead of sorting the entire array, and
+; the `DIMENSION`, `INTERPOLATION`, `NAN`, and `N_THREADS` keywords may be
+; used.
+;
 ; :Returns:
 ;   the return value is either a scalar or vector of data values corresponding to
 ;    the number of percentiles asked for with the `Percentiles` keyword, or a -1 if
@@ -15,8 +20,23 @@
 ; :Keywords:
 ;    percentiles : in, optional, type=fltarr, default="[0.25, 0.50, 0.75]"
 ;      set to a scalar or vector of values between 0.0 and 1.0
+;    dimension : in, optional, type=long
+;      dimension to compute percentiles along, 1-based; requires the
+;      `mg_stats` DLM
+;    interpolation : in, optional, type=string, default=rank
+;      "rank" for the element at rank `floor(p * n)`, or one of the NumPy
+;      modes "linear", "lower", "higher", "nearest", or "midpoint"; requires
+;      the `mg_stats` DLM
+;    nan : in, optional, type=boolean
+;      set to ignore NaNs; requires the `mg_stats` DLM
+;    n_threads : in, optional, type=long
+;      number of threads to use; requires the `mg_stats` DLM
 ;-
-function mg_percentiles, data, percentiles=percentiles
+function mg_percentiles, data, percentiles=percentiles, $
+                         dimension=dimension, $
+                         interpolation=interpolation, $
+                         nan=nan, $
+                         n_threads=n_threads
   compile_opt strictarr
   on_error, 2
 
@@ -28,6 +48,19 @@ function mg_percentiles, data, percentiles=percentiles
   index = where((_percentiles lt 0.0) or (_percentiles gt 1.0), count)
   if (count gt 0L) then message, 'percentiles must be between 0.0 and 1.0.'
 
+  if (mg_hasroutine('mg_quantiles')) then begin
+    return, mg_quantiles(data, _percentiles, $
+                         dimension=dimension, $
+                         interpolation=interpolation, $
+                         nan=nan, $
+                         n_threads=n_threads)
+  endif
+
+  if (n_elements(dimension) gt 0L || n_elements(interpolation) gt 0L $
+        || keyword_set(nan)) then begin
+    message, 'DIMENSION, INTERPOLATION, and NAN require the mg_stats DLM'
+  endif
+
   n = n_elements(data)
 
   ; sort the data and find percentiles
@@ -0,0 +1,155 @@
+; docformat = 'rst'
+
+;+
+; Random number generator keeping the state of a Philox sequence between
+; calls. Requires the `mg_stats` DLM.
+;
+; :Examples:
+;   Draw from a few distributions::
+;
+;     IDL> rng = mg_rng(seed=42)
+;     IDL> u = rng->random(1000)
+;     IDL> x = rng->random(1000, distribution='gamma', parameters=[2.0, 1.5])
+;
+;   Two generators with the same seed and position return the same values,
+;   so a part of a sequence can be reproduced by setting `position`::
+;
+;     IDL> rng->setProperty, position=1000
+;     IDL> x2 = rng->random(1000, distribution='gamma', parameters=[2.0, 1.5])
+;
+; :Properties:
+;   seed : type=ulong64
+;     key of the sequence
+;   position : type=ulong64
+;     index of the next value of the sequence
+;   state : type=ulon64arr(2)
+;     state of the sequence, `[seed, position]`, as used by `MG_RANDOM`
+;-
+
+
+;= API
+
+;+
+; Generate random values, continuing the sequence.
+;
+; :Returns:
+;   array of the given dimensions, or scalar if no dimensions are given
+;
+; :Params:
+;   d1, d2, d3, d4, d5, d6, d7, d8 : in, optional, type=long
+;     dimensions of the result; `d1` may also be an array of dimensions
+;
+; :Keywords:
+;   _extra : in, optional, type=keywords
+;     keywords to `MG_RANDOM`, i.e., `DISTRIBUTION`, `PARAMETERS`, `DOUBLE`,
+;     `LONG`, `ULONG`, `L64`, `UL64`, and `N_THREADS`
+;-
+function mg_rng::random, d1, d2, d3, d4, d5, d6, d7, d8, _extra=e
+  compile_opt strictarr
+  on_error, 2
+
+  state = self.state
+  case n_params() of
+    0: result = mg_random(state, _extra=e)
+    1: result = mg_random(state, d1, _extra=e)
+    2: result = mg_random(state, d1, d2, _extra=e)
+    3: result = mg_random(state, d1, d2, d3, _extra=e)
+    4: result = mg_random(state, d1, d2, d3, d4, _extra=e)
+    5: result = mg_random(state, d1, d2, d3, d4, d5, _extra=e)
+    6: result = mg_random(state, d1, d2, d3, d4, d5, d6, _extra=e)
+    7: result = mg_random(state, d1, d2, d3, d4, d5, d6, d7, _extra=e)
+    8: result = mg_random(state, d1, d2, d3, d4, d5, d6, d7, d8, _extra=e)
+  endcase
+  self.state = state
+
+  return, result
+end
+
+
+;= overload methods
+
+function mg_rng::_overloadHelp, varname
+  compile_opt strictarr
+
+  _type = 'RNG'
+  _specs = string(self.state, format='(%"<Philox seed %d at position %d>")')
+  return, string(varname, _type, _specs, format='(%"%-15s %-9s = %s")')
+end
+
+
+;= property access
+
+pro mg_rng::getProperty, seed=seed, position=position, state=state
+  compile_opt strictarr
+
+  if (arg_present(seed)) then seed = self.state[0]
+  if (arg_present(position)) then position = self.state[1]
+  if (arg_present(state)) then state = self.state
+end
+
+
+pro mg_rng::setProperty, position=position, state=state
+  compile_opt strictarr
+
+  if (n_elements(state) gt 0L) then self.state = ulong64(state)
+  if (n_elements(position) gt 0L) then self.state[1] = ulong64(position)
+end
+
+
+;= lifecycle methods
+
+;+
+; Create a generator.
+;
+; :Returns:
+;   1 for success, 0 for failure
+;
+; :Keywords:
+;   seed : in, optional, type=integer
+;     seed of the sequence; default is to seed from the time
+;   state : in, optional, type=ulon64arr(2)
+;     state of a sequence, from the `state` property of another generator or
+;     from `MG_RANDOM`
+;-
+function mg_rng::init, seed=seed, state=state
+  compile_opt strictarr
+  on_error, 2
+
+  if (~mg_hasroutine('mg_random')) then message, 'mg_stats DLM required'
+
+  case 1 of
+    n_elements(state) gt 0L: self.state = ulong64(state)
+    n_elements(seed) gt 0L: self.state = [ulong64(seed[0]), 0ULL]
+    else: begin
+        !null = mg_random(_seed)
+        self.state = [_seed[0], 0ULL]
+      end
+  endcase
+
+  return, 1
+end
+
+
+pro mg_rng__define
+  compile_opt strictarr
+
+  !null = {mg_rng, inherits IDL_Object, $
+           state: ulon64arr(2) $
+          }
+end
+
+
+; main-level example program
+
+rng = mg_rng(seed=42)
+help, rng
+
+x = rng->random(100000, distribution='normal', parameters=[10.0, 2.0])
+print, mean(x), stddev(x), format='(%"mean: %0.3f, standard deviation: %0.3f")'
+
+p = rng->random(10, distribution='poisson', parameters=4.0)
+print, p
+
+obj_destroy, rng
+
+end
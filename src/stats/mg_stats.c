@@ -0,0 +1,4539 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "mg_idl_export.h"
+#include "mg_threads.h"
+
+/**************************************************************************
+  Selection helpers
+***************************************************************************/
+
+// minimum number of elements per thread
+#define MG_STATS_MIN_ELTS   65536
+
+// ranges at most this size are insertion sorted instead of partitioned
+#define MG_SELECT_SMALL     16
+
+// result of the quantile of a stack with no valid values
+#define MG_STATS_NAN        (0.0 / 0.0)
+
+#define MG_STATS_ALIGN(x)   (((x) + 7) & ~((IDL_MEMINT) 7))
+
+#define MG_SWAP(TYPE, a, b) { TYPE _tmp = (a); (a) = (b); (b) = _tmp; }
+
+
+/*
+  Introselect: after mg_select_TYPE(v, lo, hi, k), v[k] is the value that
+  would be at k if v[lo:hi - 1] were sorted, all values in v[lo:k - 1] are
+  less than or equal to it, and all values in v[k + 1:hi - 1] are greater than
+  or equal to it. Quickselect with median-of-3 pivots falls back to heapsort
+  if the partitions are not shrinking fast enough, so the worst case is
+  O(n log n) while the expected time is O(n).
+
+  mg_multiselect_TYPE does the same for a sorted list of distinct ranks,
+  splitting the range at the median requested rank.
+
+  NaNs must be removed (see mg_compact_TYPE) before selecting.
+*/
+#define MG_SELECT(TYPE)                                                      \
+static void mg_heapsort_ ## TYPE(TYPE *v, IDL_MEMINT n) {                    \
+  IDL_MEMINT start, end, root, child;                                        \
+                                                                             \
+  for (start = n / 2 - 1, end = n - 1; end > 0; ) {                          \
+    if (start >= 0) {                                                        \
+      root = start--;                                                        \
+    } else {                                                                 \
+      MG_SWAP(TYPE, v[0], v[end]);                                           \
+      end--;                                                                 \
+      root = 0;                                                              \
+    }                                                                        \
+    while ((child = 2 * root + 1) <= end) {                                  \
+      if (child < end && v[child] < v[child + 1]) child++;                   \
+      if (!(v[root] < v[child])) break;                                      \
+      MG_SWAP(TYPE, v[root], v[child]);                                      \
+      root = child;                                                          \
+    }                                                                        \
+  }                                                                          \
+}                                                                            \
+                                                                             \
+static void mg_select_ ## TYPE(TYPE *v, IDL_MEMINT lo, IDL_MEMINT hi,        \
+                               IDL_MEMINT k) {                               \
+  IDL_MEMINT i, j, mid, size;                                                \
+  int depth = 0;                                                             \
+  TYPE pivot, x;                                                             \
+                                                                             \
+  for (size = hi - lo; size > 1; size >>= 1) depth += 2;                     \
+                                                                             \
+  while (hi - lo > MG_SELECT_SMALL) {                                        \
+    if (depth-- == 0) {                                                      \
+      mg_heapsort_ ## TYPE(v + lo, hi - lo);                                 \
+      return;                                                                \
+    }                                                                        \
+                                                                             \
+    mid = lo + (hi - lo) / 2;                                                \
+    if (v[mid] < v[lo]) MG_SWAP(TYPE, v[mid], v[lo]);                        \
+    if (v[hi - 1] < v[mid]) {                                                \
+      MG_SWAP(TYPE, v[hi - 1], v[mid]);                                      \
+      if (v[mid] < v[lo]) MG_SWAP(TYPE, v[mid], v[lo]);                      \
+    }                                                                        \
+    pivot = v[mid];                                                          \
+                                                                             \
+    i = lo;                                                                  \
+    j = hi - 1;                                                              \
+    do {                                                                     \
+      while (v[i] < pivot) i++;                                              \
+      while (pivot < v[j]) j--;                                              \
+      if (i <= j) {                                                          \
+        MG_SWAP(TYPE, v[i], v[j]);                                           \
+        i++;                                                                 \
+        j--;                                                                 \
+      }                                                                      \
+    } while (i <= j);                                                        \
+                                                                             \
+    /* v[lo:j] <= pivot, v[j + 1:i - 1] == pivot, v[i:hi - 1] >= pivot */    \
+    if (k <= j) {                                                            \
+      hi = j + 1;                                                            \
+    } else if (k >= i) {                                                     \
+      lo = i;                                                                \
+    } else {                                                                 \
+      return;                                                                \
+    }                                                                        \
+  }                                                                          \
+                                                                             \
+  for (i = lo + 1; i < hi; i++) {                                            \
+    x = v[i];                                                                \
+    for (j = i; j > lo && x < v[j - 1]; j--) v[j] = v[j - 1];                \
+    v[j] = x;                                                                \
+  }                                                                          \
+}                                                                            \
+                                                                             \
+static void mg_multiselect_ ## TYPE(TYPE *v, IDL_MEMINT lo, IDL_MEMINT hi,   \
+                                    IDL_MEMINT *ranks, int n_ranks) {        \
+  int m = n_ranks / 2;                                                       \
+                                                                             \
+  if (n_ranks == 0 || hi - lo < 2) return;                                   \
+  mg_select_ ## TYPE(v, lo, hi, ranks[m]);                                   \
+  mg_multiselect_ ## TYPE(v, lo, ranks[m], ranks, m);                        \
+  mg_multiselect_ ## TYPE(v, ranks[m] + 1, hi, ranks + m + 1, n_ranks - m - 1); \
+}                                                                            \
+                                                                             \
+/* move non-NaN values to the front, returning how many there are */         \
+static IDL_MEMINT mg_compact_ ## TYPE(TYPE *v, IDL_MEMINT n) {               \
+  IDL_MEMINT i, n_valid = 0;                                                 \
+  for (i = 0; i < n; i++) {                                                  \
+    if (v[i] == v[i]) v[n_valid++] = v[i];                                   \
+  }                                                                          \
+  return n_valid;                                                            \
+}
+
+MG_SELECT(UCHAR)
+MG_SELECT(IDL_INT)
+MG_SELECT(IDL_LONG)
+MG_SELECT(float)
+MG_SELECT(double)
+MG_SELECT(IDL_UINT)
+MG_SELECT(IDL_ULONG)
+MG_SELECT(IDL_LONG64)
+MG_SELECT(IDL_ULONG64)
+
+
+// sort a small list of ranks and remove duplicates, returning the new length
+static int mg_sort_ranks(IDL_MEMINT *ranks, int n) {
+  int i, j, n_unique = 0;
+  IDL_MEMINT r;
+
+  for (i = 1; i < n; i++) {
+    r = ranks[i];
+    for (j = i; j > 0 && r < ranks[j - 1]; j--) ranks[j] = ranks[j - 1];
+    ranks[j] = r;
+  }
+  for (i = 0; i < n; i++) {
+    if (n_unique == 0 || ranks[i] != ranks[n_unique - 1]) {
+      ranks[n_unique++] = ranks[i];
+    }
+  }
+
+  return n_unique;
+}
+
+
+// view an array as inner x len x outer when working along a dimension,
+// storing the dimensions of the result without the given dimension
+static void mg_stats_layout(IDL_ARRAY *arr, int dimension,
+                            IDL_MEMINT *inner, IDL_MEMINT *len,
+                            IDL_MEMINT *outer,
+                            IDL_MEMINT *dims, int *n_dims) {
+  int d;
+
+  *inner = 1;
+  *outer = 1;
+  *n_dims = 0;
+  if (dimension == 0) {
+    *len = arr->n_elts;
+    return;
+  }
+
+  for (d = 0; d < dimension - 1; d++) {
+    *inner *= arr->dim[d];
+    dims[(*n_dims)++] = arr->dim[d];
+  }
+  *len = arr->dim[dimension - 1];
+  for (d = dimension; d < arr->n_dim; d++) {
+    *outer *= arr->dim[d];
+    dims[(*n_dims)++] = arr->dim[d];
+  }
+}
+
+
+static int mg_stats_is_real(int type) {
+  switch (type) {
+    case IDL_TYP_BYTE:
+    case IDL_TYP_INT:
+    case IDL_TYP_LONG:
+    case IDL_TYP_FLOAT:
+    case IDL_TYP_DOUBLE:
+    case IDL_TYP_UINT:
+    case IDL_TYP_ULONG:
+    case IDL_TYP_LONG64:
+    case IDL_TYP_ULONG64:
+      return 1;
+  }
+  return 0;
+}
+
+
+/**************************************************************************
+  MG_QUANTILES
+***************************************************************************/
+
+/*
+  Interpolation modes. MG_QUANTILE_RANK is the element at rank floor(q * n),
+  as MG_PERCENTILES has always returned, while the others match the NumPy
+  modes of the same name, using h = q * (n - 1).
+*/
+#define MG_QUANTILE_RANK      0
+#define MG_QUANTILE_LINEAR    1
+#define MG_QUANTILE_LOWER     2
+#define MG_QUANTILE_HIGHER    3
+#define MG_QUANTILE_NEAREST   4
+#define MG_QUANTILE_MIDPOINT  5
+
+static char *mg_quantile_modes[] = {
+  "rank", "linear", "lower", "higher", "nearest", "midpoint", NULL
+};
+
+#define MG_QUANTILE_INTERPOLATES(mode) \
+  ((mode) == MG_QUANTILE_LINEAR || (mode) == MG_QUANTILE_MIDPOINT)
+
+typedef struct {
+  char *data;
+  char *result;
+  int result_double;   // interpolated results are double instead of float
+  IDL_MEMINT inner;
+  IDL_MEMINT len;
+  double *q;
+  int n_q;
+  int mode;
+  int nan;
+  char *scratch;       // len elements per thread
+  IDL_MEMINT *ranks;   // 2 * n_q ranks per thread
+} mg_quantiles_info;
+
+
+// ranks r0 <= r1 needed for quantile q of n sorted values, result is
+// v[r0] + frac * (v[r1] - v[r0])
+static void mg_quantile_ranks(double q, IDL_MEMINT n, int mode,
+                              IDL_MEMINT *r0, IDL_MEMINT *r1, double *frac) {
+  double h = q * (n - 1);
+  double f = floor(h);
+
+  *frac = 0.0;
+  switch (mode) {
+    case MG_QUANTILE_RANK:
+      *r0 = (IDL_MEMINT) floor(q * n);
+      if (*r0 > n - 1) *r0 = n - 1;
+      *r1 = *r0;
+      break;
+    case MG_QUANTILE_LINEAR:
+      *r0 = (IDL_MEMINT) f;
+      *r1 = *r0 + 1 < n ? *r0 + 1 : *r0;
+      *frac = h - f;
+      break;
+    case MG_QUANTILE_LOWER:
+      *r0 = *r1 = (IDL_MEMINT) f;
+      break;
+    case MG_QUANTILE_HIGHER:
+      *r0 = *r1 = (IDL_MEMINT) ceil(h);
+      break;
+    case MG_QUANTILE_NEAREST:
+      // round half to even, like NumPy
+      *r0 = *r1 = (IDL_MEMINT) rint(h);
+      break;
+    case MG_QUANTILE_MIDPOINT:
+      *r0 = (IDL_MEMINT) f;
+      *r1 = (IDL_MEMINT) ceil(h);
+      *frac = 0.5;
+      break;
+  }
+}
+
+
+#define MG_QUANTILES(TYPE)                                                   \
+static void mg_quantiles_ ## TYPE(IDL_MEMINT start, IDL_MEMINT end,          \
+                                  int thread_index, void *data) {            \
+  mg_quantiles_info *info = (mg_quantiles_info *) data;                      \
+  TYPE *v = (TYPE *) info->scratch + thread_index * info->len;               \
+  IDL_MEMINT *ranks = info->ranks + thread_index * 2 * info->n_q;            \
+  IDL_MEMINT s, i, o, c, n, n_valid, r0, r1, out;                            \
+  TYPE *src;                                                                 \
+  double frac, value;                                                        \
+  int qi, n_ranks;                                                           \
+                                                                             \
+  for (s = start; s < end; s++) {                                            \
+    o = s / info->inner;                                                     \
+    c = s % info->inner;                                                     \
+    src = (TYPE *) info->data + o * info->len * info->inner + c;             \
+    for (i = 0; i < info->len; i++) v[i] = src[i * info->inner];             \
+                                                                             \
+    /* without NAN, NaNs are treated as larger than any other value */       \
+    n_valid = mg_compact_ ## TYPE(v, info->len);                             \
+    n = info->nan ? n_valid : info->len;                                     \
+                                                                             \
+    n_ranks = 0;                                                             \
+    for (qi = 0; qi < info->n_q && n > 0; qi++) {                            \
+      mg_quantile_ranks(info->q[qi], n, info->mode, &r0, &r1, &frac);        \
+      if (r0 < n_valid) ranks[n_ranks++] = r0;                               \
+      if (r1 < n_valid) ranks[n_ranks++] = r1;                               \
+    }                                                                        \
+    n_ranks = mg_sort_ranks(ranks, n_ranks);                                 \
+    mg_multiselect_ ## TYPE(v, 0, n_valid, ranks, n_ranks);                  \
+                                                                             \
+    for (qi = 0; qi < info->n_q; qi++) {                                     \
+      out = (o * info->n_q + qi) * info->inner + c;                          \
+      if (n > 0) mg_quantile_ranks(info->q[qi], n, info->mode, &r0, &r1, &frac); \
+      if (n == 0 || r1 >= n_valid) {                                         \
+        value = MG_STATS_NAN;                                                \
+      } else {                                                               \
+        value = (double) v[r0];                                              \
+        if (frac != 0.0 && r1 != r0) {                                       \
+          value += frac * ((double) v[r1] - (double) v[r0]);                 \
+        }                                                                    \
+      }                                                                      \
+                                                                             \
+      if (MG_QUANTILE_INTERPOLATES(info->mode)) {                            \
+        if (info->result_double) {                                           \
+          ((double *) info->result)[out] = value;                            \
+        } else {                                                             \
+          ((float *) info->result)[out] = (float) value;                     \
+        }                                                                    \
+      } else {                                                               \
+        /* NaN results are only possible for float and double */             \
+        ((TYPE *) info->result)[out] = (n == 0 || r0 >= n_valid)             \
+                                         ? (TYPE) value                      \
+                                         : v[r0];                            \
+      }                                                                      \
+    }                                                                        \
+  }                                                                          \
+}
+
+MG_QUANTILES(UCHAR)
+MG_QUANTILES(IDL_INT)
+MG_QUANTILES(IDL_LONG)
+MG_QUANTILES(float)
+MG_QUANTILES(double)
+MG_QUANTILES(IDL_UINT)
+MG_QUANTILES(IDL_ULONG)
+MG_QUANTILES(IDL_LONG64)
+MG_QUANTILES(IDL_ULONG64)
+
+
+static mg_thread_work mg_quantiles_kernel(int type) {
+  switch (type) {
+    case IDL_TYP_BYTE:    return mg_quantiles_UCHAR;
+    case IDL_TYP_INT:     return mg_quantiles_IDL_INT;
+    case IDL_TYP_LONG:    return mg_quantiles_IDL_LONG;
+    case IDL_TYP_FLOAT:   return mg_quantiles_float;
+    case IDL_TYP_DOUBLE:  return mg_quantiles_double;
+    case IDL_TYP_UINT:    return mg_quantiles_IDL_UINT;
+    case IDL_TYP_ULONG:   return mg_quantiles_IDL_ULONG;
+    case IDL_TYP_LONG64:  return mg_quantiles_IDL_LONG64;
+    case IDL_TYP_ULONG64: return mg_quantiles_IDL_ULONG64;
+  }
+  return NULL;
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_quantiles(int argc, IDL_VPTR *argv, char *argk) {
+  IDL_VPTR data = argv[0], q_var, result;
+  IDL_ARRAY *arr;
+  IDL_MEMINT dims[IDL_MAX_ARRAY_DIM], n_q, outer, n_stacks, i;
+  IDL_ALLTYPES scalar;
+  mg_quantiles_info info;
+  mg_thread_work kernel;
+  int nargs, dimension, n_threads, n_dims, d, result_type, q_is_array;
+  int nthreads;
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_LONG dimension;
+    IDL_STRING interpolation;
+    int interpolation_present;
+    IDL_LONG nan;
+    IDL_LONG n_threads;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "DIMENSION", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(dimension) },
+    { "INTERPOLATION", IDL_TYP_STRING, 1, 0,
+      IDL_KW_OFFSETOF(interpolation_present), IDL_KW_OFFSETOF(interpolation) },
+    { "NAN", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(nan) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+  dimension = kw.dimension;
+  n_threads = kw.n_threads;
+  info.nan = kw.nan;
+  info.mode = MG_QUANTILE_RANK;
+  if (kw.interpolation_present) {
+    char *mode = IDL_STRING_STR(&kw.interpolation), lower[16];
+    for (i = 0; mode[i] && i < 15; i++) lower[i] = (char) tolower(mode[i]);
+    lower[i] = '\0';
+    for (info.mode = 0; mg_quantile_modes[info.mode]; info.mode++) {
+      if (strcmp(lower, mg_quantile_modes[info.mode]) == 0) break;
+    }
+  }
+  IDL_KW_FREE;
+
+  if (mg_quantile_modes[info.mode] == NULL) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unknown INTERPOLATION mode");
+  }
+
+  IDL_ENSURE_SIMPLE(data);
+  IDL_ENSURE_ARRAY(data);
+  arr = data->value.arr;
+
+  kernel = mg_quantiles_kernel(data->type);
+  if (kernel == NULL) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "unsupported type");
+  }
+
+  if (dimension < 0 || dimension > arr->n_dim) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "illegal value for DIMENSION");
+  }
+
+  IDL_ENSURE_SIMPLE(argv[1]);
+  q_is_array = (argv[1]->flags & IDL_V_ARR) != 0;
+  q_var = IDL_CvtDbl(1, &argv[1], NULL);
+  IDL_VarGetData(q_var, &n_q, (char **) &info.q, FALSE);
+  for (i = 0; i < n_q; i++) {
+    if (!(info.q[i] >= 0.0 && info.q[i] <= 1.0)) {
+      if (q_var != argv[1]) IDL_Deltmp(q_var);
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "quantiles must be between 0.0 and 1.0");
+    }
+  }
+  info.n_q = (int) n_q;
+
+  // result has the dimensions of data with the quantiles in place of the
+  // given dimension
+  mg_stats_layout(arr, dimension, &info.inner, &info.len, &outer, dims, &n_dims);
+  if (q_is_array) {
+    d = dimension == 0 ? 0 : dimension - 1;
+    memmove(dims + d + 1, dims + d, (n_dims - d) * sizeof(IDL_MEMINT));
+    dims[d] = n_q;
+    n_dims++;
+  }
+
+  if (MG_QUANTILE_INTERPOLATES(info.mode)) {
+    info.result_double = data->type == IDL_TYP_DOUBLE;
+    result_type = info.result_double ? IDL_TYP_DOUBLE : IDL_TYP_FLOAT;
+  } else {
+    result_type = data->type;
+  }
+
+  if (n_dims == 0) {
+    info.result = (char *) &scalar;
+    result = IDL_Gettmp();
+  } else {
+    info.result = IDL_MakeTempArray(result_type, n_dims, dims,
+                                    IDL_ARR_INI_NOP, &result);
+  }
+
+  n_stacks = info.inner * outer;
+  nthreads = mg_thread_count(n_stacks, MG_STATS_MIN_ELTS / info.len, n_threads);
+
+  info.data = (char *) arr->data;
+  info.scratch = (char *) IDL_MemAlloc(nthreads * (info.len * arr->elt_len
+                                                     + 2 * n_q * sizeof(IDL_MEMINT)),
+                                       "quantile scratch space", IDL_MSG_RET);
+  if (info.scratch == NULL) {
+    if (q_var != argv[1]) IDL_Deltmp(q_var);
+    IDL_Deltmp(result);
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unable to allocate memory for quantiles");
+  }
+  info.ranks = (IDL_MEMINT *) (info.scratch + nthreads * info.len * arr->elt_len);
+
+  mg_thread_run(nthreads, n_stacks, kernel, &info);
+
+  IDL_MemFree(info.scratch, NULL, IDL_MSG_RET);
+  if (q_var != argv[1]) IDL_Deltmp(q_var);
+
+  if (n_dims == 0) {
+    result->type = result_type;
+    result->value = scalar;
+  }
+
+  return result;
+}
+
+
+/**************************************************************************
+  MG_MEDIAN_DEVIATION
+***************************************************************************/
+
+typedef struct {
+  char *data;
+  int type;
+  int elt_len;
+  char *result;
+  int result_double;
+  IDL_MEMINT inner;
+  IDL_MEMINT len;
+  int even;
+  double *scratch;     // len elements per thread
+} mg_mad_info;
+
+
+// median of n values like MEDIAN: the upper middle value for an even number
+// of values unless even is set
+static double mg_median(double *v, IDL_MEMINT n, int even) {
+  IDL_MEMINT i, k = n / 2;
+  double lower;
+
+  mg_select_double(v, 0, n, k);
+  if (!even || n % 2 == 1) return v[k];
+
+  // the lower middle value is the largest value below the upper one
+  lower = v[0];
+  for (i = 1; i < k; i++) {
+    if (v[i] > lower) lower = v[i];
+  }
+  return (lower + v[k]) / 2.0;
+}
+
+
+#define MG_MAD_GATHER(TYPE)                                                  \
+static void mg_mad_gather_ ## TYPE(char *data, IDL_MEMINT inner,             \
+                                   IDL_MEMINT len, double *v) {              \
+  TYPE *src = (TYPE *) data;                                                 \
+  IDL_MEMINT i;                                                              \
+  for (i = 0; i < len; i++) v[i] = (double) src[i * inner];                  \
+}
+
+MG_MAD_GATHER(UCHAR)
+MG_MAD_GATHER(IDL_INT)
+MG_MAD_GATHER(IDL_LONG)
+MG_MAD_GATHER(float)
+MG_MAD_GATHER(double)
+MG_MAD_GATHER(IDL_UINT)
+MG_MAD_GATHER(IDL_ULONG)
+MG_MAD_GATHER(IDL_LONG64)
+MG_MAD_GATHER(IDL_ULONG64)
+
+
+// copy len elements, inner elements apart, of an array of the given type to v
+static void mg_mad_gather(int type, char *src, IDL_MEMINT inner,
+                          IDL_MEMINT len, double *v) {
+  switch (type) {
+    case IDL_TYP_BYTE:    mg_mad_gather_UCHAR(src, inner, len, v); break;
+    case IDL_TYP_INT:     mg_mad_gather_IDL_INT(src, inner, len, v); break;
+    case IDL_TYP_LONG:    mg_mad_gather_IDL_LONG(src, inner, len, v); break;
+    case IDL_TYP_FLOAT:   mg_mad_gather_float(src, inner, len, v); break;
+    case IDL_TYP_DOUBLE:  mg_mad_gather_double(src, inner, len, v); break;
+    case IDL_TYP_UINT:    mg_mad_gather_IDL_UINT(src, inner, len, v); break;
+    case IDL_TYP_ULONG:   mg_mad_gather_IDL_ULONG(src, inner, len, v); break;
+    case IDL_TYP_LONG64:  mg_mad_gather_IDL_LONG64(src, inner, len, v); break;
+    case IDL_TYP_ULONG64: mg_mad_gather_IDL_ULONG64(src, inner, len, v); break;
+  }
+}
+
+
+static void mg_mad_work(IDL_MEMINT start, IDL_MEMINT end,
+                        int thread_index, void *data) {
+  mg_mad_info *info = (mg_mad_info *) data;
+  double *v = info->scratch + thread_index * info->len;
+  IDL_MEMINT s, i, o, c, n;
+  char *src;
+  double m, mad;
+
+  for (s = start; s < end; s++) {
+    o = s / info->inner;
+    c = s % info->inner;
+    src = info->data + (o * info->len * info->inner + c) * info->elt_len;
+    mg_mad_gather(info->type, src, info->inner, info->len, v);
+
+    // like MEDIAN, NaNs are treated as missing
+    n = mg_compact_double(v, info->len);
+    if (n == 0) {
+      mad = MG_STATS_NAN;
+    } else {
+      m = mg_median(v, n, info->even);
+      for (i = 0; i < n; i++) v[i] = fabs(v[i] - m);
+      mad = mg_median(v, n, info->even);
+    }
+
+    if (info->result_double) {
+      ((double *) info->result)[s] = mad;
+    } else {
+      ((float *) info->result)[s] = (float) mad;
+    }
+  }
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_median_deviation(int argc, IDL_VPTR *argv, char *argk) {
+  IDL_VPTR data = argv[0], result;
+  IDL_ARRAY *arr;
+  IDL_MEMINT dims[IDL_MAX_ARRAY_DIM], outer, n_stacks;
+  IDL_ALLTYPES scalar;
+  mg_mad_info info;
+  int nargs, dimension, n_threads, n_dims, result_type, nthreads;
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_LONG dimension;
+    IDL_LONG even;
+    IDL_LONG n_threads;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "DIMENSION", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(dimension) },
+    { "EVEN", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(even) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+  dimension = kw.dimension;
+  n_threads = kw.n_threads;
+  info.even = kw.even;
+  IDL_KW_FREE;
+
+  IDL_ENSURE_SIMPLE(data);
+  IDL_ENSURE_ARRAY(data);
+  arr = data->value.arr;
+
+  if (!mg_stats_is_real(data->type)) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "unsupported type");
+  }
+
+  if (dimension < 0 || dimension > arr->n_dim) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "illegal value for DIMENSION");
+  }
+
+  mg_stats_layout(arr, dimension, &info.inner, &info.len, &outer, dims, &n_dims);
+
+  info.data = (char *) arr->data;
+  info.type = data->type;
+  info.elt_len = arr->elt_len;
+  info.result_double = data->type == IDL_TYP_DOUBLE;
+  result_type = info.result_double ? IDL_TYP_DOUBLE : IDL_TYP_FLOAT;
+
+  if (n_dims == 0) {
+    info.result = (char *) &scalar;
+    result = IDL_Gettmp();
+  } else {
+    info.result = IDL_MakeTempArray(result_type, n_dims, dims,
+                                    IDL_ARR_INI_NOP, &result);
+  }
+
+  n_stacks = info.inner * outer;
+  nthreads = mg_thread_count(n_stacks, MG_STATS_MIN_ELTS / info.len, n_threads);
+
+  info.scratch = (double *) IDL_MemAlloc(nthreads * info.len * sizeof(double),
+                                         "MAD scratch space", IDL_MSG_RET);
+  if (info.scratch == NULL) {
+    IDL_Deltmp(result);
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unable to allocate memory for MAD");
+  }
+
+  mg_thread_run(nthreads, n_stacks, mg_mad_work, &info);
+
+  IDL_MemFree(info.scratch, NULL, IDL_MSG_RET);
+
+  if (n_dims == 0) {
+    result->type = result_type;
+    result->value = scalar;
+  }
+
+  return result;
+}
+
+
+/**************************************************************************
+  MG_SMALLEST
+***************************************************************************/
+
+/*
+  Find the n smallest (or largest) values by selecting the n-th value t on a
+  copy of the data, then collecting the indices of values strictly beyond t
+  followed by the first indices of values equal to t. Only the n results are
+  sorted, by value and then index.
+*/
+#define MG_SMALLEST(TYPE)                                                    \
+typedef struct {                                                             \
+  TYPE value;                                                                \
+  IDL_MEMINT index;                                                          \
+} mg_pair_ ## TYPE;                                                          \
+                                                                             \
+static int mg_pair_ascending_ ## TYPE(const void *a, const void *b) {        \
+  const mg_pair_ ## TYPE *p1 = (const mg_pair_ ## TYPE *) a;                 \
+  const mg_pair_ ## TYPE *p2 = (const mg_pair_ ## TYPE *) b;                 \
+  if (p1->value < p2->value) return -1;                                      \
+  if (p1->value > p2->value) return 1;                                       \
+  return p1->index < p2->index ? -1 : (p1->index > p2->index);               \
+}                                                                            \
+                                                                             \
+static int mg_pair_descending_ ## TYPE(const void *a, const void *b) {       \
+  const mg_pair_ ## TYPE *p1 = (const mg_pair_ ## TYPE *) a;                 \
+  const mg_pair_ ## TYPE *p2 = (const mg_pair_ ## TYPE *) b;                 \
+  if (p1->value > p2->value) return -1;                                      \
+  if (p1->value < p2->value) return 1;                                       \
+  return p1->index < p2->index ? -1 : (p1->index > p2->index);               \
+}                                                                            \
+                                                                             \
+/* returns the number of indices stored */                                   \
+static IDL_MEMINT mg_smallest_ ## TYPE(TYPE *data, IDL_MEMINT n_elts,        \
+                                       IDL_MEMINT n, int largest, int nan,   \
+                                       TYPE *v, mg_pair_ ## TYPE *pairs,     \
+                                       IDL_MEMINT *indices) {                \
+  IDL_MEMINT i, n_valid, n_nan, n_found = 0, n_select, n_beyond = 0;         \
+  TYPE t;                                                                    \
+                                                                             \
+  memcpy(v, data, n_elts * sizeof(TYPE));                                    \
+  n_valid = mg_compact_ ## TYPE(v, n_elts);                                  \
+  n_nan = n_elts - n_valid;                                                  \
+                                                                             \
+  /* without NAN, NaNs are larger than any value */                          \
+  if (largest && !nan) {                                                     \
+    for (i = 0; i < n_elts && n_found < n && n_found < n_nan; i++) {         \
+      if (data[i] != data[i]) indices[n_found++] = i;                        \
+    }                                                                        \
+  }                                                                          \
+                                                                             \
+  n_select = n - n_found < n_valid ? n - n_found : n_valid;                  \
+  if (n_select > 0) {                                                        \
+    mg_select_ ## TYPE(v, 0, n_valid,                                        \
+                       largest ? n_valid - n_select : n_select - 1);         \
+    t = v[largest ? n_valid - n_select : n_select - 1];                      \
+    for (i = 0; i < n_elts; i++) {                                           \
+      if (largest ? data[i] > t : data[i] < t) {                             \
+        pairs[n_beyond].value = data[i];                                     \
+        pairs[n_beyond++].index = i;                                         \
+      }                                                                      \
+    }                                                                        \
+    for (i = 0; i < n_elts && n_beyond < n_select; i++) {                    \
+      if (data[i] == t) {                                                    \
+        pairs[n_beyond].value = data[i];                                     \
+        pairs[n_beyond++].index = i;                                         \
+      }                                                                      \
+    }                                                                        \
+    qsort(pairs, n_select, sizeof(mg_pair_ ## TYPE),                         \
+          largest ? mg_pair_descending_ ## TYPE : mg_pair_ascending_ ## TYPE); \
+    for (i = 0; i < n_select; i++) indices[n_found++] = pairs[i].index;      \
+  }                                                                          \
+                                                                             \
+  if (!largest && !nan) {                                                    \
+    for (i = 0; i < n_elts && n_found < n; i++) {                            \
+      if (data[i] != data[i]) indices[n_found++] = i;                        \
+    }                                                                        \
+  }                                                                          \
+                                                                             \
+  return n_found;                                                            \
+}
+
+MG_SMALLEST(UCHAR)
+MG_SMALLEST(IDL_INT)
+MG_SMALLEST(IDL_LONG)
+MG_SMALLEST(float)
+MG_SMALLEST(double)
+MG_SMALLEST(IDL_UINT)
+MG_SMALLEST(IDL_ULONG)
+MG_SMALLEST(IDL_LONG64)
+MG_SMALLEST(IDL_ULONG64)
+
+
+#define MG_SMALLEST_CASE(TYPE_VALUE, TYPE)                                   \
+  case TYPE_VALUE:                                                           \
+    n_found = mg_smallest_ ## TYPE((TYPE *) data, n_elts, n, largest, nan,   \
+                                   (TYPE *) scratch,                         \
+                                   (mg_pair_ ## TYPE *) (scratch + data_size), \
+                                   indices);                                 \
+    break;
+
+static IDL_VPTR IDL_CDECL IDL_mg_smallest(int argc, IDL_VPTR *argv, char *argk) {
+  IDL_VPTR result;
+  IDL_MEMINT n_elts, n, n_found = 0, i, data_size, *indices;
+  char *data, *scratch;
+  int nargs, largest, nan, elt_len;
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_LONG largest;
+    IDL_LONG nan;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "LARGEST", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(largest) },
+    { "NAN", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(nan) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+  largest = kw.largest;
+  nan = kw.nan;
+  IDL_KW_FREE;
+
+  IDL_ENSURE_SIMPLE(argv[0]);
+  if (!mg_stats_is_real(argv[0]->type)) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "unsupported type");
+  }
+  IDL_VarGetData(argv[0], &n_elts, &data, FALSE);
+  elt_len = IDL_TypeSizeFunc(argv[0]->type);
+
+  n = IDL_MEMINTScalar(argv[1]);
+  if (n < 1 || n > n_elts) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "n must be between 1 and the number of elements");
+  }
+
+  // copy of the data, (value, index) pairs, and indices
+  data_size = MG_STATS_ALIGN(n_elts * elt_len);
+  scratch = (char *) IDL_MemAlloc(data_size
+                                    + n * (8 + sizeof(IDL_MEMINT))
+                                    + n * sizeof(IDL_MEMINT),
+                                  "selection scratch space", IDL_MSG_LONGJMP);
+  indices = (IDL_MEMINT *) (scratch + data_size + n * (8 + sizeof(IDL_MEMINT)));
+
+  switch (argv[0]->type) {
+    MG_SMALLEST_CASE(IDL_TYP_BYTE, UCHAR)
+    MG_SMALLEST_CASE(IDL_TYP_INT, IDL_INT)
+    MG_SMALLEST_CASE(IDL_TYP_LONG, IDL_LONG)
+    MG_SMALLEST_CASE(IDL_TYP_FLOAT, float)
+    MG_SMALLEST_CASE(IDL_TYP_DOUBLE, double)
+    MG_SMALLEST_CASE(IDL_TYP_UINT, IDL_UINT)
+    MG_SMALLEST_CASE(IDL_TYP_ULONG, IDL_ULONG)
+    MG_SMALLEST_CASE(IDL_TYP_LONG64, IDL_LONG64)
+    MG_SMALLEST_CASE(IDL_TYP_ULONG64, IDL_ULONG64)
+  }
+
+  // like WHERE, return -1 if nothing is found
+  if (n_found == 0) {
+    IDL_MemFree(scratch, NULL, IDL_MSG_RET);
+    return IDL_GettmpLong(-1);
+  }
+
+  if (n_elts > 2147483647) {
+    IDL_LONG64 *result_data = (IDL_LONG64 *) IDL_MakeTempVector(IDL_TYP_LONG64, n_found,
+                                                                IDL_ARR_INI_NOP, &result);
+    for (i = 0; i < n_found; i++) result_data[i] = indices[i];
+  } else {
+    IDL_LONG *result_data = (IDL_LONG *) IDL_MakeTempVector(IDL_TYP_LONG, n_found,
+                                                            IDL_ARR_INI_NOP, &result);
+    for (i = 0; i < n_found; i++) result_data[i] = (IDL_LONG) indices[i];
+  }
+
+  IDL_MemFree(scratch, NULL, IDL_MSG_RET);
+
+  return result;
+}
+
+/**************************************************************************
+  MG_HISTOGRAM_ND
+***************************************************************************/
+
+// bins per thread allowed for private histograms, relative to the points
+#define MG_HIST_MIN_PRIVATE 1048576
+
+typedef struct {
+  char *data;              // n_dims by n_points
+  IDL_MEMINT n_dims;
+  IDL_MEMINT n_points;
+  IDL_MEMINT n_bins;       // total number of bins
+  double *min;
+  double *max;
+  double *bin_size;
+  IDL_MEMINT *nbins;
+  IDL_MEMINT *strides;     // bin index multiplier for each dimension
+  double *edges;           // non-uniform edges, NULL for uniform bins
+  IDL_MEMINT *edge_starts; // index of first edge of each dimension
+  double *weights;         // NULL if no weights
+  IDL_MEMINT *counts;      // n_bins per thread
+  double *sums;            // n_bins per thread, only with weights
+  IDL_MEMINT *bins;        // bin of each point or -1, only for reverse indices
+  char *result;            // merged counts
+  char *weighted;          // merged sums
+  int wide;                // counts are LONG64 instead of LONG
+  int weighted_double;     // sums are double instead of float
+  int n_threads;
+} mg_hist_info;
+
+// natural range of each dimension, ignoring NaNs
+typedef void (*mg_hist_range)(char *data, IDL_MEMINT n_dims,
+                              IDL_MEMINT n_points, double *lo, double *hi);
+
+
+/*
+  Bin of a value in dimension d, or -1 if out of range. The last bin includes
+  its upper edge, i.e., the maximum.
+*/
+static inline IDL_MEMINT mg_hist_bin(mg_hist_info *info, IDL_MEMINT d, double x) {
+  IDL_MEMINT lo, hi, mid, j;
+  double *e;
+
+  if (!(x >= info->min[d] && x <= info->max[d])) return -1;
+
+  if (info->edges) {
+    e = info->edges + info->edge_starts[d];
+    lo = 0;
+    hi = info->nbins[d];
+    while (hi - lo > 1) {
+      mid = (lo + hi) / 2;
+      if (e[mid] <= x) lo = mid; else hi = mid;
+    }
+    return lo;
+  }
+
+  if (info->bin_size[d] == 0.0) return 0;
+  j = (IDL_MEMINT) ((x - info->min[d]) / info->bin_size[d]);
+  return j < info->nbins[d] ? j : info->nbins[d] - 1;
+}
+
+
+// count points [start, end) in the private histogram of the thread
+#define MG_HIST_ND(TYPE)                                                     \
+static void mg_hist_nd_ ## TYPE(IDL_MEMINT start, IDL_MEMINT end,            \
+                                int thread_index, void *data) {              \
+  mg_hist_info *info = (mg_hist_info *) data;                                \
+  IDL_MEMINT *counts = info->counts + thread_index * info->n_bins;           \
+  double *sums = info->sums ? info->sums + thread_index * info->n_bins : NULL; \
+  TYPE *point = (TYPE *) info->data + start * info->n_dims;                  \
+  IDL_MEMINT i, d, b, j;                                                     \
+                                                                             \
+  for (i = start; i < end; i++, point += info->n_dims) {                     \
+    for (d = 0, b = 0; d < info->n_dims; d++) {                              \
+      j = mg_hist_bin(info, d, (double) point[d]);                           \
+      if (j < 0) {                                                           \
+        b = -1;                                                              \
+        break;                                                               \
+      }                                                                      \
+      b += j * info->strides[d];                                             \
+    }                                                                        \
+    if (info->bins) info->bins[i] = b;                                       \
+    if (b < 0) continue;                                                     \
+    counts[b]++;                                                             \
+    if (sums) sums[b] += info->weights[i];                                   \
+  }                                                                          \
+}                                                                            \
+                                                                             \
+static void mg_hist_range_ ## TYPE(char *data, IDL_MEMINT n_dims,            \
+                                   IDL_MEMINT n_points,                      \
+                                   double *lo, double *hi) {                 \
+  TYPE *point = (TYPE *) data;                                               \
+  IDL_MEMINT i, d;                                                           \
+  double x;                                                                  \
+                                                                             \
+  for (d = 0; d < n_dims; d++) {                                             \
+    lo[d] = 0.0;                                                             \
+    hi[d] = -1.0;                                                            \
+  }                                                                          \
+  for (i = 0; i < n_points; i++, point += n_dims) {                          \
+    for (d = 0; d < n_dims; d++) {                                           \
+      x = (double) point[d];                                                 \
+      if (x != x) continue;                                                  \
+      if (lo[d] > hi[d]) {                                                   \
+        lo[d] = hi[d] = x;                                                   \
+      } else if (x < lo[d]) {                                                \
+        lo[d] = x;                                                           \
+      } else if (x > hi[d]) {                                                \
+        hi[d] = x;                                                           \
+      }                                                                      \
+    }                                                                        \
+  }                                                                          \
+}
+
+MG_HIST_ND(UCHAR)
+MG_HIST_ND(IDL_INT)
+MG_HIST_ND(IDL_LONG)
+MG_HIST_ND(float)
+MG_HIST_ND(double)
+MG_HIST_ND(IDL_UINT)
+MG_HIST_ND(IDL_ULONG)
+MG_HIST_ND(IDL_LONG64)
+MG_HIST_ND(IDL_ULONG64)
+
+
+#define MG_HIST_ND_CASE(TYPE_VALUE, TYPE)                                    \
+  case TYPE_VALUE:                                                           \
+    *range = mg_hist_range_ ## TYPE;                                         \
+    return mg_hist_nd_ ## TYPE;
+
+static mg_thread_work mg_hist_nd_kernel(int type, mg_hist_range *range) {
+  switch (type) {
+    MG_HIST_ND_CASE(IDL_TYP_BYTE, UCHAR)
+    MG_HIST_ND_CASE(IDL_TYP_INT, IDL_INT)
+    MG_HIST_ND_CASE(IDL_TYP_LONG, IDL_LONG)
+    MG_HIST_ND_CASE(IDL_TYP_FLOAT, float)
+    MG_HIST_ND_CASE(IDL_TYP_DOUBLE, double)
+    MG_HIST_ND_CASE(IDL_TYP_UINT, IDL_UINT)
+    MG_HIST_ND_CASE(IDL_TYP_ULONG, IDL_ULONG)
+    MG_HIST_ND_CASE(IDL_TYP_LONG64, IDL_LONG64)
+    MG_HIST_ND_CASE(IDL_TYP_ULONG64, IDL_ULONG64)
+  }
+  return NULL;
+}
+
+
+// merge the private histograms for bins [start, end)
+static void mg_hist_merge(IDL_MEMINT start, IDL_MEMINT end,
+                          int thread_index, void *data) {
+  mg_hist_info *info = (mg_hist_info *) data;
+  IDL_MEMINT b, count;
+  double sum;
+  int t;
+
+  for (b = start; b < end; b++) {
+    for (t = 0, count = 0; t < info->n_threads; t++) {
+      count += info->counts[t * info->n_bins + b];
+    }
+    if (info->wide) {
+      ((IDL_LONG64 *) info->result)[b] = count;
+    } else {
+      ((IDL_LONG *) info->result)[b] = (IDL_LONG) count;
+    }
+
+    if (info->sums) {
+      for (t = 0, sum = 0.0; t < info->n_threads; t++) {
+        sum += info->sums[t * info->n_bins + b];
+      }
+      if (info->weighted_double) {
+        ((double *) info->weighted)[b] = sum;
+      } else {
+        ((float *) info->weighted)[b] = (float) sum;
+      }
+    }
+  }
+}
+
+
+/*
+  Fill the indices part of the reverse indices for points [start, end), the
+  same points that the thread counted; the counts of each thread have been
+  replaced by the positions of its first point in each bin.
+*/
+static void mg_hist_reverse(IDL_MEMINT start, IDL_MEMINT end,
+                            int thread_index, void *data) {
+  mg_hist_info *info = (mg_hist_info *) data;
+  IDL_MEMINT *pos = info->counts + thread_index * info->n_bins;
+  IDL_MEMINT i, b;
+
+  for (i = start; i < end; i++) {
+    b = info->bins[i];
+    if (b < 0) continue;
+    if (info->wide) {
+      ((IDL_LONG64 *) info->result)[pos[b]++] = i;
+    } else {
+      ((IDL_LONG *) info->result)[pos[b]++] = (IDL_LONG) i;
+    }
+  }
+}
+
+
+// convert an optional, simple variable to n_dims doubles, a scalar applies to
+// all dimensions; returns 0 if not present, -1 if it has the wrong number of
+// elements
+static int mg_hist_param(IDL_VPTR var, IDL_MEMINT n_dims, double *values) {
+  IDL_VPTR dbl;
+  IDL_MEMINT n, d;
+  double *v;
+
+  if (var == NULL || var->type == IDL_TYP_UNDEF) return 0;
+  dbl = var->type == IDL_TYP_DOUBLE ? var : IDL_CvtDbl(1, &var, NULL);
+  IDL_VarGetData(dbl, &n, (char **) &v, FALSE);
+  if (n != 1 && n != n_dims) {
+    if (dbl != var) IDL_Deltmp(dbl);
+    return -1;
+  }
+  for (d = 0; d < n_dims; d++) values[d] = v[n == 1 ? 0 : d];
+  if (dbl != var) IDL_Deltmp(dbl);
+
+  return 1;
+}
+
+
+static void mg_hist_store_doubles(IDL_VPTR var, double *values, IDL_MEMINT n) {
+  IDL_VPTR result;
+  double *data = (double *) IDL_MakeTempVector(IDL_TYP_DOUBLE, n,
+                                               IDL_ARR_INI_NOP, &result);
+  memcpy(data, values, n * sizeof(double));
+  IDL_VarCopy(result, var);
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_histogram_nd(int argc, IDL_VPTR *argv, char *argk) {
+  IDL_VPTR array = argv[0], result, weighted_var, weights_var = NULL, ri_var;
+  IDL_VPTR edges_var = NULL;
+  IDL_ARRAY *arr;
+  mg_hist_info info;
+  mg_thread_work kernel;
+  mg_hist_range range;
+  IDL_MEMINT n_dims, n_points, d, b, n_edges, n_weights, n_in, offset;
+  IDL_MEMINT dims[IDL_MAX_ARRAY_DIM], *params_int;
+  double *params, *nbins_d;
+  char *buffer, *name;
+  int nargs, t, have_min, have_max, have_bin_size, have_nbins, ri_wide;
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_VPTR bin_size;
+    IDL_VPTR edges;
+    IDL_LONG l64;
+    IDL_VPTR max;
+    IDL_VPTR min;
+    IDL_LONG n_threads;
+    IDL_VPTR nbins;
+    IDL_VPTR omax;
+    int omax_present;
+    IDL_VPTR omin;
+    int omin_present;
+    IDL_VPTR reverse_indices;
+    int reverse_indices_present;
+    IDL_VPTR unweighted;
+    int unweighted_present;
+    IDL_VPTR weights;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "BIN_SIZE", IDL_TYP_UNDEF, 1, IDL_KW_VIN | IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(bin_size) },
+    { "EDGES", IDL_TYP_UNDEF, 1, IDL_KW_VIN | IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(edges) },
+    { "L64", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(l64) },
+    { "MAX", IDL_TYP_UNDEF, 1, IDL_KW_VIN | IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(max) },
+    { "MIN", IDL_TYP_UNDEF, 1, IDL_KW_VIN | IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(min) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { "NBINS", IDL_TYP_UNDEF, 1, IDL_KW_VIN | IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(nbins) },
+    { "OMAX", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(omax_present), IDL_KW_OFFSETOF(omax) },
+    { "OMIN", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(omin_present), IDL_KW_OFFSETOF(omin) },
+    { "REVERSE_INDICES", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(reverse_indices_present), IDL_KW_OFFSETOF(reverse_indices) },
+    { "UNWEIGHTED", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(unweighted_present), IDL_KW_OFFSETOF(unweighted) },
+    { "WEIGHTS", IDL_TYP_UNDEF, 1, IDL_KW_VIN | IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(weights) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+
+  IDL_ENSURE_SIMPLE(array);
+  IDL_ENSURE_ARRAY(array);
+  arr = array->value.arr;
+
+  kernel = mg_hist_nd_kernel(array->type, &range);
+  if (kernel == NULL) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "unsupported type");
+  }
+  if (arr->n_dim > 2) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "input must be 2-dimensional: dimensions by points");
+  }
+  n_dims = arr->n_dim == 2 ? arr->dim[0] : 1;
+  n_points = arr->n_elts / n_dims;
+
+  // check the keywords before there is memory to free
+  if (kw.min) IDL_ENSURE_SIMPLE(kw.min);
+  if (kw.max) IDL_ENSURE_SIMPLE(kw.max);
+  if (kw.bin_size) IDL_ENSURE_SIMPLE(kw.bin_size);
+  if (kw.nbins) IDL_ENSURE_SIMPLE(kw.nbins);
+  if (kw.edges) IDL_ENSURE_SIMPLE(kw.edges);
+  if (kw.weights) IDL_ENSURE_SIMPLE(kw.weights);
+
+  // min, max, bin_size, nbins (as doubles, then as integers), strides, and
+  // edge starts for each dimension
+  params = (double *) IDL_MemAlloc(7 * n_dims * sizeof(double), "parameters",
+                                   IDL_MSG_RET);
+  if (params == NULL) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unable to allocate memory for parameters");
+  }
+  info.min = params;
+  info.max = params + n_dims;
+  info.bin_size = params + 2 * n_dims;
+  nbins_d = params + 3 * n_dims;
+  params_int = (IDL_MEMINT *) (params + 4 * n_dims);
+
+  // NBINS is converted before the range needs nbins_d and strides as scratch
+  info.nbins = params_int;
+  info.strides = params_int + n_dims;
+  info.edge_starts = params_int + 2 * n_dims;
+
+  have_min = mg_hist_param(kw.min, n_dims, info.min);
+  have_max = mg_hist_param(kw.max, n_dims, info.max);
+  have_bin_size = mg_hist_param(kw.bin_size, n_dims, info.bin_size);
+  have_nbins = mg_hist_param(kw.nbins, n_dims, nbins_d);
+  name = have_min < 0 ? "MIN"
+           : have_max < 0 ? "MAX"
+           : have_bin_size < 0 ? "BIN_SIZE"
+           : have_nbins < 0 ? "NBINS"
+           : NULL;
+  if (name) {
+    IDL_MemFree(params, NULL, IDL_MSG_RET);
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "%s must be a scalar or have an element for each dimension",
+                name);
+  }
+  for (d = 0; d < n_dims && have_nbins; d++) info.nbins[d] = (IDL_MEMINT) nbins_d[d];
+
+  info.edges = NULL;
+  if (kw.edges && kw.edges->type != IDL_TYP_UNDEF) {
+    // edges of all dimensions concatenated, split evenly if NBINS not given
+    edges_var = kw.edges->type == IDL_TYP_DOUBLE
+                  ? kw.edges
+                  : IDL_CvtDbl(1, &kw.edges, NULL);
+    IDL_VarGetData(edges_var, &n_edges, (char **) &info.edges, FALSE);
+    if (!have_nbins) {
+      for (d = 0; d < n_dims; d++) info.nbins[d] = n_edges / n_dims - 1;
+    }
+    for (d = 0, offset = 0; d < n_dims; d++) {
+      info.edge_starts[d] = offset;
+      offset += info.nbins[d] + 1;
+    }
+    if (offset != n_edges || have_bin_size) goto edges_error;
+    for (d = 0; d < n_dims; d++) {
+      double *e = info.edges + info.edge_starts[d];
+      if (info.nbins[d] < 1) goto edges_error;
+      for (b = 0; b < info.nbins[d]; b++) {
+        if (!(e[b] < e[b + 1])) goto edges_error;
+      }
+      info.min[d] = e[0];
+      info.max[d] = e[info.nbins[d]];
+    }
+  } else {
+    // natural range of each dimension where not given, ignoring NaNs
+    if (!have_min || !have_max) {
+      double *lo = nbins_d, *hi = (double *) info.strides;
+      range((char *) arr->data, n_dims, n_points, lo, hi);
+      for (d = 0; d < n_dims; d++) {
+        if (!have_min) info.min[d] = lo[d];
+        if (!have_max) info.max[d] = hi[d];
+      }
+    }
+
+    for (d = 0; d < n_dims; d++) {
+      if (!(info.min[d] <= info.max[d])) {
+        IDL_MemFree(params, NULL, IDL_MSG_RET);
+        IDL_KW_FREE;
+        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                    "minimum must be less than or equal to maximum");
+      }
+    }
+
+    if (have_bin_size == have_nbins) {
+      IDL_MemFree(params, NULL, IDL_MSG_RET);
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "must pass either BIN_SIZE or NBINS");
+    }
+    for (d = 0; d < n_dims; d++) {
+      if (have_nbins) {
+        info.bin_size[d] = (info.max[d] - info.min[d]) / info.nbins[d];
+      } else if (info.bin_size[d] > 0.0) {
+        info.nbins[d] = (IDL_MEMINT) ((info.max[d] - info.min[d]) / info.bin_size[d] + 1);
+      } else {
+        info.nbins[d] = 0;
+      }
+      if (info.nbins[d] < 1) {
+        IDL_MemFree(params, NULL, IDL_MSG_RET);
+        IDL_KW_FREE;
+        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                    "number of bins must be positive");
+      }
+    }
+  }
+
+  // the first dimension varies fastest
+  info.n_bins = 1;
+  for (d = 0; d < n_dims; d++) {
+    info.strides[d] = info.n_bins;
+    if ((double) info.nbins[d] * info.n_bins > 9.0e18) {
+      if (edges_var && edges_var != kw.edges) IDL_Deltmp(edges_var);
+      IDL_MemFree(params, NULL, IDL_MSG_RET);
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "too many bins");
+    }
+    info.n_bins *= info.nbins[d];
+  }
+
+  info.weights = NULL;
+  if (kw.weights && kw.weights->type != IDL_TYP_UNDEF) {
+    weights_var = kw.weights->type == IDL_TYP_DOUBLE
+                    ? kw.weights
+                    : IDL_CvtDbl(1, &kw.weights, NULL);
+    IDL_VarGetData(weights_var, &n_weights, (char **) &info.weights, FALSE);
+    if (n_weights < n_points) {
+      if (weights_var != kw.weights) IDL_Deltmp(weights_var);
+      if (edges_var && edges_var != kw.edges) IDL_Deltmp(edges_var);
+      IDL_MemFree(params, NULL, IDL_MSG_RET);
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "WEIGHTS must have an element for each point");
+    }
+  }
+
+  // private histograms only as far as they are small compared to the points
+  info.n_threads = mg_thread_count(n_points, MG_STATS_MIN_ELTS, kw.n_threads);
+  while (info.n_threads > 1
+           && info.n_threads * info.n_bins > (n_points > MG_HIST_MIN_PRIVATE
+                                              ? n_points
+                                              : MG_HIST_MIN_PRIVATE)) {
+    info.n_threads--;
+  }
+
+  info.data = (char *) arr->data;
+  info.n_dims = n_dims;
+  info.n_points = n_points;
+  info.wide = kw.l64 != 0;
+  info.weighted_double = kw.weights && kw.weights->type == IDL_TYP_DOUBLE;
+
+  // result first, then counts, sums, and bins for reverse indices
+  if (n_dims <= IDL_MAX_ARRAY_DIM) {
+    for (d = 0; d < n_dims; d++) dims[d] = info.nbins[d];
+  } else {
+    dims[0] = info.n_bins;
+  }
+  info.result = IDL_MakeTempArray(info.wide ? IDL_TYP_LONG64 : IDL_TYP_LONG,
+                                  n_dims <= IDL_MAX_ARRAY_DIM ? (int) n_dims : 1,
+                                  dims, IDL_ARR_INI_NOP, &result);
+  info.weighted = NULL;
+  if (info.weights) {
+    info.weighted = IDL_MakeTempArray(info.weighted_double ? IDL_TYP_DOUBLE : IDL_TYP_FLOAT,
+                                      n_dims <= IDL_MAX_ARRAY_DIM ? (int) n_dims : 1,
+                                      dims, IDL_ARR_INI_NOP, &weighted_var);
+  }
+
+  buffer = (char *) IDL_MemAlloc(info.n_threads * info.n_bins
+                                   * (sizeof(IDL_MEMINT) + (info.weights ? sizeof(double) : 0))
+                                   + (kw.reverse_indices_present ? n_points * sizeof(IDL_MEMINT) : 0),
+                                 "histograms", IDL_MSG_RET);
+  if (buffer == NULL) {
+    if (weights_var && weights_var != kw.weights) IDL_Deltmp(weights_var);
+    if (edges_var && edges_var != kw.edges) IDL_Deltmp(edges_var);
+    if (info.weighted) IDL_Deltmp(weighted_var);
+    IDL_Deltmp(result);
+    IDL_MemFree(params, NULL, IDL_MSG_RET);
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unable to allocate memory for histograms");
+  }
+  info.counts = (IDL_MEMINT *) buffer;
+  memset(info.counts, 0, info.n_threads * info.n_bins * sizeof(IDL_MEMINT));
+  info.sums = NULL;
+  if (info.weights) {
+    info.sums = (double *) (info.counts + info.n_threads * info.n_bins);
+    memset(info.sums, 0, info.n_threads * info.n_bins * sizeof(double));
+  }
+  info.bins = NULL;
+  if (kw.reverse_indices_present) {
+    info.bins = (IDL_MEMINT *) (buffer + info.n_threads * info.n_bins
+                                  * (sizeof(IDL_MEMINT) + (info.weights ? sizeof(double) : 0)));
+  }
+
+  mg_thread_run(info.n_threads, n_points, kernel, &info);
+  mg_thread_run(mg_thread_count(info.n_bins, MG_STATS_MIN_ELTS, kw.n_threads),
+                info.n_bins, mg_hist_merge, &info);
+
+  if (kw.reverse_indices_present) {
+    // like HISTOGRAM: n_bins + 1 offsets, starting after them, then indices
+    for (b = 0, n_in = 0; b < info.n_bins; b++) {
+      for (t = 0; t < info.n_threads; t++) n_in += info.counts[t * info.n_bins + b];
+    }
+    ri_wide = info.wide || info.n_bins + 1 + n_in > 2147483647;
+    buffer = IDL_MakeTempVector(ri_wide ? IDL_TYP_LONG64 : IDL_TYP_LONG,
+                                info.n_bins + 1 + n_in, IDL_ARR_INI_NOP,
+                                &ri_var);
+    offset = info.n_bins + 1;
+    for (b = 0; b < info.n_bins; b++) {
+      if (ri_wide) {
+        ((IDL_LONG64 *) buffer)[b] = offset;
+      } else {
+        ((IDL_LONG *) buffer)[b] = (IDL_LONG) offset;
+      }
+      for (t = 0; t < info.n_threads; t++) {
+        IDL_MEMINT count = info.counts[t * info.n_bins + b];
+        info.counts[t * info.n_bins + b] = offset;
+        offset += count;
+      }
+    }
+    if (ri_wide) {
+      ((IDL_LONG64 *) buffer)[info.n_bins] = offset;
+    } else {
+      ((IDL_LONG *) buffer)[info.n_bins] = (IDL_LONG) offset;
+    }
+
+    info.result = buffer;
+    info.wide = ri_wide;
+    mg_thread_run(info.n_threads, n_points, mg_hist_reverse, &info);
+    IDL_VarCopy(ri_var, kw.reverse_indices);
+  }
+
+  IDL_MemFree(info.counts, NULL, IDL_MSG_RET);
+  if (weights_var && weights_var != kw.weights) IDL_Deltmp(weights_var);
+  if (edges_var && edges_var != kw.edges) IDL_Deltmp(edges_var);
+
+  if (kw.omin_present) mg_hist_store_doubles(kw.omin, info.min, n_dims);
+  if (kw.omax_present) mg_hist_store_doubles(kw.omax, info.max, n_dims);
+  IDL_MemFree(params, NULL, IDL_MSG_RET);
+
+  if (info.weighted) {
+    if (kw.unweighted_present) {
+      IDL_VarCopy(result, kw.unweighted);
+    } else {
+      IDL_Deltmp(result);
+    }
+    result = weighted_var;
+  } else if (kw.unweighted_present) {
+    char *copy = IDL_MakeTempArray(result->type, result->value.arr->n_dim,
+                                   result->value.arr->dim, IDL_ARR_INI_NOP,
+                                   &ri_var);
+    memcpy(copy, result->value.arr->data, result->value.arr->arr_len);
+    IDL_VarCopy(ri_var, kw.unweighted);
+  }
+
+  IDL_KW_FREE;
+
+  return result;
+
+edges_error:
+  if (edges_var != kw.edges) IDL_Deltmp(edges_var);
+  IDL_MemFree(params, NULL, IDL_MSG_RET);
+  IDL_KW_FREE;
+  IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+              "EDGES must be increasing, with NBINS + 1 edges per dimension");
+  return NULL;
+}
+
+
+/**************************************************************************
+  MG_WINDOW_MOMENTS
+***************************************************************************/
+
+/*
+  Moments of the values in a box around each element. The box sums of the
+  powers of the values are separable, so they are computed one dimension at a
+  time with a running sum along each line: each step adds the element
+  entering the box and subtracts the element leaving it, so the cost per
+  element does not depend on the width. Running sums use Neumaier
+  compensation and the values are shifted by their mean before taking
+  powers to keep the cancellation in the central moments small.
+
+  Edges are handled like CONVOL: by default the results for elements whose
+  box does not fit in the array are 0, otherwise the array is extended by
+  mirroring, repeating the edge element, wrapping, or with zeros. Each
+  dimension is extended independently, which gives the same box sums as
+  extending the whole array.
+
+  Non-finite values are not added to the sums but counted as missing; boxes
+  with missing values are NaN unless the NAN keyword is set, in which case
+  the moments are of the remaining values.
+*/
+
+#define MG_MOMENT_EDGE_NONE      0
+#define MG_MOMENT_EDGE_MIRROR    1
+#define MG_MOMENT_EDGE_TRUNCATE  2
+#define MG_MOMENT_EDGE_WRAP      3
+#define MG_MOMENT_EDGE_ZERO      4
+
+// number of lines processed together along dimensions other than the first
+#define MG_MOMENT_LANES          32
+
+// count of values and sums of the first four powers
+#define MG_MOMENT_MAX_CHANNELS   5
+
+#define MG_NEUMAIER_ADD(SUM, C, X) {                                         \
+  double _t = (SUM) + (X);                                                   \
+  if (fabs(SUM) >= fabs(X)) {                                                \
+    (C) += ((SUM) - _t) + (X);                                               \
+  } else {                                                                   \
+    (C) += ((X) - _t) + (SUM);                                               \
+  }                                                                          \
+  (SUM) = _t;                                                                \
+}
+
+typedef struct {
+  char *data;
+  int type;
+  int elt_len;
+  IDL_MEMINT n_elts;
+  IDL_MEMINT n_dims;
+  IDL_MEMINT dims[IDL_MAX_ARRAY_DIM];
+  IDL_MEMINT width[IDL_MAX_ARRAY_DIM];
+  int edge;
+  int nan;
+  int n_channels;          // 1 + highest power needed
+  double shift;            // subtracted from values before taking powers
+  double *sums;            // n_channels arrays of n_elts box sums
+  double *scratch;
+  IDL_MEMINT scratch_size; // doubles per thread
+
+  // current dimension
+  IDL_MEMINT inner;
+  IDL_MEMINT len;
+  IDL_MEMINT w;            // width of the box
+  IDL_MEMINT lanes;
+  IDL_MEMINT n_chunks;
+  IDL_MEMINT *map;         // extended index to index, -1 for zero padding
+  double pad[MG_MOMENT_MAX_CHANNELS];
+
+  // results
+  int result_double;
+  char *mean;
+  char *variance;
+  char *sdev;
+  char *skewness;
+  char *kurtosis;
+} mg_moment_info;
+
+
+// index of the element at index k, which may be outside [0, len), of a
+// dimension extended according to edge; -1 for zero padding
+static IDL_MEMINT mg_moment_extend(IDL_MEMINT k, IDL_MEMINT len, int edge) {
+  if (k >= 0 && k < len) return k;
+
+  switch (edge) {
+    case MG_MOMENT_EDGE_MIRROR:
+      while (k < 0 || k >= len) k = k < 0 ? - k - 1 : 2 * len - k - 1;
+      return k;
+    case MG_MOMENT_EDGE_TRUNCATE:
+      return k < 0 ? 0 : len - 1;
+    case MG_MOMENT_EDGE_WRAP:
+      k %= len;
+      return k < 0 ? k + len : k;
+  }
+
+  return -1;
+}
+
+
+// box sums along the current dimension for chunks of lanes lines
+static void mg_moment_pass(IDL_MEMINT start, IDL_MEMINT end,
+                           int thread_index, void *data) {
+  mg_moment_info *info = (mg_moment_info *) data;
+  IDL_MEMINT len = info->len, inner = info->inner, lanes = info->lanes;
+  IDL_MEMINT w = info->w, s, o, i0, n_lanes, base, c, k, i, t, j;
+  int n_channels = info->n_channels;
+  double *tmp = info->scratch + thread_index * info->scratch_size;
+  double *sum = tmp + n_channels * len * lanes;
+  double *comp = sum + n_channels * lanes;
+  double *line = comp + n_channels * lanes;
+  double *in, *out, x, d, p;
+
+  for (s = start; s < end; s++) {
+    o = s / info->n_chunks;
+    i0 = (s % info->n_chunks) * lanes;
+    n_lanes = inner - i0 < lanes ? inner - i0 : lanes;
+    base = o * len * inner + i0;
+
+    // tmp[c][k][i] is channel c of element k of lane i
+    if (info->data != NULL) {
+      // first dimension: powers of the shifted values of a single line
+      mg_mad_gather(info->type, info->data + base * info->elt_len, 1, len, line);
+      for (k = 0; k < len; k++) {
+        x = line[k];
+        if (x - x != 0.0) {
+          for (c = 0; c < n_channels; c++) tmp[c * len + k] = 0.0;
+          continue;
+        }
+        d = x - info->shift;
+        tmp[k] = 1.0;
+        for (c = 1, p = d; c < n_channels; c++, p *= d) tmp[c * len + k] = p;
+      }
+    } else {
+      for (c = 0; c < n_channels; c++) {
+        in = info->sums + c * info->n_elts + base;
+        for (k = 0; k < len; k++) {
+          for (i = 0; i < n_lanes; i++) {
+            tmp[(c * len + k) * lanes + i] = in[k * inner + i];
+          }
+        }
+      }
+    }
+
+    // running sums over the extended line: element t of the result is the
+    // sum of extended elements t to t + w - 1, i.e., map[t] to map[t + w - 1]
+    for (c = 0; c < n_channels; c++) {
+      in = tmp + c * len * lanes;
+      out = info->sums + c * info->n_elts + base;
+      for (i = 0; i < n_lanes; i++) sum[c * lanes + i] = comp[c * lanes + i] = 0.0;
+      for (j = 0; j < w; j++) {
+        for (i = 0; i < n_lanes; i++) {
+          x = info->map[j] < 0 ? info->pad[c] : in[info->map[j] * lanes + i];
+          MG_NEUMAIER_ADD(sum[c * lanes + i], comp[c * lanes + i], x);
+        }
+      }
+      for (i = 0; i < n_lanes; i++) out[i] = sum[c * lanes + i] + comp[c * lanes + i];
+      for (t = 1; t < len; t++) {
+        for (i = 0; i < n_lanes; i++) {
+          x = info->map[t + w - 1] < 0 ? info->pad[c] : in[info->map[t + w - 1] * lanes + i];
+          MG_NEUMAIER_ADD(sum[c * lanes + i], comp[c * lanes + i], x);
+          x = info->map[t - 1] < 0 ? info->pad[c] : in[info->map[t - 1] * lanes + i];
+          MG_NEUMAIER_ADD(sum[c * lanes + i], comp[c * lanes + i], -x);
+          out[t * inner + i] = sum[c * lanes + i] + comp[c * lanes + i];
+        }
+      }
+    }
+  }
+}
+
+
+// moments from the box sums for lines along the first dimension
+static void mg_moment_combine(IDL_MEMINT start, IDL_MEMINT end,
+                              int thread_index, void *data) {
+  mg_moment_info *info = (mg_moment_info *) data;
+  IDL_MEMINT nx = info->dims[0], s, o, d, x, x0, x1, pos, e, full = 1;
+  double n, s1, s2, s3, s4, m, var, sdev, skew, kurt;
+  double mean_value;
+  int valid;
+
+  for (d = 0; d < info->n_dims; d++) full *= info->width[d];
+
+  for (s = start; s < end; s++) {
+    // by default, only elements whose box fits in the array have results
+    x0 = 0;
+    x1 = nx - 1;
+    if (info->edge == MG_MOMENT_EDGE_NONE) {
+      x0 = info->width[0] / 2;
+      x1 = nx - info->width[0] + info->width[0] / 2;
+      for (d = 1, o = s; d < info->n_dims; d++) {
+        pos = o % info->dims[d];
+        o /= info->dims[d];
+        if (pos < info->width[d] / 2
+              || pos > info->dims[d] - info->width[d] + info->width[d] / 2) {
+          x0 = nx;
+          x1 = -1;
+        }
+      }
+    }
+
+    for (x = 0; x < nx; x++) {
+      e = s * nx + x;
+      mean_value = var = sdev = skew = kurt = 0.0;
+      if (x >= x0 && x <= x1) {
+        n = info->sums[e];
+        valid = info->nan ? n > 0.5 : n > full - 0.5;
+        if (!valid) {
+          mean_value = var = sdev = skew = kurt = MG_STATS_NAN;
+        } else {
+          s1 = info->sums[info->n_elts + e];
+          m = s1 / n;
+          mean_value = info->shift + m;
+          if (info->n_channels > 2) {
+            s2 = info->sums[2 * info->n_elts + e];
+            var = (s2 - s1 * m) / (n - 1.0);
+            if (var < 0.0) var = 0.0;
+            sdev = sqrt(var);
+            if (info->n_channels > 3) {
+              s3 = info->sums[3 * info->n_elts + e];
+              skew = (s3 / n - 3.0 * m * s2 / n + 2.0 * m * m * m) / (sdev * sdev * sdev);
+              if (info->n_channels > 4) {
+                s4 = info->sums[4 * info->n_elts + e];
+                kurt = (s4 / n - 4.0 * m * s3 / n + 6.0 * m * m * s2 / n - 3.0 * m * m * m * m)
+                         / (var * var) - 3.0;
+              }
+            }
+          }
+        }
+      }
+
+      if (info->result_double) {
+        ((double *) info->mean)[e] = mean_value;
+        if (info->variance) ((double *) info->variance)[e] = var;
+        if (info->sdev) ((double *) info->sdev)[e] = sdev;
+        if (info->skewness) ((double *) info->skewness)[e] = skew;
+        if (info->kurtosis) ((double *) info->kurtosis)[e] = kurt;
+      } else {
+        ((float *) info->mean)[e] = (float) mean_value;
+        if (info->variance) ((float *) info->variance)[e] = (float) var;
+        if (info->sdev) ((float *) info->sdev)[e] = (float) sdev;
+        if (info->skewness) ((float *) info->skewness)[e] = (float) skew;
+        if (info->kurtosis) ((float *) info->kurtosis)[e] = (float) kurt;
+      }
+    }
+  }
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_window_moments(int argc, IDL_VPTR *argv, char *argk) {
+  IDL_VPTR image = argv[0], result, outputs[4] = { NULL, NULL, NULL, NULL };
+  IDL_ARRAY *arr;
+  mg_moment_info info;
+  IDL_MEMINT d, k, i, max_len = 0, max_w = 0, block = 4096, n_finite = 0, n;
+  double widths[IDL_MAX_ARRAY_DIM], *line, total = 0.0, prod_w = 1.0, p;
+  char **output_data[4];
+  int nargs, n_threads, nthreads, c, n_edges, present[4];
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_LONG double_kw;
+    IDL_LONG edge_mirror;
+    IDL_LONG edge_truncate;
+    IDL_LONG edge_wrap;
+    IDL_LONG edge_zero;
+    IDL_VPTR kurtosis;
+    int kurtosis_present;
+    IDL_LONG nan;
+    IDL_LONG n_threads;
+    IDL_VPTR sdev;
+    int sdev_present;
+    IDL_VPTR skewness;
+    int skewness_present;
+    IDL_VPTR variance;
+    int variance_present;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "DOUBLE", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(double_kw) },
+    { "EDGE_MIRROR", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(edge_mirror) },
+    { "EDGE_TRUNCATE", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(edge_truncate) },
+    { "EDGE_WRAP", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(edge_wrap) },
+    { "EDGE_ZERO", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(edge_zero) },
+    { "KURTOSIS", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(kurtosis_present), IDL_KW_OFFSETOF(kurtosis) },
+    { "NAN", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(nan) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { "SDEV", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(sdev_present), IDL_KW_OFFSETOF(sdev) },
+    { "SKEWNESS", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(skewness_present), IDL_KW_OFFSETOF(skewness) },
+    { "VARIANCE", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(variance_present), IDL_KW_OFFSETOF(variance) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+  n_threads = kw.n_threads;
+  info.nan = kw.nan != 0;
+  n_edges = (kw.edge_mirror != 0) + (kw.edge_truncate != 0)
+              + (kw.edge_wrap != 0) + (kw.edge_zero != 0);
+  info.edge = kw.edge_mirror ? MG_MOMENT_EDGE_MIRROR
+                : kw.edge_truncate ? MG_MOMENT_EDGE_TRUNCATE
+                : kw.edge_wrap ? MG_MOMENT_EDGE_WRAP
+                : kw.edge_zero ? MG_MOMENT_EDGE_ZERO
+                : MG_MOMENT_EDGE_NONE;
+  present[0] = kw.variance_present;
+  present[1] = kw.sdev_present;
+  present[2] = kw.skewness_present;
+  present[3] = kw.kurtosis_present;
+
+  IDL_ENSURE_SIMPLE(image);
+  IDL_ENSURE_ARRAY(image);
+  arr = image->value.arr;
+
+  if (!mg_stats_is_real(image->type)) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "unsupported type");
+  }
+  if (n_edges > 1) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "only one EDGE_* keyword may be set");
+  }
+
+  info.n_dims = arr->n_dim;
+  IDL_ENSURE_SIMPLE(argv[1]);
+  if (mg_hist_param(argv[1], info.n_dims, widths) < 0) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "width must be a scalar or have an element for each dimension");
+  }
+  for (d = 0; d < info.n_dims; d++) {
+    info.dims[d] = arr->dim[d];
+    info.width[d] = (IDL_MEMINT) widths[d];
+    if (info.width[d] < 1) {
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "width must be positive");
+    }
+    if (info.dims[d] > max_len) max_len = info.dims[d];
+    if (info.width[d] > max_w) max_w = info.width[d];
+  }
+
+  info.data = (char *) arr->data;
+  info.type = image->type;
+  info.elt_len = arr->elt_len;
+  info.n_elts = arr->n_elts;
+  info.result_double = kw.double_kw || image->type == IDL_TYP_DOUBLE;
+  info.n_channels = kw.kurtosis_present ? 5
+                      : kw.skewness_present ? 4
+                      : (kw.variance_present || kw.sdev_present) ? 3
+                      : 2;
+
+  nthreads = mg_thread_count(info.n_elts, MG_STATS_MIN_ELTS, n_threads);
+  info.scratch_size = MG_STATS_ALIGN(info.n_channels * (max_len + 2) * MG_MOMENT_LANES + max_len);
+  info.sums = (double *) IDL_MemAlloc((info.n_channels * info.n_elts
+                                         + nthreads * info.scratch_size) * sizeof(double)
+                                        + (max_len + max_w) * sizeof(IDL_MEMINT),
+                                      "window moments", IDL_MSG_RET);
+  if (info.sums == NULL) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unable to allocate memory for window moments");
+  }
+  info.scratch = info.sums + info.n_channels * info.n_elts;
+  info.map = (IDL_MEMINT *) (info.scratch + nthreads * info.scratch_size);
+
+  // shift by the mean of the finite values, in blocks that fit in the scratch
+  // space of the threads
+  line = info.scratch;
+  if (block > nthreads * info.scratch_size) block = nthreads * info.scratch_size;
+  for (k = 0; k < info.n_elts; k += block) {
+    n = info.n_elts - k < block ? info.n_elts - k : block;
+    mg_mad_gather(info.type, info.data + k * info.elt_len, 1, n, line);
+    for (i = 0; i < n; i++) {
+      if (line[i] - line[i] != 0.0) continue;
+      total += line[i];
+      n_finite++;
+    }
+  }
+  info.shift = n_finite > 0 ? total / n_finite : 0.0;
+
+  // one pass per dimension, the first from the image, the rest in place
+  for (d = 0; d < info.n_dims; d++) {
+    info.len = info.dims[d];
+    info.w = info.width[d];
+    info.inner = d == 0 ? 1 : info.inner * info.dims[d - 1];
+    info.lanes = d == 0 ? 1 : MG_MOMENT_LANES;
+    info.n_chunks = (info.inner + info.lanes - 1) / info.lanes;
+    for (k = 0; k < info.len + info.w - 1; k++) {
+      info.map[k] = mg_moment_extend(k - info.w / 2, info.len, info.edge);
+    }
+
+    // zero padding is a box of prod_w zeros of the previous dimensions
+    for (c = 0, p = 1.0; c < info.n_channels; c++, p *= - info.shift) {
+      info.pad[c] = prod_w * p;
+    }
+    prod_w *= info.w;
+
+    if (d == 1) info.data = NULL;
+    mg_thread_run(nthreads, info.n_elts / (info.len * info.inner) * info.n_chunks,
+                  mg_moment_pass, &info);
+  }
+
+  // results
+  info.mean = IDL_MakeTempArray(info.result_double ? IDL_TYP_DOUBLE : IDL_TYP_FLOAT,
+                                arr->n_dim, arr->dim, IDL_ARR_INI_NOP, &result);
+  output_data[0] = &info.variance;
+  output_data[1] = &info.sdev;
+  output_data[2] = &info.skewness;
+  output_data[3] = &info.kurtosis;
+  for (c = 0; c < 4; c++) {
+    *output_data[c] = NULL;
+    if (present[c]) {
+      *output_data[c] = IDL_MakeTempArray(info.result_double ? IDL_TYP_DOUBLE : IDL_TYP_FLOAT,
+                                          arr->n_dim, arr->dim, IDL_ARR_INI_NOP,
+                                          &outputs[c]);
+    }
+  }
+
+  mg_thread_run(nthreads, info.n_elts / info.dims[0], mg_moment_combine, &info);
+
+  IDL_MemFree(info.sums, NULL, IDL_MSG_RET);
+
+  if (present[0]) IDL_VarCopy(outputs[0], kw.variance);
+  if (present[1]) IDL_VarCopy(outputs[1], kw.sdev);
+  if (present[2]) IDL_VarCopy(outputs[2], kw.skewness);
+  if (present[3]) IDL_VarCopy(outputs[3], kw.kurtosis);
+
+  IDL_KW_FREE;
+
+  return result;
+}
+
+
+/**************************************************************************
+  MG_KDTREE_BUILD, MG_KDTREE_QUERY, and MG_KDTREE_QUERY_RADIUS
+***************************************************************************/
+
+/*
+  A k-d tree for nearest neighbor searches. The tree is returned to IDL as a
+  byte array holding a header, the permutation of the samples, and, for each
+  node, the range of the permutation it contains and its bounding box,
+  followed by a copy of the samples in tree order. So a tree is built once
+  and can then be queried any number of times, stored in a variable or an
+  object, and saved with SAVE (on a machine with the same byte order).
+
+  Nodes are split at the median of their widest dimension until they have at
+  most LEAF_SIZE samples. Splitting at the median makes a complete binary
+  tree, so nodes are stored in level order with the children of node i at
+  2 i + 1 and 2 i + 2, and all nodes of a level can be built concurrently.
+
+  The bounding boxes give a lower bound on the distance from a query to any
+  sample in a node for Euclidean, Manhattan, and Chebyshev distances, so the
+  same tree serves all three metrics. Queries are split between threads;
+  results are sorted by distance, then by index, like a brute force search.
+*/
+
+#define MG_KDTREE_MAGIC      0x4D474B44
+#define MG_KDTREE_VERSION    1
+#define MG_KDTREE_HEADER     8
+#define MG_KDTREE_LEAF_SIZE  16
+#define MG_KDTREE_MAX_DEPTH  64
+#define MG_KDTREE_MIN_QUERIES 64
+
+#define MG_METRIC_EUCLIDEAN  0
+#define MG_METRIC_MANHATTAN  1
+#define MG_METRIC_CHEBYSHEV  2
+
+static char *mg_metrics[] = { "euclidean", "manhattan", "chebyshev", NULL };
+
+typedef struct {
+  IDL_LONG64 *header;
+  IDL_MEMINT n_features;
+  IDL_MEMINT n_samples;
+  IDL_MEMINT n_nodes;
+  IDL_LONG64 *index;       // sample of each position in tree order
+  IDL_LONG64 *start;       // first position of each node
+  IDL_LONG64 *end;         // one past the last position of each node
+  double *lo;              // bounding box of each node, n_features per node
+  double *hi;
+  double *points;          // samples in tree order
+} mg_kdtree;
+
+typedef struct {
+  mg_kdtree tree;
+  double *x;               // samples to build from
+  IDL_MEMINT level_start;  // first node of the level being built
+} mg_kdtree_build_info;
+
+typedef struct {
+  double dist;
+  IDL_LONG64 index;
+} mg_kdtree_neighbor;
+
+typedef struct {
+  mg_kdtree_neighbor *items;
+  IDL_MEMINT n;
+  IDL_MEMINT size;
+} mg_kdtree_list;
+
+typedef struct {
+  mg_kdtree tree;
+  double *queries;
+  IDL_MEMINT n_queries;
+  int metric;
+  IDL_MEMINT k;            // number of neighbors
+  double radius;           // radius in reduced distance
+  mg_kdtree_neighbor *neighbors;       // k per query
+  IDL_LONG64 *counts;                  // number of neighbors per query
+  mg_kdtree_list lists[MG_THREADS_MAX];
+  int failed;
+} mg_kdtree_query_info;
+
+
+static IDL_MEMINT mg_kdtree_size(IDL_MEMINT n_features, IDL_MEMINT n_samples,
+                                 IDL_MEMINT n_nodes) {
+  return (MG_KDTREE_HEADER + n_samples + 2 * n_nodes) * sizeof(IDL_LONG64)
+           + (2 * n_nodes + n_samples) * n_features * sizeof(double);
+}
+
+
+// point the fields of tree into the data of a tree array
+static void mg_kdtree_layout(mg_kdtree *tree, char *data) {
+  tree->header = (IDL_LONG64 *) data;
+  tree->n_features = (IDL_MEMINT) tree->header[2];
+  tree->n_samples = (IDL_MEMINT) tree->header[3];
+  tree->n_nodes = (IDL_MEMINT) tree->header[4];
+  tree->index = tree->header + MG_KDTREE_HEADER;
+  tree->start = tree->index + tree->n_samples;
+  tree->end = tree->start + tree->n_nodes;
+  tree->lo = (double *) (tree->end + tree->n_nodes);
+  tree->hi = tree->lo + tree->n_nodes * tree->n_features;
+  tree->points = tree->hi + tree->n_nodes * tree->n_features;
+}
+
+
+// check that var is a tree made by MG_KDTREE_BUILD and lay it out
+static void mg_kdtree_get(IDL_VPTR var, mg_kdtree *tree) {
+  IDL_LONG64 *header;
+  IDL_MEMINT n;
+
+  if (var->type != IDL_TYP_BYTE || !(var->flags & IDL_V_ARR)
+        || var->value.arr->n_elts < MG_KDTREE_HEADER * sizeof(IDL_LONG64)) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "tree must be a byte array returned by MG_KDTREE_BUILD");
+  }
+  header = (IDL_LONG64 *) var->value.arr->data;
+  n = var->value.arr->n_elts;
+  if (header[0] != MG_KDTREE_MAGIC || header[1] != MG_KDTREE_VERSION
+        || header[2] < 1 || header[3] < 1 || header[4] < 1
+        || mg_kdtree_size(header[2], header[3], header[4]) != n) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "invalid tree, not made by this version of MG_KDTREE_BUILD");
+  }
+  mg_kdtree_layout(tree, (char *) header);
+}
+
+
+// reorder index[lo:hi - 1] so that index[k] has the k-th smallest value of
+// dimension d of the samples x, with smaller or equal values before it
+static void mg_kdtree_select(IDL_LONG64 *index, IDL_MEMINT lo, IDL_MEMINT hi,
+                             IDL_MEMINT k, double *x, IDL_MEMINT n_features,
+                             IDL_MEMINT d) {
+  IDL_MEMINT i, j, mid;
+  double pivot;
+
+#define MG_KDTREE_VALUE(j) (x[index[j] * n_features + d])
+
+  while (hi - lo > 1) {
+    // median of 3 pivot
+    mid = lo + (hi - lo) / 2;
+    if (MG_KDTREE_VALUE(mid) < MG_KDTREE_VALUE(lo)) MG_SWAP(IDL_LONG64, index[mid], index[lo]);
+    if (MG_KDTREE_VALUE(hi - 1) < MG_KDTREE_VALUE(lo)) MG_SWAP(IDL_LONG64, index[hi - 1], index[lo]);
+    if (MG_KDTREE_VALUE(hi - 1) < MG_KDTREE_VALUE(mid)) MG_SWAP(IDL_LONG64, index[hi - 1], index[mid]);
+    pivot = MG_KDTREE_VALUE(mid);
+
+    // Hoare partition
+    i = lo;
+    j = hi - 1;
+    while (i <= j) {
+      while (MG_KDTREE_VALUE(i) < pivot) i++;
+      while (MG_KDTREE_VALUE(j) > pivot) j--;
+      if (i <= j) {
+        MG_SWAP(IDL_LONG64, index[i], index[j]);
+        i++;
+        j--;
+      }
+    }
+
+    if (k <= j) {
+      hi = j + 1;
+    } else if (k >= i) {
+      lo = i;
+    } else {
+      return;
+    }
+  }
+
+#undef MG_KDTREE_VALUE
+}
+
+
+// bounding box and split of the nodes [start, end) of the current level
+static void mg_kdtree_build_level(IDL_MEMINT start, IDL_MEMINT end,
+                                  int thread_index, void *data) {
+  mg_kdtree_build_info *info = (mg_kdtree_build_info *) data;
+  mg_kdtree *tree = &info->tree;
+  IDL_MEMINT node, i, d, split_d, mid, nf = tree->n_features;
+  double *lo, *hi, *p, width, max_width;
+
+  for (node = info->level_start + start; node < info->level_start + end; node++) {
+    lo = tree->lo + node * nf;
+    hi = tree->hi + node * nf;
+    p = info->x + tree->index[tree->start[node]] * nf;
+    for (d = 0; d < nf; d++) lo[d] = hi[d] = p[d];
+    for (i = tree->start[node] + 1; i < tree->end[node]; i++) {
+      p = info->x + tree->index[i] * nf;
+      for (d = 0; d < nf; d++) {
+        if (p[d] < lo[d]) lo[d] = p[d];
+        if (p[d] > hi[d]) hi[d] = p[d];
+      }
+    }
+
+    if (2 * node + 1 >= tree->n_nodes) continue;
+
+    for (d = 0, split_d = 0, max_width = -1.0; d < nf; d++) {
+      width = hi[d] - lo[d];
+      if (width > max_width) {
+        max_width = width;
+        split_d = d;
+      }
+    }
+
+    mid = tree->start[node] + (tree->end[node] - tree->start[node]) / 2;
+    mg_kdtree_select(tree->index, tree->start[node], tree->end[node], mid,
+                     info->x, nf, split_d);
+    tree->start[2 * node + 1] = tree->start[node];
+    tree->end[2 * node + 1] = mid;
+    tree->start[2 * node + 2] = mid;
+    tree->end[2 * node + 2] = tree->end[node];
+  }
+}
+
+
+// reduced distance between two points: squared for Euclidean distances
+static inline double mg_kdtree_dist(double *a, double *b, IDL_MEMINT n, int metric) {
+  IDL_MEMINT d;
+  double diff, dist = 0.0;
+
+  switch (metric) {
+    case MG_METRIC_EUCLIDEAN:
+      for (d = 0; d < n; d++) {
+        diff = a[d] - b[d];
+        dist += diff * diff;
+      }
+      break;
+    case MG_METRIC_MANHATTAN:
+      for (d = 0; d < n; d++) dist += fabs(a[d] - b[d]);
+      break;
+    case MG_METRIC_CHEBYSHEV:
+      for (d = 0; d < n; d++) {
+        diff = fabs(a[d] - b[d]);
+        if (diff > dist) dist = diff;
+      }
+      break;
+  }
+
+  return dist;
+}
+
+
+// reduced distance from a point to the closest point of a box
+static inline double mg_kdtree_box_dist(double *q, double *lo, double *hi,
+                                        IDL_MEMINT n, int metric) {
+  IDL_MEMINT d;
+  double gap, dist = 0.0;
+
+  for (d = 0; d < n; d++) {
+    gap = q[d] < lo[d] ? lo[d] - q[d] : (q[d] > hi[d] ? q[d] - hi[d] : 0.0);
+    switch (metric) {
+      case MG_METRIC_EUCLIDEAN: dist += gap * gap; break;
+      case MG_METRIC_MANHATTAN: dist += gap; break;
+      case MG_METRIC_CHEBYSHEV: if (gap > dist) dist = gap; break;
+    }
+  }
+
+  return dist;
+}
+
+
+#define MG_KDTREE_LESS(a, b) \
+  ((a).dist < (b).dist || ((a).dist == (b).dist && (a).index < (b).index))
+
+static int mg_kdtree_compare(const void *a, const void *b) {
+  const mg_kdtree_neighbor *na = (const mg_kdtree_neighbor *) a;
+  const mg_kdtree_neighbor *nb = (const mg_kdtree_neighbor *) b;
+  if (MG_KDTREE_LESS(*na, *nb)) return -1;
+  if (MG_KDTREE_LESS(*nb, *na)) return 1;
+  return 0;
+}
+
+
+// restore the max heap property of heap[0:n - 1] after changing heap[0]
+static void mg_kdtree_sift_down(mg_kdtree_neighbor *heap, IDL_MEMINT n) {
+  IDL_MEMINT i = 0, child;
+  mg_kdtree_neighbor tmp;
+
+  while ((child = 2 * i + 1) < n) {
+    if (child + 1 < n && MG_KDTREE_LESS(heap[child], heap[child + 1])) child++;
+    if (!MG_KDTREE_LESS(heap[i], heap[child])) break;
+    tmp = heap[i];
+    heap[i] = heap[child];
+    heap[child] = tmp;
+    i = child;
+  }
+}
+
+
+// add to the max heap of the k nearest neighbors found so far
+static void mg_kdtree_push(mg_kdtree_neighbor *heap, IDL_MEMINT *n,
+                           IDL_MEMINT k, mg_kdtree_neighbor item) {
+  IDL_MEMINT i, parent;
+
+  if (*n < k) {
+    i = (*n)++;
+    while (i > 0) {
+      parent = (i - 1) / 2;
+      if (!MG_KDTREE_LESS(heap[parent], item)) break;
+      heap[i] = heap[parent];
+      i = parent;
+    }
+    heap[i] = item;
+  } else if (MG_KDTREE_LESS(item, heap[0])) {
+    heap[0] = item;
+    mg_kdtree_sift_down(heap, k);
+  }
+}
+
+
+// k nearest neighbors, or all neighbors within radius if k is 0
+static void mg_kdtree_query_work(IDL_MEMINT start, IDL_MEMINT end,
+                                 int thread_index, void *data) {
+  mg_kdtree_query_info *info = (mg_kdtree_query_info *) data;
+  mg_kdtree *tree = &info->tree;
+  mg_kdtree_list *list = &info->lists[thread_index];
+  mg_kdtree_neighbor *heap, item, *items;
+  IDL_MEMINT stack[MG_KDTREE_MAX_DEPTH + 2], n_stack, q, node, i, n_found, near, far;
+  IDL_MEMINT nf = tree->n_features, first;
+  double *query, bound;
+
+  for (q = start; q < end; q++) {
+    query = info->queries + q * nf;
+    heap = info->neighbors + q * info->k;
+    n_found = 0;
+    first = list->n;
+
+    n_stack = 0;
+    stack[n_stack++] = 0;
+    while (n_stack > 0) {
+      node = stack[--n_stack];
+      bound = mg_kdtree_box_dist(query, tree->lo + node * nf, tree->hi + node * nf,
+                                 nf, info->metric);
+      if (info->k > 0) {
+        if (n_found == info->k && bound > heap[0].dist) continue;
+      } else if (bound > info->radius) {
+        continue;
+      }
+
+      if (2 * node + 1 < tree->n_nodes) {
+        // visit the child closer to the query first
+        near = 2 * node + 1;
+        far = 2 * node + 2;
+        if (mg_kdtree_box_dist(query, tree->lo + far * nf, tree->hi + far * nf, nf, info->metric)
+              < mg_kdtree_box_dist(query, tree->lo + near * nf, tree->hi + near * nf, nf, info->metric)) {
+          near = 2 * node + 2;
+          far = 2 * node + 1;
+        }
+        stack[n_stack++] = far;
+        stack[n_stack++] = near;
+        continue;
+      }
+
+      for (i = tree->start[node]; i < tree->end[node]; i++) {
+        item.dist = mg_kdtree_dist(query, tree->points + i * nf, nf, info->metric);
+        item.index = tree->index[i];
+        if (info->k > 0) {
+          mg_kdtree_push(heap, &n_found, info->k, item);
+        } else if (item.dist <= info->radius) {
+          if (list->n == list->size) {
+            list->size = list->size == 0 ? 1024 : 2 * list->size;
+            items = (mg_kdtree_neighbor *) realloc(list->items,
+                                                   list->size * sizeof(mg_kdtree_neighbor));
+            if (items == NULL) {
+              info->failed = 1;
+              return;
+            }
+            list->items = items;
+          }
+          list->items[list->n++] = item;
+        }
+      }
+    }
+
+    if (info->k > 0) {
+      qsort(heap, info->k, sizeof(mg_kdtree_neighbor), mg_kdtree_compare);
+    } else {
+      qsort(list->items + first, list->n - first, sizeof(mg_kdtree_neighbor),
+            mg_kdtree_compare);
+      info->counts[q] = list->n - first;
+    }
+  }
+}
+
+
+// actual distance from a reduced distance
+static double mg_kdtree_unreduce(double dist, int metric) {
+  return metric == MG_METRIC_EUCLIDEAN ? sqrt(dist) : dist;
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_kdtree_build(int argc, IDL_VPTR *argv, char *argk) {
+  IDL_VPTR x = argv[0], x_dbl, result;
+  IDL_ARRAY *arr;
+  mg_kdtree_build_info info;
+  IDL_MEMINT n_features, n_samples, leaf_size, depth, n_nodes, i, level, n_level;
+  char *data;
+  int nargs, n_threads;
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_LONG leaf_size;
+    int leaf_size_present;
+    IDL_LONG n_threads;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "LEAF_SIZE", IDL_TYP_LONG, 1, 0,
+      IDL_KW_OFFSETOF(leaf_size_present), IDL_KW_OFFSETOF(leaf_size) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+  leaf_size = kw.leaf_size_present ? kw.leaf_size : MG_KDTREE_LEAF_SIZE;
+  n_threads = kw.n_threads;
+  IDL_KW_FREE;
+
+  if (leaf_size < 1) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "LEAF_SIZE must be positive");
+  }
+
+  IDL_ENSURE_SIMPLE(x);
+  IDL_ENSURE_ARRAY(x);
+  if (!mg_stats_is_real(x->type) || x->value.arr->n_dim > 2) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "x must be a non-complex numeric (n_features, n_samples) array");
+  }
+  arr = x->value.arr;
+  n_features = arr->n_dim == 2 ? arr->dim[0] : 1;
+  n_samples = arr->n_elts / n_features;
+
+  x_dbl = x->type == IDL_TYP_DOUBLE ? x : IDL_CvtDbl(1, &x, NULL);
+  info.x = (double *) x_dbl->value.arr->data;
+  for (i = 0; i < arr->n_elts; i++) {
+    if (info.x[i] - info.x[i] != 0.0) {
+      if (x_dbl != x) IDL_Deltmp(x_dbl);
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "x must not contain NaN or infinite values");
+    }
+  }
+
+  // complete tree deep enough that the leaves have at most leaf_size samples
+  for (depth = 0; (n_samples + ((IDL_MEMINT) 1 << depth) - 1) >> depth > leaf_size; depth++);
+  n_nodes = ((IDL_MEMINT) 2 << depth) - 1;
+
+  data = (char *) IDL_MakeTempVector(IDL_TYP_BYTE,
+                                     mg_kdtree_size(n_features, n_samples, n_nodes),
+                                     IDL_ARR_INI_NOP, &result);
+  info.tree.header = (IDL_LONG64 *) data;
+  info.tree.header[0] = MG_KDTREE_MAGIC;
+  info.tree.header[1] = MG_KDTREE_VERSION;
+  info.tree.header[2] = n_features;
+  info.tree.header[3] = n_samples;
+  info.tree.header[4] = n_nodes;
+  info.tree.header[5] = leaf_size;
+  info.tree.header[6] = info.tree.header[7] = 0;
+  mg_kdtree_layout(&info.tree, data);
+
+  for (i = 0; i < n_samples; i++) info.tree.index[i] = i;
+  info.tree.start[0] = 0;
+  info.tree.end[0] = n_samples;
+
+  // nodes of a level cover disjoint parts of the permutation
+  for (level = 0; level <= depth; level++) {
+    info.level_start = ((IDL_MEMINT) 1 << level) - 1;
+    n_level = (IDL_MEMINT) 1 << level;
+    mg_thread_run(mg_thread_count(n_samples, MG_STATS_MIN_ELTS, n_threads) < n_level
+                    ? mg_thread_count(n_samples, MG_STATS_MIN_ELTS, n_threads)
+                    : (int) n_level,
+                  n_level, mg_kdtree_build_level, &info);
+  }
+
+  for (i = 0; i < n_samples; i++) {
+    memcpy(info.tree.points + i * n_features, info.x + info.tree.index[i] * n_features,
+           n_features * sizeof(double));
+  }
+
+  if (x_dbl != x) IDL_Deltmp(x_dbl);
+
+  return result;
+}
+
+
+// shared setup of queries: tree, queries as doubles, and metric
+static IDL_VPTR mg_kdtree_queries(IDL_VPTR *argv, mg_kdtree_query_info *info,
+                                  int metric_present, IDL_STRING *metric) {
+  IDL_VPTR xi = argv[1], xi_dbl;
+  char *name, lower[16];
+  int i;
+
+  mg_kdtree_get(argv[0], &info->tree);
+
+  info->metric = MG_METRIC_EUCLIDEAN;
+  if (metric_present) {
+    name = IDL_STRING_STR(metric);
+    for (i = 0; name[i] && i < 15; i++) lower[i] = (char) tolower(name[i]);
+    lower[i] = '\0';
+    for (info->metric = 0; mg_metrics[info->metric]; info->metric++) {
+      if (strcmp(lower, mg_metrics[info->metric]) == 0) break;
+    }
+    if (mg_metrics[info->metric] == NULL) {
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "unknown metric %s", name);
+    }
+  }
+
+  IDL_ENSURE_SIMPLE(xi);
+  if (!mg_stats_is_real(xi->type)) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "xi must be a non-complex numeric (n_features, n_queries) array");
+  }
+  xi_dbl = xi->type == IDL_TYP_DOUBLE ? xi : IDL_CvtDbl(1, &xi, NULL);
+  if (xi_dbl->flags & IDL_V_ARR) {
+    info->queries = (double *) xi_dbl->value.arr->data;
+    info->n_queries = xi_dbl->value.arr->n_elts / info->tree.n_features;
+    if (xi_dbl->value.arr->n_elts % info->tree.n_features != 0
+          || (xi_dbl->value.arr->n_dim > 1 && xi_dbl->value.arr->dim[0] != info->tree.n_features)) {
+      if (xi_dbl != xi) IDL_Deltmp(xi_dbl);
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "xi must have the same number of features as the tree");
+    }
+  } else {
+    if (info->tree.n_features != 1) {
+      if (xi_dbl != xi) IDL_Deltmp(xi_dbl);
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "xi must have the same number of features as the tree");
+    }
+    info->queries = &xi_dbl->value.d;
+    info->n_queries = 1;
+  }
+  info->failed = 0;
+
+  return xi_dbl;
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_kdtree_query(int argc, IDL_VPTR *argv, char *argk) {
+  IDL_VPTR xi_dbl, result, distances;
+  mg_kdtree_query_info info;
+  IDL_MEMINT i, dims[2], n;
+  char *data;
+  double *dist_data;
+  int nargs, wide, nthreads;
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_VPTR distances;
+    int distances_present;
+    IDL_STRING metric;
+    int metric_present;
+    IDL_LONG n_threads;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "DISTANCES", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(distances_present), IDL_KW_OFFSETOF(distances) },
+    { "METRIC", IDL_TYP_STRING, 1, 0,
+      IDL_KW_OFFSETOF(metric_present), IDL_KW_OFFSETOF(metric) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+
+  xi_dbl = mg_kdtree_queries(argv, &info, kw.metric_present, &kw.metric);
+  info.k = IDL_LongScalar(argv[2]);
+  if (info.k < 1 || info.k > info.tree.n_samples) {
+    if (xi_dbl != argv[1]) IDL_Deltmp(xi_dbl);
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "k must be between 1 and the number of samples");
+  }
+
+  info.neighbors = (mg_kdtree_neighbor *) IDL_MemAlloc(info.n_queries * info.k * sizeof(mg_kdtree_neighbor),
+                                                       "k-d tree neighbors", IDL_MSG_RET);
+  if (info.neighbors == NULL) {
+    if (xi_dbl != argv[1]) IDL_Deltmp(xi_dbl);
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unable to allocate memory for neighbors");
+  }
+
+  nthreads = mg_thread_count(info.n_queries, MG_KDTREE_MIN_QUERIES, kw.n_threads);
+  mg_thread_run(nthreads, info.n_queries, mg_kdtree_query_work, &info);
+
+  // lonarr(k, n_queries), or lonarr(k) for a single query
+  dims[0] = info.k;
+  dims[1] = info.n_queries;
+  n = info.k * info.n_queries;
+  wide = info.tree.n_samples > 2147483647;
+  data = IDL_MakeTempArray(wide ? IDL_TYP_LONG64 : IDL_TYP_LONG,
+                           info.n_queries > 1 ? 2 : 1, dims, IDL_ARR_INI_NOP, &result);
+  for (i = 0; i < n; i++) {
+    if (wide) {
+      ((IDL_LONG64 *) data)[i] = info.neighbors[i].index;
+    } else {
+      ((IDL_LONG *) data)[i] = (IDL_LONG) info.neighbors[i].index;
+    }
+  }
+
+  if (kw.distances_present) {
+    dist_data = (double *) IDL_MakeTempArray(IDL_TYP_DOUBLE, info.n_queries > 1 ? 2 : 1,
+                                             dims, IDL_ARR_INI_NOP, &distances);
+    for (i = 0; i < n; i++) {
+      dist_data[i] = mg_kdtree_unreduce(info.neighbors[i].dist, info.metric);
+    }
+    IDL_VarCopy(distances, kw.distances);
+  }
+
+  IDL_MemFree(info.neighbors, NULL, IDL_MSG_RET);
+  if (xi_dbl != argv[1]) IDL_Deltmp(xi_dbl);
+  IDL_KW_FREE;
+
+  return result;
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_kdtree_query_radius(int argc, IDL_VPTR *argv, char *argk) {
+  IDL_VPTR xi_dbl, result, offsets, distances;
+  mg_kdtree_query_info info;
+  mg_kdtree_list *list;
+  IDL_MEMINT i, q, total, pos;
+  char *data, *offsets_data;
+  double *dist_data = NULL, radius;
+  int nargs, wide, nthreads, t;
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_VPTR count;
+    int count_present;
+    IDL_VPTR distances;
+    int distances_present;
+    IDL_STRING metric;
+    int metric_present;
+    IDL_LONG n_threads;
+    IDL_VPTR offsets;
+    int offsets_present;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "COUNT", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(count_present), IDL_KW_OFFSETOF(count) },
+    { "DISTANCES", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(distances_present), IDL_KW_OFFSETOF(distances) },
+    { "METRIC", IDL_TYP_STRING, 1, 0,
+      IDL_KW_OFFSETOF(metric_present), IDL_KW_OFFSETOF(metric) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { "OFFSETS", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(offsets_present), IDL_KW_OFFSETOF(offsets) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+
+  xi_dbl = mg_kdtree_queries(argv, &info, kw.metric_present, &kw.metric);
+  radius = IDL_DoubleScalar(argv[2]);
+  if (radius < 0.0) {
+    if (xi_dbl != argv[1]) IDL_Deltmp(xi_dbl);
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "radius must not be negative");
+  }
+  info.radius = info.metric == MG_METRIC_EUCLIDEAN ? radius * radius : radius;
+  info.k = 0;
+  info.neighbors = NULL;
+
+  info.counts = (IDL_LONG64 *) IDL_MemAlloc(info.n_queries * sizeof(IDL_LONG64),
+                                            "k-d tree counts", IDL_MSG_RET);
+  if (info.counts == NULL) {
+    if (xi_dbl != argv[1]) IDL_Deltmp(xi_dbl);
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unable to allocate memory for neighbor counts");
+  }
+
+  // each thread collects the neighbors of its queries, in order
+  nthreads = mg_thread_count(info.n_queries, MG_KDTREE_MIN_QUERIES, kw.n_threads);
+  for (t = 0; t < nthreads; t++) {
+    info.lists[t].items = NULL;
+    info.lists[t].n = info.lists[t].size = 0;
+  }
+  mg_thread_run(nthreads, info.n_queries, mg_kdtree_query_work, &info);
+
+  if (info.failed) {
+    for (t = 0; t < nthreads; t++) free(info.lists[t].items);
+    IDL_MemFree(info.counts, NULL, IDL_MSG_RET);
+    if (xi_dbl != argv[1]) IDL_Deltmp(xi_dbl);
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unable to allocate memory for neighbors");
+  }
+
+  for (t = 0, total = 0; t < nthreads; t++) total += info.lists[t].n;
+  wide = info.tree.n_samples > 2147483647 || total > 2147483647;
+
+  // offsets into the result of the neighbors of each query
+  offsets_data = IDL_MakeTempVector(wide ? IDL_TYP_LONG64 : IDL_TYP_LONG,
+                                    info.n_queries + 1, IDL_ARR_INI_NOP, &offsets);
+  for (q = 0, pos = 0; q <= info.n_queries; q++) {
+    if (wide) {
+      ((IDL_LONG64 *) offsets_data)[q] = pos;
+    } else {
+      ((IDL_LONG *) offsets_data)[q] = (IDL_LONG) pos;
+    }
+    if (q < info.n_queries) pos += info.counts[q];
+  }
+
+  if (total == 0) {
+    result = IDL_GettmpLong(-1);
+  } else {
+    data = IDL_MakeTempVector(wide ? IDL_TYP_LONG64 : IDL_TYP_LONG, total,
+                              IDL_ARR_INI_NOP, &result);
+    if (kw.distances_present) {
+      dist_data = (double *) IDL_MakeTempVector(IDL_TYP_DOUBLE, total,
+                                                IDL_ARR_INI_NOP, &distances);
+    }
+    for (t = 0, pos = 0; t < nthreads; t++) {
+      list = &info.lists[t];
+      for (i = 0; i < list->n; i++, pos++) {
+        if (wide) {
+          ((IDL_LONG64 *) data)[pos] = list->items[i].index;
+        } else {
+          ((IDL_LONG *) data)[pos] = (IDL_LONG) list->items[i].index;
+        }
+        if (dist_data) dist_data[pos] = mg_kdtree_unreduce(list->items[i].dist, info.metric);
+      }
+    }
+  }
+
+  for (t = 0; t < nthreads; t++) free(info.lists[t].items);
+  IDL_MemFree(info.counts, NULL, IDL_MSG_RET);
+  if (xi_dbl != argv[1]) IDL_Deltmp(xi_dbl);
+
+  if (kw.count_present) {
+    IDL_ALLTYPES value;
+    if (wide) {
+      value.l64 = total;
+      IDL_StoreScalar(kw.count, IDL_TYP_LONG64, &value);
+    } else {
+      value.l = (IDL_LONG) total;
+      IDL_StoreScalar(kw.count, IDL_TYP_LONG, &value);
+    }
+  }
+  if (kw.offsets_present) {
+    IDL_VarCopy(offsets, kw.offsets);
+  } else {
+    IDL_Deltmp(offsets);
+  }
+  if (kw.distances_present) {
+    if (total == 0) {
+      IDL_ALLTYPES value;
+      value.d = -1.0;
+      IDL_StoreScalar(kw.distances, IDL_TYP_DOUBLE, &value);
+    } else {
+      IDL_VarCopy(distances, kw.distances);
+    }
+  }
+
+  IDL_KW_FREE;
+
+  return result;
+}
+
+
+/**************************************************************************
+  MG_KMEANS_FIT and MG_KMEANS_PREDICT
+***************************************************************************/
+
+/*
+  K-means clustering. Lloyd iterations use Hamerly's bounds: each sample
+  keeps an upper bound on the distance to its center and a lower bound on
+  the distance to any other center, and the distances are only computed
+  when the bounds, moved by how far the centers moved, cannot rule out a
+  change of cluster. Hamerly's single lower bound needs O(n_samples) memory,
+  unlike Elkan's O(n_samples * n_clusters), and works well for the low
+  dimensional data k-means is usually applied to.
+
+  Centers are seeded by k-means++, k-means|| (a few rounds of oversampling
+  followed by a weighted k-means++ on the candidates), or randomly chosen
+  samples. With BATCH_SIZE, mini-batch k-means updates the centers from
+  random batches of samples instead, which also allows fitting data one
+  chunk at a time by passing the centers and COUNTS of the last chunk.
+
+  Samples are processed in blocks whose number depends only on the size of
+  the problem; sums are accumulated per block and combined in block order,
+  and random numbers come from a generator seeded by SEED, so results for a
+  given SEED do not depend on the number of threads.
+*/
+
+#define MG_KMEANS_INIT_RANDOM       0
+#define MG_KMEANS_INIT_PLUSPLUS     1
+#define MG_KMEANS_INIT_PARALLEL     2
+
+#define MG_KMEANS_MIN_BLOCK         16384
+#define MG_KMEANS_MAX_BLOCKS        256
+#define MG_KMEANS_MAX_BLOCK_SUMS    (1 << 25)
+#define MG_KMEANS_ROUNDS            5
+
+static char *mg_kmeans_inits[] = { "random", "k-means++", "k-means||", NULL };
+
+typedef struct {
+  char *data;              // samples, float or double
+  int is_float;
+  IDL_MEMINT n_features;
+  IDL_MEMINT n_samples;
+  IDL_MEMINT n_clusters;
+  double *centers;         // n_features * n_clusters
+  double *half_gap;        // half distance from each center to the nearest other
+  double *shift;           // distance each center moved in the last update
+  IDL_MEMINT max_shift_center;
+  double max_shift;
+  double second_shift;
+  IDL_LONG *labels;
+  double *upper;
+  double *lower;
+  int first;               // set for the first assignment of a fit
+
+  // blocks of samples
+  IDL_MEMINT n_blocks;
+  IDL_MEMINT block_size;
+  double *block_sums;      // n_features * n_clusters per block
+  double *block_counts;    // n_clusters per block
+  double *block_values;    // per block changes, inertia, or total of min_d2
+
+  // seeding
+  double *min_d2;          // squared distance to the nearest chosen center
+  IDL_LONG *nearest;       // index of the nearest chosen center
+  IDL_MEMINT n_new;        // centers to update min_d2 with...
+  IDL_MEMINT first_new;    // ...starting from this one
+  double *candidates;      // candidate centers for k-means||
+  unsigned char *chosen;
+  double oversampling;
+  double total_d2;
+  IDL_ULONG64 round_seed;
+
+  // mini-batch
+  IDL_MEMINT *batch;
+  IDL_MEMINT batch_size;
+} mg_kmeans_info;
+
+
+// splitmix64: small, fast, and good enough to pick samples
+static inline IDL_ULONG64 mg_kmeans_next(IDL_ULONG64 *state) {
+  IDL_ULONG64 z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+
+// uniform random double in [0, 1)
+static inline double mg_kmeans_uniform(IDL_ULONG64 *state) {
+  return (mg_kmeans_next(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+// squared distance from sample i to a center
+static inline double mg_kmeans_dist2(mg_kmeans_info *info, IDL_MEMINT i,
+                                     double *center) {
+  IDL_MEMINT d, nf = info->n_features;
+  double diff, dist = 0.0;
+
+  if (info->is_float) {
+    float *x = (float *) info->data + i * nf;
+    for (d = 0; d < nf; d++) {
+      diff = x[d] - center[d];
+      dist += diff * diff;
+    }
+  } else {
+    double *x = (double *) info->data + i * nf;
+    for (d = 0; d < nf; d++) {
+      diff = x[d] - center[d];
+      dist += diff * diff;
+    }
+  }
+
+  return dist;
+}
+
+
+static inline void mg_kmeans_add(mg_kmeans_info *info, IDL_MEMINT i,
+                                 double *sum, double weight) {
+  IDL_MEMINT d, nf = info->n_features;
+
+  if (info->is_float) {
+    float *x = (float *) info->data + i * nf;
+    for (d = 0; d < nf; d++) sum[d] += weight * x[d];
+  } else {
+    double *x = (double *) info->data + i * nf;
+    for (d = 0; d < nf; d++) sum[d] += weight * x[d];
+  }
+}
+
+
+static inline void mg_kmeans_copy(mg_kmeans_info *info, IDL_MEMINT i,
+                                  double *center) {
+  IDL_MEMINT d, nf = info->n_features;
+
+  if (info->is_float) {
+    float *x = (float *) info->data + i * nf;
+    for (d = 0; d < nf; d++) center[d] = x[d];
+  } else {
+    double *x = (double *) info->data + i * nf;
+    for (d = 0; d < nf; d++) center[d] = x[d];
+  }
+}
+
+
+static double mg_kmeans_center_dist(double *a, double *b, IDL_MEMINT n) {
+  IDL_MEMINT d;
+  double diff, dist = 0.0;
+  for (d = 0; d < n; d++) {
+    diff = a[d] - b[d];
+    dist += diff * diff;
+  }
+  return sqrt(dist);
+}
+
+
+#define MG_KMEANS_LOCAL_FEATURES 16
+
+// nearest and second nearest centers of sample i, as distances
+static inline IDL_LONG mg_kmeans_nearest(mg_kmeans_info *info, IDL_MEMINT i,
+                                         double *d1, double *d2) {
+  IDL_MEMINT c, f, nf = info->n_features;
+  IDL_LONG best = 0;
+  double d, diff, first = INFINITY, second = INFINITY, *center = info->centers;
+  double x[MG_KMEANS_LOCAL_FEATURES];
+
+  // most centers are farther than the second nearest so far
+  if (nf <= MG_KMEANS_LOCAL_FEATURES) {
+    for (f = 0; f < nf; f++) x[f] = 0.0;
+    mg_kmeans_add(info, i, x, 1.0);
+  }
+  for (c = 0; c < info->n_clusters; c++, center += nf) {
+    if (nf <= MG_KMEANS_LOCAL_FEATURES) {
+      for (f = 0, d = 0.0; f < nf; f++) {
+        diff = x[f] - center[f];
+        d += diff * diff;
+      }
+    } else {
+      d = mg_kmeans_dist2(info, i, center);
+    }
+    if (d < second) {
+      if (d < first) {
+        second = first;
+        first = d;
+        best = (IDL_LONG) c;
+      } else {
+        second = d;
+      }
+    }
+  }
+  *d1 = sqrt(first);
+  *d2 = sqrt(second);
+
+  return best;
+}
+
+
+// assign samples of blocks [start, end) to centers with Hamerly's bounds and
+// accumulate the sums of the samples of each cluster
+static void mg_kmeans_assign(IDL_MEMINT start, IDL_MEMINT end,
+                             int thread_index, void *data) {
+  mg_kmeans_info *info = (mg_kmeans_info *) data;
+  IDL_MEMINT b, i, i_end, nf = info->n_features, k = info->n_clusters;
+  IDL_LONG a, old;
+  double *sums, *counts, bound, d1, d2;
+
+  for (b = start; b < end; b++) {
+    sums = info->block_sums + b * nf * k;
+    counts = info->block_counts + b * k;
+    memset(sums, 0, nf * k * sizeof(double));
+    memset(counts, 0, k * sizeof(double));
+    info->block_values[b] = 0.0;
+
+    i_end = (b + 1) * info->block_size;
+    if (i_end > info->n_samples) i_end = info->n_samples;
+    for (i = b * info->block_size; i < i_end; i++) {
+      if (info->first) {
+        info->labels[i] = mg_kmeans_nearest(info, i, &info->upper[i], &info->lower[i]);
+        info->block_values[b] += 1.0;
+      } else {
+        // move the bounds by how far the centers moved
+        a = info->labels[i];
+        info->upper[i] += info->shift[a];
+        info->lower[i] -= a == info->max_shift_center ? info->second_shift : info->max_shift;
+
+        bound = info->half_gap[a] > info->lower[i] ? info->half_gap[a] : info->lower[i];
+        if (info->upper[i] > bound) {
+          info->upper[i] = sqrt(mg_kmeans_dist2(info, i, info->centers + a * nf));
+          if (info->upper[i] > bound) {
+            old = a;
+            info->labels[i] = mg_kmeans_nearest(info, i, &d1, &d2);
+            info->upper[i] = d1;
+            info->lower[i] = d2;
+            if (info->labels[i] != old) info->block_values[b] += 1.0;
+          }
+        }
+      }
+
+      a = info->labels[i];
+      mg_kmeans_add(info, i, sums + a * nf, 1.0);
+      counts[a] += 1.0;
+    }
+  }
+}
+
+
+// new centers from the block sums; returns the sum of the squared shifts
+static double mg_kmeans_update(mg_kmeans_info *info) {
+  IDL_MEMINT b, c, c2, d, i, nf = info->n_features, k = info->n_clusters;
+  IDL_MEMINT far_sample;
+  double count, *center, *sum, total_shift = 0.0, dist, far;
+
+  sum = info->block_sums;   // block 0 collects the totals
+  for (c = 0; c < k; c++) {
+    for (b = 1; b < info->n_blocks; b++) {
+      for (d = 0; d < nf; d++) sum[c * nf + d] += info->block_sums[(b * k + c) * nf + d];
+      info->block_counts[c] += info->block_counts[b * k + c];
+    }
+  }
+
+  info->max_shift = info->second_shift = 0.0;
+  info->max_shift_center = -1;
+  for (c = 0; c < k; c++) {
+    center = info->centers + c * nf;
+    count = info->block_counts[c];
+    if (count > 0.0) {
+      for (d = 0, dist = 0.0; d < nf; d++) {
+        double value = sum[c * nf + d] / count;
+        dist += (value - center[d]) * (value - center[d]);
+        center[d] = value;
+      }
+    } else {
+      // an empty cluster takes the sample farthest from its center
+      for (i = 0, far = -1.0, far_sample = 0; i < info->n_samples; i++) {
+        if (info->upper[i] > far) {
+          far = info->upper[i];
+          far_sample = i;
+        }
+      }
+      for (d = 0, dist = 0.0; d < nf; d++) center[d] = 0.0;
+      mg_kmeans_copy(info, far_sample, center);
+      info->upper[far_sample] = 0.0;
+      dist = INFINITY;
+    }
+    total_shift += dist;
+    info->shift[c] = sqrt(dist);
+    if (info->shift[c] > info->max_shift) {
+      info->second_shift = info->max_shift;
+      info->max_shift = info->shift[c];
+      info->max_shift_center = c;
+    } else if (info->shift[c] > info->second_shift) {
+      info->second_shift = info->shift[c];
+    }
+  }
+
+  // a relocated center invalidates all the bounds
+  if (isinf(info->max_shift)) info->first = 1;
+
+  for (c = 0; c < k; c++) {
+    info->half_gap[c] = INFINITY;
+    for (c2 = 0; c2 < k; c2++) {
+      if (c2 == c) continue;
+      dist = 0.5 * mg_kmeans_center_dist(info->centers + c * nf, info->centers + c2 * nf, nf);
+      if (dist < info->half_gap[c]) info->half_gap[c] = dist;
+    }
+  }
+
+  return total_shift;
+}
+
+
+// sum of the squared distances of the samples of blocks [start, end) to
+// their centers, and their labels if not known
+static void mg_kmeans_inertia(IDL_MEMINT start, IDL_MEMINT end,
+                              int thread_index, void *data) {
+  mg_kmeans_info *info = (mg_kmeans_info *) data;
+  IDL_MEMINT b, i, i_end;
+  double d1, d2;
+
+  for (b = start; b < end; b++) {
+    info->block_values[b] = 0.0;
+    i_end = (b + 1) * info->block_size;
+    if (i_end > info->n_samples) i_end = info->n_samples;
+    for (i = b * info->block_size; i < i_end; i++) {
+      if (info->first) info->labels[i] = mg_kmeans_nearest(info, i, &d1, &d2);
+      info->block_values[b] += mg_kmeans_dist2(info, i,
+                                               info->centers + info->labels[i] * info->n_features);
+    }
+  }
+}
+
+
+// update the distance of each sample to the nearest chosen center with the
+// n_new centers starting at first_new; totals per block
+static void mg_kmeans_min_d2(IDL_MEMINT start, IDL_MEMINT end,
+                             int thread_index, void *data) {
+  mg_kmeans_info *info = (mg_kmeans_info *) data;
+  IDL_MEMINT b, i, i_end, c;
+  double d;
+
+  for (b = start; b < end; b++) {
+    info->block_values[b] = 0.0;
+    i_end = (b + 1) * info->block_size;
+    if (i_end > info->n_samples) i_end = info->n_samples;
+    for (i = b * info->block_size; i < i_end; i++) {
+      for (c = info->first_new; c < info->first_new + info->n_new; c++) {
+        d = mg_kmeans_dist2(info, i, info->candidates + c * info->n_features);
+        if (d < info->min_d2[i]) {
+          info->min_d2[i] = d;
+          if (info->nearest) info->nearest[i] = (IDL_LONG) c;
+        }
+      }
+      info->block_values[b] += info->min_d2[i];
+    }
+  }
+}
+
+
+// k-means|| oversampling: choose each sample with probability proportional
+// to its squared distance, using a random number depending only on the
+// round and the sample
+static void mg_kmeans_oversample(IDL_MEMINT start, IDL_MEMINT end,
+                                 int thread_index, void *data) {
+  mg_kmeans_info *info = (mg_kmeans_info *) data;
+  IDL_MEMINT b, i, i_end;
+  IDL_ULONG64 state;
+
+  for (b = start; b < end; b++) {
+    i_end = (b + 1) * info->block_size;
+    if (i_end > info->n_samples) i_end = info->n_samples;
+    for (i = b * info->block_size; i < i_end; i++) {
+      state = info->round_seed ^ ((IDL_ULONG64) i * 0xD1B54A32D192ED03ULL);
+      info->chosen[i] = mg_kmeans_uniform(&state) * info->total_d2
+                          < info->oversampling * info->min_d2[i];
+    }
+  }
+}
+
+
+static double mg_kmeans_blocks_total(mg_kmeans_info *info) {
+  IDL_MEMINT b;
+  double total = 0.0;
+  for (b = 0; b < info->n_blocks; b++) total += info->block_values[b];
+  return total;
+}
+
+
+// sample with probability proportional to min_d2, or uniformly if all are 0
+static IDL_MEMINT mg_kmeans_draw(mg_kmeans_info *info, IDL_ULONG64 *state) {
+  IDL_MEMINT b, i, i_end;
+  double total = mg_kmeans_blocks_total(info), r;
+
+  if (!(total > 0.0)) return (IDL_MEMINT) (mg_kmeans_uniform(state) * info->n_samples);
+
+  r = mg_kmeans_uniform(state) * total;
+  for (b = 0; b < info->n_blocks - 1 && r >= info->block_values[b]; b++) {
+    r -= info->block_values[b];
+  }
+  i_end = (b + 1) * info->block_size;
+  if (i_end > info->n_samples) i_end = info->n_samples;
+  for (i = b * info->block_size; i < i_end - 1; i++) {
+    if (r < info->min_d2[i]) break;
+    r -= info->min_d2[i];
+  }
+  return i;
+}
+
+
+// weighted k-means++ on a small set of points, serially
+static void mg_kmeans_weighted_plusplus(double *points, double *weights,
+                                        IDL_MEMINT n, IDL_MEMINT nf,
+                                        double *centers, IDL_MEMINT k,
+                                        IDL_ULONG64 *state, double *min_d2) {
+  IDL_MEMINT c, i, chosen;
+  double total, r, d;
+
+  for (i = 0, total = 0.0; i < n; i++) total += weights[i];
+  r = mg_kmeans_uniform(state) * total;
+  for (chosen = 0; chosen < n - 1 && r >= weights[chosen]; chosen++) r -= weights[chosen];
+  memcpy(centers, points + chosen * nf, nf * sizeof(double));
+  for (i = 0; i < n; i++) min_d2[i] = INFINITY;
+
+  for (c = 1; c < k; c++) {
+    for (i = 0, total = 0.0; i < n; i++) {
+      d = mg_kmeans_center_dist(points + i * nf, centers + (c - 1) * nf, nf);
+      if (d * d < min_d2[i]) min_d2[i] = d * d;
+      total += weights[i] * min_d2[i];
+    }
+    r = mg_kmeans_uniform(state) * total;
+    for (chosen = 0; chosen < n - 1 && r >= weights[chosen] * min_d2[chosen]; chosen++) {
+      r -= weights[chosen] * min_d2[chosen];
+    }
+    memcpy(centers + c * nf, points + chosen * nf, nf * sizeof(double));
+  }
+}
+
+
+/*
+  Seed the centers. Returns 0 if memory for k-means|| candidates could not
+  be allocated. Uses min_d2 and block values.
+*/
+static int mg_kmeans_seed(mg_kmeans_info *info, int init, int nthreads,
+                          IDL_ULONG64 *state) {
+  IDL_MEMINT c, i, r, n_candidates, size, nf = info->n_features, k = info->n_clusters;
+  double *weights, *more;
+
+  for (i = 0; i < info->n_samples; i++) info->min_d2[i] = INFINITY;
+
+  if (init == MG_KMEANS_INIT_RANDOM) {
+    // distinct random samples by Floyd's algorithm
+    IDL_MEMINT *picks = info->batch, j, t, u;
+    for (c = 0, j = info->n_samples - k; c < k; c++, j++) {
+      t = (IDL_MEMINT) (mg_kmeans_uniform(state) * (j + 1));
+      for (u = 0; u < c; u++) if (picks[u] == t) break;
+      picks[c] = u < c ? j : t;
+      mg_kmeans_copy(info, picks[c], info->centers + c * nf);
+    }
+    return 1;
+  }
+
+  info->nearest = NULL;
+  info->candidates = info->centers;
+  info->n_new = 1;
+  mg_kmeans_copy(info, (IDL_MEMINT) (mg_kmeans_uniform(state) * info->n_samples), info->centers);
+
+  if (init == MG_KMEANS_INIT_PLUSPLUS) {
+    for (c = 1; c < k; c++) {
+      info->first_new = c - 1;
+      mg_thread_run(nthreads, info->n_blocks, mg_kmeans_min_d2, info);
+      mg_kmeans_copy(info, mg_kmeans_draw(info, state), info->centers + c * nf);
+    }
+    return 1;
+  }
+
+  // k-means||: oversample about 2 k candidates per round
+  size = k * (2 * MG_KMEANS_ROUNDS + 2);
+  info->candidates = (double *) malloc(size * nf * sizeof(double));
+  if (info->candidates == NULL) return 0;
+  memcpy(info->candidates, info->centers, nf * sizeof(double));
+  n_candidates = 1;
+  info->oversampling = 2.0 * k;
+
+  info->nearest = info->labels;
+  for (i = 0; i < info->n_samples; i++) info->nearest[i] = 0;
+  info->first_new = 0;
+  for (r = 0; r < MG_KMEANS_ROUNDS; r++) {
+    mg_thread_run(nthreads, info->n_blocks, mg_kmeans_min_d2, info);
+    info->total_d2 = mg_kmeans_blocks_total(info);
+    if (!(info->total_d2 > 0.0)) break;
+
+    info->round_seed = mg_kmeans_next(state);
+    mg_thread_run(nthreads, info->n_blocks, mg_kmeans_oversample, info);
+
+    info->first_new = n_candidates;
+    for (i = 0; i < info->n_samples; i++) {
+      if (!info->chosen[i]) continue;
+      if (n_candidates == size) {
+        size *= 2;
+        more = (double *) realloc(info->candidates, size * nf * sizeof(double));
+        if (more == NULL) {
+          free(info->candidates);
+          return 0;
+        }
+        info->candidates = more;
+      }
+      mg_kmeans_copy(info, i, info->candidates + n_candidates * nf);
+      n_candidates++;
+    }
+    info->n_new = n_candidates - info->first_new;
+  }
+  mg_thread_run(nthreads, info->n_blocks, mg_kmeans_min_d2, info);
+
+  if (n_candidates <= k) {
+    // too few candidates, e.g., from repeated samples: finish with k-means++
+    double *candidates = info->candidates;
+    memcpy(info->centers, info->candidates, n_candidates * nf * sizeof(double));
+    info->candidates = info->centers;
+    info->nearest = NULL;
+    info->n_new = 1;
+    for (c = n_candidates; c < k; c++) {
+      mg_kmeans_copy(info, mg_kmeans_draw(info, state), info->centers + c * nf);
+      info->first_new = c;
+      mg_thread_run(nthreads, info->n_blocks, mg_kmeans_min_d2, info);
+    }
+    free(candidates);
+    return 1;
+  }
+
+  // weight candidates by the number of samples nearest to them
+  weights = (double *) calloc(2 * n_candidates, sizeof(double));
+  if (weights == NULL) {
+    free(info->candidates);
+    return 0;
+  }
+  for (i = 0; i < info->n_samples; i++) weights[info->nearest[i]] += 1.0;
+  mg_kmeans_weighted_plusplus(info->candidates, weights, n_candidates, nf,
+                              info->centers, k, state, weights + n_candidates);
+  free(weights);
+  free(info->candidates);
+
+  return 1;
+}
+
+
+// one Lloyd/Hamerly fit from the current centers; returns the iterations
+static IDL_MEMINT mg_kmeans_lloyd(mg_kmeans_info *info, int nthreads,
+                                  IDL_MEMINT max_iterations, double tolerance) {
+  IDL_MEMINT iter;
+  double changed;
+
+  info->first = 1;
+  for (iter = 0; iter < max_iterations; iter++) {
+    mg_thread_run(nthreads, info->n_blocks, mg_kmeans_assign, info);
+    changed = mg_kmeans_blocks_total(info);
+    info->first = 0;
+    if (changed == 0.0) return iter;
+    if (mg_kmeans_update(info) <= tolerance) {
+      iter++;
+      break;
+    }
+  }
+
+  // labels for the final centers
+  mg_thread_run(nthreads, info->n_blocks, mg_kmeans_assign, info);
+  info->first = 0;
+
+  return iter;
+}
+
+
+// assign a batch of samples, stored in labels by position in the batch
+static void mg_kmeans_assign_batch(IDL_MEMINT start, IDL_MEMINT end,
+                                   int thread_index, void *data) {
+  mg_kmeans_info *info = (mg_kmeans_info *) data;
+  IDL_MEMINT i;
+  double d1, d2;
+
+  for (i = start; i < end; i++) {
+    info->labels[i] = mg_kmeans_nearest(info, info->batch[i], &d1, &d2);
+  }
+}
+
+
+// mini-batch k-means: counts are the number of samples seen by each center
+static IDL_MEMINT mg_kmeans_minibatch(mg_kmeans_info *info, int nthreads,
+                                      IDL_MEMINT max_iterations, double *counts,
+                                      IDL_ULONG64 *state) {
+  IDL_MEMINT iter, i, d, c, nf = info->n_features;
+  double eta, *center, *x = info->block_sums;
+
+  for (iter = 0; iter < max_iterations; iter++) {
+    // a batch of all the samples takes them in order
+    for (i = 0; i < info->batch_size; i++) {
+      info->batch[i] = info->batch_size == info->n_samples
+                         ? i
+                         : (IDL_MEMINT) (mg_kmeans_uniform(state) * info->n_samples);
+    }
+    mg_thread_run(mg_thread_count(info->batch_size, 1024, nthreads), info->batch_size,
+                  mg_kmeans_assign_batch, info);
+
+    // gradient step with a per center learning rate of 1 / count
+    for (i = 0; i < info->batch_size; i++) {
+      c = info->labels[i];
+      center = info->centers + c * nf;
+      counts[c] += 1.0;
+      eta = 1.0 / counts[c];
+      for (d = 0; d < nf; d++) x[d] = 0.0;
+      mg_kmeans_add(info, info->batch[i], x, 1.0);
+      for (d = 0; d < nf; d++) center[d] += eta * (x[d] - center[d]);
+    }
+  }
+
+  return iter;
+}
+
+
+// seed for the random number generator from an IDL variable
+static IDL_ULONG64 mg_kmeans_get_seed(IDL_VPTR var) {
+  IDL_VPTR lng;
+  IDL_MEMINT i, n;
+  IDL_LONG64 *values;
+  IDL_ULONG64 state = 0x2545F4914F6CDD1DULL;
+
+  if (var == NULL || var->type == IDL_TYP_UNDEF) {
+    state ^= (IDL_ULONG64) time(NULL);
+    return mg_kmeans_next(&state);
+  }
+
+  IDL_ENSURE_SIMPLE(var);
+  lng = var->type == IDL_TYP_LONG64 ? var : IDL_CvtLng64(1, &var, NULL);
+  IDL_VarGetData(lng, &n, (char **) &values, FALSE);
+  for (i = 0; i < n; i++) {
+    state ^= (IDL_ULONG64) values[i];
+    mg_kmeans_next(&state);
+  }
+  if (lng != var) IDL_Deltmp(lng);
+
+  return state;
+}
+
+
+static void mg_kmeans_free(mg_kmeans_info *info) {
+  if (info->centers) IDL_MemFree(info->centers, NULL, IDL_MSG_RET);
+  if (info->labels) IDL_MemFree(info->labels, NULL, IDL_MSG_RET);
+  if (info->upper) IDL_MemFree(info->upper, NULL, IDL_MSG_RET);
+  if (info->block_sums) IDL_MemFree(info->block_sums, NULL, IDL_MSG_RET);
+  if (info->chosen) IDL_MemFree(info->chosen, NULL, IDL_MSG_RET);
+  if (info->batch) IDL_MemFree(info->batch, NULL, IDL_MSG_RET);
+}
+
+
+// allocate the work space of a fit; returns 0 if memory is not available
+static int mg_kmeans_alloc(mg_kmeans_info *info, int seeding) {
+  IDL_MEMINT nf = info->n_features, k = info->n_clusters, n = info->n_samples;
+  IDL_MEMINT n_batch = info->batch_size > k ? info->batch_size : k;
+
+  // work is divided into blocks independent of the number of threads
+  info->n_blocks = (n + MG_KMEANS_MIN_BLOCK - 1) / MG_KMEANS_MIN_BLOCK;
+  if (info->n_blocks > MG_KMEANS_MAX_BLOCKS) info->n_blocks = MG_KMEANS_MAX_BLOCKS;
+  if (info->n_blocks * nf * k > MG_KMEANS_MAX_BLOCK_SUMS) {
+    info->n_blocks = MG_KMEANS_MAX_BLOCK_SUMS / (nf * k);
+  }
+  if (info->n_blocks < 1) info->n_blocks = 1;
+  info->block_size = (n + info->n_blocks - 1) / info->n_blocks;
+  info->n_blocks = (n + info->block_size - 1) / info->block_size;
+
+  // centers, best centers, half gaps, and shifts
+  info->centers = (double *) IDL_MemAlloc((2 * nf * k + 2 * k) * sizeof(double),
+                                          "k-means centers", IDL_MSG_RET);
+  info->labels = (IDL_LONG *) IDL_MemAlloc(n * sizeof(IDL_LONG),
+                                           "k-means labels", IDL_MSG_RET);
+  // upper and lower bounds; the lower bounds double as min_d2 when seeding
+  info->upper = (double *) IDL_MemAlloc(2 * n * sizeof(double),
+                                        "k-means bounds", IDL_MSG_RET);
+  info->block_sums = (double *) IDL_MemAlloc(info->n_blocks * (nf * k + k + 1) * sizeof(double),
+                                             "k-means sums", IDL_MSG_RET);
+  info->chosen = seeding == MG_KMEANS_INIT_PARALLEL
+                   ? (unsigned char *) IDL_MemAlloc(n, "k-means candidates", IDL_MSG_RET)
+                   : NULL;
+  info->batch = (IDL_MEMINT *) IDL_MemAlloc(n_batch * sizeof(IDL_MEMINT),
+                                            "k-means batch", IDL_MSG_RET);
+
+  if (info->centers == NULL || info->labels == NULL || info->upper == NULL
+        || info->block_sums == NULL || info->batch == NULL
+        || (seeding == MG_KMEANS_INIT_PARALLEL && info->chosen == NULL)) {
+    return 0;
+  }
+
+  info->half_gap = info->centers + 2 * nf * k;
+  info->shift = info->half_gap + k;
+  info->lower = info->min_d2 = info->upper + n;
+  info->block_counts = info->block_sums + info->n_blocks * nf * k;
+  info->block_values = info->block_counts + info->n_blocks * k;
+
+  return 1;
+}
+
+
+static int mg_kmeans_blocks_threads(mg_kmeans_info *info, int requested) {
+  int nthreads = mg_thread_count(info->n_samples, MG_STATS_MIN_ELTS, requested);
+  return nthreads < info->n_blocks ? nthreads : (int) info->n_blocks;
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_kmeans_fit(int argc, IDL_VPTR *argv, char *argk) {
+  IDL_VPTR x = argv[0], x_data, init_dbl = NULL, counts_dbl = NULL, result, tmp;
+  IDL_ARRAY *arr;
+  mg_kmeans_info info;
+  IDL_MEMINT i, d, c, nf, k, n, max_iterations, n_init, run, iter, n_iterations = 0;
+  IDL_ULONG64 state;
+  IDL_ALLTYPES value;
+  double *best, *counts = NULL, inertia, best_inertia = INFINITY, tolerance;
+  double mean, m2, delta, *init_centers = NULL;
+  char *name, lower[16], *data;
+  int nargs, nthreads, seeding = MG_KMEANS_INIT_PLUSPLUS, minibatch, cont = 0;
+  IDL_MEMINT dims[2];
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_LONG batch_size;
+    int batch_size_present;
+    IDL_VPTR counts;
+    int counts_present;
+    IDL_LONG double_keyword;
+    IDL_VPTR inertia;
+    int inertia_present;
+    IDL_VPTR init;
+    int init_present;
+    IDL_VPTR labels;
+    int labels_present;
+    IDL_LONG max_iterations;
+    int max_iterations_present;
+    IDL_LONG n_init;
+    int n_init_present;
+    IDL_VPTR n_iterations;
+    int n_iterations_present;
+    IDL_LONG n_threads;
+    IDL_VPTR seed;
+    int seed_present;
+    double tolerance;
+    int tolerance_present;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "BATCH_SIZE", IDL_TYP_LONG, 1, 0,
+      IDL_KW_OFFSETOF(batch_size_present), IDL_KW_OFFSETOF(batch_size) },
+    { "COUNTS", IDL_TYP_UNDEF, 1, IDL_KW_VIN | IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(counts_present), IDL_KW_OFFSETOF(counts) },
+    { "DOUBLE", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(double_keyword) },
+    { "INERTIA", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(inertia_present), IDL_KW_OFFSETOF(inertia) },
+    { "INIT", IDL_TYP_UNDEF, 1, IDL_KW_VIN | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(init_present), IDL_KW_OFFSETOF(init) },
+    { "LABELS", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(labels_present), IDL_KW_OFFSETOF(labels) },
+    { "MAX_ITERATIONS", IDL_TYP_LONG, 1, 0,
+      IDL_KW_OFFSETOF(max_iterations_present), IDL_KW_OFFSETOF(max_iterations) },
+    { "N_INIT", IDL_TYP_LONG, 1, 0,
+      IDL_KW_OFFSETOF(n_init_present), IDL_KW_OFFSETOF(n_init) },
+    { "N_ITERATIONS", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(n_iterations_present), IDL_KW_OFFSETOF(n_iterations) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { "SEED", IDL_TYP_UNDEF, 1, IDL_KW_VIN | IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(seed_present), IDL_KW_OFFSETOF(seed) },
+    { "TOLERANCE", IDL_TYP_DOUBLE, 1, 0,
+      IDL_KW_OFFSETOF(tolerance_present), IDL_KW_OFFSETOF(tolerance) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+
+  IDL_ENSURE_SIMPLE(x);
+  IDL_ENSURE_ARRAY(x);
+  if (!mg_stats_is_real(x->type) || x->value.arr->n_dim > 2) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "x must be a non-complex numeric (n_features, n_samples) array");
+  }
+  arr = x->value.arr;
+  nf = arr->n_dim == 2 ? arr->dim[0] : 1;
+  n = arr->n_elts / nf;
+
+  k = IDL_LongScalar(argv[1]);
+  if (k < 1 || k > n) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "n_clusters must be between 1 and the number of samples");
+  }
+  if (kw.batch_size_present && kw.batch_size < 1) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "BATCH_SIZE must be positive");
+  }
+  n_init = kw.n_init_present ? kw.n_init : 1;
+  if (n_init < 1) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "N_INIT must be positive");
+  }
+
+  // initial centers, by name or value
+  if (kw.init_present && kw.init->type != IDL_TYP_UNDEF) {
+    if (kw.init->type == IDL_TYP_STRING && !(kw.init->flags & IDL_V_ARR)) {
+      name = IDL_STRING_STR(&kw.init->value.str);
+      for (i = 0; name[i] && i < 15; i++) lower[i] = (char) tolower(name[i]);
+      lower[i] = '\0';
+      for (seeding = 0; mg_kmeans_inits[seeding]; seeding++) {
+        if (strcmp(lower, mg_kmeans_inits[seeding]) == 0) break;
+      }
+      if (mg_kmeans_inits[seeding] == NULL) {
+        IDL_KW_FREE;
+        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                    "unknown initialization %s", name);
+      }
+    } else {
+      IDL_ENSURE_SIMPLE(kw.init);
+      if (!mg_stats_is_real(kw.init->type) || !(kw.init->flags & IDL_V_ARR)
+            || kw.init->value.arr->n_elts != nf * k) {
+        IDL_KW_FREE;
+        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                    "INIT must be a method name or (n_features, n_clusters) centers");
+      }
+      init_dbl = kw.init->type == IDL_TYP_DOUBLE ? kw.init : IDL_CvtDbl(1, &kw.init, NULL);
+      init_centers = (double *) init_dbl->value.arr->data;
+      n_init = 1;
+    }
+  }
+
+  // counts from a previous mini-batch fit continue it
+  if (kw.counts_present && kw.counts->type != IDL_TYP_UNDEF) {
+    IDL_ENSURE_SIMPLE(kw.counts);
+    if (init_centers == NULL || !mg_stats_is_real(kw.counts->type)
+          || (kw.counts->flags & IDL_V_ARR ? kw.counts->value.arr->n_elts : 1) != k) {
+      if (init_dbl && init_dbl != kw.init) IDL_Deltmp(init_dbl);
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "COUNTS requires INIT centers and must have n_clusters elements");
+    }
+    counts_dbl = IDL_CvtDbl(1, &kw.counts, NULL);
+    cont = 1;
+  }
+  minibatch = kw.batch_size_present || cont;
+
+  if (kw.max_iterations_present) {
+    max_iterations = kw.max_iterations;
+  } else {
+    max_iterations = minibatch ? (cont ? 1 : 100) : 300;
+  }
+  if (max_iterations < 1) {
+    if (init_dbl && init_dbl != kw.init) IDL_Deltmp(init_dbl);
+    if (counts_dbl && counts_dbl != kw.counts) IDL_Deltmp(counts_dbl);
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "MAX_ITERATIONS must be positive");
+  }
+
+  x_data = x->type == IDL_TYP_FLOAT || x->type == IDL_TYP_DOUBLE ? x : IDL_CvtDbl(1, &x, NULL);
+
+  memset(&info, 0, sizeof(info));
+  info.data = (char *) x_data->value.arr->data;
+  info.is_float = x_data->type == IDL_TYP_FLOAT;
+  info.n_features = nf;
+  info.n_samples = n;
+  info.n_clusters = k;
+  info.batch_size = minibatch
+                      ? (kw.batch_size_present && kw.batch_size < n ? kw.batch_size : n)
+                      : 0;
+
+  // mean variance of the features for the default tolerance, checking for
+  // non-finite values on the way
+  for (d = 0, tolerance = 0.0; d < nf; d++) {
+    for (i = 0, mean = m2 = 0.0; i < n; i++) {
+      value.d = info.is_float ? ((float *) info.data)[i * nf + d] : ((double *) info.data)[i * nf + d];
+      if (value.d - value.d != 0.0) break;
+      delta = value.d - mean;
+      mean += delta / (i + 1);
+      m2 += delta * (value.d - mean);
+    }
+    if (i < n) {
+      if (x_data != x) IDL_Deltmp(x_data);
+      if (init_dbl && init_dbl != kw.init) IDL_Deltmp(init_dbl);
+      if (counts_dbl && counts_dbl != kw.counts) IDL_Deltmp(counts_dbl);
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "x must not contain NaN or infinite values");
+    }
+    tolerance += m2 / n;
+  }
+  tolerance = kw.tolerance_present ? kw.tolerance : 1.0e-4 * tolerance / nf;
+
+  if (!mg_kmeans_alloc(&info, init_centers ? -1 : seeding)) {
+    mg_kmeans_free(&info);
+    if (x_data != x) IDL_Deltmp(x_data);
+    if (init_dbl && init_dbl != kw.init) IDL_Deltmp(init_dbl);
+    if (counts_dbl && counts_dbl != kw.counts) IDL_Deltmp(counts_dbl);
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unable to allocate memory for k-means");
+  }
+  best = info.centers + nf * k;
+  nthreads = mg_kmeans_blocks_threads(&info, kw.n_threads);
+  state = mg_kmeans_get_seed(kw.seed_present ? kw.seed : NULL);
+  if (counts_dbl) counts = (double *) counts_dbl->value.arr->data;
+
+  for (run = 0; run < n_init; run++) {
+    if (init_centers) {
+      memcpy(info.centers, init_centers, nf * k * sizeof(double));
+    } else if (!mg_kmeans_seed(&info, seeding, nthreads, &state)) {
+      mg_kmeans_free(&info);
+      if (x_data != x) IDL_Deltmp(x_data);
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "unable to allocate memory for k-means|| candidates");
+    }
+
+    if (minibatch) {
+      if (!cont) {
+        // a fresh mini-batch fit; counts live in the block counts of block 0
+        counts = info.block_counts;
+        for (c = 0; c < k; c++) counts[c] = 0.0;
+      }
+      iter = mg_kmeans_minibatch(&info, nthreads, max_iterations, counts, &state);
+      info.first = 1;
+    } else {
+      iter = mg_kmeans_lloyd(&info, nthreads, max_iterations, tolerance);
+    }
+
+    mg_thread_run(nthreads, info.n_blocks, mg_kmeans_inertia, &info);
+    inertia = mg_kmeans_blocks_total(&info);
+    if (run == 0 || inertia < best_inertia) {
+      best_inertia = inertia;
+      n_iterations = iter;
+      memcpy(best, info.centers, nf * k * sizeof(double));
+      // shifts are not used by mini-batch k-means, keep its counts there
+      if (minibatch) memcpy(info.shift, counts, k * sizeof(double));
+    }
+  }
+
+  // final labels and counts of the best fit
+  memcpy(info.centers, best, nf * k * sizeof(double));
+  if (n_init > 1) {
+    info.first = 1;
+    mg_thread_run(nthreads, info.n_blocks, mg_kmeans_inertia, &info);
+  }
+
+  dims[0] = nf;
+  dims[1] = k;
+  if (info.is_float && !kw.double_keyword) {
+    float *centers = (float *) IDL_MakeTempArray(IDL_TYP_FLOAT, k > 1 ? 2 : 1, dims,
+                                                 IDL_ARR_INI_NOP, &result);
+    for (i = 0; i < nf * k; i++) centers[i] = (float) best[i];
+  } else {
+    double *centers = (double *) IDL_MakeTempArray(IDL_TYP_DOUBLE, k > 1 ? 2 : 1, dims,
+                                                   IDL_ARR_INI_NOP, &result);
+    memcpy(centers, best, nf * k * sizeof(double));
+  }
+
+  if (kw.counts_present) {
+    IDL_LONG64 *counts_data = (IDL_LONG64 *) IDL_MakeTempVector(IDL_TYP_LONG64, k,
+                                                                IDL_ARR_INI_ZERO, &tmp);
+    if (minibatch) {
+      for (c = 0; c < k; c++) counts_data[c] = (IDL_LONG64) info.shift[c];
+    } else {
+      for (i = 0; i < n; i++) counts_data[info.labels[i]]++;
+    }
+    IDL_VarCopy(tmp, kw.counts);
+  }
+  if (kw.labels_present) {
+    data = IDL_MakeTempVector(IDL_TYP_LONG, n, IDL_ARR_INI_NOP, &tmp);
+    memcpy(data, info.labels, n * sizeof(IDL_LONG));
+    IDL_VarCopy(tmp, kw.labels);
+  }
+  if (kw.inertia_present) {
+    value.d = best_inertia;
+    IDL_StoreScalar(kw.inertia, IDL_TYP_DOUBLE, &value);
+  }
+  if (kw.n_iterations_present) {
+    value.l = (IDL_LONG) n_iterations;
+    IDL_StoreScalar(kw.n_iterations, IDL_TYP_LONG, &value);
+  }
+  if (kw.seed_present && !(kw.seed->flags & IDL_V_TEMP)) {
+    value.l = (IDL_LONG) (mg_kmeans_next(&state) >> 33);
+    IDL_StoreScalar(kw.seed, IDL_TYP_LONG, &value);
+  }
+
+  mg_kmeans_free(&info);
+  if (x_data != x) IDL_Deltmp(x_data);
+  if (init_dbl && init_dbl != kw.init) IDL_Deltmp(init_dbl);
+  if (counts_dbl && counts_dbl != kw.counts) IDL_Deltmp(counts_dbl);
+  IDL_KW_FREE;
+
+  return result;
+}
+
+
+static void mg_kmeans_predict_work(IDL_MEMINT start, IDL_MEMINT end,
+                                   int thread_index, void *data) {
+  mg_kmeans_info *info = (mg_kmeans_info *) data;
+  IDL_MEMINT i;
+  double d1, d2;
+
+  for (i = start; i < end; i++) {
+    info->labels[i] = mg_kmeans_nearest(info, i, &d1, &d2);
+    if (info->upper) info->upper[i] = d1;
+  }
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_kmeans_predict(int argc, IDL_VPTR *argv, char *argk) {
+  IDL_VPTR x = argv[0], centers = argv[1], x_data, centers_dbl, result, distances;
+  mg_kmeans_info info;
+  IDL_MEMINT nf, n;
+  int nargs;
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_VPTR distances;
+    int distances_present;
+    IDL_LONG n_threads;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "DISTANCES", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(distances_present), IDL_KW_OFFSETOF(distances) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+
+  IDL_ENSURE_SIMPLE(x);
+  IDL_ENSURE_SIMPLE(centers);
+  if (!mg_stats_is_real(x->type) || !mg_stats_is_real(centers->type)
+        || !(centers->flags & IDL_V_ARR)) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "x and centers must be non-complex numeric arrays");
+  }
+  nf = centers->value.arr->n_dim == 2 ? centers->value.arr->dim[0] : centers->value.arr->n_elts;
+  n = x->flags & IDL_V_ARR ? x->value.arr->n_elts : 1;
+  if (n % nf != 0 || (x->flags & IDL_V_ARR && x->value.arr->n_dim > 1 && x->value.arr->dim[0] != nf)) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "x must have the same number of features as the centers");
+  }
+
+  memset(&info, 0, sizeof(info));
+  info.n_features = nf;
+  info.n_samples = n / nf;
+  info.n_clusters = centers->value.arr->n_elts / nf;
+
+  x_data = x->type == IDL_TYP_FLOAT || x->type == IDL_TYP_DOUBLE ? x : IDL_CvtDbl(1, &x, NULL);
+  info.data = x_data->flags & IDL_V_ARR ? (char *) x_data->value.arr->data : (char *) &x_data->value;
+  info.is_float = x_data->type == IDL_TYP_FLOAT;
+  centers_dbl = centers->type == IDL_TYP_DOUBLE ? centers : IDL_CvtDbl(1, &centers, NULL);
+  info.centers = (double *) centers_dbl->value.arr->data;
+
+  info.labels = (IDL_LONG *) IDL_MakeTempVector(IDL_TYP_LONG, info.n_samples,
+                                                IDL_ARR_INI_NOP, &result);
+  if (kw.distances_present) {
+    info.upper = (double *) IDL_MakeTempVector(IDL_TYP_DOUBLE, info.n_samples,
+                                               IDL_ARR_INI_NOP, &distances);
+  }
+
+  mg_thread_run(mg_thread_count(info.n_samples, MG_STATS_MIN_ELTS / 4, kw.n_threads),
+                info.n_samples, mg_kmeans_predict_work, &info);
+
+  if (kw.distances_present) IDL_VarCopy(distances, kw.distances);
+
+  if (x_data != x) IDL_Deltmp(x_data);
+  if (centers_dbl != centers) IDL_Deltmp(centers_dbl);
+  IDL_KW_FREE;
+
+  return result;
+}
+
+
+/**************************************************************************
+  MG_RANDOM
+***************************************************************************/
+
+/*
+  Random numbers from Philox4x32-10, the counter-based generator of Salmon
+  et al., "Parallel Random Numbers: As Easy as 1, 2, 3" (SC11). Philox
+  encrypts a 128-bit counter with a 64-bit key, so any part of a sequence
+  can be computed directly, without generating what comes before it.
+
+  The state of a sequence is the key and a position, the number of values
+  already taken from the sequence. Value i of a call is value position + i
+  of the sequence and only depends on the key and that index, so threads
+  fill their own slices of the result and the values do not depend on the
+  number of threads or on how the sequence is split into calls.
+
+  Uniform values are packed into the 128 bits of a block: block b of the
+  counter { b_lo, b_hi, 0, 1 } holds 4 values of 32 bits or 2 values of 64
+  bits. Every value of other distributions has a stream of its own, blocks
+  { index_lo, index_hi, 0, 0 }, { index_lo, index_hi, 1, 0 }, ..., so
+  rejection methods may use as many uniform values as they need.
+*/
+
+#define MG_RANDOM_BERNOULLI          0
+#define MG_RANDOM_BETA               1
+#define MG_RANDOM_BINOMIAL           2
+#define MG_RANDOM_CAUCHY             3
+#define MG_RANDOM_CHISQ              4
+#define MG_RANDOM_EXPONENTIAL        5
+#define MG_RANDOM_FDIST              6
+#define MG_RANDOM_GAMMA              7
+#define MG_RANDOM_GEOMETRIC          8
+#define MG_RANDOM_LAPLACE            9
+#define MG_RANDOM_LOGISTIC          10
+#define MG_RANDOM_LOGNORMAL         11
+#define MG_RANDOM_NEGATIVE_BINOMIAL 12
+#define MG_RANDOM_NORMAL            13
+#define MG_RANDOM_PARETO            14
+#define MG_RANDOM_POISSON           15
+#define MG_RANDOM_RAYLEIGH          16
+#define MG_RANDOM_TDIST             17
+#define MG_RANDOM_UNIFORM           18
+#define MG_RANDOM_WEIBULL           19
+
+#define MG_RANDOM_PACKED             1
+
+#define MG_RANDOM_PI                 3.14159265358979323846
+
+typedef struct {
+  IDL_ULONG key[2];
+  IDL_ULONG counter[4];
+  IDL_ULONG bits[4];
+  int used;                // number of words of bits already returned
+} mg_random_stream;
+
+typedef double (*mg_random_sampler)(mg_random_stream *s, double a, double b);
+
+typedef struct {
+  char *name;
+  mg_random_sampler sampler;
+  int min_params;
+  int max_params;
+  double a;                // default parameters
+  double b;
+  int discrete;
+} mg_random_distribution;
+
+typedef struct {
+  IDL_ULONG key[2];
+  IDL_ULONG64 position;
+  mg_random_sampler sampler;
+  double a;
+  double b;
+  int type;
+  char *result;
+} mg_random_info;
+
+
+static inline IDL_ULONG mg_random_mulhilo(IDL_ULONG a, IDL_ULONG b, IDL_ULONG *hi) {
+  IDL_ULONG64 product = (IDL_ULONG64) a * (IDL_ULONG64) b;
+  *hi = (IDL_ULONG) (product >> 32);
+  return (IDL_ULONG) product;
+}
+
+
+// Philox4x32-10: the 128 random bits of a counter and key
+static inline void mg_random_philox(const IDL_ULONG counter[4],
+                                    const IDL_ULONG key[2],
+                                    IDL_ULONG bits[4]) {
+  IDL_ULONG c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+  IDL_ULONG k0 = key[0], k1 = key[1], hi0, hi1, lo0, lo1;
+  int r;
+
+  for (r = 0; r < 10; r++) {
+    lo0 = mg_random_mulhilo(0xD2511F53, c0, &hi0);
+    lo1 = mg_random_mulhilo(0xCD9E8D57, c2, &hi1);
+    c0 = hi1 ^ c1 ^ k0;
+    c1 = lo1;
+    c2 = hi0 ^ c3 ^ k1;
+    c3 = lo0;
+    k0 += 0x9E3779B9;
+    k1 += 0xBB67AE85;
+  }
+
+  bits[0] = c0;
+  bits[1] = c1;
+  bits[2] = c2;
+  bits[3] = c3;
+}
+
+
+// start the stream of value index of a sequence
+static inline void mg_random_seek(mg_random_stream *s, const IDL_ULONG key[2],
+                                  IDL_ULONG64 index) {
+  s->key[0] = key[0];
+  s->key[1] = key[1];
+  s->counter[0] = (IDL_ULONG) index;
+  s->counter[1] = (IDL_ULONG) (index >> 32);
+  s->counter[2] = 0;
+  s->counter[3] = 0;
+  s->used = 4;
+}
+
+
+static inline IDL_ULONG mg_random_next32(mg_random_stream *s) {
+  if (s->used == 4) {
+    mg_random_philox(s->counter, s->key, s->bits);
+    s->counter[2]++;
+    s->used = 0;
+  }
+  return s->bits[s->used++];
+}
+
+
+// uniform double in the open interval (0, 1), so its log is finite
+static inline double mg_random_open(mg_random_stream *s) {
+  IDL_ULONG64 hi = mg_random_next32(s);
+  IDL_ULONG64 bits = (hi << 32) | mg_random_next32(s);
+  return ((bits >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+
+// log(k!) from a table for small k, Stirling's series otherwise
+static double mg_random_log_factorial(double k) {
+  static double table[] = {
+    0.0, 0.0, 0.69314718055994531, 1.79175946922805500,
+    3.17805383034794562, 4.78749174278204599, 6.57925121201010100,
+    8.52516136106541430, 10.60460290274525023, 12.80182748008146961
+  };
+  double x = k + 1.0, x2;
+
+  if (k < 10.0) return table[(int) k];
+  x2 = 1.0 / (x * x);
+  return (x - 0.5) * log(x) - x + 0.91893853320467274
+           + (1.0 / 12.0 - x2 * (1.0 / 360.0 - x2 * (1.0 / 1260.0 - x2 / 1680.0))) / x;
+}
+
+
+static double mg_random_normal(mg_random_stream *s, double mu, double sigma) {
+  double u1 = mg_random_open(s), u2 = mg_random_open(s);
+  return mu + sigma * sqrt(-2.0 * log(u1)) * cos(2.0 * MG_RANDOM_PI * u2);
+}
+
+
+// Marsaglia and Tsang's method for shape a and scale b
+static double mg_random_gamma(mg_random_stream *s, double a, double b) {
+  double d, c, x, v, u;
+
+  if (a < 1.0) {
+    u = mg_random_open(s);
+    return mg_random_gamma(s, a + 1.0, b) * pow(u, 1.0 / a);
+  }
+
+  d = a - 1.0 / 3.0;
+  c = 1.0 / sqrt(9.0 * d);
+  while (1) {
+    do {
+      x = mg_random_normal(s, 0.0, 1.0);
+      v = 1.0 + c * x;
+    } while (v <= 0.0);
+    v = v * v * v;
+    u = mg_random_open(s);
+    if (u < 1.0 - 0.0331 * x * x * x * x) break;
+    if (log(u) < 0.5 * x * x + d * (1.0 - v + log(v))) break;
+  }
+
+  return b * d * v;
+}
+
+
+// multiplication method for small means, Hormann's PTRS otherwise
+static double mg_random_poisson(mg_random_stream *s, double mu, double b) {
+  double limit, product, k, slam, loglam, pb, pa, invalpha, vr, u, v, us;
+
+  if (mu < 10.0) {
+    limit = exp(-mu);
+    product = mg_random_open(s);
+    for (k = 0.0; product > limit; k += 1.0) product *= mg_random_open(s);
+    return k;
+  }
+
+  slam = sqrt(mu);
+  loglam = log(mu);
+  pb = 0.931 + 2.53 * slam;
+  pa = -0.059 + 0.02483 * pb;
+  invalpha = 1.1239 + 1.1328 / (pb - 3.4);
+  vr = 0.9277 - 3.6224 / (pb - 2.0);
+
+  while (1) {
+    u = mg_random_open(s) - 0.5;
+    v = mg_random_open(s);
+    us = 0.5 - fabs(u);
+    k = floor((2.0 * pa / us + pb) * u + mu + 0.43);
+    if (us >= 0.07 && v <= vr) return k;
+    if (k < 0.0 || (us < 0.013 && v > us)) continue;
+    if (log(v) + log(invalpha) - log(pa / (us * us) + pb)
+          <= -mu + k * loglam - mg_random_log_factorial(k)) {
+      return k;
+    }
+  }
+}
+
+
+// inversion for small means, Hormann's BTRS otherwise
+static double mg_random_binomial(mg_random_stream *s, double n, double p) {
+  double q, np, px, qn, bound, u, v, us, k, spq, pb, pa, c, vr, alpha, lpq, m, h;
+  int flip = p > 0.5;
+
+  if (flip) p = 1.0 - p;
+  q = 1.0 - p;
+  np = n * p;
+  if (np == 0.0) return flip ? n : 0.0;
+
+  if (np < 30.0) {
+    qn = exp(n * log(q));
+    bound = fmin(n, np + 10.0 * sqrt(np * q + 1.0));
+    k = 0.0;
+    px = qn;
+    u = mg_random_open(s);
+    while (u > px) {
+      k += 1.0;
+      if (k > bound) {
+        k = 0.0;
+        px = qn;
+        u = mg_random_open(s);
+      } else {
+        u -= px;
+        px = ((n - k + 1.0) * p * px) / (k * q);
+      }
+    }
+    return flip ? n - k : k;
+  }
+
+  spq = sqrt(np * q);
+  pb = 1.15 + 2.53 * spq;
+  pa = -0.0873 + 0.0248 * pb + 0.01 * p;
+  c = np + 0.5;
+  vr = 0.92 - 4.2 / pb;
+  alpha = (2.83 + 5.1 / pb) * spq;
+  lpq = log(p / q);
+  m = floor((n + 1.0) * p);
+  h = mg_random_log_factorial(m) + mg_random_log_factorial(n - m);
+
+  while (1) {
+    u = mg_random_open(s) - 0.5;
+    v = mg_random_open(s);
+    us = 0.5 - fabs(u);
+    k = floor((2.0 * pa / us + pb) * u + c);
+    if (k < 0.0 || k > n) continue;
+    if (us >= 0.07 && v <= vr) break;
+    v = log(v * alpha / (pa / (us * us) + pb));
+    if (v <= h - mg_random_log_factorial(k) - mg_random_log_factorial(n - k)
+               + (k - m) * lpq) {
+      break;
+    }
+  }
+
+  return flip ? n - k : k;
+}
+
+
+static double mg_random_bernoulli(mg_random_stream *s, double p, double b) {
+  return mg_random_open(s) < p ? 1.0 : 0.0;
+}
+
+
+static double mg_random_beta(mg_random_stream *s, double a, double b) {
+  double x = mg_random_gamma(s, a, 1.0);
+  return x / (x + mg_random_gamma(s, b, 1.0));
+}
+
+
+static double mg_random_cauchy(mg_random_stream *s, double a, double b) {
+  return a * tan(MG_RANDOM_PI * (mg_random_open(s) - 0.5));
+}
+
+
+static double mg_random_chisq(mg_random_stream *s, double nu, double b) {
+  return mg_random_gamma(s, 0.5 * nu, 2.0);
+}
+
+
+static double mg_random_exponential(mg_random_stream *s, double mu, double b) {
+  return -mu * log(mg_random_open(s));
+}
+
+
+static double mg_random_fdist(mg_random_stream *s, double nu1, double nu2) {
+  double x = mg_random_gamma(s, 0.5 * nu1, 2.0) / nu1;
+  return x / (mg_random_gamma(s, 0.5 * nu2, 2.0) / nu2);
+}
+
+
+// number of trials up to and including the first success
+static double mg_random_geometric(mg_random_stream *s, double p, double b) {
+  if (p == 1.0) return 1.0;
+  return ceil(log(mg_random_open(s)) / log1p(-p));
+}
+
+
+static double mg_random_laplace(mg_random_stream *s, double a, double b) {
+  double u = mg_random_open(s);
+  return u < 0.5 ? a * log(2.0 * u) : -a * log(2.0 * (1.0 - u));
+}
+
+
+static double mg_random_logistic(mg_random_stream *s, double a, double b) {
+  double u = mg_random_open(s);
+  return a * log(u / (1.0 - u));
+}
+
+
+static double mg_random_lognormal(mg_random_stream *s, double zeta, double sigma) {
+  return exp(mg_random_normal(s, zeta, sigma));
+}
+
+
+// number of failures before n successes, as a gamma mixture of Poissons
+static double mg_random_negative_binomial(mg_random_stream *s, double n, double p) {
+  if (p == 1.0) return 0.0;
+  return mg_random_poisson(s, mg_random_gamma(s, n, (1.0 - p) / p), 0.0);
+}
+
+
+static double mg_random_pareto(mg_random_stream *s, double a, double b) {
+  return b / pow(mg_random_open(s), 1.0 / a);
+}
+
+
+static double mg_random_rayleigh(mg_random_stream *s, double sigma, double b) {
+  return sigma * sqrt(-2.0 * log(mg_random_open(s)));
+}
+
+
+static double mg_random_tdist(mg_random_stream *s, double nu, double b) {
+  double x = mg_random_normal(s, 0.0, 1.0);
+  return x / sqrt(mg_random_gamma(s, 0.5 * nu, 2.0) / nu);
+}
+
+
+static double mg_random_weibull(mg_random_stream *s, double a, double b) {
+  return a * pow(-log(mg_random_open(s)), 1.0 / b);
+}
+
+
+// in the order of the MG_RANDOM_* distribution codes
+static mg_random_distribution mg_random_distributions[] = {
+  { "bernoulli",         mg_random_bernoulli,         1, 1, 0.0, 0.0, 1 },
+  { "beta",              mg_random_beta,              2, 2, 0.0, 0.0, 0 },
+  { "binomial",          mg_random_binomial,          2, 2, 0.0, 0.0, 1 },
+  { "cauchy",            mg_random_cauchy,            0, 1, 1.0, 0.0, 0 },
+  { "chisq",             mg_random_chisq,             1, 1, 0.0, 0.0, 0 },
+  { "exponential",       mg_random_exponential,       0, 1, 1.0, 0.0, 0 },
+  { "fdist",             mg_random_fdist,             2, 2, 0.0, 0.0, 0 },
+  { "gamma",             mg_random_gamma,             1, 2, 0.0, 1.0, 0 },
+  { "geometric",         mg_random_geometric,         1, 1, 0.0, 0.0, 1 },
+  { "laplace",           mg_random_laplace,           0, 1, 1.0, 0.0, 0 },
+  { "logistic",          mg_random_logistic,          0, 1, 1.0, 0.0, 0 },
+  { "lognormal",         mg_random_lognormal,         0, 2, 0.0, 1.0, 0 },
+  { "negative_binomial", mg_random_negative_binomial, 2, 2, 0.0, 0.0, 1 },
+  { "normal",            mg_random_normal,            0, 2, 0.0, 1.0, 0 },
+  { "pareto",            mg_random_pareto,            2, 2, 0.0, 0.0, 0 },
+  { "poisson",           mg_random_poisson,           1, 1, 0.0, 0.0, 1 },
+  { "rayleigh",          mg_random_rayleigh,          0, 1, 1.0, 0.0, 0 },
+  { "tdist",             mg_random_tdist,             1, 1, 0.0, 0.0, 0 },
+  { "uniform",           NULL,                        0, 2, 0.0, 1.0, 0 },
+  { "weibull",           mg_random_weibull,           2, 2, 0.0, 0.0, 0 },
+  { NULL }
+};
+
+
+// returns an error message for invalid parameters, NULL if valid
+static char *mg_random_check(int distribution, double a, double b) {
+  switch (distribution) {
+    case MG_RANDOM_BERNOULLI:
+      return a >= 0.0 && a <= 1.0 ? NULL : "p must be in [0, 1]";
+    case MG_RANDOM_BINOMIAL:
+      if (a < 0.0 || a != floor(a) || a > 9007199254740992.0) {
+        return "n must be a non-negative integer";
+      }
+      return b >= 0.0 && b <= 1.0 ? NULL : "p must be in [0, 1]";
+    case MG_RANDOM_GEOMETRIC:
+      return a > 0.0 && a <= 1.0 ? NULL : "p must be in (0, 1]";
+    case MG_RANDOM_LOGNORMAL:
+    case MG_RANDOM_NORMAL:
+      return b >= 0.0 ? NULL : "sigma must be non-negative";
+    case MG_RANDOM_NEGATIVE_BINOMIAL:
+      if (!(a > 0.0)) return "n must be positive";
+      return b > 0.0 && b <= 1.0 ? NULL : "p must be in (0, 1]";
+    case MG_RANDOM_POISSON:
+      return a >= 0.0 && a < 1.0e15 ? NULL : "mu must be in [0, 1e15)";
+    case MG_RANDOM_UNIFORM:
+      return a <= b ? NULL : "lower limit must not be above upper limit";
+    case MG_RANDOM_BETA:
+    case MG_RANDOM_FDIST:
+    case MG_RANDOM_GAMMA:
+    case MG_RANDOM_PARETO:
+    case MG_RANDOM_WEIBULL:
+      if (!(b > 0.0)) return "parameters must be positive";
+    default:
+      return a > 0.0 ? NULL : "parameters must be positive";
+  }
+}
+
+
+/*
+  Uniform values, WORDS 32-bit words each, packed into blocks. EXPR is the
+  value from the words w[0], ..., w[WORDS - 1].
+*/
+#define MG_RANDOM_UNIFORM_FILL(NAME, TYPE, WORDS, EXPR)                      \
+static void mg_random_uniform_ ## NAME(IDL_MEMINT start, IDL_MEMINT end,      \
+                                       int thread_index, void *data) {        \
+  mg_random_info *info = (mg_random_info *) data;                             \
+  TYPE *result = (TYPE *) info->result;                                       \
+  IDL_ULONG counter[4] = { 0, 0, 0, MG_RANDOM_PACKED }, bits[4], *w;          \
+  IDL_ULONG64 index, block;                                                   \
+  IDL_MEMINT i;                                                               \
+                                                                              \
+  index = info->position + (IDL_ULONG64) start;                               \
+  block = index / (4 / WORDS) - 1;                                            \
+  for (i = start; i < end; i++, index++) {                                    \
+    if (index / (4 / WORDS) != block) {                                       \
+      block = index / (4 / WORDS);                                            \
+      counter[0] = (IDL_ULONG) block;                                         \
+      counter[1] = (IDL_ULONG) (block >> 32);                                 \
+      mg_random_philox(counter, info->key, bits);                             \
+    }                                                                         \
+    w = bits + (index % (4 / WORDS)) * WORDS;                                 \
+    result[i] = EXPR;                                                         \
+  }                                                                           \
+}
+
+MG_RANDOM_UNIFORM_FILL(float, float, 1,
+                       (float) (info->a + (info->b - info->a)
+                                            * ((w[0] >> 8) * (1.0 / 16777216.0))))
+MG_RANDOM_UNIFORM_FILL(double, double, 2,
+                       info->a + (info->b - info->a)
+                                   * ((((IDL_ULONG64) w[0] << 21) | (w[1] >> 11))
+                                      * (1.0 / 9007199254740992.0)))
+MG_RANDOM_UNIFORM_FILL(long, IDL_LONG, 1, (IDL_LONG) (w[0] >> 1))
+MG_RANDOM_UNIFORM_FILL(ulong, IDL_ULONG, 1, w[0])
+MG_RANDOM_UNIFORM_FILL(long64, IDL_LONG64, 2,
+                       (IDL_LONG64) ((((IDL_ULONG64) w[0] << 32) | w[1]) >> 1))
+MG_RANDOM_UNIFORM_FILL(ulong64, IDL_ULONG64, 2,
+                       ((IDL_ULONG64) w[0] << 32) | w[1])
+
+
+// values of other distributions, each from its own stream
+static void mg_random_work(IDL_MEMINT start, IDL_MEMINT end,
+                           int thread_index, void *data) {
+  mg_random_info *info = (mg_random_info *) data;
+  mg_random_stream s;
+  IDL_MEMINT i;
+  double x;
+
+  for (i = start; i < end; i++) {
+    mg_random_seek(&s, info->key, info->position + (IDL_ULONG64) i);
+    x = info->sampler(&s, info->a, info->b);
+    switch (info->type) {
+      case IDL_TYP_FLOAT:
+        ((float *) info->result)[i] = (float) x;
+        break;
+      case IDL_TYP_DOUBLE:
+        ((double *) info->result)[i] = x;
+        break;
+      case IDL_TYP_LONG:
+        ((IDL_LONG *) info->result)[i] = x > 2147483647.0 ? 2147483647 : (IDL_LONG) x;
+        break;
+      case IDL_TYP_ULONG:
+        ((IDL_ULONG *) info->result)[i] = x > 4294967295.0 ? 4294967295U : (IDL_ULONG) x;
+        break;
+      case IDL_TYP_LONG64:
+        ((IDL_LONG64 *) info->result)[i] = (IDL_LONG64) x;
+        break;
+      case IDL_TYP_ULONG64:
+        ((IDL_ULONG64 *) info->result)[i] = (IDL_ULONG64) x;
+        break;
+    }
+  }
+}
+
+
+// key and position from a seed or state; an undefined seed uses the time
+static void mg_random_get_state(IDL_VPTR var, mg_random_info *info) {
+  IDL_VPTR lng;
+  IDL_MEMINT n;
+  IDL_ULONG64 *values, key;
+
+  if (var->type == IDL_TYP_UNDEF) {
+    key = mg_kmeans_get_seed(NULL);
+    info->position = 0;
+  } else {
+    IDL_ENSURE_SIMPLE(var);
+    if (var->type != IDL_TYP_LONG64 && var->type != IDL_TYP_ULONG64
+          && !(IDL_TYP_MASK(var->type) & (IDL_TYP_MASK(IDL_TYP_BYTE)
+                                          | IDL_TYP_MASK(IDL_TYP_INT)
+                                          | IDL_TYP_MASK(IDL_TYP_LONG)
+                                          | IDL_TYP_MASK(IDL_TYP_UINT)
+                                          | IDL_TYP_MASK(IDL_TYP_ULONG)))) {
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "seed must be an integer or a state from MG_RANDOM");
+    }
+    lng = var->type == IDL_TYP_LONG64 || var->type == IDL_TYP_ULONG64
+            ? var
+            : IDL_CvtLng64(1, &var, NULL);
+    IDL_VarGetData(lng, &n, (char **) &values, FALSE);
+    if (n > 2) {
+      if (lng != var) IDL_Deltmp(lng);
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "seed must be an integer or a state from MG_RANDOM");
+    }
+    key = values[0];
+    info->position = n == 2 ? values[1] : 0;
+    if (lng != var) IDL_Deltmp(lng);
+  }
+
+  info->key[0] = (IDL_ULONG) key;
+  info->key[1] = (IDL_ULONG) (key >> 32);
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_random(int argc, IDL_VPTR *argv, char *argk) {
+  IDL_VPTR seed = argv[0], result, dims_lng, params_dbl, state;
+  mg_random_info info;
+  mg_random_distribution *dist;
+  IDL_MEMINT d, n_dims = 0, n = 1, dims[IDL_MAX_ARRAY_DIM], n_params = 0;
+  IDL_LONG64 *dims_values;
+  IDL_ULONG64 *state_values;
+  double *params;
+  char *name, lower[32], *msg;
+  int nargs, distribution = MG_RANDOM_UNIFORM, n_types, min_elts;
+  mg_thread_work work = mg_random_work;
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_VPTR distribution;
+    int distribution_present;
+    IDL_LONG double_keyword;
+    IDL_LONG l64;
+    IDL_LONG long_keyword;
+    IDL_LONG n_threads;
+    IDL_VPTR parameters;
+    int parameters_present;
+    IDL_LONG ul64;
+    IDL_LONG ulong_keyword;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "DISTRIBUTION", IDL_TYP_UNDEF, 1, IDL_KW_VIN | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(distribution_present), IDL_KW_OFFSETOF(distribution) },
+    { "DOUBLE", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(double_keyword) },
+    { "L64", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(l64) },
+    { "LONG", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(long_keyword) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { "PARAMETERS", IDL_TYP_UNDEF, 1, IDL_KW_VIN | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(parameters_present), IDL_KW_OFFSETOF(parameters) },
+    { "UL64", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(ul64) },
+    { "ULONG", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(ulong_keyword) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+
+  // dimensions of the result, as separate arguments or an array
+  if (nargs == 2 && (argv[1]->flags & IDL_V_ARR)) {
+    IDL_ENSURE_SIMPLE(argv[1]);
+    if (argv[1]->value.arr->n_elts > IDL_MAX_ARRAY_DIM) {
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "too many dimensions");
+    }
+    dims_lng = argv[1]->type == IDL_TYP_LONG64 ? argv[1] : IDL_CvtLng64(1, &argv[1], NULL);
+    dims_values = (IDL_LONG64 *) dims_lng->value.arr->data;
+    n_dims = dims_lng->value.arr->n_elts;
+    for (d = 0; d < n_dims; d++) dims[d] = (IDL_MEMINT) dims_values[d];
+    if (dims_lng != argv[1]) IDL_Deltmp(dims_lng);
+  } else {
+    n_dims = nargs - 1;
+    for (d = 0; d < n_dims; d++) dims[d] = IDL_MEMINTScalar(argv[d + 1]);
+  }
+  for (d = 0; d < n_dims; d++) {
+    if (dims[d] < 1) {
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "dimensions must be positive");
+    }
+    n *= dims[d];
+  }
+
+  // distribution by name
+  if (kw.distribution_present && kw.distribution->type != IDL_TYP_UNDEF) {
+    if (kw.distribution->type != IDL_TYP_STRING || (kw.distribution->flags & IDL_V_ARR)) {
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "DISTRIBUTION must be a scalar string");
+    }
+    name = IDL_STRING_STR(&kw.distribution->value.str);
+    for (d = 0; name[d] && d < 31; d++) lower[d] = (char) tolower(name[d]);
+    lower[d] = '\0';
+    for (distribution = 0; mg_random_distributions[distribution].name; distribution++) {
+      if (strcmp(lower, mg_random_distributions[distribution].name) == 0) break;
+    }
+    if (mg_random_distributions[distribution].name == NULL) {
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "unknown distribution %s", name);
+    }
+  }
+  dist = &mg_random_distributions[distribution];
+
+  // parameters of the distribution, missing ones take the defaults
+  memset(&info, 0, sizeof(info));
+  info.sampler = dist->sampler;
+  info.a = dist->a;
+  info.b = dist->b;
+  if (kw.parameters_present && kw.parameters->type != IDL_TYP_UNDEF) {
+    IDL_ENSURE_SIMPLE(kw.parameters);
+    params_dbl = kw.parameters->type == IDL_TYP_DOUBLE
+                   ? kw.parameters
+                   : IDL_CvtDbl(1, &kw.parameters, NULL);
+    IDL_VarGetData(params_dbl, &n_params, (char **) &params, FALSE);
+    if (n_params > 0) info.a = params[0];
+    if (n_params > 1) info.b = params[1];
+    if (params_dbl != kw.parameters) IDL_Deltmp(params_dbl);
+  }
+  if (n_params < dist->min_params || n_params > dist->max_params) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "%s distribution takes %d to %d parameters",
+                dist->name, dist->min_params, dist->max_params);
+  }
+  if ((msg = mg_random_check(distribution, info.a, info.b)) != NULL) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "invalid %s parameters: %s", dist->name, msg);
+  }
+
+  // type of the result
+  n_types = (kw.double_keyword != 0) + (kw.l64 != 0) + (kw.long_keyword != 0)
+              + (kw.ul64 != 0) + (kw.ulong_keyword != 0);
+  info.type = dist->discrete ? IDL_TYP_LONG : IDL_TYP_FLOAT;
+  if (kw.double_keyword) info.type = IDL_TYP_DOUBLE;
+  if (kw.l64) info.type = IDL_TYP_LONG64;
+  if (kw.long_keyword) info.type = IDL_TYP_LONG;
+  if (kw.ul64) info.type = IDL_TYP_ULONG64;
+  if (kw.ulong_keyword) info.type = IDL_TYP_ULONG;
+  if (n_types > 1) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "conflicting result types specified");
+  }
+  if (n_types == 1 && !kw.double_keyword && !dist->discrete
+        && (distribution != MG_RANDOM_UNIFORM || n_params > 0)) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "integer results require a discrete distribution or uniform bits");
+  }
+
+  mg_random_get_state(seed, &info);
+
+  if (n_dims == 0) {
+    result = IDL_Gettmp();
+    result->type = info.type;
+    info.result = (char *) &result->value;
+  } else {
+    info.result = IDL_MakeTempArray(info.type, n_dims, dims, IDL_ARR_INI_NOP, &result);
+  }
+
+  min_elts = MG_STATS_MIN_ELTS;
+  if (distribution == MG_RANDOM_UNIFORM) {
+    switch (info.type) {
+      case IDL_TYP_FLOAT: work = mg_random_uniform_float; break;
+      case IDL_TYP_DOUBLE: work = mg_random_uniform_double; break;
+      case IDL_TYP_LONG: work = mg_random_uniform_long; break;
+      case IDL_TYP_ULONG: work = mg_random_uniform_ulong; break;
+      case IDL_TYP_LONG64: work = mg_random_uniform_long64; break;
+      case IDL_TYP_ULONG64: work = mg_random_uniform_ulong64; break;
+    }
+  } else {
+    min_elts /= 16;
+  }
+  mg_thread_run(mg_thread_count(n, min_elts, kw.n_threads), n, work, &info);
+
+  // the state for the next call, unless the seed is an expression
+  if (!(seed->flags & (IDL_V_CONST | IDL_V_TEMP))) {
+    dims[0] = 2;
+    state_values = (IDL_ULONG64 *) IDL_MakeTempArray(IDL_TYP_ULONG64, 1, dims,
+                                                     IDL_ARR_INI_NOP, &state);
+    state_values[0] = (IDL_ULONG64) info.key[0] | ((IDL_ULONG64) info.key[1] << 32);
+    state_values[1] = info.position + (IDL_ULONG64) n;
+    IDL_VarCopy(state, seed);
+  }
+
+  IDL_KW_FREE;
+
+  return result;
+}
+
+
+int IDL_Load(void) {
+  /*
+   * These tables contain information on the functions and procedures
+   * that make up the stats DLM. The information contained in these
+   * tables must be identical to that contained in mg_stats.dlm.
+   */
+  static IDL_SYSFUN_DEF2 function_addr[] = {
+    { IDL_mg_quantiles,   "MG_QUANTILES",   2, 2, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+    { IDL_mg_median_deviation,
+                          "MG_MEDIAN_DEVIATION",
+                                            1, 1, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+    { IDL_mg_smallest,    "MG_SMALLEST",    2, 2, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+    { IDL_mg_histogram_nd,
+                          "MG_HISTOGRAM_ND",
+                                            1, 1, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+    { IDL_mg_window_moments,
+                          "MG_WINDOW_MOMENTS",
+                                            2, 2, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+    { IDL_mg_kdtree_build,
+                          "MG_KDTREE_BUILD",
+                                            1, 1, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+    { IDL_mg_kdtree_query,
+                          "MG_KDTREE_QUERY",
+                                            3, 3, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+    { IDL_mg_kdtree_query_radius,
+                          "MG_KDTREE_QUERY_RADIUS",
+                                            3, 3, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+    { IDL_mg_kmeans_fit,  "MG_KMEANS_FIT",  2, 2, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+    { IDL_mg_kmeans_predict,
+                          "MG_KMEANS_PREDICT",
+                                            2, 2, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+    { IDL_mg_random,      "MG_RANDOM",      1, 9, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+  };
+
+  /*
+   * Register our routines. The routines must be specified exactly the same
+   * as in mg_stats.dlm.
+   */
+  return IDL_SysRtnAdd(function_addr, TRUE, IDL_CARRAY_ELTS(function_addr));
+}
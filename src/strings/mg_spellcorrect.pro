@@ -44,27 +44,96 @@ function mg_spellcorrect_generate_hash
                        or bindgen(256) gt 122)
   ignore = string(byte(ignore_ind[1:*]))
   words = strsplit(text, ignore, /extract)
-  nwords = n_elements(words)
 
-  model = hash()
-  start = 0L
+  ; count the occurrences of each word
+  words = words[sort(words)]
+  last = uniq(words)
+  counts = last - [-1L, last[0:-2]]
 
-  for w = 0L, nwords - 1L do begin
-    word = strlowcase(words[w])
+  return, hash(words[last], counts)
+end
 
-    if ((w mod 10000) eq 0) then begin
-      print, 100. * w / nwords, w, nwords, $
-             format='(%"%0.1f\% completed: %d out of %d done")'
-    endif
 
-    if (model->hasKey(word)) then begin
-      model[word] = model[word] + 1L
-    endif else begin
-      model[word] = 1L
-    endelse
-  endfor
+;+
+; Returns the spelling index for the `mg_strings` DLM made from a known words
+; hash. The index of the default dictionary is written to a file next to it
+; the first time it is needed, and the filename is returned so the DLM can
+; map it; if the file cannot be written, the index itself is returned.
+;
+; :Returns:
+;    string filename or `bytarr` index
+;
+; :Params:
+;    spell_hash : in, out, optional, type=hash: string->long
+;       hash of known word frequencies; the default dictionary is used if
+;       not given, and passed out if `known_words` is present
+;
+; :Keywords:
+;    default : in, optional, type=boolean
+;       set to use the default dictionary
+;    known_words_present : in, optional, type=boolean
+;       set if the known words hash should be returned for the default
+;       dictionary
+;-
+function mg_spellcorrect_index, spell_hash, default=default, $
+                                known_words_present=known_words_present
+  compile_opt strictarr, hidden
+
+  if (~keyword_set(default)) then begin
+    return, mg_spell_index((spell_hash->keys())->toArray(), $
+                           (spell_hash->values())->toArray())
+  endif
+
+  index_filename = filepath('spell_index.bin', $
+                            subdir='dictionary', $
+                            root=mg_src_root())
+  if (file_test(index_filename) && ~keyword_set(known_words_present)) then begin
+    return, index_filename
+  endif
+
+  spell_hash = mg_spellcorrect_load_hash()
+  if (file_test(index_filename)) then return, index_filename
+
+  index = mg_spell_index((spell_hash->keys())->toArray(), $
+                         (spell_hash->values())->toArray())
+
+  error = 0L
+  catch, error
+  if (error ne 0L) then begin
+    catch, /cancel
+    if (n_elements(lun) gt 0L) then free_lun, lun
+    return, index
+  endif
+
+  openw, lun, index_filename, /get_lun
+  writeu, lun, index
+  free_lun, lun
 
-  return, model
+  return, index_filename
+end
+
+
+;+
+; Loads the known words hash of the default dictionary, generating it if
+; needed.
+;
+; :Returns:
+;    hash: string->long
+;-
+function mg_spellcorrect_load_hash
+  compile_opt strictarr, hidden
+
+  spell_hash_filename = filepath('spell_hash.sav', $
+                                 subdir='dictionary', $
+                                 root=mg_src_root())
+  if (file_test(spell_hash_filename)) then begin
+    restore, filename=spell_hash_filename
+  endif else begin
+    spell_hash = mg_spellcorrect_generate_hash()
+    save, spell_hash, filename=spell_hash_filename
+  endelse
+
+  return, spell_hash
 end
 
 
@@ -177,58 +246,98 @@ end
 
 
 ;+
-; Corrects the spelling of a word.
+; Corrects the spelling of a word or an array of words.
+;
+; Uses a spelling index from the `mg_strings` DLM when it is available; the
+; index of the default dictionary is stored next to it and mapped on first
+; use. Otherwise, the edits of each word are checked in IDL.
 ;
 ; :Returns:
-;   string
+;   string/strarr
 ;
 ; :Params:
-;   word : in, required, type=string
-;     string to check spelling of
+;   word : in, required, type=string/strarr
+;     string(s) to check spelling of
 ;
 ; :Keywords:
 ;   known_words : in, out, optional, type=hash object
 ;     can be passed in to avoid reading/construction the known words
 ;     frequency table; will be passed out if given a named variable
-;   correct : out, optional, type=boolean
+;   correct : out, optional, type=boolean/bytarr
 ;     set to a named variable to indicate if the word passed in was
 ;     correctly spelled
-;   found : out, optional, type=boolean
+;   found : out, optional, type=boolean/bytarr
 ;     set to a named variable to return whether a match was found for the
 ;     incorrect word
+;   max_distance : in, optional, type=long, default=2
+;     maximum number of edits from a word to its correction; more than 2
+;     requires the `mg_strings` DLM
+;   n_threads : in, optional, type=long
+;     number of threads to use with the `mg_strings` DLM, default is the
+;     number of processors
 ;-
 function mg_spellcorrect, word, $
                           known_words=spell_hash, $
                           correct=correct, $
-                          found=found
+                          found=found, $
+                          max_distance=max_distance, $
+                          n_threads=n_threads
   compile_opt strictarr
+  on_error, 2
 
-  found = 0B
+  _max_distance = mg_default(max_distance, 2L)
 
-  if (n_elements(spell_hash) eq 0L) then begin
-    spell_hash_filename = filepath('spell_hash.sav', $
-                                   subdir='dictionary', $
-                                   root=mg_src_root())
-    if (file_test(spell_hash_filename)) then begin
-      restore, filename=spell_hash_filename
+  if (mg_hasroutine('mg_spell_index')) then begin
+    if (_max_distance gt 2L) then begin
+      if (n_elements(spell_hash) eq 0L) then spell_hash = mg_spellcorrect_load_hash()
+      index = mg_spell_index((spell_hash->keys())->toArray(), $
+                             (spell_hash->values())->toArray(), $
+                             max_distance=_max_distance)
     endif else begin
-      spell_hash = mg_spellcorrect_generate_hash()
-      save, spell_hash, filename=spell_hash_filename
+      index = mg_spellcorrect_index(spell_hash, $
+                                    default=n_elements(spell_hash) eq 0L, $
+                                    known_words_present=arg_present(spell_hash))
     endelse
+    return, mg_spell_correct(index, word, correct=correct, found=found, $
+                             max_distance=_max_distance, n_threads=n_threads)
   endif
 
+  if (_max_distance gt 2L) then begin
+    message, 'MAX_DISTANCE greater than 2 requires the mg_strings DLM'
+  endif
+
+  if (n_elements(spell_hash) eq 0L) then spell_hash = mg_spellcorrect_load_hash()
+
+  if (size(word, /n_dimensions) gt 0L) then begin
+    corrections = strarr(size(word, /dimensions))
+    correct = bytarr(size(word, /dimensions))
+    found = bytarr(size(word, /dimensions))
+    for w = 0L, n_elements(word) - 1L do begin
+      corrections[w] = mg_spellcorrect(word[w], known_words=spell_hash, $
+                                       correct=c, found=f, $
+                                       max_distance=_max_distance)
+      correct[w] = c
+      found[w] = f
+    endfor
+    return, corrections
+  endif
+
+  found = 0B
+
   candidates = mg_spellcorrect_known(hash(word, 1B), known_hash=spell_hash)
 
   if (n_elements(candidates) eq 0L) then begin
     correct = 0B
-    candidates += mg_spellcorrect_known(mg_spellcorrect_edits1(word), known_hash=spell_hash)
+    if (_max_distance ge 1L) then begin
+      candidates += mg_spellcorrect_known(mg_spellcorrect_edits1(word), known_hash=spell_hash)
+    endif
   endif else begin
     correct = 1B
     found = 1B
     return, word
   endelse
 
-  if (n_elements(candidates) eq 0L) then begin
+  if (n_elements(candidates) eq 0L && _max_distance ge 2L) then begin
     candidates += mg_spellcorrect_known_edits2(word, known_hash=spell_hash)
   endif
 
@@ -5,114 +5,341 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <limits.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
 
 #include "mg_idl_export.h"
+#include "mg_threads.h"
 #include "tre/tre.h"
 
 
 
 // define the structure for a match
-struct mg_regmatch {
-  struct mg_regmatch *next;
+typedef struct {
   int cost;
   regoff_t rm_so;
   regoff_t rm_eo;
-};
-typedef struct mg_regmatch mg_regmatch_t;
+} mg_regmatch_t;
+
+// a piece of the input still to search, or a match waiting for the matches
+// before it to be found
+typedef struct {
+  int start;
+  int end;
+  int cost;                // -1 for a piece of input
+} mg_regpiece_t;
+
+/*
+  Growable arrays for the matches found by a thread and for the pieces of
+  the input it still has to search, reused for each string and freed all at
+  once by mg_freearena.
+*/
+typedef struct {
+  mg_regmatch_t *matches;
+  IDL_MEMINT n_matches;
+  IDL_MEMINT matches_size;
+  mg_regpiece_t *pieces;
+  IDL_MEMINT n_pieces;
+  IDL_MEMINT pieces_size;
+  int failed;              // set if memory could not be allocated
+} mg_regarena_t;
+
+
+// returns 0 and sets failed if memory is not available
+static int mg_addmatch(mg_regarena_t *arena, int start, int end, int cost) {
+  mg_regmatch_t *matches;
+  IDL_MEMINT size;
+
+  if (arena->n_matches == arena->matches_size) {
+    size = arena->matches_size ? 2 * arena->matches_size : 64;
+    matches = (mg_regmatch_t *) realloc(arena->matches, size * sizeof(mg_regmatch_t));
+    if (matches == NULL) {
+      arena->failed = 1;
+      return 0;
+    }
+    arena->matches = matches;
+    arena->matches_size = size;
+  }
 
+  arena->matches[arena->n_matches].cost = cost;
+  arena->matches[arena->n_matches].rm_so = start;
+  arena->matches[arena->n_matches].rm_eo = end;
+  arena->n_matches++;
 
-static IDL_VPTR IDL_CDECL IDL_mg_strsplit(int argc, IDL_VPTR *argv) {
-  return IDL_GettmpLong(5);
+  return 1;
 }
 
-static mg_regmatch_t *mg_getamatches(regex_t *preg,
-                                     char *input, int offset, int input_length,
-                                     int cost_ins, int cost_del, int cost_subst,
-                                     int max_cost, int max_del, int max_err,
-                                     int max_ins, int max_subst,
-                                     int find_all) {
 
-  regamatch_t amatch;
-  regaparams_t match_params;
-  regmatch_t pmatch[1];
+// returns 0 and sets failed if memory is not available
+static int mg_addpiece(mg_regarena_t *arena, int start, int end, int cost) {
+  mg_regpiece_t *pieces;
+  IDL_MEMINT size;
+
+  if (arena->n_pieces == arena->pieces_size) {
+    size = arena->pieces_size ? 2 * arena->pieces_size : 64;
+    pieces = (mg_regpiece_t *) realloc(arena->pieces, size * sizeof(mg_regpiece_t));
+    if (pieces == NULL) {
+      arena->failed = 1;
+      return 0;
+    }
+    arena->pieces = pieces;
+    arena->pieces_size = size;
+  }
+
+  arena->pieces[arena->n_pieces].start = start;
+  arena->pieces[arena->n_pieces].end = end;
+  arena->pieces[arena->n_pieces].cost = cost;
+  arena->n_pieces++;
+
+  return 1;
+}
+
 
-  mg_regmatch_t *current_match = NULL;
-  mg_regmatch_t *match = NULL;
-  mg_regmatch_t *before_match = NULL;
-  mg_regmatch_t *after_match = NULL;
+static void mg_freearena(mg_regarena_t *arena) {
+  if (arena->matches) free(arena->matches);
+  if (arena->pieces) free(arena->pieces);
+  memset(arena, 0, sizeof(mg_regarena_t));
+}
 
-  int search_status;
 
-  // initialize the match params and match
-  tre_regaparams_default(&match_params);
-  match_params.cost_ins = cost_ins;
-  match_params.cost_del = cost_del;
-  match_params.cost_subst = cost_subst;
-  match_params.max_cost = max_cost;
-  match_params.max_del = max_del;
-  match_params.max_err = max_err;
-  match_params.max_ins = max_ins;
-  match_params.max_subst = max_subst;
+/*
+  Adds the approximate matches of a regex in a string to the arena, in
+  order, stopping after max_matches; returns the number added. TRE finds the
+  best match in the input, so with find_all the pieces before and after each
+  match are searched in turn, using a stack of pieces: the piece before a
+  match is on top of the match, which is on top of the piece after it.
+*/
+static IDL_MEMINT mg_getamatches(regex_t *preg, char *input, int input_length,
+                                 regaparams_t *match_params,
+                                 int find_all, IDL_MEMINT max_matches,
+                                 mg_regarena_t *arena) {
+  regamatch_t amatch;
+  regmatch_t pmatch[1];
+  mg_regpiece_t piece;
+  IDL_MEMINT n_matches = 0;
+  int start, end;
 
   amatch.pmatch = pmatch;
   amatch.nmatch = 1;
 
-  search_status = tre_reganexec(preg, input, input_length,
-                                &amatch, match_params, 0);
+  arena->n_pieces = 0;
+  if (!mg_addpiece(arena, 0, input_length, -1)) return 0;
+
+  while (arena->n_pieces > 0 && n_matches < max_matches) {
+    piece = arena->pieces[--arena->n_pieces];
 
-  // return NULL pointer if nothing found
-  if (search_status || (pmatch[0].rm_so == pmatch[0].rm_eo)) {
-    return (mg_regmatch_t *)NULL;
+    // the matches before this one have been added
+    if (piece.cost >= 0) {
+      if (!mg_addmatch(arena, piece.start, piece.end, piece.cost)) break;
+      n_matches++;
+      continue;
+    }
+
+    if (tre_reganexec(preg, &input[piece.start], piece.end - piece.start,
+                      &amatch, *match_params, 0)) continue;
+    if (pmatch[0].rm_so == pmatch[0].rm_eo) continue;
+
+    start = piece.start + pmatch[0].rm_so;
+    end = piece.start + pmatch[0].rm_eo;
+    if (find_all && end < piece.end) {
+      if (!mg_addpiece(arena, end, piece.end, -1)) break;
+    }
+    if (!mg_addpiece(arena, start, end, amatch.cost)) break;
+    if (find_all && start > piece.start) {
+      if (!mg_addpiece(arena, piece.start, start, -1)) break;
+    }
   }
 
-  match = (mg_regmatch_t *) malloc(sizeof(mg_regmatch_t));
+  return n_matches;
+}
 
-  match->cost = amatch.cost;
-  match->rm_so = offset + pmatch[0].rm_so;
-  match->rm_eo = offset + pmatch[0].rm_eo;
-  match->next = NULL;
 
-  if (find_all) {
-    // search before match
-    if (pmatch[0].rm_so != 0) {
-      before_match = mg_getamatches(preg,
-                                    input, offset, pmatch[0].rm_so,
-                                    cost_ins, cost_del, cost_subst,
-                                    max_cost, max_del, max_err,
-                                    max_ins, max_subst,
-                                    find_all);
+// adds the exact matches of a regex in a string to the arena, see above
+static IDL_MEMINT mg_getmatches(regex_t *preg, char *input, int input_length,
+                                int find_all, IDL_MEMINT max_matches,
+                                mg_regarena_t *arena) {
+  regmatch_t pmatch[1];
+  IDL_MEMINT n_matches = 0;
+  int offset = 0;
+
+  while (offset <= input_length && n_matches < max_matches) {
+    if (tre_regexec(preg, &input[offset], (size_t) 1, pmatch,
+                    offset > 0 ? REG_NOTBOL : 0) != 0) break;
+
+    if (!mg_addmatch(arena, offset + pmatch[0].rm_so, offset + pmatch[0].rm_eo, 0)) {
+      break;
     }
+    n_matches++;
+
+    if (!find_all) break;
+
+    // continue after the match, skipping a character after an empty match
+    offset += pmatch[0].rm_eo + (pmatch[0].rm_eo == pmatch[0].rm_so ? 1 : 0);
+  }
+
+  return n_matches;
+}
+
+
+/*
+  Compiled regexes are kept in a small cache, keyed by the pattern and the
+  compile flags, so that calling MG_STREGEX repeatedly with the same pattern
+  only compiles it once. When the cache is full, the least recently used
+  regex is freed.
+*/
+
+#define MG_REGEX_CACHE_SIZE 32
+
+typedef struct {
+  char *pattern;           // NULL for an unused entry
+  int cflags;
+  regex_t preg;
+  unsigned long last_used;
+} mg_regex_cache_entry;
 
-    // search after match
-    if (pmatch[0].rm_eo < input_length) {
-      after_match = mg_getamatches(preg,
-                                   &input[pmatch[0].rm_eo],
-                                   offset + pmatch[0].rm_eo,
-                                   input_length - pmatch[0].rm_eo,
-                                   cost_ins, cost_del, cost_subst,
-                                   max_cost, max_del, max_err,
-                                   max_ins, max_subst,
-                                   find_all);
+static mg_regex_cache_entry mg_regex_cache[MG_REGEX_CACHE_SIZE];
+static unsigned long mg_regex_clock = 0;
+
+
+// compiled regex for a pattern, returns the TRE status of the compilation
+static int mg_regex_lookup(char *pattern, int cflags, regex_t **preg) {
+  mg_regex_cache_entry *entry = NULL;
+  int e, status;
+
+  for (e = 0; e < MG_REGEX_CACHE_SIZE; e++) {
+    if (mg_regex_cache[e].pattern
+          && mg_regex_cache[e].cflags == cflags
+          && strcmp(mg_regex_cache[e].pattern, pattern) == 0) {
+      mg_regex_cache[e].last_used = ++mg_regex_clock;
+      *preg = &mg_regex_cache[e].preg;
+      return 0;
+    }
+  }
+
+  // use an unused entry or the least recently used one
+  for (e = 0; e < MG_REGEX_CACHE_SIZE; e++) {
+    if (mg_regex_cache[e].pattern == NULL) {
+      entry = &mg_regex_cache[e];
+      break;
+    }
+    if (entry == NULL || mg_regex_cache[e].last_used < entry->last_used) {
+      entry = &mg_regex_cache[e];
     }
+  }
+  if (entry->pattern) {
+    tre_regfree(&entry->preg);
+    free(entry->pattern);
+    entry->pattern = NULL;
+  }
+
+  status = tre_regcomp(&entry->preg, pattern, cflags);
+  if (status != 0) return status;
+
+  entry->pattern = (char *) malloc(strlen(pattern) + 1);
+  if (entry->pattern == NULL) {
+    tre_regfree(&entry->preg);
+    return REG_ESPACE;
+  }
+  strcpy(entry->pattern, pattern);
+  entry->cflags = cflags;
+  entry->last_used = ++mg_regex_clock;
+  *preg = &entry->preg;
+
+  return 0;
+}
 
-    // merge lists
-    match->next = after_match;
-    if (before_match == NULL) return match;
 
-    current_match = before_match;
-    while (current_match->next) {
-      current_match = current_match->next;
+static char *mg_regex_error(int status) {
+  switch (status) {
+    case REG_BADPAT: return "regex contained an invalid multibyte sequence";
+    case REG_ECOLLATE: return "invalid collating element referenced in regex";
+    case REG_ECTYPE: return "unknown character class name in regex";
+    case REG_EESCAPE: return "last character of regex was a backslash";
+    case REG_ESUBREG: return "invalid back reference in regex";
+    case REG_EBRACK: return "unbalanced [] in regex";
+    case REG_EPAREN: return "unbalanced parentheses in regex";
+    case REG_EBRACE: return "unbalanced braces in regex";
+    case REG_BADBR: return "content invalid in regex";
+    case REG_ERANGE: return "invalid character range in regex";
+    case REG_ESPACE: return "out of memory in regex";
+    case REG_BADRPT: return "invalid use of repetition operators in regex";
+    default: return "invalid regex";
+  }
+}
+
+
+// minimum number of strings per thread
+#define MG_STREGEX_MIN_ELTS 256
+
+typedef struct {
+  regex_t *preg;
+  IDL_STRING *strings;
+  int approximate;
+  int all;
+  IDL_MEMINT max_matches;
+  regaparams_t match_params;
+
+  // matches found by each thread, in the order of the strings
+  mg_regarena_t *arenas;
+
+  // with ALL or a scalar string, the number of matches of each string
+  IDL_MEMINT *counts;
+
+  // otherwise, the first match of each string or -1
+  IDL_LONG *starts;
+  IDL_LONG *lengths;
+  IDL_LONG *costs;
+} mg_stregex_info;
+
+
+static void mg_stregex_work(IDL_MEMINT start, IDL_MEMINT end,
+                            int thread_index, void *data) {
+  mg_stregex_info *info = (mg_stregex_info *) data;
+  mg_regarena_t *arena = &info->arenas[thread_index];
+  mg_regmatch_t *first;
+  char *input;
+  IDL_MEMINT i, n;
+  int find_all = info->counts ? info->all : 0;
+
+  for (i = start; i < end && !arena->failed; i++) {
+    input = IDL_STRING_STR(&info->strings[i]);
+    if (info->approximate) {
+      n = mg_getamatches(info->preg, input, info->strings[i].slen,
+                         &info->match_params, find_all, info->max_matches,
+                         arena);
+    } else {
+      n = mg_getmatches(info->preg, input, info->strings[i].slen,
+                        find_all, info->max_matches, arena);
+    }
+
+    if (info->counts) {
+      info->counts[i] = n;
+    } else {
+      first = n > 0 ? &arena->matches[arena->n_matches - n] : NULL;
+      info->starts[i] = first ? first->rm_so : -1;
+      info->lengths[i] = first ? first->rm_eo - first->rm_so : -1;
+      info->costs[i] = first ? first->cost : -1;
+      arena->n_matches = 0;
     }
-    current_match->next = match;
-    match = before_match;
-    return match;
-  } else {
-    return match;
   }
 }
 
 
+// store the n characters of src as an IDL string
+static void mg_stregex_store(IDL_STRING *dst, char *src, int n, char *buffer) {
+  memcpy(buffer, src, n);
+  buffer[n] = '\0';
+  IDL_StrStore(dst, buffer);
+}
+
 
 static IDL_VPTR IDL_CDECL IDL_mg_stregex(int argc, IDL_VPTR *argv, char *argk) {
   typedef struct {
@@ -140,8 +367,13 @@ static IDL_VPTR IDL_CDECL IDL_mg_stregex(int argc, IDL_VPTR *argv, char *argk) {
     int max_err_present;
     IDL_LONG max_ins;
     int max_ins_present;
+    IDL_LONG max_matches;
+    int max_matches_present;
     IDL_LONG max_subst;
     int max_subst_present;
+    IDL_LONG n_threads;
+    IDL_VPTR offsets;
+    int offsets_present;
     IDL_LONG subexpr;  // TODO: handle SUBEXPR keyword
   } KW_RESULT;
 
@@ -175,8 +407,14 @@ static IDL_VPTR IDL_CDECL IDL_mg_stregex(int argc, IDL_VPTR *argv, char *argk) {
       IDL_KW_OFFSETOF(max_err_present), IDL_KW_OFFSETOF(max_err) },
     { "MAX_INS", IDL_TYP_LONG, 1, 0,
       IDL_KW_OFFSETOF(max_ins_present), IDL_KW_OFFSETOF(max_ins) },
+    { "MAX_MATCHES", IDL_TYP_LONG, 1, 0,
+      IDL_KW_OFFSETOF(max_matches_present), IDL_KW_OFFSETOF(max_matches) },
     { "MAX_SUBST", IDL_TYP_LONG, 1, 0,
       IDL_KW_OFFSETOF(max_subst_present), IDL_KW_OFFSETOF(max_subst) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { "OFFSETS", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(offsets_present), IDL_KW_OFFSETOF(offsets) },
     { "SUBEXPR", IDL_TYP_LONG, 1, IDL_KW_ZERO | IDL_KW_VALUE | 1,
       0, IDL_KW_OFFSETOF(subexpr) },
     { NULL }
@@ -187,209 +425,256 @@ static IDL_VPTR IDL_CDECL IDL_mg_stregex(int argc, IDL_VPTR *argv, char *argk) {
   int nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
 
   if (kw.all && kw.boolean) {
+    IDL_KW_FREE;
     IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
                 "conflicting keywords, ALL and BOOLEAN");
   }
 
   if (kw.extract && kw.boolean) {
+    IDL_KW_FREE;
     IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
                 "conflicting keywords, EXTRACT and BOOLEAN");
   }
 
   if (kw.length_present && kw.boolean) {
+    IDL_KW_FREE;
     IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
                 "conflicting keywords, LENGTH and BOOLEAN");
   }
 
-  char *input = IDL_VarGetString(argv[0]);
+  IDL_VPTR input = argv[0];
+  IDL_ENSURE_SIMPLE(input);
+  if (input->type != IDL_TYP_STRING) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "input must be a string or string array");
+  }
+
   char *re = IDL_VarGetString(argv[1]);
-  regex_t preg;
-  int compile_status = tre_regcomp(&preg, re,
-                                   REG_EXTENDED
-                                     | (kw.fold_case ? REG_ICASE : 0));
+  regex_t *preg;
+  int compile_status = mg_regex_lookup(re,
+                                       REG_EXTENDED
+                                         | (kw.fold_case ? REG_ICASE : 0),
+                                       &preg);
   if (compile_status != 0) {
-    switch (compile_status) {
-      case REG_BADPAT:
-        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
-                    "regex contained an invalid multibyte sequence");
-      case REG_ECOLLATE:
-        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
-                    "invalid collating element referenced in regex");
-      case REG_ECTYPE:
-        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
-                    "unknown character class name in regex");
-      case REG_EESCAPE:
-        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
-                    "last character of regex was a backslash");
-      case REG_ESUBREG:
-        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
-                    "invalid back reference in regex");
-      case REG_EBRACK:
-        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
-                    "unbalanced [] in regex");
-      case REG_EPAREN:
-        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
-                    "unbalanced parentheses in regex");
-      case REG_EBRACE:
-        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
-                    "unbalanced braces in regex");
-      case REG_BADBR:
-        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
-                    "content invalid in regex");
-      case REG_ERANGE:
-        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
-                    "invalid character range in regex");
-      case REG_ESPACE:
-        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
-                    "out of memory in regex");
-      case REG_BADRPT:
-        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
-                    "invalid use of repetition operators in regex");
-      default:
-        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "invalid regex");
-    }
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "%s",
+                mg_regex_error(compile_status));
   }
 
-  regamatch_t amatch;
-  regaparams_t match_params;
-  regmatch_t pmatch[1];
-  size_t length;
+  mg_stregex_info info;
+  mg_regarena_t arenas[MG_THREADS_MAX];
+  mg_regmatch_t *match;
+  IDL_MEMINT i, n, m, j, c, nmatches = 0;
+  int per_element = (input->flags & IDL_V_ARR) && !kw.all;
+  int max_length = 0, nthreads, t, failed = 0;
+  char *buffer = NULL;
 
   IDL_VPTR result_vptr;
+  IDL_VPTR lengths_vptr = NULL;
+  IDL_VPTR costs_vptr = NULL;
+  IDL_VPTR offsets_vptr = NULL;
   IDL_STRING *extracts;
-  int *starts;
-  IDL_VPTR lengths_vptr;
-  int *lengths;
-  IDL_VPTR costs_vptr;
-  int *costs;
+  IDL_LONG *starts, *lengths, *costs, *offsets = NULL;
+  UCHAR *found;
 
-  int m = 0, nmatches = 0;
-  mg_regmatch_t *matches = NULL;
-  mg_regmatch_t *current_match = NULL;
+  if (kw.max_matches_present && kw.max_matches < 1) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "MAX_MATCHES must be positive");
+  }
 
-  int search_status = 0;
-  int offset = 0;
-  int find_all = 1;
-
-  int cost_ins = kw.cost_ins_present ? kw.cost_ins : 1;
-  int cost_del = kw.cost_del_present ? kw.cost_del : 1;
-  int cost_subst = kw.cost_subst_present ? kw.cost_subst : 1;
-
-  int max_cost = kw.max_cost_present ? kw.max_cost : INT_MAX;
-  int max_del = kw.max_del_present ? kw.max_del : INT_MAX;
-  int max_err = kw.max_err_present ? kw.max_err : INT_MAX;
-  int max_ins = kw.max_ins_present ? kw.max_ins : INT_MAX;
-  int max_subst = kw.max_subst_present ? kw.max_subst : INT_MAX;
-
-  if (kw.approximate) {
-    matches = mg_getamatches(&preg,
-                             input, offset, strlen(input),
-                             cost_ins, cost_del, cost_subst,
-                             max_cost, max_del, max_err,
-                             max_ins,  max_subst,
-                             kw.all);
-    current_match = matches;
-
-    // count up number of matches
-    while (current_match) {
-      nmatches++;
-      current_match = current_match->next;
-    }
+  memset(&info, 0, sizeof(info));
+  memset(arenas, 0, sizeof(arenas));
+  info.preg = preg;
+  info.approximate = kw.approximate;
+  info.all = kw.all;
+  info.max_matches = kw.max_matches_present ? kw.max_matches : INT_MAX;
+  info.arenas = arenas;
+
+  // initialize the match params
+  tre_regaparams_default(&info.match_params);
+  info.match_params.cost_ins = kw.cost_ins_present ? kw.cost_ins : 1;
+  info.match_params.cost_del = kw.cost_del_present ? kw.cost_del : 1;
+  info.match_params.cost_subst = kw.cost_subst_present ? kw.cost_subst : 1;
+
+  info.match_params.max_cost = kw.max_cost_present ? kw.max_cost : INT_MAX;
+  info.match_params.max_del = kw.max_del_present ? kw.max_del : INT_MAX;
+  info.match_params.max_err = kw.max_err_present ? kw.max_err : INT_MAX;
+  info.match_params.max_ins = kw.max_ins_present ? kw.max_ins : INT_MAX;
+  info.match_params.max_subst = kw.max_subst_present ? kw.max_subst : INT_MAX;
+
+  if (input->flags & IDL_V_ARR) {
+    info.strings = (IDL_STRING *) input->value.arr->data;
+    n = input->value.arr->n_elts;
   } else {
-    while (search_status == 0 && offset <= strlen(input) && find_all) {
+    info.strings = &input->value.str;
+    n = 1;
+  }
+  nthreads = mg_thread_count(n, MG_STREGEX_MIN_ELTS, kw.n_threads);
 
-      search_status = tre_regexec(&preg, &input[offset], (size_t) 1, pmatch, 0);
+  if (kw.extract) {
+    for (i = 0; i < n; i++) {
+      if (info.strings[i].slen > max_length) max_length = info.strings[i].slen;
+    }
+    buffer = (char *) malloc(max_length + 1);
+    if (buffer == NULL) {
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "unable to allocate memory");
+    }
+  }
 
-      if (search_status == 0) {
-        nmatches++;
+  if (per_element) {
+    // the first match of each element of an array
+    IDL_ARRAY *arr = input->value.arr;
+    info.starts = (IDL_LONG *) IDL_MakeTempArray(IDL_TYP_LONG, arr->n_dim, arr->dim,
+                                                 IDL_ARR_INI_NOP, &result_vptr);
+    info.lengths = (IDL_LONG *) IDL_MakeTempArray(IDL_TYP_LONG, arr->n_dim, arr->dim,
+                                                  IDL_ARR_INI_NOP, &lengths_vptr);
+    info.costs = (IDL_LONG *) IDL_MakeTempArray(IDL_TYP_LONG, arr->n_dim, arr->dim,
+                                                IDL_ARR_INI_NOP, &costs_vptr);
+
+    mg_thread_run(nthreads, n, mg_stregex_work, &info);
+
+    for (t = 0; t < nthreads; t++) {
+      failed |= arenas[t].failed;
+      mg_freearena(&arenas[t]);
+    }
+    if (failed) {
+      IDL_Deltmp(result_vptr);
+      IDL_Deltmp(lengths_vptr);
+      IDL_Deltmp(costs_vptr);
+      if (buffer) free(buffer);
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "unable to allocate memory");
+    }
 
-        if (current_match == NULL) {
-          current_match = (mg_regmatch_t *) malloc(sizeof(mg_regmatch_t));
-          matches = current_match;
-        } else {
-          current_match->next = (mg_regmatch_t *) malloc(sizeof(mg_regmatch_t));
-          current_match = current_match->next;
-        }
+    if (kw.boolean) {
+      IDL_VPTR positions_vptr = result_vptr;
+      found = (UCHAR *) IDL_MakeTempArray(IDL_TYP_BYTE, arr->n_dim, arr->dim,
+                                          IDL_ARR_INI_NOP, &result_vptr);
+      for (i = 0; i < n; i++) found[i] = info.starts[i] >= 0;
+      IDL_Deltmp(positions_vptr);
+    } else if (kw.extract) {
+      IDL_VPTR positions_vptr = result_vptr;
+      extracts = (IDL_STRING *) IDL_MakeTempArray(IDL_TYP_STRING, arr->n_dim, arr->dim,
+                                                  IDL_ARR_INI_ZERO, &result_vptr);
+      for (i = 0; i < n; i++) {
+        if (info.starts[i] < 0) continue;
+        mg_stregex_store(&extracts[i],
+                         IDL_STRING_STR(&info.strings[i]) + info.starts[i],
+                         info.lengths[i], buffer);
+      }
+      IDL_Deltmp(positions_vptr);
+    }
+  } else {
+    // all matches of each element, or the first match of a scalar string
+    info.counts = (IDL_MEMINT *) IDL_MemAlloc(n * sizeof(IDL_MEMINT),
+                                              NULL, IDL_MSG_RET);
+    if (info.counts == NULL) {
+      if (buffer) free(buffer);
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "unable to allocate memory");
+    }
 
-        current_match->cost = 0;
-        current_match->rm_so = offset + pmatch[0].rm_so;
-        current_match->rm_eo = offset + pmatch[0].rm_eo;
-        current_match->next = NULL;
+    mg_thread_run(nthreads, n, mg_stregex_work, &info);
 
-        offset += pmatch[0].rm_eo;
-      }
+    for (t = 0; t < nthreads; t++) failed |= arenas[t].failed;
+    if (failed) {
+      for (t = 0; t < nthreads; t++) mg_freearena(&arenas[t]);
+      IDL_MemFree(info.counts, NULL, IDL_MSG_RET);
+      if (buffer) free(buffer);
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "unable to allocate memory");
+    }
 
-      find_all = kw.all;
+    if (kw.offsets_present) {
+      offsets = (IDL_LONG *) IDL_MakeTempVector(IDL_TYP_LONG, n + 1,
+                                                IDL_ARR_INI_NOP, &offsets_vptr);
     }
-  }
+    for (i = 0; i < n; i++) {
+      if (offsets) offsets[i] = (IDL_LONG) nmatches;
+      nmatches += info.counts[i];
+    }
+    if (offsets) offsets[n] = (IDL_LONG) nmatches;
 
-  if (kw.boolean) {
-    result_vptr = IDL_GettmpByte(nmatches > 0 ? 1 : 0);
-  } else {
-    if (nmatches > 0) {
+    if (kw.boolean) {
+      result_vptr = IDL_GettmpByte(nmatches > 0 ? 1 : 0);
+    } else if (nmatches > 0) {
       if (kw.extract) {
-        extracts = (IDL_STRING *)IDL_MakeTempVector(IDL_TYP_STRING,
-                                                    (IDL_MEMINT)nmatches,
-                                                    IDL_ARR_INI_ZERO,
-                                                    &result_vptr);
+        extracts = (IDL_STRING *) IDL_MakeTempVector(IDL_TYP_STRING, nmatches,
+                                                     IDL_ARR_INI_ZERO,
+                                                     &result_vptr);
       } else {
-        starts = (int *)IDL_MakeTempVector(IDL_TYP_LONG, (IDL_MEMINT)nmatches,
-                                           IDL_ARR_INI_NOP, &result_vptr);
+        starts = (IDL_LONG *) IDL_MakeTempVector(IDL_TYP_LONG, nmatches,
+                                                 IDL_ARR_INI_NOP, &result_vptr);
       }
-      lengths = (int *)IDL_MakeTempVector(IDL_TYP_LONG, (IDL_MEMINT)nmatches,
-                                          IDL_ARR_INI_NOP, &lengths_vptr);
-      costs = (int *)IDL_MakeTempVector(IDL_TYP_LONG, (IDL_MEMINT)nmatches,
-                                        IDL_ARR_INI_NOP, &costs_vptr);
-
-      current_match = matches;
-      for(m = 0; m < nmatches; m++) {
-        lengths[m] = current_match->rm_eo - current_match->rm_so;
-        costs[m] = current_match->cost;
-
-        if (kw.extract) {
-          char *e = (char *) malloc(lengths[m] + 1);
-          strncpy(e, input + current_match->rm_so, lengths[m]);
-          e[lengths[m]] = '\0';
-          IDL_StrEnsureLength(&(extracts[m]), lengths[m]);
-          IDL_StrDelete(&(extracts[m]), 1);
-          IDL_StrStore(&(extracts[m]), e);
-          free(e);
-
-          extracts[m].slen = lengths[m];
-        } else {
-          starts[m] = current_match->rm_so;
+      lengths = (IDL_LONG *) IDL_MakeTempVector(IDL_TYP_LONG, nmatches,
+                                                IDL_ARR_INI_NOP, &lengths_vptr);
+      costs = (IDL_LONG *) IDL_MakeTempVector(IDL_TYP_LONG, nmatches,
+                                              IDL_ARR_INI_NOP, &costs_vptr);
+
+      // the arenas of the threads hold the matches of the strings in order
+      m = 0;
+      t = 0;
+      j = 0;
+      for (i = 0; i < n; i++) {
+        for (c = 0; c < info.counts[i]; c++) {
+          while (j == arenas[t].n_matches) {
+            t++;
+            j = 0;
+          }
+          match = &arenas[t].matches[j++];
+          lengths[m] = match->rm_eo - match->rm_so;
+          costs[m] = match->cost;
+
+          if (kw.extract) {
+            mg_stregex_store(&extracts[m],
+                             IDL_STRING_STR(&info.strings[i]) + match->rm_so,
+                             lengths[m], buffer);
+          } else {
+            starts[m] = match->rm_so;
+          }
+          m++;
         }
-
-        // advance to next match
-        current_match = current_match->next;
       }
     } else {
       result_vptr = IDL_GettmpLong(-1);
       lengths_vptr = IDL_GettmpLong(-1);
+      costs_vptr = IDL_GettmpLong(-1);
     }
 
-    // copy over lengths if LENGTH keyword was passed as a named variable
+    // free the matches
+    for (t = 0; t < nthreads; t++) mg_freearena(&arenas[t]);
+    IDL_MemFree(info.counts, NULL, IDL_MSG_RET);
+  }
+
+  if (buffer) free(buffer);
+
+  // copy over lengths if LENGTH keyword was passed as a named variable
+  if (lengths_vptr) {
     if (kw.length_present) {
       IDL_VarCopy(lengths_vptr, kw.length);
     } else IDL_Deltmp(lengths_vptr);
+  }
 
-    // copy over costs if COSTS keyword was passed as a named variable
+  // copy over costs if COSTS keyword was passed as a named variable
+  if (costs_vptr) {
     if (kw.costs_present) {
       IDL_VarCopy(costs_vptr, kw.costs);
     } else IDL_Deltmp(costs_vptr);
   }
 
-  // free match linked list
-  current_match = matches;
-  while (matches) {
-    matches = matches->next;
-    free(current_match);
-    current_match = matches;
+  // copy over offsets if OFFSETS keyword was passed as a named variable
+  if (kw.offsets_present) {
+    if (offsets_vptr == NULL) offsets_vptr = IDL_GettmpLong(-1);
+    IDL_VarCopy(offsets_vptr, kw.offsets);
   }
 
-  // free the compiled regex
-  tre_regfree(&preg);
-
   // free the keyword processing information
   IDL_KW_FREE;
 
@@ -397,6 +682,1162 @@ static IDL_VPTR IDL_CDECL IDL_mg_stregex(int argc, IDL_VPTR *argv, char *argk) {
 }
 
 
+// minimum number of strings per thread
+#define MG_STRSPLIT_MIN_ELTS 1024
+
+typedef struct {
+  IDL_STRING *strings;
+
+  // characters which might end a token: the delimiters (or the first
+  // characters of the literal delimiters), the quotes, and the escape
+  char stops[260];
+  int n_stops;
+
+  // literal delimiters, NULL if each character of the pattern is a delimiter
+  IDL_STRING *literals;
+  int n_literals;
+
+  UCHAR is_quote[256];
+  int escape;                // -1 for none
+  int preserve_null;
+
+  // the number of tokens in each string for the first pass, the index of
+  // the first token of each string for the second
+  IDL_MEMINT *counts;
+  IDL_LONG *starts;
+  IDL_LONG *lengths;
+} mg_strsplit_info;
+
+
+// first character of [p, end) in stops, or end; *end must be NUL
+static const char *mg_strsplit_next(const char *p, const char *end,
+                                    const char *stops, int n_stops) {
+  const char *next;
+
+  if (n_stops == 1) {
+    next = (const char *) memchr(p, stops[0], end - p);
+    return next ? next : end;
+  }
+  return p + strcspn(p, stops);
+}
+
+
+// length of the longest literal delimiter starting at p, 0 if none
+static int mg_strsplit_literal(mg_strsplit_info *info,
+                               const char *p, const char *end) {
+  int i, length, longest = 0;
+
+  for (i = 0; i < info->n_literals; i++) {
+    length = info->literals[i].slen;
+    if (length > longest && length <= end - p
+          && memcmp(p, IDL_STRING_STR(&info->literals[i]), length) == 0) {
+      longest = length;
+    }
+  }
+
+  return longest;
+}
+
+
+/*
+  Finds the tokens of s, storing their positions and lengths if starts is
+  not NULL; returns the number of tokens. Delimiters between quotes or
+  right after the escape character do not end a token.
+*/
+static IDL_MEMINT mg_strsplit_scan(mg_strsplit_info *info,
+                                   const char *s, int slen,
+                                   IDL_LONG *starts, IDL_LONG *lengths) {
+  const char *end = s + slen, *p = s, *token = s;
+  char quote_stops[3];
+  IDL_MEMINT n = 0;
+  int length;
+  UCHAR c;
+
+  while ((p = mg_strsplit_next(p, end, info->stops, info->n_stops)) < end) {
+    c = (UCHAR) *p;
+
+    if (c == info->escape) {
+      p = p + 1 < end ? p + 2 : end;
+      continue;
+    }
+
+    // skip to the closing quote; an unclosed quote extends to the end
+    if (info->is_quote[c]) {
+      quote_stops[0] = (char) c;
+      quote_stops[1] = info->escape < 0 ? '\0' : (char) info->escape;
+      quote_stops[2] = '\0';
+      for (p++; (p = mg_strsplit_next(p, end, quote_stops,
+                                      info->escape < 0 ? 1 : 2)) < end; ) {
+        if ((UCHAR) *p == c) break;
+        p = p + 1 < end ? p + 2 : end;
+      }
+      if (p < end) p++;
+      continue;
+    }
+
+    length = info->literals ? mg_strsplit_literal(info, p, end) : 1;
+    if (length == 0) {
+      p++;
+      continue;
+    }
+
+    if (p > token || info->preserve_null) {
+      if (starts) {
+        starts[n] = (IDL_LONG) (token - s);
+        lengths[n] = (IDL_LONG) (p - token);
+      }
+      n++;
+    }
+    p += length;
+    token = p;
+  }
+
+  if (end > token || info->preserve_null) {
+    if (starts) {
+      starts[n] = (IDL_LONG) (token - s);
+      lengths[n] = (IDL_LONG) (end - token);
+    }
+    n++;
+  }
+
+  return n;
+}
+
+
+static void mg_strsplit_count(IDL_MEMINT start, IDL_MEMINT end,
+                              int thread_index, void *data) {
+  mg_strsplit_info *info = (mg_strsplit_info *) data;
+  IDL_MEMINT i;
+
+  for (i = start; i < end; i++) {
+    info->counts[i] = mg_strsplit_scan(info,
+                                       IDL_STRING_STR(&info->strings[i]),
+                                       info->strings[i].slen,
+                                       NULL, NULL);
+  }
+}
+
+
+static void mg_strsplit_fill(IDL_MEMINT start, IDL_MEMINT end,
+                             int thread_index, void *data) {
+  mg_strsplit_info *info = (mg_strsplit_info *) data;
+  IDL_MEMINT i, first;
+
+  for (i = start; i < end; i++) {
+    first = info->counts[i];
+    mg_strsplit_scan(info,
+                     IDL_STRING_STR(&info->strings[i]), info->strings[i].slen,
+                     info->starts + first, info->lengths + first);
+  }
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_strsplit(int argc, IDL_VPTR *argv, char *argk) {
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_VPTR count;
+    int count_present;
+    IDL_STRING escape;
+    int escape_present;
+    IDL_LONG extract;
+    IDL_VPTR length;
+    int length_present;
+    IDL_LONG literal;
+    IDL_LONG n_threads;
+    IDL_VPTR offsets;
+    int offsets_present;
+    IDL_LONG preserve_null;
+    IDL_STRING quote;
+    int quote_present;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "COUNT", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(count_present), IDL_KW_OFFSETOF(count) },
+    { "ESCAPE", IDL_TYP_STRING, 1, 0,
+      IDL_KW_OFFSETOF(escape_present), IDL_KW_OFFSETOF(escape) },
+    { "EXTRACT", IDL_TYP_LONG, 1, IDL_KW_ZERO | IDL_KW_VALUE | 1,
+      0, IDL_KW_OFFSETOF(extract) },
+    { "LENGTH", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(length_present), IDL_KW_OFFSETOF(length) },
+    { "LITERAL", IDL_TYP_LONG, 1, IDL_KW_ZERO | IDL_KW_VALUE | 1,
+      0, IDL_KW_OFFSETOF(literal) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { "OFFSETS", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(offsets_present), IDL_KW_OFFSETOF(offsets) },
+    { "PRESERVE_NULL", IDL_TYP_LONG, 1, IDL_KW_ZERO | IDL_KW_VALUE | 1,
+      0, IDL_KW_OFFSETOF(preserve_null) },
+    { "QUOTE", IDL_TYP_STRING, 1, 0,
+      IDL_KW_OFFSETOF(quote_present), IDL_KW_OFFSETOF(quote) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  int nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+
+  IDL_VPTR input = argv[0];
+  IDL_ENSURE_SIMPLE(input);
+  if (input->type != IDL_TYP_STRING) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "input must be a string or string array");
+  }
+
+  mg_strsplit_info info;
+  IDL_STRING default_pattern, *pattern;
+  IDL_MEMINT i, n, ntokens = 0, first, last;
+  int n_patterns = 1, nthreads, max_length = 0;
+  char *p, *buffer;
+  UCHAR c;
+
+  memset(&info, 0, sizeof(info));
+  info.escape = -1;
+  info.preserve_null = kw.preserve_null;
+
+  // the default pattern is whitespace, like STRSPLIT
+  if (nargs > 1) {
+    IDL_ENSURE_SIMPLE(argv[1]);
+    if (argv[1]->type != IDL_TYP_STRING) {
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "pattern must be a string or string array");
+    }
+    if (argv[1]->flags & IDL_V_ARR) {
+      pattern = (IDL_STRING *) argv[1]->value.arr->data;
+      n_patterns = (int) argv[1]->value.arr->n_elts;
+    } else {
+      pattern = &argv[1]->value.str;
+    }
+  } else {
+    default_pattern.slen = 2;
+    default_pattern.stype = 0;
+    default_pattern.s = " \t";
+    pattern = &default_pattern;
+  }
+
+  for (i = 0; i < n_patterns; i++) {
+    if (pattern[i].slen == 0) {
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "delimiters must not be empty");
+    }
+  }
+
+  // an array of patterns is always a list of literal delimiters
+  if (kw.literal || n_patterns > 1) {
+    info.literals = pattern;
+    info.n_literals = n_patterns;
+  }
+
+  for (i = 0; i < n_patterns; i++) {
+    for (p = IDL_STRING_STR(&pattern[i]); *p != '\0'; p++) {
+      if (memchr(info.stops, *p, info.n_stops) == NULL) {
+        info.stops[info.n_stops++] = *p;
+      }
+      if (info.literals) break;
+    }
+  }
+
+  if (kw.quote_present) {
+    for (p = IDL_STRING_STR(&kw.quote); *p != '\0'; p++) {
+      c = (UCHAR) *p;
+      info.is_quote[c] = 1;
+      if (memchr(info.stops, c, info.n_stops) == NULL) {
+        info.stops[info.n_stops++] = (char) c;
+      }
+    }
+  }
+
+  if (kw.escape_present) {
+    if (kw.escape.slen != 1) {
+      IDL_KW_FREE;
+      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                  "ESCAPE must be a single character");
+    }
+    c = (UCHAR) IDL_STRING_STR(&kw.escape)[0];
+    info.escape = c;
+    if (memchr(info.stops, c, info.n_stops) == NULL) {
+      info.stops[info.n_stops++] = (char) c;
+    }
+  }
+
+  if (input->flags & IDL_V_ARR) {
+    info.strings = (IDL_STRING *) input->value.arr->data;
+    n = input->value.arr->n_elts;
+  } else {
+    info.strings = &input->value.str;
+    n = 1;
+  }
+  nthreads = mg_thread_count(n, MG_STRSPLIT_MIN_ELTS, kw.n_threads);
+
+  // first pass counts the tokens of each string, the second stores them
+  info.counts = (IDL_MEMINT *) IDL_MemAlloc(n * sizeof(IDL_MEMINT),
+                                            NULL, IDL_MSG_RET);
+  if (info.counts == NULL) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unable to allocate memory");
+  }
+
+  mg_thread_run(nthreads, n, mg_strsplit_count, &info);
+
+  IDL_VPTR result_vptr;
+  IDL_VPTR lengths_vptr = NULL;
+  IDL_VPTR offsets_vptr = NULL;
+  IDL_VPTR starts_vptr;
+  IDL_LONG *offsets = NULL;
+  IDL_STRING *extracts;
+
+  if (kw.offsets_present) {
+    offsets = (IDL_LONG *) IDL_MakeTempVector(IDL_TYP_LONG, n + 1,
+                                              IDL_ARR_INI_NOP, &offsets_vptr);
+  }
+  for (i = 0; i < n; i++) {
+    first = ntokens;
+    ntokens += info.counts[i];
+    info.counts[i] = first;
+    if (offsets) offsets[i] = (IDL_LONG) first;
+  }
+  if (offsets) offsets[n] = (IDL_LONG) ntokens;
+
+  if (ntokens > 0) {
+    info.starts = (IDL_LONG *) IDL_MakeTempVector(IDL_TYP_LONG, ntokens,
+                                                  IDL_ARR_INI_NOP,
+                                                  &starts_vptr);
+    info.lengths = (IDL_LONG *) IDL_MakeTempVector(IDL_TYP_LONG, ntokens,
+                                                   IDL_ARR_INI_NOP,
+                                                   &lengths_vptr);
+
+    mg_thread_run(nthreads, n, mg_strsplit_fill, &info);
+
+    if (kw.extract) {
+      for (i = 0; i < ntokens; i++) {
+        if (info.lengths[i] > max_length) max_length = info.lengths[i];
+      }
+      buffer = (char *) malloc(max_length + 1);
+      if (buffer == NULL) {
+        IDL_MemFree(info.counts, NULL, IDL_MSG_RET);
+        IDL_Deltmp(starts_vptr);
+        IDL_Deltmp(lengths_vptr);
+        if (offsets_vptr) IDL_Deltmp(offsets_vptr);
+        IDL_KW_FREE;
+        IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                    "unable to allocate memory");
+      }
+
+      extracts = (IDL_STRING *) IDL_MakeTempVector(IDL_TYP_STRING, ntokens,
+                                                   IDL_ARR_INI_ZERO,
+                                                   &result_vptr);
+      for (i = 0; i < n; i++) {
+        last = i < n - 1 ? info.counts[i + 1] : ntokens;
+        for (first = info.counts[i]; first < last; first++) {
+          mg_stregex_store(&extracts[first],
+                           IDL_STRING_STR(&info.strings[i]) + info.starts[first],
+                           info.lengths[first], buffer);
+        }
+      }
+
+      free(buffer);
+      IDL_Deltmp(starts_vptr);
+    } else {
+      result_vptr = starts_vptr;
+    }
+  } else {
+    result_vptr = kw.extract ? IDL_StrToSTRING("") : IDL_GettmpLong(-1);
+    lengths_vptr = IDL_GettmpLong(-1);
+  }
+
+  IDL_MemFree(info.counts, NULL, IDL_MSG_RET);
+
+  // copy over the outputs for keywords passed as named variables
+  if (kw.count_present) {
+    IDL_VarCopy(IDL_GettmpLong((IDL_LONG) ntokens), kw.count);
+  }
+
+  if (kw.length_present) {
+    IDL_VarCopy(lengths_vptr, kw.length);
+  } else IDL_Deltmp(lengths_vptr);
+
+  if (kw.offsets_present) {
+    IDL_VarCopy(offsets_vptr, kw.offsets);
+  }
+
+  IDL_KW_FREE;
+
+  return result_vptr;
+}
+
+
+/*
+  A spelling correction index using symmetric deletes: every string made by
+  deleting up to max_distance characters from a dictionary word is hashed
+  into a table pointing back to the word. The words within max_distance of
+  a query are among those listed under the deletes of the query, so only a
+  few candidates need their true distance computed.
+
+  The index is returned to IDL as a byte array holding a header, the offset
+  and count of each word, the hash table, and the text of the words; it can
+  be written to a file and passed back as the filename, in which case the
+  file is memory mapped on first use and kept mapped until a different (or
+  modified) file is requested. Words are ordered by decreasing count, so a
+  lower word index breaks ties between candidates at the same distance.
+*/
+
+#define MG_SPELL_MAGIC        0x4D475350
+#define MG_SPELL_VERSION      1
+#define MG_SPELL_HEADER       8
+#define MG_SPELL_MAX_LENGTH   255
+#define MG_SPELL_MAX_DISTANCE 4
+#define MG_SPELL_MIN_WORDS    256
+
+// number of deletes of a query whose buckets are fetched together
+#define MG_SPELL_BATCH        64
+
+#if defined(__GNUC__)
+#define MG_SPELL_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define MG_SPELL_PREFETCH(p)
+#endif
+
+// size of the buffer for each level of deletes
+#define MG_SPELL_STRIDE       (MG_SPELL_MAX_LENGTH + MG_SPELL_MAX_DISTANCE + 1)
+
+typedef struct {
+  IDL_LONG64 *header;
+  IDL_MEMINT n_words;
+  IDL_MEMINT n_buckets;
+  IDL_MEMINT n_entries;
+  int max_distance;
+  IDL_ULONG *offsets;      // start of each word in text, n_words + 1
+  IDL_LONG *counts;        // count of each word
+  IDL_ULONG *buckets;      // first entry of each bucket, n_buckets + 1
+  IDL_ULONG *entries;      // check bits and word of each entry
+  char *text;              // NUL-terminated words
+} mg_spell_index;
+
+typedef struct {
+  IDL_ULONG64 hash;
+  IDL_ULONG word;
+} mg_spell_delete;
+
+typedef struct {
+  mg_spell_delete *deletes;
+  IDL_MEMINT n;
+  IDL_MEMINT size;
+  IDL_ULONG word;
+  int failed;
+} mg_spell_build_info;
+
+typedef struct {
+  mg_spell_index index;
+  IDL_STRING *words;
+  int max_distance;
+  IDL_ULONG *stamps;       // n_words per thread, last query checking a word
+  IDL_LONG *best;          // index of the correction of each word, or -1
+  IDL_LONG *distances;
+} mg_spell_query_info;
+
+typedef struct {
+  mg_spell_query_info *info;
+  IDL_ULONG *stamps;
+  IDL_ULONG stamp;
+  const char *word;
+  int length;
+  int best_distance;
+  IDL_LONG best;
+  IDL_ULONG64 hashes[MG_SPELL_BATCH];   // deletes waiting to be checked
+  IDL_ULONG bucket_starts[MG_SPELL_BATCH];
+  int n_hashes;
+} mg_spell_query;
+
+// the index file currently mapped
+static struct {
+  char *filename;
+  char *data;
+  IDL_MEMINT size;
+  time_t mtime;
+} mg_spell_file = { NULL, NULL, 0, 0 };
+
+
+// FNV-1a
+static IDL_ULONG64 mg_spell_hash(const char *s, int length) {
+  IDL_ULONG64 h = 14695981039346656037ULL;
+  int i;
+
+  for (i = 0; i < length; i++) {
+    h ^= (UCHAR) s[i];
+    h *= 1099511628211ULL;
+  }
+
+  return h;
+}
+
+
+static IDL_MEMINT mg_spell_size(IDL_MEMINT n_words, IDL_MEMINT n_buckets,
+                                IDL_MEMINT n_entries, IDL_MEMINT text_size) {
+  IDL_MEMINT size = MG_SPELL_HEADER * sizeof(IDL_LONG64)
+                      + (2 * n_words + n_buckets + 2 + 2 * n_entries) * sizeof(IDL_ULONG)
+                      + text_size;
+  return (size + 7) / 8 * 8;
+}
+
+
+// point the fields of index into the data of an index array
+static void mg_spell_layout(mg_spell_index *index, char *data) {
+  index->header = (IDL_LONG64 *) data;
+  index->max_distance = (int) index->header[2];
+  index->n_words = (IDL_MEMINT) index->header[3];
+  index->n_buckets = (IDL_MEMINT) index->header[4];
+  index->n_entries = (IDL_MEMINT) index->header[5];
+  index->offsets = (IDL_ULONG *) (index->header + MG_SPELL_HEADER);
+  index->counts = (IDL_LONG *) (index->offsets + index->n_words + 1);
+  index->buckets = (IDL_ULONG *) (index->counts + index->n_words);
+  index->entries = index->buckets + index->n_buckets + 1;
+  index->text = (char *) (index->entries + 2 * index->n_entries);
+}
+
+
+// returns 1 if data of the given size is an index made by MG_SPELL_INDEX
+static int mg_spell_check(char *data, IDL_MEMINT size) {
+  IDL_LONG64 *header = (IDL_LONG64 *) data;
+
+  if (size < MG_SPELL_HEADER * (IDL_MEMINT) sizeof(IDL_LONG64)) return 0;
+  if (header[0] != MG_SPELL_MAGIC || header[1] != MG_SPELL_VERSION) return 0;
+  if (header[2] < 0 || header[2] > MG_SPELL_MAX_DISTANCE
+        || header[3] < 1 || header[4] < 1 || header[5] < 0 || header[6] < 1) {
+    return 0;
+  }
+  if (header[4] & (header[4] - 1)) return 0;
+  return mg_spell_size(header[3], header[4], header[5], header[6]) == size;
+}
+
+
+#ifndef _WIN32
+static void mg_spell_unmap(void) {
+  if (mg_spell_file.data) munmap(mg_spell_file.data, mg_spell_file.size);
+  if (mg_spell_file.filename) free(mg_spell_file.filename);
+  mg_spell_file.filename = NULL;
+  mg_spell_file.data = NULL;
+  mg_spell_file.size = 0;
+}
+#else
+static void mg_spell_unmap(void) {
+  if (mg_spell_file.data) free(mg_spell_file.data);
+  if (mg_spell_file.filename) free(mg_spell_file.filename);
+  mg_spell_file.filename = NULL;
+  mg_spell_file.data = NULL;
+  mg_spell_file.size = 0;
+}
+#endif
+
+
+// map an index file, reusing the current mapping if the file is unchanged;
+// returns an error message or NULL
+static char *mg_spell_map(char *filename) {
+  struct stat st;
+  char *data;
+
+  if (stat(filename, &st) != 0) return "unable to find index file";
+
+  if (mg_spell_file.filename && strcmp(mg_spell_file.filename, filename) == 0
+        && mg_spell_file.mtime == st.st_mtime
+        && mg_spell_file.size == (IDL_MEMINT) st.st_size) {
+    return NULL;
+  }
+  mg_spell_unmap();
+
+#ifndef _WIN32
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) return "unable to open index file";
+  data = st.st_size > 0
+           ? (char *) mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)
+           : (char *) MAP_FAILED;
+  close(fd);
+  if (data == (char *) MAP_FAILED) return "unable to map index file";
+#else
+  FILE *fp = fopen(filename, "rb");
+  if (fp == NULL) return "unable to open index file";
+  data = (char *) malloc(st.st_size > 0 ? st.st_size : 1);
+  if (data == NULL || fread(data, 1, st.st_size, fp) != (size_t) st.st_size) {
+    if (data) free(data);
+    fclose(fp);
+    return "unable to read index file";
+  }
+  fclose(fp);
+#endif
+
+  mg_spell_file.data = data;
+  mg_spell_file.size = (IDL_MEMINT) st.st_size;
+  mg_spell_file.mtime = st.st_mtime;
+  mg_spell_file.filename = (char *) malloc(strlen(filename) + 1);
+  if (mg_spell_file.filename == NULL) {
+    mg_spell_unmap();
+    return "unable to allocate memory";
+  }
+  strcpy(mg_spell_file.filename, filename);
+
+  if (!mg_spell_check(data, mg_spell_file.size)) {
+    mg_spell_unmap();
+    return "invalid index file, not made by this version of MG_SPELL_INDEX";
+  }
+
+  return NULL;
+}
+
+
+// get the index from a byte array or the name of an index file; returns an
+// error message or NULL
+static char *mg_spell_get(IDL_VPTR var, mg_spell_index *index) {
+  char *msg;
+
+  if (var->type == IDL_TYP_STRING && !(var->flags & IDL_V_ARR)) {
+    msg = mg_spell_map(IDL_VarGetString(var));
+    if (msg) return msg;
+    mg_spell_layout(index, mg_spell_file.data);
+    return NULL;
+  }
+
+  if (var->type != IDL_TYP_BYTE || !(var->flags & IDL_V_ARR)) {
+    return "index must be a byte array returned by MG_SPELL_INDEX or a filename";
+  }
+  if (!mg_spell_check((char *) var->value.arr->data, var->value.arr->n_elts)) {
+    return "invalid index, not made by this version of MG_SPELL_INDEX";
+  }
+  mg_spell_layout(index, (char *) var->value.arr->data);
+
+  return NULL;
+}
+
+
+/*
+  Calls emit for s and each string made by deleting up to depth more
+  characters from s at positions from start on, so each set of positions is
+  deleted once. Each level of recursion uses the next MG_SPELL_STRIDE
+  characters of buffers.
+*/
+typedef int (*mg_spell_emit)(const char *s, int length, void *data);
+
+static int mg_spell_deletes(char *buffers, int depth, const char *s,
+                            int length, int start,
+                            mg_spell_emit emit, void *data) {
+  int i;
+
+  if (!emit(s, length, data)) return 0;
+  if (depth == 0 || length == 0) return 1;
+
+  for (i = start; i < length; i++) {
+    memcpy(buffers, s, i);
+    memcpy(buffers + i, s + i + 1, length - i - 1);
+    if (!mg_spell_deletes(buffers + MG_SPELL_STRIDE, depth - 1,
+                          buffers, length - 1, i, emit, data)) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+
+static int mg_spell_add_delete(const char *s, int length, void *data) {
+  mg_spell_build_info *info = (mg_spell_build_info *) data;
+  mg_spell_delete *deletes;
+  IDL_MEMINT size;
+
+  if (info->n == info->size) {
+    size = info->size ? 2 * info->size : 1024;
+    deletes = (mg_spell_delete *) realloc(info->deletes, size * sizeof(mg_spell_delete));
+    if (deletes == NULL) {
+      info->failed = 1;
+      return 0;
+    }
+    info->deletes = deletes;
+    info->size = size;
+  }
+
+  info->deletes[info->n].hash = mg_spell_hash(s, length);
+  info->deletes[info->n].word = info->word;
+  info->n++;
+
+  return 1;
+}
+
+
+// mg_spell_delete compare by hash, then word
+static int mg_spell_delete_compare(const void *a, const void *b) {
+  const mg_spell_delete *da = (const mg_spell_delete *) a;
+  const mg_spell_delete *db = (const mg_spell_delete *) b;
+
+  if (da->hash != db->hash) return da->hash < db->hash ? -1 : 1;
+  if (da->word != db->word) return da->word < db->word ? -1 : 1;
+  return 0;
+}
+
+
+typedef struct {
+  IDL_STRING *word;
+  IDL_LONG count;
+} mg_spell_word;
+
+// mg_spell_word compare by decreasing count, then word
+static int mg_spell_word_compare(const void *a, const void *b) {
+  const mg_spell_word *wa = (const mg_spell_word *) a;
+  const mg_spell_word *wb = (const mg_spell_word *) b;
+
+  if (wa->count != wb->count) return wa->count > wb->count ? -1 : 1;
+  return strcmp(IDL_STRING_STR(wa->word), IDL_STRING_STR(wb->word));
+}
+
+
+/*
+  Damerau-Levenshtein (optimal string alignment) distance of a and b, or
+  max_distance + 1 if it is more than max_distance. Only the cells within
+  max_distance of the diagonal can be small enough, so only that band of
+  each row is computed, with the cells just outside it set to
+  max_distance + 1.
+*/
+static int mg_spell_distance(const char *a, int a_length,
+                             const char *b, int b_length, int max_distance) {
+  int rows[3][MG_SPELL_MAX_LENGTH + MG_SPELL_MAX_DISTANCE + 2];
+  int *prev2 = rows[0], *prev = rows[1], *cur = rows[2], *tmp;
+  int i, j, lo, hi, d, row_min, far = max_distance + 1;
+
+  if (abs(a_length - b_length) > max_distance) return far;
+
+  for (j = 0; j <= b_length; j++) prev[j] = j <= max_distance ? j : far;
+
+  for (i = 1; i <= a_length; i++) {
+    lo = i - max_distance > 1 ? i - max_distance : 1;
+    hi = i + max_distance < b_length ? i + max_distance : b_length;
+    cur[lo - 1] = lo == 1 && i <= max_distance ? i : far;
+    row_min = cur[lo - 1];
+
+    for (j = lo; j <= hi; j++) {
+      d = prev[j - 1] + (a[i - 1] == b[j - 1] ? 0 : 1);
+      if (prev[j] + 1 < d) d = prev[j] + 1;
+      if (cur[j - 1] + 1 < d) d = cur[j - 1] + 1;
+      if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1]
+            && prev2[j - 2] + 1 < d) {
+        d = prev2[j - 2] + 1;
+      }
+      cur[j] = d;
+      if (d < row_min) row_min = d;
+    }
+    if (hi < b_length) cur[hi + 1] = far;
+
+    if (row_min > max_distance) return far;
+    tmp = prev2;
+    prev2 = prev;
+    prev = cur;
+    cur = tmp;
+  }
+
+  return prev[b_length] > max_distance ? far : prev[b_length];
+}
+
+
+/*
+  Check the words listed under the waiting deletes of the query; returns 0
+  once the query itself is found. The hash table is much larger than the
+  cache, so the buckets of a batch of deletes are prefetched, then their
+  entries, before any are used.
+*/
+static int mg_spell_check_batch(mg_spell_query *query) {
+  mg_spell_index *index = &query->info->index;
+  IDL_ULONG check, word, bucket, e, end;
+  const char *w;
+  int d, k;
+
+  for (k = 0; k < query->n_hashes; k++) {
+    MG_SPELL_PREFETCH(&index->buckets[query->hashes[k] & (index->n_buckets - 1)]);
+  }
+  for (k = 0; k < query->n_hashes; k++) {
+    bucket = (IDL_ULONG) (query->hashes[k] & (index->n_buckets - 1));
+    query->bucket_starts[k] = index->buckets[bucket];
+    MG_SPELL_PREFETCH(&index->entries[2 * query->bucket_starts[k]]);
+  }
+
+  for (k = 0; k < query->n_hashes; k++) {
+    check = (IDL_ULONG) (query->hashes[k] >> 32);
+    bucket = (IDL_ULONG) (query->hashes[k] & (index->n_buckets - 1));
+    end = index->buckets[bucket + 1];
+    for (e = query->bucket_starts[k]; e < end; e++) {
+      if (index->entries[2 * e] != check) continue;
+      word = index->entries[2 * e + 1];
+      if (query->stamps[word] == query->stamp) continue;
+      query->stamps[word] = query->stamp;
+
+      w = index->text + index->offsets[word];
+      d = mg_spell_distance(query->word, query->length,
+                            w, index->offsets[word + 1] - index->offsets[word] - 1,
+                            query->best_distance);
+      if (d < query->best_distance
+            || (d == query->best_distance && (IDL_LONG) word < query->best)) {
+        query->best_distance = d;
+        query->best = word;
+      }
+    }
+    if (query->best_distance == 0) return 0;
+  }
+  query->n_hashes = 0;
+
+  return 1;
+}
+
+
+// queue a delete of the query to be checked
+static int mg_spell_check_delete(const char *s, int length, void *data) {
+  mg_spell_query *query = (mg_spell_query *) data;
+
+  query->hashes[query->n_hashes++] = mg_spell_hash(s, length);
+
+  // check the query itself right away, it is usually spelled correctly
+  if (query->n_hashes == MG_SPELL_BATCH || length == query->length) {
+    return mg_spell_check_batch(query);
+  }
+
+  return 1;
+}
+
+
+static void mg_spell_correct_work(IDL_MEMINT start, IDL_MEMINT end,
+                                  int thread_index, void *data) {
+  mg_spell_query_info *info = (mg_spell_query_info *) data;
+  char buffers[MG_SPELL_MAX_DISTANCE * MG_SPELL_STRIDE];
+  mg_spell_query query;
+  IDL_MEMINT i;
+
+  query.info = info;
+  query.stamps = info->stamps + thread_index * info->index.n_words;
+  query.stamp = 0;
+
+  for (i = start; i < end; i++) {
+    query.word = IDL_STRING_STR(&info->words[i]);
+    query.length = info->words[i].slen;
+    query.best_distance = info->max_distance + 1;
+    query.best = -1;
+    query.n_hashes = 0;
+
+    if (query.length <= MG_SPELL_MAX_LENGTH + info->max_distance) {
+      if (++query.stamp == 0) {
+        memset(query.stamps, 0, info->index.n_words * sizeof(IDL_ULONG));
+        query.stamp = 1;
+      }
+      if (mg_spell_deletes(buffers,
+                           info->max_distance, query.word, query.length, 0,
+                           mg_spell_check_delete, &query)) {
+        mg_spell_check_batch(&query);
+      }
+    }
+
+    info->best[i] = query.best;
+    info->distances[i] = query.best >= 0 ? query.best_distance : -1;
+  }
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_spell_index(int argc, IDL_VPTR *argv, char *argk) {
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_LONG max_distance;
+    int max_distance_present;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "MAX_DISTANCE", IDL_TYP_LONG, 1, 0,
+      IDL_KW_OFFSETOF(max_distance_present), IDL_KW_OFFSETOF(max_distance) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  int nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+
+  IDL_VPTR words_var = argv[0], counts_var;
+  IDL_ENSURE_SIMPLE(words_var);
+  IDL_ENSURE_SIMPLE(argv[1]);
+  if (words_var->type != IDL_TYP_STRING) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "words must be a string array");
+  }
+
+  int max_distance = kw.max_distance_present ? kw.max_distance : 2;
+  IDL_KW_FREE;
+  if (max_distance < 0 || max_distance > MG_SPELL_MAX_DISTANCE) {
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "MAX_DISTANCE must be from 0 to %d", MG_SPELL_MAX_DISTANCE);
+  }
+
+  IDL_STRING *words;
+  IDL_MEMINT i, j, n, n_words = 0, n_buckets, n_entries, text_size = 0;
+  if (words_var->flags & IDL_V_ARR) {
+    words = (IDL_STRING *) words_var->value.arr->data;
+    n = words_var->value.arr->n_elts;
+  } else {
+    words = &words_var->value.str;
+    n = 1;
+  }
+
+  counts_var = argv[1]->type == IDL_TYP_LONG ? argv[1] : IDL_CvtLng(1, &argv[1]);
+  IDL_LONG *counts;
+  IDL_MEMINT n_counts;
+  IDL_VarGetData(counts_var, &n_counts, (char **) &counts, TRUE);
+  if (n_counts != n) {
+    if (counts_var != argv[1]) IDL_Deltmp(counts_var);
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "words and counts must have the same number of elements");
+  }
+
+  // sort the words by decreasing count, skipping empty and long words
+  mg_spell_word *sorted = (mg_spell_word *) malloc(n * sizeof(mg_spell_word));
+  if (sorted == NULL) {
+    if (counts_var != argv[1]) IDL_Deltmp(counts_var);
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unable to allocate memory");
+  }
+  for (i = 0; i < n; i++) {
+    if (words[i].slen == 0 || words[i].slen > MG_SPELL_MAX_LENGTH) continue;
+    sorted[n_words].word = &words[i];
+    sorted[n_words].count = counts[i];
+    text_size += words[i].slen + 1;
+    n_words++;
+  }
+  if (counts_var != argv[1]) IDL_Deltmp(counts_var);
+  if (n_words == 0) {
+    free(sorted);
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "no words to index");
+  }
+  qsort(sorted, n_words, sizeof(mg_spell_word), mg_spell_word_compare);
+
+  // hash the deletes of each word
+  char buffers[MG_SPELL_MAX_DISTANCE * MG_SPELL_STRIDE];
+  mg_spell_build_info info;
+  memset(&info, 0, sizeof(info));
+  for (i = 0; i < n_words && !info.failed; i++) {
+    info.word = (IDL_ULONG) i;
+    mg_spell_deletes(buffers,
+                     max_distance, IDL_STRING_STR(sorted[i].word),
+                     sorted[i].word->slen, 0, mg_spell_add_delete, &info);
+  }
+  if (info.failed) {
+    free(sorted);
+    if (info.deletes) free(info.deletes);
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unable to allocate memory");
+  }
+
+  // remove duplicate deletes of a word
+  qsort(info.deletes, info.n, sizeof(mg_spell_delete), mg_spell_delete_compare);
+  for (i = 0, n_entries = 0; i < info.n; i++) {
+    if (n_entries > 0
+          && info.deletes[i].hash == info.deletes[n_entries - 1].hash
+          && info.deletes[i].word == info.deletes[n_entries - 1].word) {
+      continue;
+    }
+    info.deletes[n_entries++] = info.deletes[i];
+  }
+
+  for (n_buckets = 1; n_buckets < n_entries; n_buckets *= 2);
+
+  IDL_VPTR result;
+  char *data = (char *) IDL_MakeTempVector(IDL_TYP_BYTE,
+                                           mg_spell_size(n_words, n_buckets,
+                                                         n_entries, text_size),
+                                           IDL_ARR_INI_ZERO, &result);
+  mg_spell_index index;
+  IDL_LONG64 *header = (IDL_LONG64 *) data;
+  header[0] = MG_SPELL_MAGIC;
+  header[1] = MG_SPELL_VERSION;
+  header[2] = max_distance;
+  header[3] = n_words;
+  header[4] = n_buckets;
+  header[5] = n_entries;
+  header[6] = text_size;
+  mg_spell_layout(&index, data);
+
+  for (i = 0, j = 0; i < n_words; i++) {
+    index.offsets[i] = (IDL_ULONG) j;
+    index.counts[i] = sorted[i].count;
+    memcpy(index.text + j, IDL_STRING_STR(sorted[i].word), sorted[i].word->slen + 1);
+    j += sorted[i].word->slen + 1;
+  }
+  index.offsets[n_words] = (IDL_ULONG) j;
+
+  // the deletes are sorted by hash, so each bucket is a contiguous run
+  for (i = 0; i < n_entries; i++) {
+    index.buckets[(info.deletes[i].hash & (n_buckets - 1)) + 1]++;
+  }
+  for (i = 0; i < n_buckets; i++) index.buckets[i + 1] += index.buckets[i];
+  for (i = 0; i < n_entries; i++) {
+    j = index.buckets[info.deletes[i].hash & (n_buckets - 1)]++;
+    index.entries[2 * j] = (IDL_ULONG) (info.deletes[i].hash >> 32);
+    index.entries[2 * j + 1] = info.deletes[i].word;
+  }
+  for (i = n_buckets; i > 0; i--) index.buckets[i] = index.buckets[i - 1];
+  index.buckets[0] = 0;
+
+  free(sorted);
+  free(info.deletes);
+
+  return result;
+}
+
+
+static IDL_VPTR IDL_CDECL IDL_mg_spell_correct(int argc, IDL_VPTR *argv, char *argk) {
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_VPTR correct;
+    int correct_present;
+    IDL_VPTR count;
+    int count_present;
+    IDL_VPTR distance;
+    int distance_present;
+    IDL_VPTR found;
+    int found_present;
+    IDL_LONG max_distance;
+    int max_distance_present;
+    IDL_LONG n_threads;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "CORRECT", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(correct_present), IDL_KW_OFFSETOF(correct) },
+    { "COUNT", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(count_present), IDL_KW_OFFSETOF(count) },
+    { "DISTANCE", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(distance_present), IDL_KW_OFFSETOF(distance) },
+    { "FOUND", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(found_present), IDL_KW_OFFSETOF(found) },
+    { "MAX_DISTANCE", IDL_TYP_LONG, 1, 0,
+      IDL_KW_OFFSETOF(max_distance_present), IDL_KW_OFFSETOF(max_distance) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  int nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, (IDL_VPTR *) NULL, 1, &kw);
+
+  mg_spell_query_info info;
+  IDL_VPTR input = argv[1];
+  IDL_MEMINT i, n;
+  int nthreads;
+
+  IDL_ENSURE_SIMPLE(argv[0]);
+  IDL_ENSURE_SIMPLE(input);
+  if (input->type != IDL_TYP_STRING) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "words must be a string or string array");
+  }
+
+  memset(&info, 0, sizeof(info));
+  char *msg = mg_spell_get(argv[0], &info.index);
+  if (msg) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "%s", msg);
+  }
+
+  info.max_distance = kw.max_distance_present ? kw.max_distance : info.index.max_distance;
+  if (info.max_distance < 0 || info.max_distance > info.index.max_distance) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "MAX_DISTANCE must be from 0 to %d for this index",
+                info.index.max_distance);
+  }
+
+  if (input->flags & IDL_V_ARR) {
+    info.words = (IDL_STRING *) input->value.arr->data;
+    n = input->value.arr->n_elts;
+  } else {
+    info.words = &input->value.str;
+    n = 1;
+  }
+  nthreads = mg_thread_count(n, MG_SPELL_MIN_WORDS, kw.n_threads);
+
+  info.stamps = (IDL_ULONG *) calloc(nthreads * info.index.n_words,
+                                     sizeof(IDL_ULONG));
+  if (info.stamps == NULL) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unable to allocate memory");
+  }
+
+  IDL_VPTR best_vptr, distances_vptr, result;
+  IDL_VPTR correct_vptr, found_vptr;
+  IDL_STRING *corrections;
+  UCHAR *correct, *found;
+  IDL_LONG n_found = 0;
+
+  if (input->flags & IDL_V_ARR) {
+    IDL_ARRAY *arr = input->value.arr;
+    info.best = (IDL_LONG *) IDL_MakeTempArray(IDL_TYP_LONG, arr->n_dim, arr->dim,
+                                               IDL_ARR_INI_NOP, &best_vptr);
+    info.distances = (IDL_LONG *) IDL_MakeTempArray(IDL_TYP_LONG, arr->n_dim, arr->dim,
+                                                    IDL_ARR_INI_NOP, &distances_vptr);
+    corrections = (IDL_STRING *) IDL_MakeTempArray(IDL_TYP_STRING, arr->n_dim, arr->dim,
+                                                   IDL_ARR_INI_ZERO, &result);
+    correct = (UCHAR *) IDL_MakeTempArray(IDL_TYP_BYTE, arr->n_dim, arr->dim,
+                                          IDL_ARR_INI_NOP, &correct_vptr);
+    found = (UCHAR *) IDL_MakeTempArray(IDL_TYP_BYTE, arr->n_dim, arr->dim,
+                                        IDL_ARR_INI_NOP, &found_vptr);
+  } else {
+    best_vptr = IDL_GettmpLong(-1);
+    distances_vptr = IDL_GettmpLong(-1);
+    result = IDL_StrToSTRING("");
+    correct_vptr = IDL_GettmpByte(0);
+    found_vptr = IDL_GettmpByte(0);
+    info.best = &best_vptr->value.l;
+    info.distances = &distances_vptr->value.l;
+    corrections = &result->value.str;
+    correct = &correct_vptr->value.c;
+    found = &found_vptr->value.c;
+  }
+
+  mg_thread_run(nthreads, n, mg_spell_correct_work, &info);
+  free(info.stamps);
+
+  for (i = 0; i < n; i++) {
+    found[i] = info.best[i] >= 0;
+    correct[i] = info.distances[i] == 0;
+    if (found[i]) {
+      n_found++;
+      IDL_StrStore(&corrections[i],
+                   info.index.text + info.index.offsets[info.best[i]]);
+    }
+  }
+  IDL_Deltmp(best_vptr);
+
+  // copy over the outputs for keywords passed as named variables
+  if (kw.correct_present) {
+    IDL_VarCopy(correct_vptr, kw.correct);
+  } else IDL_Deltmp(correct_vptr);
+
+  if (kw.count_present) {
+    IDL_VarCopy(IDL_GettmpLong(n_found), kw.count);
+  }
+
+  if (kw.distance_present) {
+    IDL_VarCopy(distances_vptr, kw.distance);
+  } else IDL_Deltmp(distances_vptr);
+
+  if (kw.found_present) {
+    IDL_VarCopy(found_vptr, kw.found);
+  } else IDL_Deltmp(found_vptr);
+
+  IDL_KW_FREE;
+
+  return result;
+}
+
+
 static IDL_VPTR IDL_CDECL IDL_mg_tre_config(int argc, IDL_VPTR *argv, char *argk) {
   typedef struct {
     IDL_KW_RESULT_FIRST_FIELD;
@@ -471,7 +1912,9 @@ int IDL_Load(void) {
     { IDL_mg_tre_version, "MG_TRE_VERSION", 0, 0, 0, 0 },
     { IDL_mg_tre_config,  "MG_TRE_CONFIG",  0, 0, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
     { IDL_mg_stregex,     "MG_STREGEX",     2, 2, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
-    { IDL_mg_strsplit,    "MG_STRSPLIT",    2, 2, 0, 0 },
+    { IDL_mg_strsplit,    "MG_STRSPLIT",    1, 2, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+    { IDL_mg_spell_index, "MG_SPELL_INDEX", 2, 2, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+    { IDL_mg_spell_correct, "MG_SPELL_CORRECT", 2, 2, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
   };
 
   return IDL_SysRtnAdd(function_addr, TRUE, IDL_CARRAY_ELTS(function_addr));
@@ -7,17 +7,70 @@
 #include <math.h>
 
 #include "mg_idl_export.h"
+#include "mg_threads.h"
 
+// default number of steps of a streamline in each direction and step size
 #define N_SEGMENTS 20
 #define STEP_SIZE 0.5
 
-// forward/backward streamlines
-static int nfwd, nbwd;
-static float fwd_float[2][N_SEGMENTS], bwd_float[2][N_SEGMENTS];
-static double fwd_double[2][N_SEGMENTS], bwd_double[2][N_SEGMENTS];
+// minimum number of rows per thread
+#define MG_LIC_MIN_ROWS 4
 
-// vector field
-static IDL_VPTR u, v;
+// FastLIC streamlines are at most this many times longer than the kernel
+#define MG_LIC_FAST_FACTOR 16
+
+// number of rows seeded and filled together by FastLIC
+#define MG_LIC_FAST_BLOCK_ROWS 64
+
+// default number of ripples of the animated kernel along a streamline
+#define MG_LIC_RIPPLES 2.0
+
+#define MG_LIC_PI 3.14159265358979323846
+
+// default maximum number of steps of a traced particle
+#define MG_TRACE_MAX_STEPS 100
+
+// default stagnation speed, as a fraction of the maximum speed of the field
+#define MG_TRACE_STAGNATION 1.0e-6
+
+// default error tolerance of an adaptive step, in elements
+#define MG_TRACE_TOLERANCE 1.0e-4
+
+// minimum number of seeds per thread
+#define MG_TRACE_MIN_SEEDS 16
+
+// number of vertices a thread initially allocates room for
+#define MG_TRACE_BUFFER_SIZE 1024
+
+
+/*
+  Vector field and texture of a LIC computation, shared by all threads, and
+  the maximum of the integral found by each thread.
+*/
+typedef struct {
+  void *u;
+  void *v;
+  int nrows;
+  int ncols;
+  int length;              // number of steps in each direction of the kernel
+  double step;
+  UCHAR *texture;
+  int *integral;
+  UCHAR *result;
+
+  // FastLIC sums of the integrals deposited in each element and their number
+  float *sums;
+  int *hits;
+
+  // animated LIC kernel weights, (2 * length + 1) for each frame, and frames
+  int nframes;
+  const float *weights;
+  float *frames;
+  float frames_max[MG_THREADS_MAX];
+
+  int max[MG_THREADS_MAX];
+  int failed[MG_THREADS_MAX];
+} mg_lic_info;
 
 
 /*
@@ -27,25 +80,24 @@ static IDL_VPTR u, v;
 
   Returns the status of finding the new point in the streamline and places
   the new point in the seg parameter.
-
-  Uses the u and v file variables to lookup vector field values.
 */
 #define MG_LIC_RK(TYPE)                                                       \
-static int mg_lic_rk_ ## TYPE(TYPE x, TYPE y, TYPE step, TYPE seg[]) {        \
-  TYPE *udata = (TYPE *)u->value.arr->data,                                   \
-       *vdata = (TYPE *)v->value.arr->data;                                   \
-  TYPE k[2][4], coef[] = { 0.0, 0.5, 0.5, 1.0 };                              \
+static int mg_lic_rk_ ## TYPE(const mg_lic_info *info,                        \
+                              TYPE x, TYPE y, TYPE step, TYPE seg[]) {        \
+  const TYPE *udata = (const TYPE *) info->u,                                 \
+             *vdata = (const TYPE *) info->v;                                 \
+  TYPE k[2][4] = { { 0.0 } }, coef[] = { 0.0, 0.5, 0.5, 1.0 };                \
   int c;                                                                      \
   TYPE mag;                                                                   \
   TYPE uv[2], xy[2] = { x, y };                                               \
   int ind;                                                                    \
-  int size = u->value.arr->dim[0] * u->value.arr->dim[1];                     \
+  int size = info->ncols * info->nrows;                                       \
                                                                               \
   for (c = 0; c < 4; c++) {                                                   \
     xy[0] = x + k[0][0] * coef[c];                                            \
     xy[1] = y + k[1][0] * coef[c];                                            \
                                                                               \
-    ind = (int) xy[0] + (int) xy[1] * u->value.arr->dim[0];                   \
+    ind = (int) xy[0] + (int) xy[1] * info->ncols;                            \
     if (ind < 0 || ind >= size) return 0;                                     \
     uv[0] = udata[ind];                                                       \
     uv[1] = vdata[ind];                                                       \
@@ -70,51 +122,72 @@ MG_LIC_RK(float);
 MG_LIC_RK(double);
 
 
+/*
+  Forward and backward streamlines of an element, each of length steps, in a
+  buffer for each thread reused for every element it computes.
+*/
+#define MG_LIC_LINES(TYPE)                                                    \
+typedef struct {                                                              \
+  int nfwd, nbwd;                                                             \
+  TYPE *fwd[2], *bwd[2];                                                      \
+} mg_lic_lines_ ## TYPE;
+
+MG_LIC_LINES(float);
+MG_LIC_LINES(double);
+
+
 /*
   Compute streamline forward and backward for the element at the given row
-  and column.
+  and column. The two directions are stepped together, so their independent
+  computations can overlap.
 */
 #define MG_LIC_STREAMLINE(TYPE)                                               \
-static void mg_lic_streamline_ ## TYPE(TYPE row, TYPE col, int nrows, int ncols) { \
+static void mg_lic_streamline_ ## TYPE(const mg_lic_info *info,               \
+                                       TYPE row, TYPE col,                    \
+                                       mg_lic_lines_ ## TYPE *lines) {        \
+  int nrows = info->nrows, ncols = info->ncols;                               \
+  TYPE step = info->step;                                                     \
   int fwdValid = 1;                                                           \
   int bwdValid = 1;                                                           \
   int k;                                                                      \
   TYPE seg[2];                                                                \
                                                                               \
-  nfwd = 0;                                                                   \
-  nbwd = 0;                                                                   \
+  lines->nfwd = 0;                                                            \
+  lines->nbwd = 0;                                                            \
                                                                               \
-  fwdValid = mg_lic_rk_ ## TYPE(col + 0.5, row + 0.5, STEP_SIZE, seg);        \
+  fwdValid = mg_lic_rk_ ## TYPE(info, col + 0.5, row + 0.5, step, seg);       \
   if (seg[0] < 0 || seg[0] >= ncols) fwdValid = 0;                            \
   if (seg[1] < 0 || seg[1] >= nrows) fwdValid = 0;                            \
-  fwd_ ## TYPE[0][0] = seg[0];                                                \
-  fwd_ ## TYPE[1][0] = seg[1];                                                \
-  if (fwdValid) nfwd++;                                                       \
+  lines->fwd[0][0] = seg[0];                                                  \
+  lines->fwd[1][0] = seg[1];                                                  \
+  if (fwdValid) lines->nfwd++;                                                \
                                                                               \
-  bwdValid = mg_lic_rk_ ## TYPE(col + 0.5, row + 0.5, - STEP_SIZE, seg);      \
+  bwdValid = mg_lic_rk_ ## TYPE(info, col + 0.5, row + 0.5, - step, seg);    \
   if (seg[0] < 0 || seg[0] >= ncols) bwdValid = 0;                            \
   if (seg[1] < 0 || seg[1] >= nrows) bwdValid = 0;                            \
-  bwd_ ## TYPE[0][0] = seg[0];                                                \
-  bwd_ ## TYPE[1][0] = seg[1];                                                \
-  if (bwdValid) nbwd++;                                                       \
+  lines->bwd[0][0] = seg[0];                                                  \
+  lines->bwd[1][0] = seg[1];                                                  \
+  if (bwdValid) lines->nbwd++;                                                \
                                                                               \
-  for (k = 1; k < N_SEGMENTS; k++) {                                          \
+  for (k = 1; k < info->length && (fwdValid || bwdValid); k++) {             \
     if (fwdValid) {                                                           \
-      fwdValid = mg_lic_rk_ ## TYPE(fwd_ ## TYPE[0][k-1], fwd_ ## TYPE[1][k-1], STEP_SIZE, seg); \
+      fwdValid = mg_lic_rk_ ## TYPE(info, lines->fwd[0][k - 1], lines->fwd[1][k - 1], \
+                                    step, seg);                               \
       if (seg[0] < 0 || seg[0] >= ncols) fwdValid = 0;                        \
       if (seg[1] < 0 || seg[1] >= nrows) fwdValid = 0;                        \
-      fwd_ ## TYPE[0][k] = seg[0];                                            \
-      fwd_ ## TYPE[1][k] = seg[1];                                            \
-      if (fwdValid) nfwd++;                                                   \
+      lines->fwd[0][k] = seg[0];                                              \
+      lines->fwd[1][k] = seg[1];                                              \
+      if (fwdValid) lines->nfwd++;                                            \
     }                                                                         \
                                                                               \
     if (bwdValid) {                                                           \
-      bwdValid = mg_lic_rk_ ## TYPE(bwd_ ## TYPE[0][k-1], bwd_ ## TYPE[1][k-1], - STEP_SIZE, seg); \
+      bwdValid = mg_lic_rk_ ## TYPE(info, lines->bwd[0][k - 1], lines->bwd[1][k - 1], \
+                                    - step, seg);                             \
       if (seg[0] < 0 || seg[0] >= ncols) bwdValid = 0;                        \
       if (seg[1] < 0 || seg[1] >= nrows) bwdValid = 0;                        \
-      bwd_ ## TYPE[0][k] = seg[0];                                            \
-      bwd_ ## TYPE[1][k] = seg[1];                                            \
-      if (bwdValid) nbwd++;                                                   \
+      lines->bwd[0][k] = seg[0];                                              \
+      lines->bwd[1][k] = seg[1];                                              \
+      if (bwdValid) lines->nbwd++;                                            \
     }                                                                         \
   }                                                                           \
 }
@@ -123,6 +196,671 @@ MG_LIC_STREAMLINE(float);
 MG_LIC_STREAMLINE(double);
 
 
+/*
+  Compute the integral, the average of the texture along the forward and
+  backward streamlines, for rows [start, end).
+*/
+#define MG_LIC_ROWS(TYPE)                                                     \
+static void mg_lic_rows_ ## TYPE(IDL_MEMINT start, IDL_MEMINT end,            \
+                                 int thread_index, void *data) {              \
+  mg_lic_info *info = (mg_lic_info *) data;                                   \
+  mg_lic_lines_ ## TYPE lines;                                                \
+  const UCHAR *tex = info->texture;                                           \
+  int ncols = info->ncols, length = info->length;                             \
+  int row, col, f, b, sum, max = 0;                                           \
+  TYPE *buffer = (TYPE *) malloc(4 * length * sizeof(TYPE));                  \
+                                                                              \
+  if (buffer == NULL) {                                                       \
+    info->failed[thread_index] = 1;                                           \
+    return;                                                                   \
+  }                                                                           \
+  lines.fwd[0] = buffer;                                                      \
+  lines.fwd[1] = buffer + length;                                             \
+  lines.bwd[0] = buffer + 2 * length;                                         \
+  lines.bwd[1] = buffer + 3 * length;                                         \
+                                                                              \
+  for (row = (int) start; row < end; row++) {                                 \
+    for (col = 0; col < ncols; col++) {                                       \
+      mg_lic_streamline_ ## TYPE(info, (TYPE) row, (TYPE) col, &lines);       \
+                                                                              \
+      sum = (int) tex[col + row * ncols];                                     \
+      for (f = 0; f < lines.nfwd; f++) {                                      \
+        sum += (int) tex[(int) lines.fwd[0][f] + (int) lines.fwd[1][f] * ncols]; \
+      }                                                                       \
+      for (b = 0; b < lines.nbwd; b++) {                                      \
+        sum += (int) tex[(int) lines.bwd[0][b] + (int) lines.bwd[1][b] * ncols]; \
+      }                                                                       \
+                                                                              \
+      sum /= lines.nfwd + lines.nbwd + 1;                                     \
+      info->integral[col + row * ncols] = sum;                                \
+      if (sum > max) max = sum;                                               \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  info->max[thread_index] = max;                                              \
+  free(buffer);                                                               \
+}
+
+MG_LIC_ROWS(float);
+MG_LIC_ROWS(double);
+
+
+/*
+  FastLIC, from "Fast and Resolution Independent Line Integral Convolution" by
+  Detlev Stalling and Hans-Christian Hege. Instead of integrating a streamline
+  for every element, a long streamline is integrated from each element not yet
+  hit by another streamline and a box filter is slid along it, depositing the
+  integral at each point into the element containing it.
+
+  Rows are processed in blocks of MG_LIC_FAST_BLOCK_ROWS rows, seeding in scan
+  order and depositing only into elements of the block, so the blocks are
+  independent and the result does not depend on the number of threads. A
+  streamline is stopped once it has been outside of its block for more than
+  the length of the kernel.
+*/
+#define MG_LIC_FAST(TYPE)                                                     \
+static void mg_lic_fast_ ## TYPE(IDL_MEMINT start, IDL_MEMINT end,            \
+                                 int thread_index, void *data) {              \
+  mg_lic_info *info = (mg_lic_info *) data;                                   \
+  const UCHAR *tex = info->texture;                                           \
+  int nrows = info->nrows, ncols = info->ncols, length = info->length;        \
+  int n = MG_LIC_FAST_FACTOR * length;                                        \
+  int block, row, col, first_row, last_row, dir, k, i, lo, hi, x, y, pix;     \
+  int valid, sum, outside;                                                    \
+  TYPE step, seg[2];                                                          \
+                                                                              \
+  /* streamline points n - nbwd to n + nfwd, centered at index n */          \
+  TYPE *xs = (TYPE *) malloc((2 * n + 1) * 2 * sizeof(TYPE));                 \
+  TYPE *ys = xs + 2 * n + 1;                                                  \
+  int *samples = (int *) malloc((2 * n + 1) * sizeof(int));                   \
+                                                                              \
+  if (xs == NULL || samples == NULL) {                                        \
+    info->failed[thread_index] = 1;                                           \
+    if (xs) free(xs);                                                         \
+    if (samples) free(samples);                                               \
+    return;                                                                   \
+  }                                                                           \
+                                                                              \
+  for (block = (int) start; block < end; block++) {                           \
+    first_row = block * MG_LIC_FAST_BLOCK_ROWS;                               \
+    last_row = first_row + MG_LIC_FAST_BLOCK_ROWS;                            \
+    if (last_row > nrows) last_row = nrows;                                   \
+                                                                              \
+    for (row = first_row; row < last_row; row++) {                            \
+      for (col = 0; col < ncols; col++) {                                     \
+        if (info->hits[col + row * ncols] > 0) continue;                      \
+                                                                              \
+        /* integrate backward, then forward, from the center of the element */ \
+        xs[n] = (TYPE) col + 0.5;                                             \
+        ys[n] = (TYPE) row + 0.5;                                             \
+        lo = hi = n;                                                          \
+        for (dir = -1; dir <= 1; dir += 2) {                                  \
+          step = dir * info->step;                                            \
+          outside = 0;                                                        \
+          for (k = n, valid = 1; valid && k != n + dir * n; k += dir) {       \
+            valid = mg_lic_rk_ ## TYPE(info, xs[k], ys[k], step, seg);        \
+            if (seg[0] < 0 || seg[0] >= ncols) valid = 0;                     \
+            if (seg[1] < 0 || seg[1] >= nrows) valid = 0;                     \
+            if (valid) {                                                      \
+              xs[k + dir] = seg[0];                                           \
+              ys[k + dir] = seg[1];                                           \
+              if (dir < 0) lo = k + dir; else hi = k + dir;                   \
+              y = (int) seg[1];                                               \
+              outside = y < first_row || y >= last_row ? outside + 1 : 0;     \
+              if (outside > length) valid = 0;                                \
+            }                                                                 \
+          }                                                                   \
+        }                                                                     \
+                                                                              \
+        for (i = lo; i <= hi; i++) {                                          \
+          samples[i] = (int) tex[(int) xs[i] + (int) ys[i] * ncols];          \
+        }                                                                     \
+                                                                              \
+        /* slide a box filter of length steps on each side along the line */ \
+        sum = 0;                                                              \
+        for (i = lo; i <= hi && i <= lo + length; i++) sum += samples[i];     \
+        for (i = lo; i <= hi; i++) {                                          \
+          x = (int) xs[i];                                                    \
+          y = (int) ys[i];                                                    \
+          if (y >= first_row && y < last_row) {                               \
+            pix = x + y * ncols;                                              \
+            info->sums[pix] += (float) sum                                    \
+                                 / ((i + length < hi ? i + length : hi)       \
+                                    - (i - length > lo ? i - length : lo) + 1); \
+            info->hits[pix]++;                                                \
+          }                                                                   \
+          if (i + length + 1 <= hi) sum += samples[i + length + 1];           \
+          if (i - length >= lo) sum -= samples[i - length];                   \
+        }                                                                     \
+      }                                                                       \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  free(xs);                                                                   \
+  free(samples);                                                              \
+}
+
+MG_LIC_FAST(float);
+MG_LIC_FAST(double);
+
+
+// average the FastLIC integrals deposited in each element of rows [start, end)
+static void mg_lic_fast_integral(IDL_MEMINT start, IDL_MEMINT end,
+                                 int thread_index, void *data) {
+  mg_lic_info *info = (mg_lic_info *) data;
+  IDL_MEMINT item;
+  int max = 0;
+
+  for (item = start * info->ncols; item < end * info->ncols; item++) {
+    info->integral[item] = (int) (info->sums[item] / info->hits[item]);
+    if (info->integral[item] > max) max = info->integral[item];
+  }
+
+  info->max[thread_index] = max;
+}
+
+
+// scale the integral of rows [start, end) by 255 / max into the result
+static void mg_lic_normalize(IDL_MEMINT start, IDL_MEMINT end,
+                             int thread_index, void *data) {
+  mg_lic_info *info = (mg_lic_info *) data;
+  IDL_MEMINT item;
+  int max = info->max[0];
+
+  for (item = start * info->ncols; item < end * info->ncols; item++) {
+    info->result[item] = max > 0 ? (UCHAR) (255 * info->integral[item] / max) : 0;
+  }
+}
+
+
+/*
+  Direction of the vector field at the point x, y, bilinearly interpolated
+  between the centers of the four nearest elements and normalized. Returns 0
+  if the point is outside of the field.
+*/
+#define MG_LIC_SAMPLE(TYPE)                                                   \
+static int mg_lic_sample_ ## TYPE(const mg_lic_info *info,                    \
+                                  TYPE x, TYPE y, TYPE uv[]) {                \
+  const TYPE *udata = (const TYPE *) info->u,                                 \
+             *vdata = (const TYPE *) info->v;                                 \
+  int ncols = info->ncols, nrows = info->nrows;                               \
+  int x0, y0, x1, y1;                                                         \
+  TYPE fx, fy, ax, ay, mag;                                                   \
+                                                                              \
+  if (!(x >= 0 && x < ncols && y >= 0 && y < nrows)) return 0;               \
+                                                                              \
+  fx = x < 0.5 ? 0.0 : x - 0.5;                                               \
+  fy = y < 0.5 ? 0.0 : y - 0.5;                                               \
+  x0 = (int) fx;                                                              \
+  y0 = (int) fy;                                                              \
+  x1 = x0 + 1 < ncols ? x0 + 1 : x0;                                          \
+  y1 = y0 + 1 < nrows ? y0 + 1 : y0;                                          \
+  ax = fx - x0;                                                               \
+  ay = fy - y0;                                                               \
+                                                                              \
+  uv[0] = (1 - ay) * ((1 - ax) * udata[x0 + y0 * ncols] + ax * udata[x1 + y0 * ncols]) \
+          + ay * ((1 - ax) * udata[x0 + y1 * ncols] + ax * udata[x1 + y1 * ncols]); \
+  uv[1] = (1 - ay) * ((1 - ax) * vdata[x0 + y0 * ncols] + ax * vdata[x1 + y0 * ncols]) \
+          + ay * ((1 - ax) * vdata[x0 + y1 * ncols] + ax * vdata[x1 + y1 * ncols]); \
+                                                                              \
+  mag = sqrt(uv[0] * uv[0] + uv[1] * uv[1]);                                  \
+  if (mag != 0) {                                                             \
+    uv[0] /= mag;                                                             \
+    uv[1] /= mag;                                                             \
+  }                                                                           \
+                                                                              \
+  return 1;                                                                   \
+}
+
+MG_LIC_SAMPLE(float);
+MG_LIC_SAMPLE(double);
+
+
+/*
+  Fourth order Runge-Kutta step of the given (possibly negative) size along
+  the bilinearly interpolated field. Returns 0 if the step leaves the field.
+*/
+#define MG_LIC_RK4(TYPE)                                                      \
+static int mg_lic_rk4_ ## TYPE(const mg_lic_info *info,                       \
+                               TYPE x, TYPE y, TYPE step, TYPE seg[]) {       \
+  TYPE k1[2], k2[2], k3[2], k4[2];                                            \
+                                                                              \
+  if (!mg_lic_sample_ ## TYPE(info, x, y, k1)) return 0;                      \
+  if (!mg_lic_sample_ ## TYPE(info, x + 0.5 * step * k1[0],                   \
+                              y + 0.5 * step * k1[1], k2)) return 0;          \
+  if (!mg_lic_sample_ ## TYPE(info, x + 0.5 * step * k2[0],                   \
+                              y + 0.5 * step * k2[1], k3)) return 0;          \
+  if (!mg_lic_sample_ ## TYPE(info, x + step * k3[0],                         \
+                              y + step * k3[1], k4)) return 0;                \
+                                                                              \
+  seg[0] = x + step * (k1[0] + 2 * k2[0] + 2 * k3[0] + k4[0]) / 6.0;          \
+  seg[1] = y + step * (k1[1] + 2 * k2[1] + 2 * k3[1] + k4[1]) / 6.0;          \
+                                                                              \
+  return seg[0] >= 0 && seg[0] < info->ncols                                  \
+           && seg[1] >= 0 && seg[1] < info->nrows;                            \
+}
+
+MG_LIC_RK4(float);
+MG_LIC_RK4(double);
+
+
+/*
+  Compute every frame of the animated LIC for rows [start, end). The
+  streamline of each element, and the texture along it, is computed once;
+  the frames only differ in the kernel weights applied to it.
+*/
+#define MG_LIC_ANIMATE_ROWS(TYPE)                                             \
+static void mg_lic_animate_rows_ ## TYPE(IDL_MEMINT start, IDL_MEMINT end,    \
+                                         int thread_index, void *data) {      \
+  mg_lic_info *info = (mg_lic_info *) data;                                   \
+  const UCHAR *tex = info->texture;                                           \
+  int ncols = info->ncols, length = info->length;                             \
+  IDL_MEMINT npixels = (IDL_MEMINT) info->nrows * ncols, item;                \
+  int row, col, k, f, j, lo, hi, fwdValid, bwdValid;                          \
+  TYPE step = info->step, fwd[2], bwd[2], seg[2];                             \
+  const float *w;                                                             \
+  float sum, wsum, value, max = 0.0;                                          \
+  float *buffer = (float *) malloc((2 * length + 1) * sizeof(float));         \
+  float *samples = buffer + length;                                           \
+                                                                              \
+  if (buffer == NULL) {                                                       \
+    info->failed[thread_index] = 1;                                           \
+    return;                                                                   \
+  }                                                                           \
+                                                                              \
+  for (row = (int) start; row < end; row++) {                                 \
+    for (col = 0; col < ncols; col++) {                                       \
+      item = col + (IDL_MEMINT) row * ncols;                                  \
+      samples[0] = tex[item];                                                 \
+                                                                              \
+      /* texture along the forward and backward streamline */                 \
+      fwd[0] = bwd[0] = col + 0.5;                                            \
+      fwd[1] = bwd[1] = row + 0.5;                                            \
+      fwdValid = bwdValid = 1;                                                \
+      lo = hi = 0;                                                            \
+      for (k = 1; k <= length && (fwdValid || bwdValid); k++) {               \
+        if (fwdValid) {                                                       \
+          fwdValid = mg_lic_rk4_ ## TYPE(info, fwd[0], fwd[1], step, seg);    \
+          if (fwdValid) {                                                     \
+            fwd[0] = seg[0];                                                  \
+            fwd[1] = seg[1];                                                  \
+            samples[k] = tex[(int) fwd[0] + (int) fwd[1] * ncols];            \
+            hi = k;                                                           \
+          }                                                                   \
+        }                                                                     \
+                                                                              \
+        if (bwdValid) {                                                       \
+          bwdValid = mg_lic_rk4_ ## TYPE(info, bwd[0], bwd[1], - step, seg);  \
+          if (bwdValid) {                                                     \
+            bwd[0] = seg[0];                                                  \
+            bwd[1] = seg[1];                                                  \
+            samples[- k] = tex[(int) bwd[0] + (int) bwd[1] * ncols];          \
+            lo = - k;                                                         \
+          }                                                                   \
+        }                                                                     \
+      }                                                                       \
+                                                                              \
+      /* weighted average of the texture with the kernel of each frame */     \
+      for (f = 0; f < info->nframes; f++) {                                   \
+        w = info->weights + f * (2 * length + 1) + length;                    \
+        sum = 0.0;                                                            \
+        wsum = 0.0;                                                           \
+        for (j = lo; j <= hi; j++) {                                          \
+          sum += w[j] * samples[j];                                           \
+          wsum += w[j];                                                       \
+        }                                                                     \
+        value = wsum > 1.0e-6 ? sum / wsum : samples[0];                      \
+        info->frames[f * npixels + item] = value;                             \
+        if (value > max) max = value;                                         \
+      }                                                                       \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  info->frames_max[thread_index] = max;                                       \
+  free(buffer);                                                               \
+}
+
+MG_LIC_ANIMATE_ROWS(float);
+MG_LIC_ANIMATE_ROWS(double);
+
+
+// scale rows [start, end) of all the frames by 255 / max into the result
+static void mg_lic_animate_normalize(IDL_MEMINT start, IDL_MEMINT end,
+                                     int thread_index, void *data) {
+  mg_lic_info *info = (mg_lic_info *) data;
+  IDL_MEMINT item;
+  float max = info->frames_max[0];
+
+  for (item = start * info->ncols; item < end * info->ncols; item++) {
+    info->result[item] = max > 0 ? (UCHAR) (255.0 * info->frames[item] / max + 0.5) : 0;
+  }
+}
+
+
+/*
+  Counter-based random texture value for the element at the given index, so
+  that a seed always produces the same texture. This is splitmix64.
+*/
+static UCHAR mg_lic_noise(IDL_ULONG64 seed, IDL_MEMINT item) {
+  IDL_ULONG64 z = seed + ((IDL_ULONG64) item + 1) * 0x9E3779B97F4A7C15ULL;
+
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z ^= z >> 31;
+
+  return (UCHAR) (z >> 56);
+}
+
+
+/*
+  Vector field and seeds of a particle trace, shared by all threads, and the
+  vertices traced by each thread. A field with nframes > 1 is time-varying,
+  with frames one time unit apart.
+*/
+typedef struct {
+  const void *fields[3];
+  int is_double;
+  int ndim;
+  IDL_MEMINT dims[3];
+  IDL_MEMINT strides[3];
+  IDL_MEMINT frame_size;
+  int nframes;
+
+  const double *seeds;
+  double start_time;
+  double step;
+  double min_speed;
+  double tolerance;
+  int adaptive;
+  IDL_LONG max_steps;
+
+  // number of vertices of each seed and, for each thread, the coordinates
+  // and time of its vertices
+  IDL_LONG *counts;
+  double *vertices[MG_THREADS_MAX];
+  IDL_MEMINT nvertices[MG_THREADS_MAX];
+  int failed[MG_THREADS_MAX];
+} mg_trace_info;
+
+
+/*
+  Velocity at the point pos, in index coordinates, and time t by bilinear (2D)
+  or trilinear (3D) interpolation in space and linear interpolation between
+  the frames of a time-varying field. Returns 0 if the point is outside of
+  the field.
+*/
+#define MG_TRACE_VELOCITY(TYPE)                                               \
+static int mg_trace_velocity_ ## TYPE(const mg_trace_info *info,              \
+                                      const double *pos, double t,            \
+                                      double *vel) {                          \
+  IDL_MEMINT i0[3], offset;                                                   \
+  double frac[3], w, wt;                                                      \
+  int d, c, corner, f, f0 = 0, nf = 1, bit;                                   \
+                                                                              \
+  for (d = 0; d < info->ndim; d++) {                                          \
+    if (!(pos[d] >= 0.0 && pos[d] <= info->dims[d] - 1)) return 0;            \
+    i0[d] = (IDL_MEMINT) pos[d];                                              \
+    if (i0[d] > info->dims[d] - 2) i0[d] = info->dims[d] - 2;                 \
+    frac[d] = pos[d] - i0[d];                                                 \
+  }                                                                           \
+                                                                              \
+  if (info->nframes > 1) {                                                    \
+    if (!(t >= 0.0 && t <= info->nframes - 1)) return 0;                      \
+    f0 = (int) t;                                                             \
+    if (f0 > info->nframes - 2) f0 = info->nframes - 2;                       \
+    t -= f0;                                                                  \
+    nf = 2;                                                                   \
+  }                                                                           \
+                                                                              \
+  for (c = 0; c < info->ndim; c++) vel[c] = 0.0;                              \
+  for (f = 0; f < nf; f++) {                                                  \
+    wt = nf == 1 ? 1.0 : (f == 0 ? 1.0 - t : t);                              \
+    for (corner = 0; corner < (1 << info->ndim); corner++) {                  \
+      w = wt;                                                                 \
+      offset = (f0 + f) * info->frame_size;                                   \
+      for (d = 0; d < info->ndim; d++) {                                      \
+        bit = (corner >> d) & 1;                                              \
+        w *= bit ? frac[d] : 1.0 - frac[d];                                   \
+        offset += (i0[d] + bit) * info->strides[d];                           \
+      }                                                                       \
+      for (c = 0; c < info->ndim; c++) {                                      \
+        vel[c] += w * ((const TYPE *) info->fields[c])[offset];               \
+      }                                                                       \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  return 1;                                                                   \
+}
+
+MG_TRACE_VELOCITY(float);
+MG_TRACE_VELOCITY(double);
+
+
+// returns whether the point pos at time t is inside of the field
+static int mg_trace_inside(const mg_trace_info *info, const double *pos,
+                           double t) {
+  int d;
+
+  for (d = 0; d < info->ndim; d++) {
+    if (!(pos[d] >= 0.0 && pos[d] <= info->dims[d] - 1)) return 0;
+  }
+
+  return info->nframes == 1 || (t >= 0.0 && t <= info->nframes - 1);
+}
+
+
+static int mg_trace_velocity(const mg_trace_info *info,
+                             const double *pos, double t, double *vel) {
+  return info->is_double
+           ? mg_trace_velocity_double(info, pos, t, vel)
+           : mg_trace_velocity_float(info, pos, t, vel);
+}
+
+
+// returns whether the particle is moving slower than the stagnation speed
+static int mg_trace_stagnant(const mg_trace_info *info, const double *vel) {
+  double speed2 = 0.0;
+  int c;
+
+  for (c = 0; c < info->ndim; c++) speed2 += vel[c] * vel[c];
+
+  return speed2 <= info->min_speed * info->min_speed;
+}
+
+
+/*
+  Fourth order Runge-Kutta step of size h from pos at time t, updating pos and
+  t. Returns 0, leaving them unchanged, if the particle leaves the field or
+  stagnates.
+*/
+static int mg_trace_rk4(const mg_trace_info *info, double *pos, double *t,
+                        double h) {
+  double k[4][3], q[3], stage[] = { 0.0, 0.5, 0.5, 1.0 };
+  int s, c, ndim = info->ndim;
+
+  for (s = 0; s < 4; s++) {
+    for (c = 0; c < ndim; c++) q[c] = pos[c] + (s > 0 ? stage[s] * h * k[s - 1][c] : 0.0);
+    if (!mg_trace_velocity(info, q, *t + stage[s] * h, k[s])) return 0;
+    if (s == 0 && mg_trace_stagnant(info, k[0])) return 0;
+  }
+
+  for (c = 0; c < ndim; c++) {
+    q[c] = pos[c] + h * (k[0][c] + 2.0 * k[1][c] + 2.0 * k[2][c] + k[3][c]) / 6.0;
+  }
+  if (!mg_trace_inside(info, q, *t + h)) return 0;
+
+  for (c = 0; c < ndim; c++) pos[c] = q[c];
+  *t += h;
+
+  return 1;
+}
+
+
+// Dormand-Prince coefficients
+static const double mg_trace_dp_c[7] = {
+  0.0, 1.0 / 5.0, 3.0 / 10.0, 4.0 / 5.0, 8.0 / 9.0, 1.0, 1.0
+};
+static const double mg_trace_dp_a[7][6] = {
+  { 0.0 },
+  { 1.0 / 5.0 },
+  { 3.0 / 40.0, 9.0 / 40.0 },
+  { 44.0 / 45.0, -56.0 / 15.0, 32.0 / 9.0 },
+  { 19372.0 / 6561.0, -25360.0 / 2187.0, 64448.0 / 6561.0, -212.0 / 729.0 },
+  { 9017.0 / 3168.0, -355.0 / 33.0, 46732.0 / 5247.0, 49.0 / 176.0,
+    -5103.0 / 18656.0 },
+  { 35.0 / 384.0, 0.0, 500.0 / 1113.0, 125.0 / 192.0, -2187.0 / 6784.0,
+    11.0 / 84.0 }
+};
+// difference between the fifth and fourth order solutions
+static const double mg_trace_dp_e[7] = {
+  71.0 / 57600.0, 0.0, -71.0 / 16695.0, 71.0 / 1920.0, -17253.0 / 339200.0,
+  22.0 / 525.0, -1.0 / 40.0
+};
+
+
+/*
+  Adaptive Dormand-Prince (RK45) step from pos at time t, trying step size h
+  first. On success, updates pos and t and sets h to the size to try for the
+  next step. Steps with a stage outside of the field are retried with half
+  the size, but not smaller than the STEP size, so particles do not creep up
+  to the boundary. Returns 0 if the particle leaves the field or stagnates.
+*/
+static int mg_trace_rk45(const mg_trace_info *info, double *pos, double *t,
+                         double *h) {
+  double k[7][3], q[3], err, e, factor, min_h = 1.0e-6 * info->step;
+  int s, j, c, valid, ndim = info->ndim;
+
+  if (!mg_trace_velocity(info, pos, *t, k[0])) return 0;
+  if (mg_trace_stagnant(info, k[0])) return 0;
+
+  while (*h >= min_h) {
+    // stages; the last stage is the velocity at the fifth order solution
+    for (s = 1, valid = 1; s < 7 && valid; s++) {
+      for (c = 0; c < ndim; c++) {
+        q[c] = pos[c];
+        for (j = 0; j < s; j++) q[c] += *h * mg_trace_dp_a[s][j] * k[j][c];
+      }
+      valid = mg_trace_velocity(info, q, *t + mg_trace_dp_c[s] * *h, k[s]);
+    }
+    if (!valid) {
+      if (0.5 * *h < info->step) return 0;
+      *h *= 0.5;
+      continue;
+    }
+
+    for (c = 0, err = 0.0; c < ndim; c++) {
+      for (j = 0, e = 0.0; j < 7; j++) e += mg_trace_dp_e[j] * k[j][c];
+      e = fabs(*h * e);
+      if (e > err) err = e;
+    }
+
+    factor = err == 0.0 ? 5.0 : 0.9 * pow(info->tolerance / err, 0.2);
+    if (factor < 0.2) factor = 0.2;
+    if (factor > 5.0) factor = 5.0;
+
+    if (err <= info->tolerance) {
+      for (c = 0; c < ndim; c++) pos[c] = q[c];
+      *t += *h;
+      *h *= factor;
+      return 1;
+    }
+    *h *= factor;
+  }
+
+  return 0;
+}
+
+
+/*
+  Trace seeds [start, end), appending the coordinates and time of each vertex
+  to a buffer for the thread.
+*/
+static void mg_trace_seeds(IDL_MEMINT start, IDL_MEMINT end,
+                           int thread_index, void *data) {
+  mg_trace_info *info = (mg_trace_info *) data;
+  int ndim = info->ndim, nc = info->ndim + 1, c, valid;
+  IDL_MEMINT seed, n = 0, capacity = MG_TRACE_BUFFER_SIZE;
+  IDL_LONG count;
+  double pos[3], vel[3], t, h, *tmp;
+  double *buffer = (double *) malloc(capacity * nc * sizeof(double));
+
+  if (buffer == NULL) {
+    info->failed[thread_index] = 1;
+    return;
+  }
+
+  for (seed = start; seed < end; seed++) {
+    for (c = 0; c < ndim; c++) pos[c] = info->seeds[seed * ndim + c];
+    t = info->start_time;
+    h = info->step;
+    valid = mg_trace_velocity(info, pos, t, vel);
+
+    for (count = 0; valid && count <= info->max_steps; count++) {
+      if (n == capacity) {
+        capacity *= 2;
+        tmp = (double *) realloc(buffer, capacity * nc * sizeof(double));
+        if (tmp == NULL) {
+          info->failed[thread_index] = 1;
+          info->vertices[thread_index] = buffer;
+          return;
+        }
+        buffer = tmp;
+      }
+      for (c = 0; c < ndim; c++) buffer[n * nc + c] = pos[c];
+      buffer[n * nc + ndim] = t;
+      n++;
+
+      if (count < info->max_steps) {
+        valid = info->adaptive
+                  ? mg_trace_rk45(info, pos, &t, &h)
+                  : mg_trace_rk4(info, pos, &t, h);
+      }
+    }
+
+    info->counts[seed] = count;
+  }
+
+  info->vertices[thread_index] = buffer;
+  info->nvertices[thread_index] = n;
+}
+
+
+// returns an error message if the vector field or texture are not valid
+static const char *mg_lic_check_inputs(IDL_VPTR u, IDL_VPTR v, IDL_VPTR texture) {
+  if (u->type != IDL_TYP_FLOAT && u->type != IDL_TYP_DOUBLE) {
+    return "u and v parameters must be float or double";
+  }
+
+  if (u->type != v->type) {
+    return "u and v parameters must be of the same type";
+  }
+
+  if (u->value.arr->n_dim !=2 || v->value.arr->n_dim != 2) {
+    return "u and v parameters must be 2 dimensional";
+  }
+
+  if (u->value.arr->dim[0] != v->value.arr->dim[0]
+        || u->value.arr->dim[1] != v->value.arr->dim[1]) {
+    return "u and v parameters must have the same dimensions";
+  }
+
+  if (texture) {
+    if (texture->type != IDL_TYP_BYTE ) {
+      return "TEXTURE must be of type byte";
+    }
+    if (texture->value.arr->n_dim !=2) {
+      return "TEXTURE must be 2 dimensional";
+    }
+    if (u->value.arr->dim[0] != texture->value.arr->dim[0]
+          || u->value.arr->dim[1] != texture->value.arr->dim[1]) {
+      return "TEXTURE must have the same dimensions as parameters";
+    }
+  }
+
+  return NULL;
+}
+
+
 /*
   Line-integral convolution (LIC) for flow visualization based on "Imaging
   Vector Fields Using Line Integral Convolution" by Brian Cabral and Leith
@@ -137,24 +875,48 @@ MG_LIC_STREAMLINE(double);
         y-coordinates of vector field
 
   :Keywords:
+     fast : in, optional, type=boolean
+        set to use FastLIC
+     length : in, optional, type=long, default=20
+        number of steps of the streamline in each direction
+     n_threads : in, optional, type=long
+        number of threads to use, default is the number of cores
+     step : in, optional, type=double, default=0.5
+        size of the steps of the streamline
      texture : in, optional, type=bytarr(m, n)
         texture map i.e. random noise
 */
 static IDL_VPTR IDL_CDECL IDL_mg_lic(int argc, IDL_VPTR *argv, char *argk) {
-  IDL_VPTR result, tex, integral, hits, plain_args[2];
+  IDL_VPTR u, v, result, tex, integral, plain_args[2];
   int nargs;
   unsigned char *result_data, *tex_data;
   int *integral_data;
-  int item, row, col, nrows, ncols, f, b, sum;
-  int max;
+  int item, nrows, ncols, t, nthreads, nblocks, failed = 0;
+  const char *msg;
+  mg_lic_info info;
 
   typedef struct {
     IDL_KW_RESULT_FIRST_FIELD;
+    IDL_LONG fast;
+    IDL_LONG length;
+    int length_present;
+    IDL_LONG n_threads;
+    double step;
+    int step_present;
     IDL_VPTR texture;
     int texture_present;
   } KW_RESULT;
 
+  // make sure to list keyword in alphabetical order
   static IDL_KW_PAR kw_pars[] = {
+    { "FAST", IDL_TYP_LONG, 1, IDL_KW_ZERO | IDL_KW_VALUE | 1,
+      0, IDL_KW_OFFSETOF(fast) },
+    { "LENGTH", IDL_TYP_LONG, 1, 0,
+      IDL_KW_OFFSETOF(length_present), IDL_KW_OFFSETOF(length) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { "STEP", IDL_TYP_DOUBLE, 1, 0,
+      IDL_KW_OFFSETOF(step_present), IDL_KW_OFFSETOF(step) },
     { "TEXTURE", IDL_TYP_UNDEF, 1, IDL_KW_VIN | IDL_KW_OUT,
       IDL_KW_OFFSETOF(texture_present), IDL_KW_OFFSETOF(texture) },
     { NULL }
@@ -165,8 +927,6 @@ static IDL_VPTR IDL_CDECL IDL_mg_lic(int argc, IDL_VPTR *argv, char *argk) {
   nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, plain_args, 1, &kw);
   u = plain_args[0];
   v = plain_args[1];
-  ncols = u->value.arr->dim[0];
-  nrows = u->value.arr->dim[1];
 
   // check inputs
   IDL_ENSURE_SIMPLE(u);
@@ -175,43 +935,30 @@ static IDL_VPTR IDL_CDECL IDL_mg_lic(int argc, IDL_VPTR *argv, char *argk) {
   IDL_ENSURE_SIMPLE(v);
   IDL_ENSURE_ARRAY(v);
 
-  if (u->type != IDL_TYP_FLOAT && u->type != IDL_TYP_DOUBLE) {
-    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
-                "u and v parameters must be float or double");
+  if (kw.texture_present) {
+    IDL_ENSURE_SIMPLE(kw.texture);
+    IDL_ENSURE_ARRAY(kw.texture);
   }
 
-  if (u->type != v->type) {
-    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
-                "u and v parameters must be of the same type");
+  msg = mg_lic_check_inputs(u, v, kw.texture_present ? kw.texture : NULL);
+  if (msg) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "%s", msg);
   }
 
-  if (u->value.arr->n_dim !=2 || v->value.arr->n_dim != 2) {
-    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
-                "u and v parameters must be 2 dimensional");
-  }
+  ncols = u->value.arr->dim[0];
+  nrows = u->value.arr->dim[1];
 
-  if (u->value.arr->dim[0] != v->value.arr->dim[0]
-        || u->value.arr->dim[1] != v->value.arr->dim[1]) {
+  if (kw.length_present && kw.length < 1) {
+    IDL_KW_FREE;
     IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
-                "u and v parameters must have the same dimensions");
+                "LENGTH must be positive");
   }
 
-  if (kw.texture_present) {
-    IDL_ENSURE_SIMPLE(kw.texture);
-    IDL_ENSURE_ARRAY(kw.texture);
-    if (kw.texture->type != IDL_TYP_BYTE ) {
-      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
-                  "TEXTURE must be of type byte");
-    }
-    if (kw.texture->value.arr->n_dim !=2) {
-      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
-                  "TEXTURE must be 2 dimensional");
-    }
-    if (u->value.arr->dim[0] != kw.texture->value.arr->dim[0]
-          || u->value.arr->dim[1] != kw.texture->value.arr->dim[1]) {
-      IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
-                  "TEXTURE must have the same dimensions as parameters");
-    }
+  if (kw.step_present && !(kw.step > 0.0)) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "STEP must be positive");
   }
 
   // variable to return result in
@@ -223,7 +970,7 @@ static IDL_VPTR IDL_CDECL IDL_mg_lic(int argc, IDL_VPTR *argv, char *argk) {
 
   // random texture
   if (kw.texture_present) {
-    tex_data = (unsigned char *) &kw.texture->value.arr->data;
+    tex_data = (unsigned char *) kw.texture->value.arr->data;
   } else {
     tex_data = (unsigned char *) IDL_MakeTempArray(IDL_TYP_BYTE,
                                                    u->value.arr->n_dim,
@@ -242,53 +989,570 @@ static IDL_VPTR IDL_CDECL IDL_mg_lic(int argc, IDL_VPTR *argv, char *argk) {
                                             IDL_ARR_INI_NOP,
                                             &integral);
 
-  // calculate the line-intergral convolution (put in result_data)
-  for (row = 0; row < nrows; row++) {
-    for (col = 0; col < ncols; col++) {
-      // compute streamline
-      if (u->type == IDL_TYP_FLOAT) {
-        mg_lic_streamline_float((float) row, (float) col, nrows, ncols);
-      } else {
-        mg_lic_streamline_double((double) row, (double) col, nrows, ncols);
-      }
+  info.u = u->value.arr->data;
+  info.v = v->value.arr->data;
+  info.nrows = nrows;
+  info.ncols = ncols;
+  info.length = kw.length_present ? kw.length : N_SEGMENTS;
+  info.step = kw.step_present ? kw.step : STEP_SIZE;
+  info.texture = tex_data;
+  info.integral = integral_data;
+  info.result = result_data;
+  info.sums = NULL;
+  info.hits = NULL;
+  info.nframes = 0;
+  info.weights = NULL;
+  info.frames = NULL;
+  for (t = 0; t < MG_THREADS_MAX; t++) {
+    info.max[t] = 0;
+    info.failed[t] = 0;
+  }
 
-      // compute I: average of texture at fwd/bwd indices
-      sum = (int) *(tex_data + col + row * ncols);
-      for (f = 0; f < nfwd; f++) {
-        sum += (int) *(tex_data
-                        + (int) (u->type == IDL_TYP_FLOAT ? fwd_float[0][f] : fwd_double[0][f])
-                        + (int) (u->type == IDL_TYP_FLOAT ? fwd_float[1][f] : fwd_double[1][f]) * ncols);
-      }
+  // calculate the line-integral convolution, splitting rows across threads
+  nthreads = mg_thread_count(nrows, MG_LIC_MIN_ROWS, kw.n_threads);
+  if (kw.fast) {
+    info.sums = (float *) calloc((size_t) nrows * ncols, sizeof(float));
+    info.hits = (int *) calloc((size_t) nrows * ncols, sizeof(int));
+    if (info.sums && info.hits) {
+      nblocks = (nrows + MG_LIC_FAST_BLOCK_ROWS - 1) / MG_LIC_FAST_BLOCK_ROWS;
+      mg_thread_run(mg_thread_count(nblocks, 1, kw.n_threads), nblocks,
+                    u->type == IDL_TYP_FLOAT ? mg_lic_fast_float : mg_lic_fast_double,
+                    &info);
+      for (t = 0; t < MG_THREADS_MAX; t++) failed |= info.failed[t];
+      if (!failed) mg_thread_run(nthreads, nrows, mg_lic_fast_integral, &info);
+    } else {
+      failed = 1;
+    }
+    if (info.sums) free(info.sums);
+    if (info.hits) free(info.hits);
+  } else {
+    mg_thread_run(nthreads, nrows,
+                  u->type == IDL_TYP_FLOAT ? mg_lic_rows_float : mg_lic_rows_double,
+                  &info);
+    for (t = 0; t < MG_THREADS_MAX; t++) failed |= info.failed[t];
+  }
 
-      for (b = 0; b < nbwd; b++) {
-        sum += (int) *(tex_data
-                         + (int) (u->type == IDL_TYP_FLOAT ? bwd_float[0][b] : bwd_double[0][b])
-                         + (int) (u->type == IDL_TYP_FLOAT ? bwd_float[1][b] : bwd_double[1][b]) * ncols);
-      }
+  if (failed) {
+    if (!kw.texture_present) IDL_Deltmp(tex);
+    IDL_Deltmp(integral);
+    IDL_Deltmp(result);
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unable to allocate memory");
+  }
 
-      *(integral_data + col + row * ncols) = sum / (nfwd + nbwd + 1);
-    }
+  // normalize result by the max of the integral
+  for (t = 1; t < nthreads; t++) {
+    if (info.max[t] > info.max[0]) info.max[0] = info.max[t];
   }
+  mg_thread_run(nthreads, nrows, mg_lic_normalize, &info);
 
-  // normalize result
+  // free IDL temporary variables
+  if (!kw.texture_present) IDL_Deltmp(tex);
+  IDL_Deltmp(integral);
+  IDL_KW_FREE;
+
+  return result;
+}
 
-  // find max of integral_data
-  max = 0;
-  for (item = 0; item < nrows * ncols; item++) {
-    if (*(integral_data + item) > max) {
-      max = *(integral_data + item);
+
+/*
+  Animated line-integral convolution: frames of a LIC of a single vector
+  field with a periodic kernel whose phase advances with each frame, so that
+  the texture appears to move along the flow and the last frame loops back to
+  the first. The field is bilinearly interpolated along the streamlines.
+
+  Arguments for the routine are passed from IDL. They are:
+
+  :Params:
+     u : in, required, type=fltarr(m, n)
+        x-coordinates of vector field
+     v : in, required, type=fltarr(m, n)
+        y-coordinates of vector field
+     nframes : in, required, type=long
+        number of frames, i.e., phases of the kernel
+
+  :Keywords:
+     length : in, optional, type=long, default=20
+        number of steps of the streamline in each direction
+     n_threads : in, optional, type=long
+        number of threads to use, default is the number of cores
+     ripples : in, optional, type=double, default=2.0
+        number of periods of the kernel along the streamline
+     seed : in, optional, type=long, default=0
+        seed of the random texture, if TEXTURE is not given
+     step : in, optional, type=double, default=0.5
+        size of the steps of the streamline
+     texture : in, optional, type=bytarr(m, n)
+        texture map i.e. random noise
+*/
+static IDL_VPTR IDL_CDECL IDL_mg_lic_animate(int argc, IDL_VPTR *argv, char *argk) {
+  IDL_VPTR u, v, result, tex, frames, plain_args[3];
+  int nargs;
+  UCHAR *tex_data;
+  float *weights;
+  double s, ripples, phase;
+  IDL_MEMINT dims[3], item;
+  int nrows, ncols, length, nframes, f, j, t, nthreads, failed = 0;
+  const char *msg;
+  mg_lic_info info;
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_LONG length;
+    int length_present;
+    IDL_LONG n_threads;
+    double ripples;
+    int ripples_present;
+    IDL_LONG seed;
+    double step;
+    int step_present;
+    IDL_VPTR texture;
+    int texture_present;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "LENGTH", IDL_TYP_LONG, 1, 0,
+      IDL_KW_OFFSETOF(length_present), IDL_KW_OFFSETOF(length) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { "RIPPLES", IDL_TYP_DOUBLE, 1, 0,
+      IDL_KW_OFFSETOF(ripples_present), IDL_KW_OFFSETOF(ripples) },
+    { "SEED", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(seed) },
+    { "STEP", IDL_TYP_DOUBLE, 1, 0,
+      IDL_KW_OFFSETOF(step_present), IDL_KW_OFFSETOF(step) },
+    { "TEXTURE", IDL_TYP_UNDEF, 1, IDL_KW_VIN | IDL_KW_OUT,
+      IDL_KW_OFFSETOF(texture_present), IDL_KW_OFFSETOF(texture) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, plain_args, 1, &kw);
+  u = plain_args[0];
+  v = plain_args[1];
+
+  // check inputs
+  IDL_ENSURE_SIMPLE(u);
+  IDL_ENSURE_ARRAY(u);
+
+  IDL_ENSURE_SIMPLE(v);
+  IDL_ENSURE_ARRAY(v);
+
+  if (kw.texture_present) {
+    IDL_ENSURE_SIMPLE(kw.texture);
+    IDL_ENSURE_ARRAY(kw.texture);
+  }
+
+  msg = mg_lic_check_inputs(u, v, kw.texture_present ? kw.texture : NULL);
+  if (msg) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "%s", msg);
+  }
+
+  nframes = IDL_LongScalar(plain_args[2]);
+  if (nframes < 1) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "NFRAMES must be positive");
+  }
+
+  if (kw.length_present && kw.length < 1) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "LENGTH must be positive");
+  }
+
+  if (kw.ripples_present && !(kw.ripples > 0.0)) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "RIPPLES must be positive");
+  }
+
+  if (kw.step_present && !(kw.step > 0.0)) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "STEP must be positive");
+  }
+
+  ncols = u->value.arr->dim[0];
+  nrows = u->value.arr->dim[1];
+  length = kw.length_present ? kw.length : N_SEGMENTS;
+  ripples = kw.ripples_present ? kw.ripples : MG_LIC_RIPPLES;
+
+  // kernel of each frame: a Hann window times a ripple moving along it
+  weights = (float *) malloc((size_t) nframes * (2 * length + 1) * sizeof(float));
+  if (weights == NULL) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unable to allocate memory");
+  }
+  for (f = 0; f < nframes; f++) {
+    phase = 2.0 * MG_LIC_PI * f / nframes;
+    for (j = - length; j <= length; j++) {
+      s = (double) j / length;
+      weights[f * (2 * length + 1) + j + length]
+        = (float) (0.25 * (1.0 + cos(MG_LIC_PI * s))
+                   * (1.0 + cos(MG_LIC_PI * ripples * s - phase)));
     }
   }
 
-  if (max > 0) {
-    for (item = 0; item < nrows * ncols; item++) {
-      *(result_data + item) = (char) (255 * *(integral_data + item) / max);
+  // variable to return result in
+  dims[0] = ncols;
+  dims[1] = nrows;
+  dims[2] = nframes;
+  info.result = (UCHAR *) IDL_MakeTempArray(IDL_TYP_BYTE, 3, dims,
+                                            IDL_ARR_INI_NOP, &result);
+  info.frames = (float *) IDL_MakeTempArray(IDL_TYP_FLOAT, 3, dims,
+                                            IDL_ARR_INI_NOP, &frames);
+
+  // random texture
+  if (kw.texture_present) {
+    tex_data = (UCHAR *) kw.texture->value.arr->data;
+  } else {
+    tex_data = (UCHAR *) IDL_MakeTempArray(IDL_TYP_BYTE,
+                                           u->value.arr->n_dim,
+                                           u->value.arr->dim,
+                                           IDL_ARR_INI_NOP,
+                                           &tex);
+    for (item = 0; item < (IDL_MEMINT) nrows * ncols; item++) {
+      tex_data[item] = mg_lic_noise((IDL_ULONG64) kw.seed, item);
     }
   }
 
+  info.u = u->value.arr->data;
+  info.v = v->value.arr->data;
+  info.nrows = nrows;
+  info.ncols = ncols;
+  info.length = length;
+  info.step = kw.step_present ? kw.step : STEP_SIZE;
+  info.texture = tex_data;
+  info.integral = NULL;
+  info.sums = NULL;
+  info.hits = NULL;
+  info.nframes = nframes;
+  info.weights = weights;
+  for (t = 0; t < MG_THREADS_MAX; t++) {
+    info.frames_max[t] = 0.0;
+    info.max[t] = 0;
+    info.failed[t] = 0;
+  }
+
+  // compute all the frames, splitting rows across threads
+  nthreads = mg_thread_count(nrows, MG_LIC_MIN_ROWS, kw.n_threads);
+  mg_thread_run(nthreads, nrows,
+                u->type == IDL_TYP_FLOAT ? mg_lic_animate_rows_float : mg_lic_animate_rows_double,
+                &info);
+  for (t = 0; t < MG_THREADS_MAX; t++) failed |= info.failed[t];
+  free(weights);
+
+  if (failed) {
+    if (!kw.texture_present) IDL_Deltmp(tex);
+    IDL_Deltmp(frames);
+    IDL_Deltmp(result);
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unable to allocate memory");
+  }
+
+  // normalize all frames by the same max, so they are comparable
+  for (t = 1; t < nthreads; t++) {
+    if (info.frames_max[t] > info.frames_max[0]) info.frames_max[0] = info.frames_max[t];
+  }
+  mg_thread_run(mg_thread_count(nrows * nframes, MG_LIC_MIN_ROWS, kw.n_threads),
+                (IDL_MEMINT) nrows * nframes, mg_lic_animate_normalize, &info);
+
   // free IDL temporary variables
   if (!kw.texture_present) IDL_Deltmp(tex);
-  IDL_Deltmp(integral);
+  IDL_Deltmp(frames);
+  IDL_KW_FREE;
+
+  return result;
+}
+
+
+/*
+  Trace particles from many seed points through a steady (streamlines) or
+  time-varying (pathlines) 2D or 3D vector field.
+
+  Arguments for the routine are passed from IDL. They are:
+
+  :Params:
+     seeds : in, required, type="fltarr(ndim, nseeds)"
+        starting points, in index coordinates
+     u : in, required, type=fltarr
+        x-coordinates of vector field, dimensions (m, n), (m, n, p) for 3D,
+        with an extra last dimension for the frames of a time-varying field
+     v : in, required, type=fltarr
+        y-coordinates of vector field
+     w : in, optional, type=fltarr
+        z-coordinates of vector field, for 3D fields
+
+  :Keywords:
+     adaptive : in, optional, type=boolean
+        set to use adaptive Dormand-Prince (RK45) steps instead of RK4
+     max_steps : in, optional, type=long, default=100
+        maximum number of steps for each seed
+     min_speed : in, optional, type=double
+        stagnation speed, default is 1e-6 times the maximum speed
+     n_threads : in, optional, type=long
+        number of threads to use, default is the number of cores
+     n_vertices : out, optional, type=lonarr(nseeds)
+        number of vertices traced from each seed
+     polylines : out, optional, type=lonarr
+        connectivity of the vertices, for IDLgrPolyline
+     start_time : in, optional, type=double, default=0.0
+        starting time for a time-varying field
+     step : in, optional, type=double
+        time step, default is the time to move half an element at the
+        maximum speed
+     times : out, optional, type=fltarr(nvertices)
+        time of each vertex
+     tolerance : in, optional, type=double, default=1e-4
+        error tolerance of an adaptive step, in elements
+*/
+static IDL_VPTR IDL_CDECL IDL_mg_trace(int argc, IDL_VPTR *argv, char *argk) {
+  IDL_VPTR seeds, fields[3], result, polylines, n_vertices, times, plain_args[4];
+  IDL_MEMINT nseeds, npoints = 0, nvertices, offset, i, item, result_dims[2];
+  IDL_LONG *polylines_data, *counts;
+  char *result_data, *times_data;
+  float *result_float, *times_float = NULL;
+  double *result_double, *times_double = NULL, *vertex;
+  double max_speed2 = 0.0, speed2, value;
+  const char *msg = NULL;
+  int nargs, ndim, c, d, t, nthreads, failed = 0;
+  mg_trace_info info;
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_LONG adaptive;
+    IDL_LONG max_steps;
+    int max_steps_present;
+    double min_speed;
+    int min_speed_present;
+    IDL_LONG n_threads;
+    IDL_VPTR n_vertices;
+    int n_vertices_present;
+    IDL_VPTR polylines;
+    int polylines_present;
+    double start_time;
+    double step;
+    int step_present;
+    IDL_VPTR times;
+    int times_present;
+    double tolerance;
+    int tolerance_present;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "ADAPTIVE", IDL_TYP_LONG, 1, IDL_KW_ZERO | IDL_KW_VALUE | 1,
+      0, IDL_KW_OFFSETOF(adaptive) },
+    { "MAX_STEPS", IDL_TYP_LONG, 1, 0,
+      IDL_KW_OFFSETOF(max_steps_present), IDL_KW_OFFSETOF(max_steps) },
+    { "MIN_SPEED", IDL_TYP_DOUBLE, 1, 0,
+      IDL_KW_OFFSETOF(min_speed_present), IDL_KW_OFFSETOF(min_speed) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { "N_VERTICES", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(n_vertices_present), IDL_KW_OFFSETOF(n_vertices) },
+    { "POLYLINES", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(polylines_present), IDL_KW_OFFSETOF(polylines) },
+    { "START_TIME", IDL_TYP_DOUBLE, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(start_time) },
+    { "STEP", IDL_TYP_DOUBLE, 1, 0,
+      IDL_KW_OFFSETOF(step_present), IDL_KW_OFFSETOF(step) },
+    { "TIMES", IDL_TYP_UNDEF, 1, IDL_KW_OUT | IDL_KW_ZERO,
+      IDL_KW_OFFSETOF(times_present), IDL_KW_OFFSETOF(times) },
+    { "TOLERANCE", IDL_TYP_DOUBLE, 1, 0,
+      IDL_KW_OFFSETOF(tolerance_present), IDL_KW_OFFSETOF(tolerance) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, plain_args, 1, &kw);
+  ndim = nargs - 1;
+
+  // check inputs
+  for (c = 0; c < ndim; c++) {
+    fields[c] = plain_args[c + 1];
+    IDL_ENSURE_SIMPLE(fields[c]);
+    IDL_ENSURE_ARRAY(fields[c]);
+  }
+  IDL_ENSURE_SIMPLE(plain_args[0]);
+
+  if (fields[0]->type != IDL_TYP_FLOAT && fields[0]->type != IDL_TYP_DOUBLE) {
+    msg = "field parameters must be float or double";
+  } else if (fields[0]->value.arr->n_dim != ndim
+               && fields[0]->value.arr->n_dim != ndim + 1) {
+    msg = "field parameters must have a dimension for each component, and optionally one for time";
+  }
+  for (c = 1; c < ndim && msg == NULL; c++) {
+    if (fields[c]->type != fields[0]->type) {
+      msg = "field parameters must be of the same type";
+    } else if (fields[c]->value.arr->n_dim != fields[0]->value.arr->n_dim) {
+      msg = "field parameters must have the same dimensions";
+    }
+    for (d = 0; d < fields[0]->value.arr->n_dim && msg == NULL; d++) {
+      if (fields[c]->value.arr->dim[d] != fields[0]->value.arr->dim[d]) {
+        msg = "field parameters must have the same dimensions";
+      }
+    }
+  }
+  for (d = 0; d < (msg ? 0 : fields[0]->value.arr->n_dim); d++) {
+    if (fields[0]->value.arr->dim[d] < 2) {
+      msg = "field parameters must have at least 2 elements in each dimension";
+    }
+  }
+  if (msg == NULL) {
+    npoints = plain_args[0]->flags & IDL_V_ARR ? plain_args[0]->value.arr->n_elts : 1;
+    if ((plain_args[0]->flags & IDL_V_ARR) == 0
+          || plain_args[0]->value.arr->dim[0] != ndim) {
+      msg = "seeds must have a first dimension of size 2 (or 3 for 3D fields)";
+    }
+  }
+  if (msg == NULL && kw.max_steps_present && kw.max_steps < 0) {
+    msg = "MAX_STEPS must be non-negative";
+  }
+  if (msg == NULL && kw.step_present && !(kw.step > 0.0)) {
+    msg = "STEP must be positive";
+  }
+  if (msg == NULL && kw.tolerance_present && !(kw.tolerance > 0.0)) {
+    msg = "TOLERANCE must be positive";
+  }
+  if (msg) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "%s", msg);
+  }
+
+  info.is_double = fields[0]->type == IDL_TYP_DOUBLE;
+  info.ndim = ndim;
+  info.frame_size = 1;
+  for (d = 0; d < ndim; d++) {
+    info.dims[d] = fields[0]->value.arr->dim[d];
+    info.strides[d] = info.frame_size;
+    info.frame_size *= info.dims[d];
+  }
+  info.nframes = fields[0]->value.arr->n_dim > ndim
+                   ? (int) fields[0]->value.arr->dim[ndim]
+                   : 1;
+  for (c = 0; c < ndim; c++) info.fields[c] = fields[c]->value.arr->data;
+
+  // maximum speed of the field for the default step and stagnation speed
+  if (!kw.step_present || !kw.min_speed_present) {
+    for (item = 0; item < fields[0]->value.arr->n_elts; item++) {
+      for (c = 0, speed2 = 0.0; c < ndim; c++) {
+        value = info.is_double
+                  ? ((const double *) info.fields[c])[item]
+                  : ((const float *) info.fields[c])[item];
+        speed2 += value * value;
+      }
+      if (speed2 > max_speed2) max_speed2 = speed2;
+    }
+  }
+  info.step = kw.step_present
+                ? kw.step
+                : (max_speed2 > 0.0 ? 0.5 / sqrt(max_speed2) : 1.0);
+  info.min_speed = kw.min_speed_present
+                     ? kw.min_speed
+                     : MG_TRACE_STAGNATION * sqrt(max_speed2);
+  info.tolerance = kw.tolerance_present ? kw.tolerance : MG_TRACE_TOLERANCE;
+  info.adaptive = kw.adaptive;
+  info.max_steps = kw.max_steps_present ? kw.max_steps : MG_TRACE_MAX_STEPS;
+  info.start_time = kw.start_time;
+
+  seeds = plain_args[0]->type == IDL_TYP_DOUBLE
+            ? plain_args[0]
+            : IDL_CvtDbl(1, &plain_args[0], NULL);
+  info.seeds = (const double *) seeds->value.arr->data;
+  nseeds = npoints / ndim;
+
+  counts = (IDL_LONG *) IDL_MakeTempVector(IDL_TYP_LONG, nseeds,
+                                           IDL_ARR_INI_ZERO, &n_vertices);
+  info.counts = counts;
+  for (t = 0; t < MG_THREADS_MAX; t++) {
+    info.vertices[t] = NULL;
+    info.nvertices[t] = 0;
+    info.failed[t] = 0;
+  }
+
+  // trace the seeds, splitting them across threads
+  nthreads = mg_thread_count(nseeds, MG_TRACE_MIN_SEEDS, kw.n_threads);
+  mg_thread_run(nthreads, nseeds, mg_trace_seeds, &info);
+  for (t = 0, nvertices = 0; t < MG_THREADS_MAX; t++) {
+    failed |= info.failed[t];
+    nvertices += info.nvertices[t];
+  }
+
+  if (seeds != plain_args[0]) IDL_Deltmp(seeds);
+  if (failed) {
+    for (t = 0; t < MG_THREADS_MAX; t++) free(info.vertices[t]);
+    IDL_Deltmp(n_vertices);
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "unable to allocate memory");
+  }
+
+  // pack the vertices of all the threads, in order of the seeds
+  if (nvertices == 0) {
+    result = IDL_GettmpLong(-1);
+    if (kw.times_present) IDL_VarCopy(IDL_GettmpLong(-1), kw.times);
+  } else {
+    result_dims[0] = ndim;
+    result_dims[1] = nvertices;
+    result_data = IDL_MakeTempArray(fields[0]->type, 2, result_dims,
+                                    IDL_ARR_INI_NOP, &result);
+    result_float = (float *) result_data;
+    result_double = (double *) result_data;
+    if (kw.times_present) {
+      times_data = IDL_MakeTempVector(fields[0]->type, nvertices,
+                                      IDL_ARR_INI_NOP, &times);
+      times_float = (float *) times_data;
+      times_double = (double *) times_data;
+    }
+    for (t = 0, offset = 0; t < MG_THREADS_MAX; t++) {
+      for (i = 0; i < info.nvertices[t]; i++, offset++) {
+        vertex = info.vertices[t] + i * (ndim + 1);
+        if (info.is_double) {
+          for (c = 0; c < ndim; c++) result_double[offset * ndim + c] = vertex[c];
+          if (kw.times_present) times_double[offset] = vertex[ndim];
+        } else {
+          for (c = 0; c < ndim; c++) result_float[offset * ndim + c] = (float) vertex[c];
+          if (kw.times_present) times_float[offset] = (float) vertex[ndim];
+        }
+      }
+    }
+    if (kw.times_present) IDL_VarCopy(times, kw.times);
+  }
+  for (t = 0; t < MG_THREADS_MAX; t++) free(info.vertices[t]);
+
+  // connectivity of the seeds with at least one vertex
+  if (kw.polylines_present) {
+    for (i = 0, item = 0; i < nseeds; i++) item += counts[i] > 0 ? counts[i] + 1 : 0;
+    if (item == 0) {
+      IDL_VarCopy(IDL_GettmpLong(-1), kw.polylines);
+    } else {
+      polylines_data = (IDL_LONG *) IDL_MakeTempVector(IDL_TYP_LONG, item,
+                                                       IDL_ARR_INI_NOP,
+                                                       &polylines);
+      for (i = 0, item = 0, offset = 0; i < nseeds; i++) {
+        if (counts[i] == 0) continue;
+        polylines_data[item++] = counts[i];
+        for (c = 0; c < counts[i]; c++) polylines_data[item++] = (IDL_LONG) offset++;
+      }
+      IDL_VarCopy(polylines, kw.polylines);
+    }
+  }
+
+  if (kw.n_vertices_present) {
+    IDL_VarCopy(n_vertices, kw.n_vertices);
+  } else {
+    IDL_Deltmp(n_vertices);
+  }
+
   IDL_KW_FREE;
 
   return result;
@@ -302,7 +1566,9 @@ static IDL_VPTR IDL_CDECL IDL_mg_lic(int argc, IDL_VPTR *argv, char *argk) {
 
 // functions to register
 static IDL_SYSFUN_DEF2 function_addr[] = {
-  { IDL_mg_lic,     "MG_LIC",     2, 2, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+  { IDL_mg_lic,         "MG_LIC",         2, 2, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+  { IDL_mg_lic_animate, "MG_LIC_ANIMATE", 3, 3, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
+  { IDL_mg_trace,       "MG_TRACE",       3, 4, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
 };
 
 int IDL_Load(void) {
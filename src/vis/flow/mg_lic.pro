@@ -44,11 +44,22 @@
 ;       y-coordinates of vector field
 ;
 ; :Keywords:
+;    fast : in, optional, type=boolean
+;       set to use FastLIC, integrating long streamlines once and sliding the
+;       kernel along them, so that the time does not grow with `LENGTH`
+;    length : in, optional, type=long, default=20
+;       number of steps of the kernel in each direction along the streamline
+;    n_threads : in, optional, type=long
+;       number of threads to use, default is the number of cores; the result
+;       does not depend on the number of threads
+;    step : in, optional, type=double, default=0.5
+;       size of the steps along the streamline, in elements
 ;    texture : in, optional, type="bytarr(m, n)"
 ;       random texture map; it is useful to use the same texture map for
 ;       generating frames of a movie
 ;-
-pro mg_lic, u, v, texture=texture
+pro mg_lic, u, v, fast=fast, length=length, n_threads=n_threads, $
+            step=step, texture=texture
   compile_opt strictarr
   on_error, 2
 
@@ -0,0 +1,76 @@
+; docformat = 'rst'
+
+;+
+; Example program demonstrating the use of `MG_LIC_ANIMATE`. Run the
+; main-level example program with::
+;
+;    IDL> .run mg_lic_animate
+;-
+
+;+
+; Compute the frames of an animated line integral convolution for a vector
+; field.
+;
+; :Returns:
+;    bytarr(m, n, nframes)
+;
+; :Params:
+;    u : in, required, type="fltarr(m, n)"
+;       x-coordinates of vector field
+;    v : in, required, type="fltarr(m, n)"
+;       y-coordinates of vector field
+;    nframes : in, required, type=long
+;       number of frames of the animation
+;
+; :Keywords:
+;    length : in, optional, type=long, default=20
+;       number of steps of the kernel in each direction along the streamline
+;    n_threads : in, optional, type=long
+;       number of threads to use, default is the number of cores; the result
+;       does not depend on the number of threads
+;    ripples : in, optional, type=double, default=2.0
+;       number of periods of the kernel along the streamline
+;    seed : in, optional, type=long, default=0
+;       seed for the random texture when `TEXTURE` is not given
+;    step : in, optional, type=double, default=0.5
+;       size of the steps along the streamline, in elements
+;    texture : in, optional, type="bytarr(m, n)"
+;       texture map to use instead of a random texture
+;-
+pro mg_lic_animate, u, v, nframes, length=length, n_threads=n_threads, $
+                    ripples=ripples, seed=seed, step=step, texture=texture
+  compile_opt strictarr
+  on_error, 2
+
+  ; empty because `MG_LIC_ANIMATE` is implemented in `mg_flow.c` as a DLM; this
+  ; header is for documenting the routine
+
+  message, 'MG_FLOW DLM not found'
+end
+
+
+scale = 4L
+nframes = 16L
+
+restore, filepath('globalwinds.dat', subdir=['examples','data'])
+
+u = rebin(u, 128L * scale, 64L * scale)
+v = rebin(v, 128L * scale, 64L * scale)
+
+startTime = systime(/seconds)
+frames = mg_lic_animate(u, v, nframes, seed=42L)
+endTime = systime(/seconds)
+
+print, format='(%"Time to compute %d frames: %0.1f seconds")', $
+       nframes, endTime - startTime
+
+window, xsize=128L * scale, ysize=64L * scale, $
+        /free, title='Animated LIC for globalwinds.dat'
+for loop = 0L, 4L do begin
+  for f = 0L, nframes - 1L do begin
+    tv, bytscl(frames[*, *, f])
+    wait, 0.05
+  endfor
+endfor
+
+end
@@ -0,0 +1,88 @@
+; docformat = 'rst'
+
+;+
+; Example program demonstrating the use of `MG_TRACE`. Run the main-level
+; example program with::
+;
+;    IDL> .run mg_trace
+;-
+
+;+
+; Trace particles from many seed points through a 2D or 3D vector field,
+; following streamlines of a steady field or pathlines of a time-varying
+; field.
+;
+; :Returns:
+;    fltarr(ndim, nvertices), or -1L if no seed is inside the field
+;
+; :Params:
+;    seeds : in, required, type="fltarr(ndim, nseeds)"
+;       starting points in index coordinates
+;    u : in, required, type="fltarr(m, n), fltarr(m, n, p)"
+;       x-coordinates of the vector field; an extra last dimension makes the
+;       field time-varying, with its frames one time unit apart
+;    v : in, required, type="fltarr(m, n), fltarr(m, n, p)"
+;       y-coordinates of the vector field
+;    w : in, optional, type="fltarr(m, n, p)"
+;       z-coordinates of the vector field for a 3D field
+;
+; :Keywords:
+;    adaptive : in, optional, type=boolean
+;       set to use adaptive Dormand-Prince (RK45) steps instead of RK4 steps
+;    max_steps : in, optional, type=long, default=100
+;       maximum number of steps of each particle
+;    min_speed : in, optional, type=double
+;       particles stop when slower than this speed, default is 1e-6 times the
+;       maximum speed of the field
+;    n_threads : in, optional, type=long
+;       number of threads to use, default is the number of cores
+;    n_vertices : out, optional, type=lonarr(nseeds)
+;       number of vertices traced from each seed
+;    polylines : out, optional, type=lonarr
+;       connectivity of the vertices, for `IDLgrPolyline`
+;    start_time : in, optional, type=double, default=0.0
+;       time at the seeds in a time-varying field
+;    step : in, optional, type=double
+;       time step; default is the time to move half an element at the maximum
+;       speed of the field
+;    times : out, optional, type=fltarr(nvertices)
+;       time of each vertex
+;    tolerance : in, optional, type=double, default=1e-4
+;       maximum error of an adaptive step, in elements
+;-
+function mg_trace, seeds, u, v, w, adaptive=adaptive, max_steps=max_steps, $
+                   min_speed=min_speed, n_threads=n_threads, $
+                   n_vertices=n_vertices, polylines=polylines, $
+                   start_time=start_time, step=step, times=times, $
+                   tolerance=tolerance
+  compile_opt strictarr
+  on_error, 2
+
+  ; empty because `MG_TRACE` is implemented in `mg_flow.c` as a DLM; this
+  ; header is for documenting the routine
+
+  message, 'MG_FLOW DLM not found'
+  return, -1L
+end
+
+
+; example code
+
+restore, filepath('globalwinds.dat', subdir=['examples','data'])
+
+dims = size(u, /dimensions)
+seeds = [randomu(seed, 1, 400) * (dims[0] - 1), $
+         randomu(seed, 1, 400) * (dims[1] - 1)]
+
+vertices = mg_trace(seeds, u, v, max_steps=50, polylines=polylines)
+
+view = obj_new('IDLgrView', viewplane_rect=[0, 0, dims[0] - 1, dims[1] - 1])
+model = obj_new('IDLgrModel')
+view->add, model
+model->add, obj_new('IDLgrPolyline', vertices, polylines=polylines)
+
+win = obj_new('IDLgrWindow', dimensions=[4 * dims[0], 4 * dims[1]], $
+              title='Streamlines for globalwinds.dat')
+win->draw, view
+
+end
@@ -198,6 +198,33 @@ function mg_vel_streamlines, u, v, $
   s[0, 0, 0] = xt
   s[0, 0, 1] = yt
 
+  ; MG_TRACE is only available from the MG_FLOW DLM, not its documentation stub
+  if (mg_hasroutine('mg_trace', is_system=is_system) && is_system) then begin
+    ; trace in index coordinates with the field scaled to match the
+    ; normalized coordinates of the streamlines
+    seeds = transpose([[(nx - 1L) * xt], [(ny - 1L) * yt]])
+    vertices = mg_trace(seeds, (nx - 1.0) * u, (ny - 1.0) * v, $
+                        step=dt, max_steps=nsteps - 1L, n_vertices=n_vertices)
+
+    ; streamlines stopping early, i.e., leaving the field, stay at their last
+    ; vertex
+    offsets = total(n_vertices, /cumulative, /integer) - n_vertices
+    valid = where(n_vertices gt 0L, n_valid)
+    for i = 1L, nsteps - 1L do begin
+      s[*, i, 0] = s[*, 0, 0]
+      s[*, i, 1] = s[*, 0, 1]
+      if (n_valid gt 0L) then begin
+        ind = offsets[valid] + ((n_vertices[valid] - 1L) < i)
+        s[valid, i, 0] = reform(vertices[0, ind]) / (nx - 1L)
+        s[valid, i, 1] = reform(vertices[1, ind]) / (ny - 1L)
+      endif
+    endfor
+
+    mg_vel_arrowhead, s
+
+    return, s < 1.0 > 0.0
+  endif
+
   ; add a segment to the streamlines each loop through
   for i = 1L, nsteps - 1L do begin
     xt[0] = (nx - 1L) * s[*, i - 1L, 0L]
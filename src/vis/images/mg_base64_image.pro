@@ -22,15 +22,25 @@ function mg_base64_image, im, column_size=column_size, encoded=encoded
 
   _column_size = n_elements(column_size) eq 0L ? 76L : column_size
 
-  s = idl_base64(keyword_set(encoded) ? im : mg_encode_png(im))
-
-  n = strlen(s)
-  if (n mod _column_size ne 0L) then begin
-    padding = _column_size - n mod _column_size
-    b = [byte(s), bytarr(padding)]
+  data = keyword_set(encoded) ? im : mg_encode_png(im)
+
+  if (mg_hasroutine('mg_base64_encode')) then begin
+    ; encode directly into the rows
+    n = 4L * ((n_elements(data) + 2L) / 3L)
+    padding = (_column_size - n mod _column_size) mod _column_size
+    b = bytarr(n + padding)
+    !null = mg_base64_encode(data, output=b)
   endif else begin
-    padding = 0L
-    b = byte(s)
+    s = idl_base64(data)
+
+    n = strlen(s)
+    if (n mod _column_size ne 0L) then begin
+      padding = _column_size - n mod _column_size
+      b = [byte(s), bytarr(padding)]
+    endif else begin
+      padding = 0L
+      b = byte(s)
+    endelse
   endelse
 
   b = reform(temporary(b), _column_size, (n + padding) / _column_size)
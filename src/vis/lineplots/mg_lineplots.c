@@ -4,109 +4,544 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #include "mg_idl_export.h"
+#include "mg_threads.h"
 
+// minimum number of polylines per thread
+#define MG_RASTER_MIN_LINES 64
 
-// Try to implement Bresenham's line algorithm from:
-//
-//   http://en.wikipedia.org/wiki/Bresenham%27s_line_algorithm
-
-//
-// generate x,y coordinates to draw a line from
-// x0,y0 to x1,y1 and output the coordinates in
-// the same direction that they are drawn.
-// any coordinates which overlap other coordinates
-// are duplicates and are removed from the output
-// because they are redundant.
-//
-
-//int idx, dupe; // declared external
-
-//void line(int x0, int y0, int x1, int y1) {
-//    int x, cx, deltax, xstep,
-//        y, cy, deltay, ystep,
-//        n, error, st;
-//
-//    // find largest delta for pixel steps
-//    st = (abs(y1 - y0) > abs(x1 - x0));
-//
-//    // if deltay > deltax then swap x,y
-//    if (st) {
-//        swap(x0, y0);
-//        swap(x1, y1);
-//    }
-//
-//    deltax = abs(x1 - x0);
-//    deltay = abs(y1 - y0);
-//    error  = (deltax / 2);
-//    y = y0;
-//
-//    if (x0 > x1) { xstep = -1; }
-//    else         { xstep =  1; }
-//
-//    if (y0 > y1) { ystep = -1; }
-//    else         { ystep =  1; }
-//
-//    for ((x = x0); (x != (x1 + xstep)); (x += xstep))
-//    {
-//        (cx = x); (cy = y); // copy of x, copy of y
-//
-//        // if x,y swapped above, swap them back now
-//        if (st) { swap(cx,cy);  }
-//
-//        (dupe = 0); // initialize no dupe
-//
-//        for ((n = 0); (n < idx); (n++)) {
-//            if((cx == accx[n]) && (cy == accy[n])) {
-//                (dupe = 1); // found a dupe - flag it
-//                break;
-//            }
-//        }
-//
-//        // record current x,y for later dupe check
-//        (accx[idx] = cx); (accy[idx] = cy); (idx++);
-//
-//        if(!dupe) { // if not a dupe, write it out
-//            fprintf(stdout, "X=%2d, Y=%2d\n", cx, cy);
-//            fflush(stdout); }
-//        else {
-////            fprintf(stdout, "; Duplicate: X=%2d, Y=%2d\n", cx, cy); // debug
-////            fflush(stdout);
-//        }
-//
-//        (error -= deltay); // converge toward end of line
-//
-//        if (error < 0) { // not done yet
-//            (y += ystep);
-//            (error += deltax);
-//        }
-//    }
-//}
-
-
-static IDL_VPTR IDL_CDECL IDL_mg_rasterpolyline(int argc, IDL_VPTR *argv) {
-  IDL_VPTR x, y, polylines, dims, xrange, yrange, result;
-  int *result_data;
-
-  x = argv[0];
-  y = argv[1];
-  polylines = argv[2];
-  dims = argv[3];
-  xrange = argv[4];
-  yrange = argv[5];
-
-  printf("dims[0] = %lld\n", x->value.arr->dim[0]);
-  printf("dims[1] = %lld\n", x->value.arr->dim[1]);
-  printf("dims[2] = %lld\n", x->value.arr->dim[2]);
+// maximum total size of the private images of the threads other than the
+// first, in bytes
+#define MG_RASTER_MAX_BUFFERS (1024 * 1024 * 1024)
+
+// minimum number of rows per thread when merging the private images
+#define MG_RASTER_MIN_ROWS 16
+
+
+/*
+  Polylines to rasterize, shared by all threads, and the private image of each
+  thread; thread 0 accumulates directly into the result.
+*/
+typedef struct {
+  const void *x;
+  const void *y;
+  int is_double;
+  IDL_MEMINT npoints;
+
+  const IDL_LONG *polylines;
+  const IDL_MEMINT *starts;  // index of the count of each polyline
+
+  int nx;
+  int ny;
+  double xmin, xscale;       // pixel = (x - xmin) * xscale
+  double ymin, yscale;
+
+  int antialias;
+  int normalize;
+
+  void *result;
+  void *images[MG_THREADS_MAX];
+  int failed[MG_THREADS_MAX];
+  int invalid[MG_THREADS_MAX];
+} mg_raster_info;
+
+
+/*
+  Image a thread draws into. When normalizing, stamps holds the id of the last
+  polyline to touch each pixel, and contrib its largest antialiased weight
+  there, so that each polyline contributes at most once to a pixel.
+*/
+typedef struct {
+  int nx;
+  int ny;
+  IDL_LONG *counts;
+  float *weights;
+  int *stamps;
+  float *contrib;
+  int id;
+} mg_raster_canvas;
+
+
+static double mg_raster_coord(const void *data, int is_double, IDL_MEMINT i) {
+  return is_double ? ((const double *) data)[i] : ((const float *) data)[i];
+}
+
+
+// count a hit on pixel ix, iy, which must be in the image
+static void mg_raster_hit(mg_raster_canvas *c, int ix, int iy) {
+  IDL_MEMINT p = ix + (IDL_MEMINT) iy * c->nx;
+
+  if (c->stamps) {
+    if (c->stamps[p] == c->id) return;
+    c->stamps[p] = c->id;
+  }
+  c->counts[p]++;
+}
+
+
+// add weight w to pixel ix, iy, if it is in the image
+static void mg_raster_blend(mg_raster_canvas *c, int ix, int iy, double w) {
+  IDL_MEMINT p;
+
+  if (ix < 0 || ix >= c->nx || iy < 0 || iy >= c->ny || !(w > 0.0)) return;
+  p = ix + (IDL_MEMINT) iy * c->nx;
+
+  if (c->stamps) {
+    if (c->stamps[p] != c->id) {
+      c->stamps[p] = c->id;
+      c->contrib[p] = (float) w;
+      c->weights[p] += (float) w;
+    } else if (w > c->contrib[p]) {
+      c->weights[p] += (float) w - c->contrib[p];
+      c->contrib[p] = (float) w;
+    }
+  } else {
+    c->weights[p] += (float) w;
+  }
+}
+
+
+/*
+  Clip the segment from x0, y0 to x1, y1 to the box [0, nx] x [0, ny] with the
+  Liang-Barsky algorithm. Returns 0 if the segment is entirely outside.
+*/
+static int mg_raster_clip(double *x0, double *y0, double *x1, double *y1,
+                          double nx, double ny) {
+  double dx = *x1 - *x0, dy = *y1 - *y0;
+  double p[4] = { -dx, dx, -dy, dy };
+  double q[4] = { *x0, nx - *x0, *y0, ny - *y0 };
+  double t0 = 0.0, t1 = 1.0, r;
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    if (p[i] == 0.0) {
+      if (q[i] < 0.0) return 0;
+    } else {
+      r = q[i] / p[i];
+      if (p[i] < 0.0) {
+        if (r > t1) return 0;
+        if (r > t0) t0 = r;
+      } else {
+        if (r < t0) return 0;
+        if (r < t1) t1 = r;
+      }
+    }
+  }
+
+  *x1 = *x0 + t1 * dx;
+  *y1 = *y0 + t1 * dy;
+  *x0 = *x0 + t0 * dx;
+  *y0 = *y0 + t0 * dy;
+
+  return 1;
+}
+
+
+/*
+  Bresenham's line algorithm between pixels ix0, iy0 and ix1, iy1. The first
+  pixel is skipped if it is the last pixel drawn, i.e., the end of the
+  previous segment of the polyline.
+*/
+static void mg_raster_bresenham(mg_raster_canvas *c,
+                                int ix0, int iy0, int ix1, int iy1,
+                                int *last) {
+  int dx = abs(ix1 - ix0), dy = -abs(iy1 - iy0);
+  int sx = ix0 < ix1 ? 1 : -1, sy = iy0 < iy1 ? 1 : -1;
+  int err = dx + dy, e2;
+
+  if (ix0 != last[0] || iy0 != last[1]) mg_raster_hit(c, ix0, iy0);
+
+  while (ix0 != ix1 || iy0 != iy1) {
+    e2 = 2 * err;
+    if (e2 >= dy) {
+      err += dy;
+      ix0 += sx;
+    }
+    if (e2 <= dx) {
+      err += dx;
+      iy0 += sy;
+    }
+    mg_raster_hit(c, ix0, iy0);
+  }
+
+  last[0] = ix1;
+  last[1] = iy1;
+}
+
+
+// plot a pixel of a Wu line, swapping back the coordinates of steep lines
+static void mg_raster_wu_plot(mg_raster_canvas *c, int steep,
+                              double x, double y, double w) {
+  if (steep) {
+    mg_raster_blend(c, (int) y, (int) x, w);
+  } else {
+    mg_raster_blend(c, (int) x, (int) y, w);
+  }
+}
+
+
+/*
+  Xiaolin Wu's antialiased line algorithm between points in pixel coordinates
+  where pixel centers are at integers.
+*/
+static void mg_raster_wu(mg_raster_canvas *c,
+                         double x0, double y0, double x1, double y1) {
+  int steep = fabs(y1 - y0) > fabs(x1 - x0);
+  double t, dx, dy, gradient, xend, yend, xgap, intery;
+  double xpxl1, ypxl1, xpxl2, ypxl2, x;
+
+  if (steep) {
+    t = x0; x0 = y0; y0 = t;
+    t = x1; x1 = y1; y1 = t;
+  }
+  if (x0 > x1) {
+    t = x0; x0 = x1; x1 = t;
+    t = y0; y0 = y1; y1 = t;
+  }
+
+  dx = x1 - x0;
+  dy = y1 - y0;
+  gradient = dx == 0.0 ? 1.0 : dy / dx;
+
+  // first endpoint
+  xend = floor(x0 + 0.5);
+  yend = y0 + gradient * (xend - x0);
+  xgap = 1.0 - (x0 + 0.5 - floor(x0 + 0.5));
+  xpxl1 = xend;
+  ypxl1 = floor(yend);
+  mg_raster_wu_plot(c, steep, xpxl1, ypxl1, (1.0 - (yend - ypxl1)) * xgap);
+  mg_raster_wu_plot(c, steep, xpxl1, ypxl1 + 1, (yend - ypxl1) * xgap);
+  intery = yend + gradient;
+
+  // second endpoint
+  xend = floor(x1 + 0.5);
+  yend = y1 + gradient * (xend - x1);
+  xgap = x1 + 0.5 - floor(x1 + 0.5);
+  xpxl2 = xend;
+  ypxl2 = floor(yend);
+  mg_raster_wu_plot(c, steep, xpxl2, ypxl2, (1.0 - (yend - ypxl2)) * xgap);
+  mg_raster_wu_plot(c, steep, xpxl2, ypxl2 + 1, (yend - ypxl2) * xgap);
+
+  for (x = xpxl1 + 1; x < xpxl2; x++) {
+    t = floor(intery);
+    mg_raster_wu_plot(c, steep, x, t, 1.0 - (intery - t));
+    mg_raster_wu_plot(c, steep, x, t + 1, intery - t);
+    intery += gradient;
+  }
+}
+
+
+// draw polylines [start, end) into the private image of the thread
+static void mg_raster_lines(IDL_MEMINT start, IDL_MEMINT end,
+                            int thread_index, void *data) {
+  mg_raster_info *info = (mg_raster_info *) data;
+  IDL_MEMINT npixels = (IDL_MEMINT) info->nx * info->ny;
+  size_t pixel_size = info->antialias ? sizeof(float) : sizeof(IDL_LONG);
+  mg_raster_canvas canvas;
+  const IDL_LONG *indices;
+  IDL_MEMINT line, i;
+  IDL_LONG k, n;
+  double x0, y0, x1, y1;
+  int last[2], ix0, iy0, ix1, iy1;
+  void *image;
+
+  image = thread_index == 0 ? info->result : calloc(npixels, pixel_size);
+  info->images[thread_index] = image;
+  canvas.stamps = info->normalize ? (int *) calloc(npixels, sizeof(int)) : NULL;
+  canvas.contrib = info->normalize && info->antialias
+                     ? (float *) malloc(npixels * sizeof(float))
+                     : NULL;
+  if (image == NULL
+        || (info->normalize && canvas.stamps == NULL)
+        || (info->normalize && info->antialias && canvas.contrib == NULL)) {
+    info->failed[thread_index] = 1;
+    free(canvas.stamps);
+    free(canvas.contrib);
+    return;
+  }
+
+  canvas.nx = info->nx;
+  canvas.ny = info->ny;
+  canvas.counts = (IDL_LONG *) image;
+  canvas.weights = (float *) image;
+
+  for (line = start; line < end; line++) {
+    n = info->polylines[info->starts[line]];
+    indices = info->polylines + info->starts[line] + 1;
+    canvas.id = (int) (line + 1);
+    last[0] = last[1] = -1;
+
+    for (k = 0; k < n; k++) {
+      if (indices[k] < 0 || indices[k] >= info->npoints) break;
+    }
+    if (k < n) {
+      info->invalid[thread_index] = 1;
+      continue;
+    }
+
+    for (k = n == 1 ? 0 : 1; k < n; k++) {
+      i = indices[k == 0 ? 0 : k - 1];
+      x0 = (mg_raster_coord(info->x, info->is_double, i) - info->xmin) * info->xscale;
+      y0 = (mg_raster_coord(info->y, info->is_double, i) - info->ymin) * info->yscale;
+      i = indices[k];
+      x1 = (mg_raster_coord(info->x, info->is_double, i) - info->xmin) * info->xscale;
+      y1 = (mg_raster_coord(info->y, info->is_double, i) - info->ymin) * info->yscale;
+
+      // NaN coordinates break the polyline
+      if (!isfinite(x0) || !isfinite(y0) || !isfinite(x1) || !isfinite(y1)) {
+        last[0] = last[1] = -1;
+        continue;
+      }
+      if (!mg_raster_clip(&x0, &y0, &x1, &y1, info->nx, info->ny)) {
+        last[0] = last[1] = -1;
+        continue;
+      }
+
+      if (info->antialias) {
+        mg_raster_wu(&canvas, x0 - 0.5, y0 - 0.5, x1 - 0.5, y1 - 0.5);
+      } else {
+        ix0 = x0 < info->nx ? (int) x0 : info->nx - 1;
+        iy0 = y0 < info->ny ? (int) y0 : info->ny - 1;
+        ix1 = x1 < info->nx ? (int) x1 : info->nx - 1;
+        iy1 = y1 < info->ny ? (int) y1 : info->ny - 1;
+        mg_raster_bresenham(&canvas, ix0, iy0, ix1, iy1, last);
+      }
+    }
+  }
+
+  free(canvas.stamps);
+  free(canvas.contrib);
+}
+
+
+// add the private images of the other threads to rows [start, end) of result
+static void mg_raster_merge(IDL_MEMINT start, IDL_MEMINT end,
+                            int thread_index, void *data) {
+  mg_raster_info *info = (mg_raster_info *) data;
+  IDL_MEMINT p, first = start * info->nx, last = end * info->nx;
+  int t;
+
+  for (t = 1; t < MG_THREADS_MAX && info->images[t]; t++) {
+    if (info->antialias) {
+      float *image = (float *) info->images[t];
+      float *result = (float *) info->result;
+      for (p = first; p < last; p++) result[p] += image[p];
+    } else {
+      IDL_LONG *image = (IDL_LONG *) info->images[t];
+      IDL_LONG *result = (IDL_LONG *) info->result;
+      for (p = first; p < last; p++) result[p] += image[p];
+    }
+  }
+}
+
+
+// convert var to two doubles, returns 0 if it does not have two elements
+static int mg_raster_pair(IDL_VPTR var, double *values) {
+  IDL_VPTR dbl;
+  IDL_MEMINT n;
+  double *v;
+
+  IDL_ENSURE_SIMPLE(var);
+  dbl = var->type == IDL_TYP_DOUBLE ? var : IDL_CvtDbl(1, &var, NULL);
+  IDL_VarGetData(dbl, &n, (char **) &v, FALSE);
+  if (n == 2) {
+    values[0] = v[0];
+    values[1] = v[1];
+  }
+  if (dbl != var) IDL_Deltmp(dbl);
+
+  return n == 2;
+}
+
+
+/*
+  Rasterize polylines into a line density image: the number of polylines
+  crossing each pixel.
+
+  Arguments for the routine are passed from IDL. They are:
+
+  :Params:
+     x : in, required, type=fltarr(n)
+        x-coordinates of the points
+     y : in, required, type=fltarr(n)
+        y-coordinates of the points
+     polylines : in, required, type=lonarr
+        connectivity, [n1, i1_0, ..., n2, i2_0, ...]
+     dims : in, required, type=lonarr(2)
+        dimensions of the output image
+     xrange : in, required, type=fltarr(2)
+        x-values of the left and right edges of the image
+     yrange : in, required, type=fltarr(2)
+        y-values of the bottom and top edges of the image
+
+  :Keywords:
+     antialias : in, optional, type=boolean
+        set to draw antialiased lines and return a float image
+     n_threads : in, optional, type=long
+        number of threads to use, default is the number of cores
+     normalize : in, optional, type=boolean
+        set to count each polyline at most once in each pixel
+*/
+static IDL_VPTR IDL_CDECL IDL_mg_rasterpolyline(int argc, IDL_VPTR *argv, char *argk) {
+  IDL_VPTR x, y, x_var, y_var, polylines, dims, result, plain_args[6];
+  IDL_LONG *polylines_data, *dims_data;
+  IDL_MEMINT npoints, ypoints, nelements, nlines, line, i, result_dims[2];
+  IDL_MEMINT *starts;
+  double xrange[2], yrange[2];
+  size_t image_size;
+  int nargs, t, nthreads, failed = 0, invalid = 0;
+  const char *msg = NULL;
+  mg_raster_info info;
+
+  typedef struct {
+    IDL_KW_RESULT_FIRST_FIELD;
+    IDL_LONG antialias;
+    IDL_LONG n_threads;
+    IDL_LONG normalize;
+  } KW_RESULT;
+
+  // make sure to list keyword in alphabetical order
+  static IDL_KW_PAR kw_pars[] = {
+    { "ANTIALIAS", IDL_TYP_LONG, 1, IDL_KW_ZERO | IDL_KW_VALUE | 1,
+      0, IDL_KW_OFFSETOF(antialias) },
+    { "N_THREADS", IDL_TYP_LONG, 1, IDL_KW_ZERO,
+      0, IDL_KW_OFFSETOF(n_threads) },
+    { "NORMALIZE", IDL_TYP_LONG, 1, IDL_KW_ZERO | IDL_KW_VALUE | 1,
+      0, IDL_KW_OFFSETOF(normalize) },
+    { NULL }
+  };
+
+  KW_RESULT kw;
+
+  nargs = IDL_KWProcessByOffset(argc, argv, argk, kw_pars, plain_args, 1, &kw);
+
+  // check inputs
+  x = plain_args[0];
+  y = plain_args[1];
+  IDL_ENSURE_SIMPLE(x);
+  IDL_ENSURE_SIMPLE(y);
+
+  if (!mg_raster_pair(plain_args[4], xrange)) {
+    msg = "XRANGE must have 2 elements";
+  } else if (!mg_raster_pair(plain_args[5], yrange)) {
+    msg = "YRANGE must have 2 elements";
+  } else if (!(xrange[0] != xrange[1]) || !(yrange[0] != yrange[1])) {
+    msg = "XRANGE and YRANGE must have distinct values";
+  }
+  if (msg) {
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "%s", msg);
+  }
+
+  IDL_ENSURE_SIMPLE(plain_args[3]);
+  dims = plain_args[3]->type == IDL_TYP_LONG ? plain_args[3] : IDL_CvtLng(1, &plain_args[3]);
+  IDL_VarGetData(dims, &nelements, (char **) &dims_data, FALSE);
+  if (nelements != 2 || dims_data[0] < 1 || dims_data[1] < 1) {
+    if (dims != plain_args[3]) IDL_Deltmp(dims);
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP,
+                "dimensions must be 2 positive values");
+  }
+  result_dims[0] = dims_data[0];
+  result_dims[1] = dims_data[1];
+  if (dims != plain_args[3]) IDL_Deltmp(dims);
+
+  // coordinates other than float or double are converted to double
+  if (x->type == IDL_TYP_FLOAT && y->type == IDL_TYP_FLOAT) {
+    x_var = x;
+    y_var = y;
+  } else {
+    x_var = x->type == IDL_TYP_DOUBLE ? x : IDL_CvtDbl(1, &x, NULL);
+    y_var = y->type == IDL_TYP_DOUBLE ? y : IDL_CvtDbl(1, &y, NULL);
+  }
+  IDL_VarGetData(x_var, &npoints, (char **) &info.x, FALSE);
+  IDL_VarGetData(y_var, &ypoints, (char **) &info.y, FALSE);
+  info.is_double = x_var->type == IDL_TYP_DOUBLE;
+
+  IDL_ENSURE_SIMPLE(plain_args[2]);
+  polylines = plain_args[2]->type == IDL_TYP_LONG ? plain_args[2] : IDL_CvtLng(1, &plain_args[2]);
+  IDL_VarGetData(polylines, &nelements, (char **) &polylines_data, FALSE);
+
+  // find the start of each polyline; a count of -1 ends the polylines
+  if (npoints != ypoints) {
+    msg = "x and y must have the same number of elements";
+  } else {
+    for (i = 0, nlines = 0; i < nelements && polylines_data[i] != -1;
+         i += polylines_data[i] + 1, nlines++) {
+      if (polylines_data[i] < 0 || polylines_data[i] >= nelements - i) {
+        msg = "invalid POLYLINES";
+        break;
+      }
+    }
+  }
+  starts = msg ? NULL : (IDL_MEMINT *) malloc((nlines > 0 ? nlines : 1) * sizeof(IDL_MEMINT));
+  if (msg == NULL && starts == NULL) msg = "unable to allocate memory";
+  if (msg) {
+    if (polylines != plain_args[2]) IDL_Deltmp(polylines);
+    if (x_var != x) IDL_Deltmp(x_var);
+    if (y_var != y) IDL_Deltmp(y_var);
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "%s", msg);
+  }
+  for (i = 0, line = 0; line < nlines; i += polylines_data[i] + 1, line++) {
+    starts[line] = i;
+  }
 
   // variable to return result in
-  result_data = (int *) IDL_MakeTempArray(IDL_TYP_LONG,
-                                          x->value.arr->n_dim,
-                                          x->value.arr->dim,
-                                          IDL_ARR_INI_ZERO,
-                                          &result);
+  info.result = IDL_MakeTempArray(kw.antialias ? IDL_TYP_FLOAT : IDL_TYP_LONG,
+                                  2, result_dims, IDL_ARR_INI_ZERO, &result);
+
+  info.npoints = npoints;
+  info.polylines = polylines_data;
+  info.starts = starts;
+  info.nx = (int) result_dims[0];
+  info.ny = (int) result_dims[1];
+  info.xmin = xrange[0];
+  info.xscale = result_dims[0] / (xrange[1] - xrange[0]);
+  info.ymin = yrange[0];
+  info.yscale = result_dims[1] / (yrange[1] - yrange[0]);
+  info.antialias = kw.antialias;
+  info.normalize = kw.normalize;
+  for (t = 0; t < MG_THREADS_MAX; t++) {
+    info.images[t] = NULL;
+    info.failed[t] = 0;
+    info.invalid[t] = 0;
+  }
+
+  // draw the polylines, each thread into its own image, then merge them
+  nthreads = mg_thread_count(nlines, MG_RASTER_MIN_LINES, kw.n_threads);
+  image_size = (size_t) result_dims[0] * result_dims[1] * 4;
+  if ((size_t) (nthreads - 1) * image_size > MG_RASTER_MAX_BUFFERS) {
+    nthreads = (int) (MG_RASTER_MAX_BUFFERS / image_size) + 1;
+  }
+  mg_thread_run(nthreads, nlines, mg_raster_lines, &info);
+  for (t = 0; t < MG_THREADS_MAX; t++) {
+    failed |= info.failed[t];
+    invalid |= info.invalid[t];
+  }
+  if (!failed && nthreads > 1) {
+    mg_thread_run(mg_thread_count(result_dims[1], MG_RASTER_MIN_ROWS, kw.n_threads),
+                  result_dims[1], mg_raster_merge, &info);
+  }
+
+  for (t = 1; t < MG_THREADS_MAX; t++) free(info.images[t]);
+  free(starts);
+  if (polylines != plain_args[2]) IDL_Deltmp(polylines);
+  if (x_var != x) IDL_Deltmp(x_var);
+  if (y_var != y) IDL_Deltmp(y_var);
+
+  if (failed || invalid) {
+    IDL_Deltmp(result);
+    IDL_KW_FREE;
+    IDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, "%s",
+                failed ? "unable to allocate memory" : "invalid index in POLYLINES");
+  }
+
+  IDL_KW_FREE;
+
   return result;
 }
 
@@ -119,7 +554,7 @@ int IDL_Load(void) {
 
   // functions to register
   static IDL_SYSFUN_DEF2 function_addr[] = {
-    { IDL_mg_rasterpolyline,     "MG_RASTERPOLYLINE",     6, 6, 0, 0 },
+    { IDL_mg_rasterpolyline,     "MG_RASTERPOLYLINE_",     6, 6, IDL_SYSFUN_DEF_F_KEYWORDS, 0 },
   };
 
   return IDL_SysRtnAdd(function_addr, TRUE, IDL_CARRAY_ELTS(function_addr));
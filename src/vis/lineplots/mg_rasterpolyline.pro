@@ -1,10 +1,11 @@
 ; docformat = 'rst'
 
 ;+
-; Create a raster image of a set of lines.
+; Create a raster image of a set of lines, i.e., a line density plot where
+; each pixel contains the number of lines crossing it.
 ;
 ; :Returns:
-;   image array
+;   `lonarr(dimensions)`, or `fltarr(dimensions)` if `ANTIALIAS` is set
 ;
 ; :Params:
 ;   x : in, required, type=numeric array
@@ -22,29 +23,40 @@
 ;
 ;        [n1, ind1_0, ind1_1, ind1_n1, n2, ... ]
 ;
+;   antialias : in, optional, type=boolean
+;     set to draw antialiased lines, returning fractional counts
 ;   dimensions : in, optional, type=lonarr(2), default="[400, 400]"
 ;     size of raster output
+;   n_threads : in, optional, type=long
+;     number of threads to use, default is the number of cores
+;   normalize : in, optional, type=boolean
+;     set to count each line at most once in each pixel, no matter how many
+;     times it crosses it
 ;   xrange : in, optional, type=fltarr(2)
 ;     min/max of `x`
 ;   yrange : in, optional, type=fltarr(2)
 ;     min/max of `y`
 ;-
 function mg_rasterpolyline, x, y, polylines=polylines, $
+                            antialias=antialias, $
                             dimensions=dimensions, $
+                            n_threads=n_threads, $
+                            normalize=normalize, $
                             xrange=xrange, yrange=yrange
   compile_opt strictarr
+  on_error, 2
 
   if (n_elements(xrange) gt 0L) then begin
     _xrange = xrange
   endif else begin
-    maxx = max(x, min=minx)
+    maxx = max(x, min=minx, /nan)
     _xrange = [minx, maxx]
   endelse
 
   if (n_elements(yrange) gt 0L) then begin
     _yrange = yrange
   endif else begin
-    maxy = max(y, min=miny)
+    maxy = max(y, min=miny, /nan)
     _yrange = [miny, maxy]
   endelse
 
@@ -53,7 +65,10 @@ function mg_rasterpolyline, x, y, polylines=polylines, $
   _dimensions = n_elements(dimensions) eq 0L ? [400L, 400L] : long(dimensions)
   _polylines = n_elements(polylines) eq 0L ? [nx, lindgen(nx)] : polylines
 
-  result = mg_rasterpolyline_(x, y, _polylines, _dimensions, _xrange, _yrange)
+  result = mg_rasterpolyline_(x, y, _polylines, _dimensions, _xrange, _yrange, $
+                              antialias=antialias, $
+                              n_threads=n_threads, $
+                              normalize=normalize)
 
   return, result
 end
@@ -173,6 +173,56 @@ function mg_array_equal_ut::test_nan2
 end
 
 
+function mg_array_equal_ut::test_mismatches
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  a = findgen(5000)
+  b = a
+  b[[1500, 3000]] += 0.25
+  result = mg_array_equal(a, b, $
+                          n_mismatches=n_mismatches, $
+                          first_index=first_index, $
+                          max_abs_diff=max_abs_diff)
+
+  assert, result eq 0, 'incorrect result'
+  assert, n_mismatches eq 2, 'incorrect number of mismatches: %d', n_mismatches
+  assert, first_index eq 1500, 'incorrect first index: %d', first_index
+  assert, max_abs_diff eq 0.25, 'incorrect max abs diff: %f', max_abs_diff
+
+  return, 1
+end
+
+
+function mg_array_equal_ut::test_first_index
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  a = lindgen(10)
+  result = mg_array_equal(a, a, first_index=first_index)
+
+  assert, result eq 1, 'incorrect result'
+  assert, first_index eq -1, 'incorrect first index: %d', first_index
+
+  return, 1
+end
+
+
+function mg_array_equal_ut::test_unsigned_tolerance
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  result = mg_array_equal([1B, 2B, 3B], [2B, 2B, 2B], tolerance=1B)
+
+  assert, result eq 1, 'incorrect result'
+
+  return, 1
+end
+
+
 ; function mg_array_equal_ut::test_typeconversion
 ;   compile_opt strictarr
 ;
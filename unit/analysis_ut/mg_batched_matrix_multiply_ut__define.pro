@@ -0,0 +1,131 @@
+; docformat = 'rst'
+
+function mg_batched_matrix_multiply_ut::_check, type, m, k, n, n_multiples, $
+                                                transpose_a=transpose_a, $
+                                                transpose_b=transpose_b
+  compile_opt strictarr
+
+  a = fix(100 * randomu(seed, k, m, n_multiples), type=type)
+  b = fix(100 * randomu(seed, n, k, n_multiples), type=type)
+
+  standard = make_array(n, m, n_multiples, type=type)
+  for i = 0L, n_multiples - 1L do standard[*, *, i] = a[*, *, i] ## b[*, *, i]
+
+  _a = keyword_set(transpose_a) ? transpose(a, [1, 0, 2]) : a
+  _b = keyword_set(transpose_b) ? transpose(b, [1, 0, 2]) : b
+  result = mg_batched_matrix_multiply(_a, _b, $
+                                      transpose_a=transpose_a, $
+                                      transpose_b=transpose_b)
+
+  assert, array_equal(size(result, /dimensions), [n, m, n_multiples]), $
+          'incorrect dimensions for type: %d', type
+  assert, array_equal(result, standard), $
+          'incorrect result for type: %d', type
+
+  return, 1
+end
+
+
+function mg_batched_matrix_multiply_ut::test_alltypes
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  types = [1, 2, 3, 4, 5, 12, 13, 14, 15]
+  for t = 0L, n_elements(types) - 1L do begin
+    result = self->_check(types[t], 3L, 5L, 2L, 10L)
+  endfor
+
+  return, 1
+end
+
+
+function mg_batched_matrix_multiply_ut::test_fixed_sizes
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  sizes = [2, 3, 4, 6]
+  for s = 0L, n_elements(sizes) - 1L do begin
+    result = self->_check(5, sizes[s], sizes[s], sizes[s], 101L)
+    result = self->_check(4, sizes[s], sizes[s], 1L, 101L)
+  endfor
+
+  return, 1
+end
+
+
+function mg_batched_matrix_multiply_ut::test_transpose
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  result = self->_check(5, 3L, 4L, 2L, 7L, /transpose_a)
+  result = self->_check(5, 3L, 4L, 2L, 7L, /transpose_b)
+  result = self->_check(5, 3L, 3L, 3L, 17L, /transpose_a, /transpose_b)
+
+  return, 1
+end
+
+
+function mg_batched_matrix_multiply_ut::test_complex
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  a = complex(randomu(seed, 3, 2, 5), randomu(seed, 3, 2, 5))
+  b = complex(randomu(seed, 4, 3, 5), randomu(seed, 4, 3, 5))
+
+  standard = complexarr(4, 2, 5)
+  for i = 0L, 4L do standard[*, *, i] = a[*, *, i] ## b[*, *, i]
+
+  result = mg_batched_matrix_multiply(a, b)
+  error = max(abs(result - standard))
+  assert, error lt 1.0e-5, 'incorrect result with error: %f', error
+
+  return, 1
+end
+
+
+function mg_batched_matrix_multiply_ut::test_threads
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  a = randomu(seed, 4, 4, 10000, /double)
+  b = randomu(seed, 4, 4, 10000, /double)
+
+  standard = mg_batched_matrix_multiply(a, b, n_threads=1)
+  result = mg_batched_matrix_multiply(a, b, n_threads=4)
+  assert, array_equal(result, standard), 'threaded result differs'
+
+  return, 1
+end
+
+
+function mg_batched_matrix_multiply_ut::test_errors
+  compile_opt strictarr
+  @error_is_pass
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  result = mg_batched_matrix_multiply(fltarr(3, 2, 4), fltarr(2, 4, 4))
+
+  return, 0
+end
+
+
+function mg_batched_matrix_multiply_ut::init, _extra=e
+  compile_opt strictarr
+
+  if (~self->MGutLibTestCase::init(_extra=e)) then return, 0
+
+  return, 1
+end
+
+
+pro mg_batched_matrix_multiply_ut__define
+  compile_opt strictarr
+
+  define = { mg_batched_matrix_multiply_ut, inherits MGutLibTestCase }
+end
@@ -128,6 +128,31 @@ function mg_batched_matrix_vector_multiply_ut::test_double
 end
 
 
+function mg_batched_matrix_vector_multiply_ut::test_complex
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  n = 4L
+  m = 3L
+  n_multiples = 20L
+
+  a = dcomplex(randomu(seed, n, m, n_multiples, /double), $
+               randomu(seed, n, m, n_multiples, /double))
+  b = dcomplex(randomu(seed, n, n_multiples, /double), $
+               randomu(seed, n, n_multiples, /double))
+
+  standard = dcomplexarr(m, n_multiples)
+  for i = 0L, n_multiples - 1L do standard[*, i] = a[*, *, i] ## b[*, i]
+
+  result = mg_batched_matrix_vector_multiply(a, b, n, m, n_multiples, n_threads=2)
+  error = max(abs(result - standard))
+  assert, error lt 1.0d-12, 'incorrect result with error: %f', error
+
+  return, 1
+end
+
+
 function mg_batched_matrix_vector_multiply_ut::init, _extra=e
   compile_opt strictarr
 
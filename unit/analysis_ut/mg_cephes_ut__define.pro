@@ -0,0 +1,98 @@
+; docformat = 'rst'
+
+function mg_cephes_ut::test_fdtr
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_cephes'), 'MG_CEPHES DLM not found', /skip
+
+  p = mg_fdtr(3, 4, 0.5D)
+  q = mg_fdtrc(3, 4, 0.5D)
+  assert, size(p, /type) eq 5 && size(p, /n_dimensions) eq 0, 'incorrect result type'
+  assert, abs(p + q - 1.0D) lt 1.0e-12, 'CDF and complement do not sum to 1'
+  assert, abs(mg_fdtri(3, 4, p) - 0.5D) lt 1.0e-10, 'incorrect inverse'
+
+  return, 1
+end
+
+
+function mg_cephes_ut::test_broadcast
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_cephes'), 'MG_CEPHES DLM not found', /skip
+
+  a = findgen(4, 3) + 1.0
+  b = [2.0, 2.5, 3.0, 3.5]
+  p = mg_fdtr(a, b, 1.5)
+
+  assert, size(p, /type) eq 4, 'incorrect result type'
+  assert, array_equal(size(p, /dimensions), [4, 3]), 'incorrect dimensions'
+  for j = 0L, 2L do begin
+    for i = 0L, 3L do begin
+      assert, p[i, j] eq mg_fdtr(a[i, j], b[i], 1.5), $
+              'incorrect value at [%d, %d]', i, j
+    endfor
+  endfor
+
+  p = mg_fdtr(reform([1.0, 2.0, 3.0], 1, 3), b, 1.5, /double)
+  assert, size(p, /type) eq 5, 'incorrect type with DOUBLE'
+  assert, array_equal(size(p, /dimensions), [4, 3]), 'incorrect broadcast dimensions'
+
+  return, 1
+end
+
+
+function mg_cephes_ut::test_incompatible
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_cephes'), 'MG_CEPHES DLM not found', /skip
+
+  catch, error
+  if (error ne 0L) then begin
+    catch, /cancel
+    return, 1
+  endif
+
+  p = mg_beta(findgen(4), findgen(3))
+
+  return, 0
+end
+
+
+function mg_cephes_ut::test_integer_parameter
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_cephes'), 'MG_CEPHES DLM not found', /skip
+
+  p = mg_stdtr([1, 5, 30], 0.0)
+  assert, array_equal(p, [0.5, 0.5, 0.5]), 'incorrect Student t CDF'
+
+  p = mg_stdtr(1.0D12, 0.0)
+  assert, finite(p, /nan), 'invalid degrees of freedom not NaN'
+
+  return, 1
+end
+
+
+function mg_cephes_ut::test_procedure
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_cephes'), 'MG_CEPHES DLM not found', /skip
+
+  x = [0.5D, 1.0D, 2.0D]
+  mg_sici, x, si, ci
+  assert, array_equal(size(si, /dimensions), [3]), 'incorrect dimensions'
+  assert, abs(si[1] - 0.946083070367183D) lt 1.0e-12, 'incorrect Si(1)'
+  assert, abs(ci[1] - 0.337403922900968D) lt 1.0e-12, 'incorrect Ci(1)'
+
+  mg_airy, 0.0, ai
+  assert, abs(ai - 0.355028) lt 1.0e-6, 'incorrect Ai(0)'
+
+  return, 1
+end
+
+
+pro mg_cephes_ut__define
+  compile_opt strictarr
+
+  define = { mg_cephes_ut, inherits MGutLibTestCase }
+end
@@ -62,6 +62,85 @@ function mg_glcm_ut::test_n_levels
 end
 
 
+function mg_glcm_ut::test_offsets
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  im = [[0B, 0B, 1B, 1B], $
+        [0B, 0B, 1B, 1B], $
+        [0B, 2B, 2B, 2B], $
+        [2B, 2B, 3B, 3B]]
+
+  result = mg_glcm_matrix(im, [[1, 0], [-1, 0], [0, 1]])
+  assert, array_equal(size(result, /dimensions), [4, 4, 3]), $
+          'incorrect dimensions'
+
+  standard = [[2L, 2L, 1L, 0L], $
+              [0L, 2L, 0L, 0L], $
+              [0L, 0L, 3L, 1L], $
+              [0L, 0L, 0L, 1L]]
+
+  assert, array_equal(result[*, *, 0], standard, /no_typeconv), $
+          'incorrect matrix for [1, 0]'
+  assert, array_equal(result[*, *, 1], transpose(standard)), $
+          'incorrect matrix for [-1, 0]'
+  assert, array_equal(result[*, *, 2], mg_glcm(im, 0, 1)), $
+          'incorrect matrix for [0, 1]'
+
+  return, 1
+end
+
+
+function mg_glcm_ut::test_features
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  im = [[0B, 0B, 1B, 1B], $
+        [0B, 0B, 1B, 1B], $
+        [0B, 2B, 2B, 2B], $
+        [2B, 2B, 3B, 3B]]
+
+  features = mg_glcm_features(im, [1, 0])
+  assert, n_elements(features) eq 5L, 'incorrect number of features'
+
+  p = mg_glcm(im, 1, 0) / 12.0D
+  d = (lindgen(4) # (lonarr(4) + 1L) - (lonarr(4) + 1L) # lindgen(4))^2
+  assert, abs(features[0] - total(p * d)) lt 1.0e-12, 'incorrect contrast'
+  assert, abs(features[2] - total(p^2)) lt 1.0e-12, 'incorrect energy'
+  assert, abs(features[3] - total(p / (1.0D + d))) lt 1.0e-12, $
+          'incorrect homogeneity'
+  ind = where(p gt 0.0D)
+  assert, abs(features[4] + total(p[ind] * alog(p[ind]))) lt 1.0e-12, $
+          'incorrect entropy'
+
+  return, 1
+end
+
+
+function mg_glcm_ut::test_windows
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  im = [[0B, 0B, 1B, 1B], $
+        [0B, 0B, 1B, 1B], $
+        [0B, 2B, 2B, 2B], $
+        [2B, 2B, 3B, 3B]]
+
+  features = mg_glcm_features(im, [1, 0], window_size=2, step=2)
+  assert, array_equal(size(features, /dimensions), [5, 2, 2]), $
+          'incorrect dimensions'
+  assert, array_equal(reform(features[0, *, *]), [[0.0D, 0.0D], [2.0D, 0.0D]]), $
+          'incorrect contrast'
+  assert, array_equal(reform(features[2, *, *]), [[1.0D, 1.0D], [0.5D, 0.5D]]), $
+          'incorrect energy'
+
+  return, 1
+end
+
+
 function mg_glcm_ut::init, _extra=e
   compile_opt strictarr
 
@@ -63,6 +63,57 @@ function mg_hist_nd_ut::test_geo
 end
 
 
+function mg_hist_nd_ut::test_reverse_indices
+  compile_opt strictarr
+
+  q = transpose([[0.1 * findgen(40)], [0.1 * findgen(40)]])
+  result = mg_hist_nd(q, bin_size=1., reverse_indices=ri)
+
+  assert, n_elements(ri) eq 16 + 1 + 40, 'incorrect number of reverse indices'
+  assert, array_equal(ri[0:16] - ri[0], [0, lonarr(5) + 10, lonarr(5) + 20, $
+                                         lonarr(5) + 30, 40]), $
+          'incorrect reverse indices offsets'
+  assert, array_equal(ri[ri[5]:ri[6] - 1], lindgen(10) + 10), $
+          'incorrect reverse indices for bin [1, 1]'
+
+  return, 1
+end
+
+
+function mg_hist_nd_ut::test_edges
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  q = transpose([[0.5, 1.5, 3.0, 10.0, 11.0], [0.0, 0.0, 5.0, 5.0, 2.0]])
+  result = mg_hist_nd(q, edges=list([0.0, 1.0, 10.0], [0.0, 2.0, 4.0, 5.0]))
+
+  standard = [[1L, 1L], [0L, 0L], [0L, 2L]]
+  assert, array_equal(size(result, /dimensions), [2, 3]), 'incorrect dimensions'
+  assert, array_equal(result, standard), 'incorrect result'
+
+  return, 1
+end
+
+
+function mg_hist_nd_ut::test_9d
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  q = fltarr(9, 100)
+  q[*, 50:*] = 1.0
+  result = mg_hist_nd(q, nbins=2)
+
+  assert, n_elements(result) eq 2L^9, 'incorrect number of bins'
+  assert, result[0] eq 50L, 'incorrect first bin'
+  assert, result[2L^9 - 1L] eq 50L, 'incorrect last bin'
+  assert, total(result, /preserve_type) eq 100L, 'incorrect total'
+
+  return, 1
+end
+
+
 function mg_hist_nd_ut::init, _extra=e
   compile_opt strictarr
 
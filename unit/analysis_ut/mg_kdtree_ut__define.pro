@@ -0,0 +1,135 @@
+; docformat = 'rst'
+
+function mg_kdtree_ut::test_query
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  x = [[0.0, 0.0], [1.0, 0.0], [0.0, 1.0], [5.0, 5.0], [1.0, 1.0]]
+  tree = mg_kdtree(x, leaf_size=1)
+
+  ind = tree->query([[0.1, 0.2], [4.0, 4.0]], 2, distances=distances)
+  assert, array_equal(size(ind, /dimensions), [2, 2]), 'incorrect dimensions'
+  assert, array_equal(ind, [[0, 2], [3, 4]]), 'incorrect neighbors'
+  assert, abs(distances[0, 0] - sqrt(0.05D)) lt 1.0e-6, 'incorrect distance'
+
+  ind = tree->query([4.0, 4.0], 1, metric='chebyshev', distances=distances)
+  assert, array_equal(ind, [3]), 'incorrect Chebyshev neighbor'
+  assert, abs(distances[0] - 1.0D) lt 1.0e-12, 'incorrect Chebyshev distance'
+
+  obj_destroy, tree
+
+  return, 1
+end
+
+
+function mg_kdtree_ut::test_ties
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  x = fltarr(2, 10)
+  tree = mg_kdtree(x, leaf_size=2)
+
+  ind = tree->query([0.0, 0.0], 3)
+  assert, array_equal(ind, [0, 1, 2]), 'ties not sorted by index'
+
+  obj_destroy, tree
+
+  return, 1
+end
+
+
+function mg_kdtree_ut::test_radius
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  x = reform(findgen(10), 1, 10)
+  tree = mg_kdtree(x)
+
+  ind = tree->query_radius(reform([2.2, 20.0, 7.5], 1, 3), 1.0, $
+                           offsets=offsets, count=count)
+  assert, count eq 4, 'incorrect count: %d', count
+  assert, array_equal(offsets, [0, 2, 2, 4]), 'incorrect offsets'
+  assert, array_equal(ind, [2, 3, 7, 8]), 'incorrect neighbors'
+
+  ind = tree->query_radius(reform([20.0], 1, 1), 1.0, count=count)
+  assert, count eq 0 && ind eq -1L, 'incorrect result without neighbors'
+
+  obj_destroy, tree
+
+  return, 1
+end
+
+
+function mg_kdtree_ut::test_brute_force
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  seed = 0L
+  x = randomu(seed, 3, 500)
+  xi = randomu(seed, 3, 20)
+
+  tree = mg_kdtree(x)
+  ind = tree->query(xi, 4, metric='manhattan')
+
+  for q = 0L, 19L do begin
+    d = total(abs(x - rebin(xi[*, q], 3, 500)), 1)
+    assert, array_equal(ind[*, q], (sort(d))[0:3]), $
+            'incorrect neighbors for query %d', q
+  endfor
+
+  obj_destroy, tree
+
+  return, 1
+end
+
+
+function mg_kdtree_ut::test_serialize
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  seed = 0L
+  x = randomu(seed, 2, 100)
+  xi = randomu(seed, 2, 10)
+
+  tree = mg_kdtree(x)
+  tree->getProperty, tree=serialized, n_samples=n_samples, n_features=n_features
+  assert, n_samples eq 100 && n_features eq 2, 'incorrect size'
+
+  copy = mg_kdtree(tree=serialized)
+  assert, array_equal(tree->query(xi, 3), copy->query(xi, 3)), $
+          'incorrect result from copy'
+
+  obj_destroy, [tree, copy]
+
+  return, 1
+end
+
+
+function mg_kdtree_ut::init, _extra=e
+  compile_opt strictarr
+
+  if (~self->MGutLibTestCase::init(_extra=e)) then return, 0
+
+  self->addTestingRoutine, ['mg_kdtree__define', $
+                            'mg_kdtree::getProperty', $
+                            'mg_kdtree::cleanup']
+  self->addTestingRoutine, ['mg_kdtree::init', $
+                            'mg_kdtree::query', $
+                            'mg_kdtree::query_radius', $
+                            'mg_kdtree::_overloadHelp'], $
+                           /is_function
+
+  return, 1
+end
+
+
+pro mg_kdtree_ut__define
+  compile_opt strictarr
+
+  define = { mg_kdtree_ut, inherits MGutLibTestCase }
+end
@@ -0,0 +1,110 @@
+; docformat = 'rst'
+
+function mg_kmeans_ut::test_fit
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  x = [[0.0, 0.0], [0.0, 1.0], [1.0, 0.0], $
+       [10.0, 10.0], [10.0, 11.0], [11.0, 10.0]]
+  centers = mg_kmeans_fit(x, 2, labels=labels, inertia=inertia, counts=counts, $
+                          init=[[0.0, 0.0], [10.0, 10.0]])
+
+  assert, array_equal(size(centers, /dimensions), [2, 2]), 'incorrect dimensions'
+  assert, array_equal(labels, [0, 0, 0, 1, 1, 1]), 'incorrect labels'
+  assert, array_equal(counts, [3, 3]), 'incorrect counts'
+  assert, max(abs(centers - [[1.0, 1.0], [31.0, 31.0]] / 3.0)) lt 1.0e-6, $
+          'incorrect centers'
+  assert, abs(inertia - 8.0D / 3.0D) lt 1.0e-6, 'incorrect inertia: %f', inertia
+
+  return, 1
+end
+
+
+function mg_kmeans_ut::test_seed
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  seed = 0L
+  x = randomu(seed, 3, 2000)
+
+  foreach init, ['k-means++', 'k-means||', 'random'] do begin
+    c1 = mg_kmeans_fit(x, 5, init=init, seed=7L, n_threads=1)
+    c2 = mg_kmeans_fit(x, 5, init=init, seed=7L, n_threads=4)
+    assert, array_equal(c1, c2), 'result depends on threads for %s', init
+  endforeach
+
+  return, 1
+end
+
+
+function mg_kmeans_ut::test_predict
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  centers = [[0.0, 0.0], [10.0, 10.0]]
+  labels = mg_kmeans_predict([[1.0, 1.0], [9.0, 8.0], [4.0, 4.0]], centers, $
+                             distances=distances)
+
+  assert, array_equal(labels, [0, 1, 0]), 'incorrect labels'
+  assert, abs(distances[1] - sqrt(5.0D)) lt 1.0e-6, 'incorrect distance'
+
+  return, 1
+end
+
+
+function mg_kmeans_ut::test_partial_fit
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  seed = 0L
+  x = [[randomu(seed, 2, 500)], [randomu(seed, 2, 500) + 5.0]]
+  x = x[*, sort(randomu(seed, 1000))]
+
+  kmeans = mg_kmeans(n_clusters=2)
+  kmeans->partial_fit, x[*, 0:499], seed=seed
+  kmeans->partial_fit, x[*, 500:*]
+
+  centers = kmeans.centers
+  centers = centers[*, sort(centers[0, *])]
+  assert, max(abs(centers - [[0.5, 0.5], [5.5, 5.5]])) lt 0.1, $
+          'incorrect centers'
+
+  labels = kmeans->predict(x)
+  assert, array_equal(labels eq labels[0], (x[0, *] gt 3.0) eq (x[0, 0] gt 3.0)), $
+          'incorrect labels'
+
+  obj_destroy, kmeans
+
+  return, 1
+end
+
+
+function mg_kmeans_ut::init, _extra=e
+  compile_opt strictarr
+
+  if (~self->MGutLibTestCase::init(_extra=e)) then return, 0
+
+  self->addTestingRoutine, ['mg_kmeans__define', $
+                            'mg_kmeans::fit', $
+                            'mg_kmeans::partial_fit', $
+                            'mg_kmeans::getProperty', $
+                            'mg_kmeans::setProperty', $
+                            'mg_kmeans::cleanup']
+  self->addTestingRoutine, ['mg_kmeans::init', $
+                            'mg_kmeans::predict', $
+                            'mg_kmeans::_overloadHelp'], $
+                           /is_function
+
+  return, 1
+end
+
+
+pro mg_kmeans_ut__define
+  compile_opt strictarr
+
+  define = { mg_kmeans_ut, inherits MGutLibTestCase }
+end
@@ -15,6 +15,99 @@ function mg_local_moment_ut::test1
 end
 
 
+function mg_local_moment_ut::test_variance
+  compile_opt strictarr
+
+  assert, mg_idlversion(require='8.1'), /skip, $
+          'test requires IDL 8.1, %s present', !version.release
+
+  x = findgen(10)
+
+  result = mg_local_moment(x, 3, variance=variance, skewness=skewness)
+
+  assert, array_equal(variance[1:8], fltarr(8) + 1.0), 'incorrect variance'
+  assert, array_equal(skewness[1:8], fltarr(8)), 'incorrect skewness'
+
+  return, 1
+end
+
+
+function mg_local_moment_ut::test_edge_truncate
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  x = findgen(5)
+
+  result = mg_local_moment(x, 3, /edge_truncate, /double)
+  standard = [1.0D / 3.0D, 1.0D, 2.0D, 3.0D, 11.0D / 3.0D]
+
+  assert, size(result, /type) eq 5L, 'incorrect type'
+  assert, total(abs(result - standard)) lt 1.0e-12, 'incorrect result'
+
+  return, 1
+end
+
+
+function mg_local_moment_ut::test_nan
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  x = [1.0, 2.0, !values.f_nan, 4.0, 5.0]
+
+  result = mg_local_moment(x, 3, /edge_truncate)
+  assert, array_equal(finite(result), [1B, 0B, 0B, 0B, 1B]), $
+          'incorrect NaNs without NAN'
+
+  result = mg_local_moment(x, 3, /edge_truncate, /nan)
+  assert, array_equal(result, [4.0 / 3.0, 1.5, 3.0, 4.5, 14.0 / 3.0]), $
+          'incorrect result with NAN'
+
+  return, 1
+end
+
+
+function mg_local_moment_ut::test_2d
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  x = dindgen(6, 5)
+
+  result = mg_local_moment(x, [3, 1], /edge_wrap, variance=variance)
+
+  standard = (shift(x, 1, 0) + x + shift(x, -1, 0)) / 3.0D
+  assert, total(abs(result - standard)) lt 1.0e-9, 'incorrect mean'
+
+  standard_variance = ((shift(x, 1, 0) - standard)^2 $
+                         + (x - standard)^2 $
+                         + (shift(x, -1, 0) - standard)^2) / 2.0D
+  assert, total(abs(variance - standard_variance)) lt 1.0e-9, $
+          'incorrect variance'
+
+  return, 1
+end
+
+
+function mg_local_moment_ut::test_small_cube
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  x = randomu(1L, 16, 16, 16, /double)
+
+  result = mg_local_moment(x, 3, /edge_wrap, kurtosis=kurtosis)
+  standard = smooth(x, 3, /edge_wrap)
+
+  assert, array_equal(size(result, /dimensions), [16, 16, 16]), $
+          'incorrect dimensions'
+  assert, max(abs(result - standard)) lt 1.0e-9, 'incorrect mean'
+
+  return, 1
+end
+
+
 function mg_local_moment_ut::init, _extra=e
   compile_opt strictarr
 
@@ -0,0 +1,54 @@
+; docformat = 'rst'
+
+function mg_median_deviation_ut::test_basic
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  x = [1.0, 1.0, 2.0, 2.0, 4.0, 6.0, 9.0]
+  assert, mg_median_deviation(x) eq 1.0, 'incorrect result'
+
+  x = randomu(seed, 1000)
+  standard = median(abs(median(x) - x))
+  assert, mg_median_deviation(x) eq standard, 'incorrect random result'
+
+  return, 1
+end
+
+
+function mg_median_deviation_ut::test_dimension
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  x = randomu(seed, 3, 20, 4, /double)
+  result = mg_median_deviation(x, dimension=2, /even)
+
+  assert, array_equal(size(result, /dimensions), [3, 4]), 'incorrect dimensions'
+  for i = 0L, 2L do begin
+    for k = 0L, 3L do begin
+      stack = reform(x[i, *, k])
+      standard = median(abs(median(stack, /even) - stack), /even)
+      assert, abs(result[i, k] - standard) lt 1.0d-12, $
+              'incorrect result for stack [%d, %d]', i, k
+    endfor
+  endfor
+
+  return, 1
+end
+
+
+function mg_median_deviation_ut::init, _extra=e
+  compile_opt strictarr
+
+  if (~self->MGutLibTestCase::init(_extra=e)) then return, 0
+
+  return, 1
+end
+
+
+pro mg_median_deviation_ut__define
+  compile_opt strictarr
+
+  define = { mg_median_deviation_ut, inherits MGutLibTestCase }
+end
@@ -0,0 +1,109 @@
+; docformat = 'rst'
+
+function mg_quantiles_ut::test_rank
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  x = randomu(seed, 1001)
+  q = [0.0, 0.1, 0.25, 0.5, 0.75, 1.0]
+  result = mg_quantiles(x, q)
+  standard = x[(sort(x))[(long(q * 1001) < 1000)]]
+
+  assert, array_equal(result, standard), 'incorrect result'
+  assert, size(result, /type) eq 4, 'incorrect type'
+
+  return, 1
+end
+
+
+function mg_quantiles_ut::test_interpolation
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  x = [5.0, 1.0, 4.0, 2.0, 3.0, 6.0]
+
+  ; standards from numpy.quantile(x, q, method=...)
+  assert, mg_quantiles(x, 0.4, interpolation='linear') eq 3.0, 'incorrect linear'
+  assert, mg_quantiles(x, 0.5, interpolation='linear') eq 3.5, 'incorrect linear'
+  assert, mg_quantiles(x, 0.5, interpolation='lower') eq 3.0, 'incorrect lower'
+  assert, mg_quantiles(x, 0.5, interpolation='higher') eq 4.0, 'incorrect higher'
+  assert, mg_quantiles(x, 0.3, interpolation='nearest') eq 3.0, 'incorrect nearest'
+  assert, mg_quantiles(x, 0.3, interpolation='midpoint') eq 2.5, 'incorrect midpoint'
+  assert, mg_quantiles(x, 0.5, interpolation='Linear') eq 3.5, 'incorrect Linear'
+
+  return, 1
+end
+
+
+function mg_quantiles_ut::test_dimension
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  x = randomu(seed, 4, 5, 31)
+  q = [0.25, 0.5, 0.75]
+  result = mg_quantiles(x, q, dimension=3, interpolation='lower')
+
+  assert, array_equal(size(result, /dimensions), [4, 5, 3]), $
+          'incorrect dimensions'
+  for i = 0L, 3L do begin
+    for j = 0L, 4L do begin
+      stack = reform(x[i, j, *])
+      standard = stack[(sort(stack))[long(q * 30)]]
+      assert, array_equal(reform(result[i, j, *]), standard), $
+              'incorrect result for stack [%d, %d]', i, j
+    endfor
+  endfor
+
+  result = mg_quantiles(x, 0.5, dimension=1)
+  assert, array_equal(size(result, /dimensions), [5, 31]), $
+          'incorrect dimensions for scalar quantile'
+
+  return, 1
+end
+
+
+function mg_quantiles_ut::test_nan
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  x = [3.0, !values.f_nan, 1.0, 2.0]
+
+  assert, mg_quantiles(x, 1.0, /nan) eq 3.0, 'incorrect result with NAN'
+  assert, finite(mg_quantiles(x, 1.0), /nan), 'incorrect result without NAN'
+  assert, finite(mg_quantiles(replicate(!values.f_nan, 3), 0.5, /nan), /nan), $
+          'incorrect result for all NaN'
+
+  return, 1
+end
+
+
+function mg_quantiles_ut::test_errors
+  compile_opt strictarr
+  @error_is_pass
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  result = mg_quantiles(findgen(10), 1.5)
+
+  return, 0
+end
+
+
+function mg_quantiles_ut::init, _extra=e
+  compile_opt strictarr
+
+  if (~self->MGutLibTestCase::init(_extra=e)) then return, 0
+
+  return, 1
+end
+
+
+pro mg_quantiles_ut__define
+  compile_opt strictarr
+
+  define = { mg_quantiles_ut, inherits MGutLibTestCase }
+end
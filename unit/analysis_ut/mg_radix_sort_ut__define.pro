@@ -0,0 +1,102 @@
+; docformat = 'rst'
+
+function mg_radix_sort_ut::test_alltypes
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  types = [1, 2, 3, 4, 5, 12, 13, 14, 15]
+  for t = 0L, n_elements(types) - 1L do begin
+    x = fix(1000 * randomu(seed, 1000), type=types[t])
+    result = mg_radix_sort(x)
+    assert, array_equal(x[result], x[sort(x)]), $
+            'incorrect result for type: %d', types[t]
+  endfor
+
+  return, 1
+end
+
+
+function mg_radix_sort_ut::test_negative
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  x = randomu(seed, 10000) - 0.5
+  result = mg_radix_sort(x)
+  assert, array_equal(x[result], x[sort(x)]), 'incorrect float result'
+
+  x = long64(1d15 * (randomu(seed, 10000, /double) - 0.5))
+  result = mg_radix_sort(x)
+  assert, array_equal(x[result], x[sort(x)]), 'incorrect long64 result'
+
+  return, 1
+end
+
+
+function mg_radix_sort_ut::test_stable
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  x = [1, 2, 3, 2, 4, 0, 1]
+  result = mg_radix_sort(x)
+  standard = [5, 0, 6, 1, 3, 2, 4]
+
+  assert, array_equal(result, standard), 'incorrect result'
+
+  x = [2.0, -1.0, 2.0, 2.0, -1.0]
+  result = mg_radix_sort(x)
+  standard = [1, 4, 0, 2, 3]
+
+  assert, array_equal(result, standard), 'incorrect float result'
+
+  return, 1
+end
+
+
+function mg_radix_sort_ut::test_strings
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  x = ['Mike', 'George', 'Bill', '', 'Bob', 'Bill', 'abc', 'ab', 'B']
+  result = mg_radix_sort(x)
+  standard = [3, 8, 2, 5, 4, 1, 0, 7, 6]
+
+  assert, array_equal(result, standard), 'incorrect result'
+
+  return, 1
+end
+
+
+function mg_radix_sort_ut::test_threads
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  x = long(1000 * randomu(seed, 1000000))
+  standard = mg_radix_sort(x, n_threads=1)
+  result = mg_radix_sort(x, n_threads=4)
+
+  assert, array_equal(result, standard), 'threaded result differs'
+  assert, array_equal(x[result], x[sort(x)]), 'incorrect result'
+
+  return, 1
+end
+
+
+function mg_radix_sort_ut::init, _extra=e
+  compile_opt strictarr
+
+  if (~self->MGutLibTestCase::init(_extra=e)) then return, 0
+
+  return, 1
+end
+
+
+pro mg_radix_sort_ut__define
+  compile_opt strictarr
+
+  define = { mg_radix_sort_ut, inherits MGutLibTestCase }
+end
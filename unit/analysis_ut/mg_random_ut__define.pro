@@ -0,0 +1,137 @@
+; docformat = 'rst'
+
+function mg_random_ut::test_sequence
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  seed = 5L
+  x = mg_random(seed, 1000)
+  assert, size(x, /type) eq 4, 'incorrect type'
+  assert, array_equal(seed, [5ULL, 1000ULL]), 'incorrect state'
+  assert, min(x) ge 0.0 && max(x) lt 1.0, 'values out of range'
+
+  seed = 5L
+  x1 = mg_random(seed, 300, n_threads=1)
+  x2 = mg_random(seed, 700, n_threads=4)
+  assert, array_equal(x, [x1, x2]), 'split sequence differs'
+
+  state = [5ULL, 300ULL]
+  assert, array_equal(mg_random(state, 700), x2), 'incorrect skip ahead'
+
+  return, 1
+end
+
+
+function mg_random_ut::test_types
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  seed = 1L
+  assert, size(mg_random(seed, 3, 4, /double), /type) eq 5, 'incorrect DOUBLE type'
+  assert, size(mg_random(seed, [3, 4], /ulong), /type) eq 13, 'incorrect ULONG type'
+  assert, size(mg_random(seed, 10, /l64), /type) eq 14, 'incorrect L64 type'
+  assert, array_equal(size(mg_random(seed, [3, 4]), /dimensions), [3, 4]), $
+          'incorrect dimensions'
+  assert, size(mg_random(seed), /n_dimensions) eq 0, 'result not scalar'
+
+  p = mg_random(seed, 10, distribution='poisson', parameters=4.0)
+  assert, size(p, /type) eq 3, 'incorrect discrete type'
+
+  return, 1
+end
+
+
+function mg_random_ut::test_distributions
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  seed = 9L
+  n = 200000L
+
+  x = mg_random(seed, n, distribution='normal', parameters=[2.0, 3.0], /double)
+  assert, abs(mean(x) - 2.0) lt 0.05, 'incorrect normal mean'
+  assert, abs(variance(x) - 9.0) lt 0.2, 'incorrect normal variance'
+
+  x = mg_random(seed, n, distribution='gamma', parameters=[0.5, 2.0], /double)
+  assert, abs(mean(x) - 1.0) lt 0.02, 'incorrect gamma mean'
+
+  x = mg_random(seed, n, distribution='poisson', parameters=1234.5)
+  assert, abs(mean(x, /double) - 1234.5) lt 0.5, 'incorrect Poisson mean'
+
+  x = mg_random(seed, n, distribution='binomial', parameters=[1000, 0.7])
+  assert, abs(mean(x, /double) - 700.0) lt 0.2, 'incorrect binomial mean'
+  assert, min(x) ge 0 && max(x) le 1000, 'binomial values out of range'
+
+  return, 1
+end
+
+
+function mg_random_ut::test_bad_parameters
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  catch, error
+  if (error ne 0L) then begin
+    catch, /cancel
+    return, 1
+  endif
+
+  seed = 1L
+  x = mg_random(seed, 10, distribution='gamma', parameters=-1.0)
+
+  return, 0
+end
+
+
+function mg_random_ut::test_rng
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  rng = mg_rng(seed=42)
+  x1 = rng->random(10, distribution='normal')
+  x2 = rng->random(2, 5, distribution='normal')
+  rng->getProperty, position=position
+  assert, position eq 20ULL, 'incorrect position: %d', position
+  assert, array_equal(size(x2, /dimensions), [2, 5]), 'incorrect dimensions'
+
+  rng->setProperty, position=10
+  assert, array_equal(rng->random(10, distribution='normal'), reform(x2, 10)), $
+          'incorrect values after setting position'
+
+  seed = 42L
+  assert, array_equal(mg_random(seed, 10, distribution='normal'), x1), $
+          'object and function sequences differ'
+
+  obj_destroy, rng
+
+  return, 1
+end
+
+
+function mg_random_ut::init, _extra=e
+  compile_opt strictarr
+
+  if (~self->MGutLibTestCase::init(_extra=e)) then return, 0
+
+  self->addTestingRoutine, ['mg_rng__define', $
+                            'mg_rng::getProperty', $
+                            'mg_rng::setProperty']
+  self->addTestingRoutine, ['mg_rng::init', $
+                            'mg_rng::random', $
+                            'mg_rng::_overloadHelp'], $
+                           /is_function
+
+  return, 1
+end
+
+
+pro mg_random_ut__define
+  compile_opt strictarr
+
+  define = { mg_random_ut, inherits MGutLibTestCase }
+end
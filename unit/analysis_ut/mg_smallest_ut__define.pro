@@ -0,0 +1,72 @@
+; docformat = 'rst'
+
+function mg_smallest_ut::test_basic
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  ind = mg_smallest([5, 7, 0, 3, 2, 1], 2)
+  assert, array_equal(ind, [2, 5]), 'incorrect result'
+
+  ind = mg_smallest([5, 7, 0, 3, 2, 1], 2, /largest)
+  assert, array_equal(ind, [1, 0]), 'incorrect largest result'
+
+  return, 1
+end
+
+
+function mg_smallest_ut::test_ties
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  ind = mg_smallest([0, 0, 0, 0, 0, 0, 0, 5], 2)
+  assert, array_equal(ind, [0, 1]), 'incorrect result'
+
+  return, 1
+end
+
+
+function mg_smallest_ut::test_random
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  x = randomu(seed, 100000)
+  ind = mg_smallest(x, 100)
+  assert, array_equal(x[ind], (x[sort(x)])[0:99]), 'incorrect result'
+
+  return, 1
+end
+
+
+function mg_smallest_ut::test_nan
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_stats'), 'MG_STATS DLM not found', /skip
+
+  x = [3.0, !values.f_nan, 1.0, !values.f_nan, 2.0]
+
+  assert, array_equal(mg_smallest(x, 4), [2, 4, 0, 1]), $
+          'incorrect result without NAN'
+  assert, array_equal(mg_smallest(x, 4, /nan), [2, 4, 0]), $
+          'incorrect result with NAN'
+
+  return, 1
+end
+
+
+function mg_smallest_ut::init, _extra=e
+  compile_opt strictarr
+
+  if (~self->MGutLibTestCase::init(_extra=e)) then return, 0
+
+  return, 1
+end
+
+
+pro mg_smallest_ut__define
+  compile_opt strictarr
+
+  define = { mg_smallest_ut, inherits MGutLibTestCase }
+end
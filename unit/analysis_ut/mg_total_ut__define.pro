@@ -44,6 +44,145 @@ function mg_total_ut::test_long_basic
 end
 
 
+function mg_total_ut::test_dimension
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  a = lindgen(3, 4, 5)
+  for d = 1, 3 do begin
+    result = mg_total(a, dimension=d)
+    standard = total(a, d, /preserve_type)
+
+    assert, size(result, /type) eq 3, 'incorrect type for dimension %d', d
+    assert, array_equal(size(result, /dimensions), size(standard, /dimensions)), $
+            'incorrect dimensions for dimension %d', d
+    assert, array_equal(result, standard), 'incorrect result for dimension %d', d
+  endfor
+
+  return, 1
+end
+
+
+function mg_total_ut::test_complex_dimension
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  a = complex(findgen(2, 3), - findgen(2, 3))
+  result = mg_total(a, dimension=1)
+
+  assert, size(result, /type) eq 6, 'incorrect type'
+  assert, array_equal(result, total(a, 1)), 'incorrect result'
+
+  return, 1
+end
+
+
+function mg_total_ut::test_nan
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  a = [1.0, !values.f_nan, 2.0, !values.f_infinity, 3.0]
+  result = mg_total(a, /nan)
+
+  assert, result eq 6.0, 'incorrect result'
+
+  return, 1
+end
+
+
+function mg_total_ut::test_double
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  result = mg_total(findgen(10), /double)
+
+  assert, size(result, /type) eq 5, 'incorrect type'
+  assert, result eq 45.0D, 'incorrect result'
+
+  return, 1
+end
+
+
+function mg_total_ut::test_integer
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  result = mg_total(bytarr(300) + 1B, /integer)
+
+  assert, size(result, /type) eq 14, 'incorrect type'
+  assert, result eq 300LL, 'incorrect result'
+
+  return, 1
+end
+
+
+function mg_total_ut::test_integer_nan
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  a = [1.5, !values.f_nan, 2.5, !values.f_infinity]
+  result = mg_total(a, /integer, /nan)
+
+  assert, size(result, /type) eq 14, 'incorrect type'
+  assert, result eq 3LL, 'incorrect result'
+
+  return, 1
+end
+
+
+function mg_total_ut::test_integer_nan_error
+  compile_opt strictarr
+  @error_is_pass
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  result = mg_total([1.0, !values.f_nan], /integer)
+
+  return, 0
+end
+
+
+function mg_total_ut::test_threads
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  n = 1000000L
+  seed = 0L
+  d = randomu(seed, n)
+
+  result1 = mg_total(d, n_threads=1)
+  result4 = mg_total(d, n_threads=4)
+
+  assert, result1 eq result4, 'result depends on number of threads'
+
+  return, 1
+end
+
+
+function mg_total_ut::test_threads_columns
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_analysis'), 'MG_ANALYSIS DLM not found', /skip
+
+  seed = 0L
+  d = randomu(seed, 3, 100000L)
+
+  result1 = mg_total(d, dimension=2, n_threads=1)
+  result4 = mg_total(d, dimension=2, n_threads=4)
+
+  assert, array_equal(result1, result4), 'result depends on number of threads'
+
+  return, 1
+end
+
+
 pro mg_total_ut__define
   compile_opt strictarr
 
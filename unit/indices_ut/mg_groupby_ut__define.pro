@@ -0,0 +1,128 @@
+; docformat = 'rst'
+
+function mg_groupby_ut::test_basic
+  compile_opt strictarr
+
+  x = [9, 0, 7, 9, 7, 9]
+  group_indices = mg_groupby(x, n_groups=n_groups, group_starts=group_starts)
+
+  assert, n_groups eq 3L, 'incorrect number of groups %d', n_groups
+  assert, array_equal(group_starts, [0, 1, 3, 6]), 'incorrect group starts'
+  assert, array_equal(group_indices, [1, 2, 4, 0, 3, 5]), $
+          'incorrect group indices'
+
+  return, 1
+end
+
+
+function mg_groupby_ut::test_strings
+  compile_opt strictarr
+
+  x = ['b', 'a', 'b', 'c']
+  group_indices = mg_groupby(x, n_groups=n_groups, group_starts=group_starts)
+
+  assert, n_groups eq 3L, 'incorrect number of groups %d', n_groups
+  assert, array_equal(group_starts, [0, 1, 3, 4]), 'incorrect group starts'
+  assert, array_equal(group_indices, [1, 0, 2, 3]), 'incorrect group indices'
+
+  return, 1
+end
+
+
+function mg_groupby_ut::test_multiplekeys
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_indices'), 'MG_INDICES DLM not found', /skip
+
+  x1 = [1, 0, 1, 0, 1]
+  x2 = ['b', 'a', 'a', 'a', 'b']
+  group_indices = mg_groupby(list(x1, x2), $
+                             n_groups=n_groups, group_starts=group_starts)
+
+  assert, n_groups eq 3L, 'incorrect number of groups %d', n_groups
+  assert, array_equal(group_starts, [0, 2, 3, 5]), 'incorrect group starts'
+  assert, array_equal(group_indices, [1, 3, 2, 0, 4]), $
+          'incorrect group indices'
+
+  return, 1
+end
+
+
+function mg_groupby_ut::test_manykeys
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_indices'), 'MG_INDICES DLM not found', /skip
+
+  ; 9 keys, more than MG_HASH_GROUPBY takes at once, are the bits of x with
+  ; the most significant bit first, so groups are in the order of x
+  x = [5L, 3L, 5L, 300L, 3L, 511L]
+  keys = list()
+  for k = 8L, 0L, -1L do keys->add, (x / 2L^k) mod 2L
+
+  group_indices = mg_groupby(keys, n_groups=n_groups, $
+                             group_starts=group_starts, count=count)
+
+  assert, n_groups eq 4L, 'incorrect number of groups %d', n_groups
+  assert, array_equal(group_starts, [0, 2, 4, 5, 6]), 'incorrect group starts'
+  assert, array_equal(group_indices, [1, 4, 0, 2, 3, 5]), $
+          'incorrect group indices'
+  assert, array_equal(count, [2, 2, 1, 1]), 'incorrect count'
+
+  return, 1
+end
+
+
+function mg_groupby_ut::test_reductions
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_indices'), 'MG_INDICES DLM not found', /skip
+
+  x = [2, 1, 2, 1, 2]
+  values = [1.0, 4.0, 3.0, 6.0, 8.0]
+  !null = mg_groupby(x, values=values, count=count, total=total, $
+                     mean=mean, variance=variance, min=min, max=max, $
+                     first=first, last=last)
+
+  assert, array_equal(count, [2, 3]), 'incorrect count'
+  assert, array_equal(total, [10.0D, 12.0D]), 'incorrect total'
+  assert, array_equal(mean, [5.0D, 4.0D]), 'incorrect mean'
+  assert, array_equal(variance, [2.0D, 13.0D]), 'incorrect variance'
+  assert, size(min, /type) eq 4L, 'incorrect min type'
+  assert, array_equal(min, [4.0, 1.0]), 'incorrect min'
+  assert, array_equal(max, [6.0, 8.0]), 'incorrect max'
+  assert, array_equal(first, [4.0, 1.0]), 'incorrect first'
+  assert, array_equal(last, [6.0, 8.0]), 'incorrect last'
+
+  return, 1
+end
+
+
+function mg_groupby_ut::test_values_error
+  compile_opt strictarr
+  @error_is_pass
+
+  assert, self->have_dlm('mg_indices'), 'MG_INDICES DLM not found', /skip
+
+  x = [2, 1, 2]
+  !null = mg_groupby(x, values=findgen(6), total=total)
+
+  return, 0
+end
+
+
+function mg_groupby_ut::init, _extra=e
+  compile_opt strictarr
+
+  if (~self->MGutLibTestCase::init(_extra=e)) then return, 0
+
+  self->addTestingRoutine, 'mg_groupby', /is_function
+
+  return, 1
+end
+
+
+pro mg_groupby_ut__define
+  compile_opt strictarr
+
+  define = { mg_groupby_ut, inherits MGutLibTestCase }
+end
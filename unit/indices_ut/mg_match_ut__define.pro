@@ -104,6 +104,73 @@ function mg_match_ut::test_strings
 end
 
 
+function mg_match_ut::test_multiple
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_indices'), 'MG_INDICES DLM not found', /skip
+
+  a = [1, 2, 2, 3]
+  b = [2, 4, 1, 2]
+
+  n_matches = mg_match(a, b, $
+                       a_matches=a_matches, $
+                       b_matches=b_matches, $
+                       /multiple)
+
+  assert, n_matches eq 5L, 'incorrect number of matches %d', n_matches
+  assert, array_equal(a_matches, [0, 1, 1, 2, 2]), 'incorrect a matches'
+  assert, array_equal(b_matches, [2, 0, 3, 0, 3]), 'incorrect b matches'
+
+  n_matches = mg_match(a, b, $
+                       a_matches=a_matches, $
+                       b_matches=b_matches)
+
+  assert, n_matches eq 2L, 'incorrect number of single matches %d', n_matches
+  assert, array_equal(a_matches, [0, 1]), 'incorrect single a matches'
+  assert, array_equal(b_matches, [2, 0]), 'incorrect single b matches'
+
+  return, 1
+end
+
+
+function mg_match_ut::test_mixedtypes
+  compile_opt strictarr
+
+  a = [5B, 7B, 9B]
+  b = [9LL, 10LL, 5LL]
+
+  n_matches = mg_match(a, b, $
+                       a_matches=a_matches, $
+                       b_matches=b_matches)
+
+  assert, n_matches eq 2L, 'incorrect number of matches %d', n_matches
+  for m = 0L, n_matches - 1L do begin
+    assert, a[a_matches[m]] eq b[b_matches[m]], $
+            'match %d not equal, a[%d] = %d, but b[%d] = %d', $
+            m, a_matches[m], a[a_matches[m]], b_matches[m], b[b_matches[m]]
+  endfor
+
+  return, 1
+end
+
+
+function mg_match_ut::test_sparse
+  compile_opt strictarr
+
+  a = [1000000000L, 3L, -7L, 123456789L]
+  b = [-7L, 123456789L, 42L]
+
+  n_matches = mg_match(a, b, $
+                       a_matches=a_matches, $
+                       b_matches=b_matches)
+
+  assert, n_matches eq 2L, 'incorrect number of matches %d', n_matches
+  assert, array_equal(a[a_matches], b[b_matches]), 'matches not equal'
+
+  return, 1
+end
+
+
 function mg_match_ut::init, _extra=e
   compile_opt strictarr
 
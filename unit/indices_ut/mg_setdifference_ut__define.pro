@@ -0,0 +1,58 @@
+; docformat = 'rst'
+
+function mg_setdifference_ut::test_basic
+  compile_opt strictarr
+
+  result = mg_setdifference([0, 3, 5, 9], [3, 5, 7], count=count)
+  assert, count eq 2L, 'incorrect count %d', count
+  assert, array_equal(result, [0, 9]), 'incorrect difference'
+
+  return, 1
+end
+
+
+function mg_setdifference_ut::test_empty
+  compile_opt strictarr
+
+  result = mg_setdifference([3, 5], [3, 5, 7], count=count)
+  assert, count eq 0L, 'incorrect count %d', count
+  assert, result[0] eq -1L, 'incorrect empty difference'
+
+  result = mg_setdifference(-1L, [3, 5], count=count)
+  assert, count eq 0L, 'incorrect count %d', count
+  assert, result[0] eq -1L, 'incorrect difference of empty set'
+
+  return, 1
+end
+
+
+function mg_setdifference_ut::test_sparse
+  compile_opt strictarr
+
+  ; too sparse for the HISTOGRAM-based implementation
+  assert, self->have_dlm('mg_indices'), 'MG_INDICES DLM not found', /skip
+
+  result = mg_setdifference([2000000000L, 5L, 7L], [7L, 1L], count=count)
+  assert, count eq 2L, 'incorrect count %d', count
+  assert, array_equal(result, [5L, 2000000000L]), 'incorrect difference'
+
+  return, 1
+end
+
+
+function mg_setdifference_ut::init, _extra=e
+  compile_opt strictarr
+
+  if (~self->MGutLibTestCase::init(_extra=e)) then return, 0
+
+  self->addTestingRoutine, 'mg_setdifference', /is_function
+
+  return, 1
+end
+
+
+pro mg_setdifference_ut__define
+  compile_opt strictarr
+
+  define = { mg_setdifference_ut, inherits MGutLibTestCase }
+end
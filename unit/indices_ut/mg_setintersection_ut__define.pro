@@ -0,0 +1,59 @@
+; docformat = 'rst'
+
+function mg_setintersection_ut::test_basic
+  compile_opt strictarr
+
+  result = mg_setintersection([0, 3, 5, 9], [3, 5, 7], count=count)
+  assert, count eq 2L, 'incorrect count %d', count
+  assert, array_equal(result, [3, 5]), 'incorrect intersection'
+
+  return, 1
+end
+
+
+function mg_setintersection_ut::test_empty
+  compile_opt strictarr
+
+  result = mg_setintersection([0, 1], [2, 3], count=count)
+  assert, count eq 0L, 'incorrect count %d', count
+  assert, result[0] eq -1L, 'incorrect empty intersection'
+
+  result = mg_setintersection(-1L, [2, 3], count=count)
+  assert, count eq 0L, 'incorrect count %d', count
+  assert, result[0] eq -1L, 'incorrect intersection with empty set'
+
+  return, 1
+end
+
+
+function mg_setintersection_ut::test_sparse
+  compile_opt strictarr
+
+  ; too sparse for the HISTOGRAM-based implementation
+  assert, self->have_dlm('mg_indices'), 'MG_INDICES DLM not found', /skip
+
+  result = mg_setintersection([2000000000L, 5L, 7L], [7L, 2000000000L], $
+                              count=count)
+  assert, count eq 2L, 'incorrect count %d', count
+  assert, array_equal(result, [7L, 2000000000L]), 'incorrect intersection'
+
+  return, 1
+end
+
+
+function mg_setintersection_ut::init, _extra=e
+  compile_opt strictarr
+
+  if (~self->MGutLibTestCase::init(_extra=e)) then return, 0
+
+  self->addTestingRoutine, 'mg_setintersection', /is_function
+
+  return, 1
+end
+
+
+pro mg_setintersection_ut__define
+  compile_opt strictarr
+
+  define = { mg_setintersection_ut, inherits MGutLibTestCase }
+end
@@ -0,0 +1,86 @@
+; docformat = 'rst'
+
+function mg_setunion_ut::test_basic
+  compile_opt strictarr
+
+  result = mg_setunion([0, 3, 5, 9], [3, 5, 7], count=count)
+  assert, count eq 5L, 'incorrect count %d', count
+  assert, array_equal(result, [0, 3, 5, 7, 9]), 'incorrect union'
+
+  return, 1
+end
+
+
+function mg_setunion_ut::test_empty
+  compile_opt strictarr
+
+  result = mg_setunion(-1L, -1L, count=count)
+  assert, count eq 0L, 'incorrect count %d', count
+  assert, result[0] eq -1L, 'incorrect empty union'
+
+  result = mg_setunion(-1L, [2, 4], count=count)
+  assert, count eq 2L, 'incorrect count %d', count
+  assert, array_equal(result, [2, 4]), 'incorrect union with empty set'
+
+  return, 1
+end
+
+
+function mg_setunion_ut::test_sparse
+  compile_opt strictarr
+
+  ; too sparse for the HISTOGRAM-based implementation
+  assert, self->have_dlm('mg_indices'), 'MG_INDICES DLM not found', /skip
+
+  result = mg_setunion([2000000000L, 5L], [5L, 1000000000L], count=count)
+  assert, count eq 3L, 'incorrect count %d', count
+  assert, array_equal(result, [5L, 1000000000L, 2000000000L]), $
+          'incorrect union'
+
+  return, 1
+end
+
+
+function mg_setunion_ut::test_count_type
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_indices'), 'MG_INDICES DLM not found', /skip
+
+  result = mg_setunion([2000000000LL, 5LL], [5ULL, 1000000000ULL], count=count)
+  assert, size(count, /type) eq 3L, 'incorrect count type'
+  assert, count eq 3L, 'incorrect count %d', count
+  assert, array_equal(result, [5LL, 1000000000LL, 2000000000LL]), $
+          'incorrect union'
+
+  return, 1
+end
+
+
+function mg_setunion_ut::test_ulong64_error
+  compile_opt strictarr
+  @error_is_pass
+
+  assert, self->have_dlm('mg_indices'), 'MG_INDICES DLM not found', /skip
+
+  result = mg_setunion([5LL, 7LL], [5ULL, 2ULL^63 + 1ULL])
+
+  return, 0
+end
+
+
+function mg_setunion_ut::init, _extra=e
+  compile_opt strictarr
+
+  if (~self->MGutLibTestCase::init(_extra=e)) then return, 0
+
+  self->addTestingRoutine, 'mg_setunion', /is_function
+
+  return, 1
+end
+
+
+pro mg_setunion_ut__define
+  compile_opt strictarr
+
+  define = { mg_setunion_ut, inherits MGutLibTestCase }
+end
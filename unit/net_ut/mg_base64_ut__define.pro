@@ -0,0 +1,130 @@
+; docformat = 'rst'
+
+function mg_base64_ut::test_basic
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_base64'), 'MG_BASE64 DLM not found', /skip
+
+  s = ['', 'f', 'fo', 'foo', 'foob', 'fooba', 'foobar']
+  standard = ['', 'Zg==', 'Zm8=', 'Zm9v', 'Zm9vYg==', 'Zm9vYmE=', 'Zm9vYmFy']
+
+  for i = 0L, n_elements(s) - 1L do begin
+    result = mg_base64_encode(s[i])
+    assert, result eq standard[i], 'incorrect encoding: %s', result
+
+    result = mg_base64_decode(standard[i], /string)
+    assert, result eq s[i], 'incorrect decoding: %s', result
+  endfor
+
+  result = mg_base64_decode('Zm9v' + string(10B) + 'YmFy', count=count)
+  assert, array_equal(result, byte('foobar')), 'incorrect bytes'
+  assert, count eq 6, 'incorrect count: %d', count
+
+  return, 1
+end
+
+
+function mg_base64_ut::test_url
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_base64'), 'MG_BASE64 DLM not found', /skip
+
+  b = [251B, 255B, 191B]
+  assert, mg_base64_encode(b) eq '+/+/', 'incorrect standard encoding'
+  assert, mg_base64_encode(b, /url) eq '-_-_', 'incorrect URL-safe encoding'
+  assert, array_equal(mg_base64_decode('-_-_'), b), 'incorrect decoding'
+
+  result = mg_base64_encode('foob', /url, /no_padding)
+  assert, result eq 'Zm9vYg', 'incorrect unpadded encoding: %s', result
+  assert, mg_base64_decode(result, /string) eq 'foob', 'incorrect decoding'
+
+  return, 1
+end
+
+
+function mg_base64_ut::test_stream
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_base64'), 'MG_BASE64 DLM not found', /skip
+
+  b = bindgen(256)
+  standard = mg_base64_encode(b)
+
+  ; encode chunks of 100 bytes into a preallocated array
+  output = bytarr(strlen(standard))
+  offset = 0L
+  for i = 0L, 255L, 100L do begin
+    offset += mg_base64_encode(b[i:(i + 99L) < 255L], state=state, $
+                               flush=i + 100L gt 255L, $
+                               output=output, offset=offset)
+  endfor
+  assert, offset eq strlen(standard), 'incorrect number of characters'
+  assert, string(output) eq standard, 'incorrect streamed encoding'
+
+  ; decode chunks of 7 characters
+  result = bytarr(256)
+  offset = 0L
+  state = !null
+  for i = 0L, strlen(standard) - 1L, 7L do begin
+    offset += mg_base64_decode(strmid(standard, i, 7), state=state, $
+                               flush=i + 7L ge strlen(standard), $
+                               output=result, offset=offset)
+  endfor
+  assert, offset eq 256, 'incorrect number of bytes'
+  assert, array_equal(result, b), 'incorrect streamed decoding'
+
+  return, 1
+end
+
+
+function mg_base64_ut::test_error
+  compile_opt strictarr
+  @error_is_pass
+
+  assert, self->have_dlm('mg_base64'), 'MG_BASE64 DLM not found', /skip
+
+  result = mg_base64_decode('Zm9v!mFy')
+
+  return, 0
+end
+
+
+function mg_base64_ut::test_error_output
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_base64'), 'MG_BASE64 DLM not found', /skip
+
+  output = bytarr(32) + 170B
+  standard = output
+
+  catch, error
+  if (error ne 0L) then begin
+    catch, /cancel
+    assert, array_equal(output, standard), 'OUTPUT changed by failed decoding'
+    return, 1
+  endif
+
+  ; invalid character in the whole quads decoded by the fast path
+  count = mg_base64_decode('QUJDR$VGR0hJSktMTU5PUFFSU1RVVldYWFla', output=output)
+
+  return, 0
+end
+
+
+function mg_base64_ut::init, _extra=e
+  compile_opt strictarr
+
+  if (~self->MGutLibTestCase::init(_extra=e)) then return, 0
+
+  self->addTestingRoutine, ['mg_base64_encode', 'mg_base64_decode'], $
+                           /is_function
+
+  return, 1
+end
+
+
+pro mg_base64_ut__define
+  compile_opt strictarr
+
+  define = { mg_base64_ut, inherits MGutLibTestCase }
+end
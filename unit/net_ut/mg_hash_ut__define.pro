@@ -0,0 +1,105 @@
+; docformat = 'rst'
+
+function mg_hash_ut::test_strings
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_hash'), 'MG_HASH DLM not found', /skip
+
+  s = ['', 'The quick brown fox jumps over the lazy dog']
+
+  result = mg_hash(s, algorithm='md5')
+  standard = ['d41d8cd98f00b204e9800998ecf8427e', $
+              '9e107d9d372bb6826bd81d3542a419d6']
+  assert, array_equal(result, standard), 'incorrect MD5'
+
+  result = mg_hash(s, algorithm='sha1')
+  standard = ['da39a3ee5e6b4b0d3255bfef95601890afd80709', $
+              '2fd4e1c67a2d28fced849ee1bb76e7391b93eb12']
+  assert, array_equal(result, standard), 'incorrect SHA-1'
+
+  result = mg_hash(s)
+  standard = ['e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855', $
+              'd7a8fbb307d7809469ca9abcb0082e4f8d5651e46d3cdb762d02d0bf37c9e592']
+  assert, array_equal(result, standard), 'incorrect SHA-256'
+
+  result = mg_hash(s, algorithm='xxh64')
+  standard = ['ef46db3751d8e999', '0b242d361fda71bc']
+  assert, array_equal(result, standard), 'incorrect XXH64'
+
+  return, 1
+end
+
+
+function mg_hash_ut::test_raw
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_hash'), 'MG_HASH DLM not found', /skip
+
+  result = mg_hash('abc', algorithm='md5', /raw)
+  assert, size(result, /type) eq 1, 'incorrect type'
+  assert, array_equal(size(result, /dimensions), [16]), 'incorrect dimensions'
+  assert, array_equal(result[0:3], [144B, 1B, 80B, 152B]), 'incorrect bytes'
+
+  result = mg_hash(['a', 'b', 'c'], /raw)
+  assert, array_equal(size(result, /dimensions), [32, 3]), $
+          'incorrect dimensions'
+
+  return, 1
+end
+
+
+function mg_hash_ut::test_numeric
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_hash'), 'MG_HASH DLM not found', /skip
+
+  result = mg_hash(byte('abc'), algorithm='sha1')
+  assert, result eq 'a9993e364706816aba3e25717850c26c9cd0d89d', $
+          'incorrect result: %s', result
+
+  return, 1
+end
+
+
+function mg_hash_ut::test_file
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_hash'), 'MG_HASH DLM not found', /skip
+
+  filename = filepath('sha1.txt', root=mg_src_root())
+  result = mg_hash([filename, filename], algorithm='sha1', /file, n_threads=2)
+  assert, array_equal(result, '2fd4e1c67a2d28fced849ee1bb76e7391b93eb12'), $
+          'incorrect result'
+
+  return, 1
+end
+
+
+function mg_hash_ut::test_error
+  compile_opt strictarr
+  @error_is_pass
+
+  assert, self->have_dlm('mg_hash'), 'MG_HASH DLM not found', /skip
+
+  result = mg_hash('abc', algorithm='sha512')
+
+  return, 0
+end
+
+
+function mg_hash_ut::init, _extra=e
+  compile_opt strictarr
+
+  if (~self->MGutLibTestCase::init(_extra=e)) then return, 0
+
+  self->addTestingRoutine, 'mg_hash', /is_function
+
+  return, 1
+end
+
+
+pro mg_hash_ut__define
+  compile_opt strictarr
+
+  define = { mg_hash_ut, inherits MGutLibTestCase }
+end
@@ -0,0 +1,96 @@
+; docformat = 'rst'
+
+function mg_spellcorrect_ut::test_basic
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_strings'), 'MG_STRINGS DLM not found', /skip
+
+  words = ['time series', 'contour', 'profile', 'image', 'heatmap']
+  index = mg_spell_index(words, lonarr(5) + 1L)
+
+  corrections = mg_spell_correct(index, $
+                                 ['time series', 'tme series', 'contours', 'another'], $
+                                 correct=correct, found=found, distance=distance, $
+                                 count=count)
+  assert, array_equal(corrections, ['time series', 'time series', 'contour', '']), $
+          'incorrect corrections'
+  assert, array_equal(correct, [1B, 0B, 0B, 0B]), 'incorrect correct'
+  assert, array_equal(found, [1B, 1B, 1B, 0B]), 'incorrect found'
+  assert, array_equal(distance, [0L, 1L, 1L, -1L]), 'incorrect distance'
+  assert, count eq 3L, 'incorrect count'
+
+  return, 1
+end
+
+
+function mg_spellcorrect_ut::test_counts
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_strings'), 'MG_STRINGS DLM not found', /skip
+
+  ; "cat" and "cot" are both one edit from "cut", the more frequent wins
+  index = mg_spell_index(['cat', 'cot', 'dog'], [10L, 20L, 5L])
+  assert, mg_spell_correct(index, 'cut') eq 'cot', 'incorrect tie break'
+
+  ; transposition is a single edit
+  assert, mg_spell_correct(index, 'dgo', max_distance=1) eq 'dog', $
+          'incorrect transposition'
+
+  return, 1
+end
+
+
+function mg_spellcorrect_ut::test_file
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_strings'), 'MG_STRINGS DLM not found', /skip
+
+  index = mg_spell_index(['information', 'correct', 'known'], [3L, 2L, 1L])
+
+  filename = filepath('mg_spellcorrect_ut.bin', /tmp)
+  openw, lun, filename, /get_lun
+  writeu, lun, index
+  free_lun, lun
+
+  corrections = mg_spell_correct(filename, ['corect', 'informtion', 'known'])
+  file_delete, filename
+
+  assert, array_equal(corrections, ['correct', 'information', 'known']), $
+          'incorrect corrections from file'
+
+  return, 1
+end
+
+
+function mg_spellcorrect_ut::test_known_words
+  compile_opt strictarr
+
+  spell_hash = hash(['time series', 'contour', 'profile'], [1L, 1L, 1L])
+  corrected = mg_spellcorrect('tme series', known_words=spell_hash, $
+                              correct=correct, found=found)
+  obj_destroy, spell_hash
+
+  assert, corrected eq 'time series', 'incorrect correction'
+  assert, correct eq 0B, 'incorrect correct'
+  assert, found eq 1B, 'incorrect found'
+
+  return, 1
+end
+
+
+function mg_spellcorrect_ut::init, _extra=e
+  compile_opt strictarr
+
+  if (~self->MGutLibTestCase::init(_extra=e)) then return, 0
+
+  self->addTestingRoutine, 'mg_spellcorrect', /is_function
+
+  return, 1
+end
+
+
+pro mg_spellcorrect_ut__define
+  compile_opt strictarr
+
+  define = { mg_spellcorrect_ut, inherits MGutLibTestCase }
+end
@@ -60,6 +60,80 @@ function mg_stregex_ut::test_basic
 end
 
 
+function mg_stregex_ut::test_array
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_strings'), 'MG_STRINGS DLM not found', /skip
+
+  s = ['foo 123 bar 45', 'none', '7x8', '', '99']
+
+  position = mg_stregex(s, '[0-9]+', length=length, n_threads=2)
+  assert, array_equal(position, [4, -1, 0, -1, 0]), 'incorrect positions'
+  assert, array_equal(length, [3, -1, 1, -1, 2]), 'incorrect lengths'
+
+  extract = mg_stregex(s, '[0-9]+', /extract)
+  assert, array_equal(extract, ['123', '', '7', '', '99']), 'incorrect extracts'
+
+  found = mg_stregex(reform(s, 5, 1), '[0-9]+', /boolean)
+  assert, size(found, /type) eq 1, 'incorrect boolean type'
+  assert, array_equal(size(found, /dimensions), [5, 1]), 'incorrect dimensions'
+  assert, array_equal(found, [1B, 0B, 1B, 0B, 1B]), 'incorrect booleans'
+
+  return, 1
+end
+
+
+function mg_stregex_ut::test_array_all
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_strings'), 'MG_STRINGS DLM not found', /skip
+
+  s = ['foo 123 bar 45', 'none', '7x8']
+
+  position = mg_stregex(s, '[0-9]+', /all, offsets=offsets, length=length)
+  assert, array_equal(position, [4, 12, 0, 2]), 'incorrect positions'
+  assert, array_equal(length, [3, 2, 1, 1]), 'incorrect lengths'
+  assert, array_equal(offsets, [0, 2, 2, 4]), 'incorrect offsets'
+
+  return, 1
+end
+
+
+function mg_stregex_ut::test_anchor_all
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_strings'), 'MG_STRINGS DLM not found', /skip
+
+  ; ^ only matches at the start of each element, not after a previous match
+  position = mg_stregex(['aaa', 'ba'], '^a', /all, offsets=offsets, $
+                        length=length)
+  assert, array_equal(position, [0]), 'incorrect positions'
+  assert, array_equal(length, [1]), 'incorrect lengths'
+  assert, array_equal(offsets, [0, 1, 1]), 'incorrect offsets'
+
+  return, 1
+end
+
+
+function mg_stregex_ut::test_max_matches
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_strings'), 'MG_STRINGS DLM not found', /skip
+
+  s = ['1 22 333 4444', '5 66']
+
+  position = mg_stregex(s, '[0-9]+', /all, max_matches=2, offsets=offsets)
+  assert, array_equal(position, [0, 2, 0, 2]), 'incorrect positions'
+  assert, array_equal(offsets, [0, 2, 4]), 'incorrect offsets'
+
+  extract = mg_stregex(s[0], '[0-9]+', /all, /approximate, /extract, $
+                       max_matches=3)
+  assert, array_equal(extract, ['1', '22', '333']), 'incorrect extracts'
+
+  return, 1
+end
+
+
 function mg_stregex_ut::init, _extra=e
   compile_opt strictarr
 
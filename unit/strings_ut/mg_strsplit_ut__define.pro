@@ -0,0 +1,108 @@
+; docformat = 'rst'
+
+function mg_strsplit_ut::test_basic
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_strings'), 'MG_STRINGS DLM not found', /skip
+
+  s = '  foo bar' + string(9B) + 'baz  '
+
+  position = mg_strsplit(s, length=length, count=count)
+  assert, array_equal(position, [2, 6, 10]), 'incorrect positions'
+  assert, array_equal(length, [3, 3, 3]), 'incorrect lengths'
+  assert, count eq 3, 'incorrect count'
+
+  tokens = mg_strsplit('a,b;;c,', ',;', /extract)
+  assert, array_equal(tokens, ['a', 'b', 'c']), 'incorrect tokens'
+
+  tokens = mg_strsplit('a,b;;c,', ',;', /extract, /preserve_null)
+  assert, array_equal(tokens, ['a', 'b', '', 'c', '']), 'incorrect null tokens'
+
+  position = mg_strsplit(',,,', ',', count=count)
+  assert, position eq -1L, 'incorrect position without tokens'
+  assert, count eq 0, 'incorrect count without tokens'
+
+  return, 1
+end
+
+
+function mg_strsplit_ut::test_literal
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_strings'), 'MG_STRINGS DLM not found', /skip
+
+  tokens = mg_strsplit('a::b:c::::d', '::', /literal, /extract)
+  assert, array_equal(tokens, ['a', 'b:c', 'd']), 'incorrect literal tokens'
+
+  tokens = mg_strsplit('a->b-c,d-->e', ['->', '-', ','], /extract, /preserve_null)
+  assert, array_equal(tokens, ['a', 'b', 'c', 'd', '', 'e']), $
+          'incorrect tokens for several delimiters'
+
+  return, 1
+end
+
+
+function mg_strsplit_ut::test_quote
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_strings'), 'MG_STRINGS DLM not found', /skip
+
+  s = '1,"a,b",''c,d'',x\,y,"q\"r,s"'
+  tokens = mg_strsplit(s, ',', quote='"''', escape='\', /extract)
+  assert, array_equal(tokens, ['1', '"a,b"', '''c,d''', 'x\,y', '"q\"r,s"']), $
+          'incorrect quoted tokens'
+
+  return, 1
+end
+
+
+function mg_strsplit_ut::test_array
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_strings'), 'MG_STRINGS DLM not found', /skip
+
+  s = ['a b', '', 'c  d e', 'f']
+
+  position = mg_strsplit(s, offsets=offsets, length=length, n_threads=2)
+  assert, array_equal(position, [0, 2, 0, 3, 5, 0]), 'incorrect positions'
+  assert, array_equal(length, [1, 1, 1, 1, 1, 1]), 'incorrect lengths'
+  assert, array_equal(offsets, [0, 2, 2, 5, 6]), 'incorrect offsets'
+
+  return, 1
+end
+
+
+function mg_strsplit_ut::test_error
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_strings'), 'MG_STRINGS DLM not found', /skip
+
+  error = 0L
+  catch, error
+  if (error ne 0L) then begin
+    catch, /cancel
+    return, 1
+  endif
+
+  tokens = mg_strsplit('abc', '')
+
+  return, 0
+end
+
+
+function mg_strsplit_ut::init, _extra=e
+  compile_opt strictarr
+
+  if (~self->MGutLibTestCase::init(_extra=e)) then return, 0
+
+  self->addTestingRoutine, 'mg_strsplit', /is_function
+
+  return, 1
+end
+
+
+pro mg_strsplit_ut__define
+  compile_opt strictarr
+
+  define = { mg_strsplit_ut, inherits MGutLibTestCase }
+end
@@ -0,0 +1,77 @@
+; docformat = 'rst'
+
+function mg_lic_animate_ut::test_basic
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_flow'), 'MG_FLOW DLM not found', /skip
+
+  x = rebin(findgen(64), 64, 48)
+  y = rebin(reform(findgen(48), 1, 48), 64, 48)
+  u = sin(x / 10.0) * cos(y / 7.0)
+  v = cos(x / 5.0) - 0.5 * sin(y / 9.0)
+
+  standard = mg_lic_animate(u, v, 6, seed=3L, n_threads=1)
+  assert, size(standard, /type) eq 1, 'incorrect type'
+  assert, array_equal(size(standard, /dimensions), [64, 48, 6]), $
+          'incorrect dimensions'
+  assert, ~array_equal(standard[*, *, 0], standard[*, *, 1]), $
+          'frames are identical'
+
+  result = mg_lic_animate(u, v, 6, seed=3L, n_threads=4)
+  assert, array_equal(result, standard), 'result depends on number of threads'
+
+  result = mg_lic_animate(u, v, 6, seed=4L)
+  assert, ~array_equal(result, standard), 'result does not depend on seed'
+
+  result = mg_lic_animate(double(u), double(v), 2, length=10, ripples=1.5)
+  assert, array_equal(size(result, /dimensions), [64, 48, 2]), $
+          'incorrect dimensions for double'
+
+  return, 1
+end
+
+
+function mg_lic_animate_ut::test_texture
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_flow'), 'MG_FLOW DLM not found', /skip
+
+  u = fltarr(32, 16) + 1.0
+  v = fltarr(32, 16) + 0.5
+  texture = bytarr(32, 16) + 100B
+
+  result = mg_lic_animate(u, v, 4, texture=texture)
+  assert, array_equal(result, 255B), 'incorrect result for constant texture'
+
+  return, 1
+end
+
+
+function mg_lic_animate_ut::test_error
+  compile_opt strictarr
+  @error_is_pass
+
+  assert, self->have_dlm('mg_flow'), 'MG_FLOW DLM not found', /skip
+
+  result = mg_lic_animate(fltarr(10, 10), fltarr(10, 10), 0)
+
+  return, 0
+end
+
+
+function mg_lic_animate_ut::init, _extra=e
+  compile_opt strictarr
+
+  if (~self->MGutLibTestCase::init(_extra=e)) then return, 0
+
+  self->addTestingRoutine, 'mg_lic_animate', /is_function
+
+  return, 1
+end
+
+
+pro mg_lic_animate_ut__define
+  compile_opt strictarr
+
+  define = { mg_lic_animate_ut, inherits MGutLibTestCase }
+end
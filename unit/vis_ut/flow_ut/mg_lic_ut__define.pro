@@ -0,0 +1,111 @@
+; docformat = 'rst'
+
+function mg_lic_ut::test_threads
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_flow'), 'MG_FLOW DLM not found', /skip
+
+  x = rebin(findgen(64), 64, 48)
+  y = rebin(reform(findgen(48), 1, 48), 64, 48)
+  u = sin(x / 10.0) * cos(y / 7.0)
+  v = cos(x / 5.0) - 0.5 * sin(y / 9.0)
+  texture = byte(randomu(1L, 64, 48) * 256)
+
+  standard = mg_lic(u, v, texture=texture, n_threads=1)
+  assert, size(standard, /type) eq 1, 'incorrect type'
+  assert, array_equal(size(standard, /dimensions), [64, 48]), $
+          'incorrect dimensions'
+
+  result = mg_lic(u, v, texture=texture, n_threads=4)
+  assert, array_equal(result, standard), 'result depends on number of threads'
+
+  result = mg_lic(double(u), double(v), texture=texture, n_threads=3)
+  assert, array_equal(size(result, /dimensions), [64, 48]), $
+          'incorrect dimensions for double'
+
+  return, 1
+end
+
+
+function mg_lic_ut::test_fast
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_flow'), 'MG_FLOW DLM not found', /skip
+
+  x = rebin(findgen(80), 80, 100)
+  y = rebin(reform(findgen(100), 1, 100), 80, 100)
+  u = sin(x / 10.0) * cos(y / 7.0) + 0.3
+  v = cos(x / 5.0) - 0.5 * sin(y / 9.0)
+  texture = byte(randomu(1L, 80, 100) * 256)
+
+  standard = mg_lic(u, v, texture=texture, /fast, length=30, n_threads=1)
+  assert, array_equal(size(standard, /dimensions), [80, 100]), $
+          'incorrect dimensions'
+
+  result = mg_lic(u, v, texture=texture, /fast, length=30, n_threads=4)
+  assert, array_equal(result, standard), 'result depends on number of threads'
+
+  result = mg_lic(fltarr(80, 100) + 1.0, fltarr(80, 100), $
+                  texture=bytarr(80, 100) + 7B, /fast, step=0.25)
+  assert, array_equal(result, 255B), 'incorrect result for constant texture'
+
+  return, 1
+end
+
+
+function mg_lic_ut::test_texture
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_flow'), 'MG_FLOW DLM not found', /skip
+
+  u = fltarr(32, 16) + 1.0
+  v = fltarr(32, 16)
+  texture = bytarr(32, 16) + 100B
+
+  result = mg_lic(u, v, texture=texture)
+  assert, array_equal(result, 255B), 'incorrect result for constant texture'
+
+  return, 1
+end
+
+
+function mg_lic_ut::test_error
+  compile_opt strictarr
+  @error_is_pass
+
+  assert, self->have_dlm('mg_flow'), 'MG_FLOW DLM not found', /skip
+
+  result = mg_lic(fltarr(10, 10), dblarr(10, 10))
+
+  return, 0
+end
+
+
+function mg_lic_ut::test_length_error
+  compile_opt strictarr
+  @error_is_pass
+
+  assert, self->have_dlm('mg_flow'), 'MG_FLOW DLM not found', /skip
+
+  result = mg_lic(fltarr(10, 10), fltarr(10, 10), length=0)
+
+  return, 0
+end
+
+
+function mg_lic_ut::init, _extra=e
+  compile_opt strictarr
+
+  if (~self->MGutLibTestCase::init(_extra=e)) then return, 0
+
+  self->addTestingRoutine, 'mg_lic', /is_function
+
+  return, 1
+end
+
+
+pro mg_lic_ut__define
+  compile_opt strictarr
+
+  define = { mg_lic_ut, inherits MGutLibTestCase }
+end
@@ -0,0 +1,94 @@
+; docformat = 'rst'
+
+function mg_trace_ut::test_uniform
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_flow'), 'MG_FLOW DLM not found', /skip
+
+  u = fltarr(20, 10) + 1.0
+  v = fltarr(20, 10)
+  seeds = [[2.0, 5.0], [17.0, 5.0], [30.0, 5.0]]
+
+  vertices = mg_trace(seeds, u, v, step=1.0, max_steps=5, $
+                      n_vertices=n_vertices, polylines=polylines, times=times)
+  assert, array_equal(n_vertices, [6, 3, 0]), 'incorrect number of vertices'
+  assert, array_equal(size(vertices, /dimensions), [2, 9]), $
+          'incorrect dimensions'
+  assert, array_equal(vertices[0, *], [2, 3, 4, 5, 6, 7, 17, 18, 19]), $
+          'incorrect x-coordinates'
+  assert, array_equal(vertices[1, *], 5.0), 'incorrect y-coordinates'
+  assert, array_equal(polylines, [6, lindgen(6), 3, 6, 7, 8]), $
+          'incorrect polylines'
+  assert, array_equal(times, [findgen(6), findgen(3)]), 'incorrect times'
+
+  return, 1
+end
+
+
+function mg_trace_ut::test_pathlines
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_flow'), 'MG_FLOW DLM not found', /skip
+
+  ; speed increases linearly from 1 to 3 over one time unit
+  u = fltarr(20, 10, 2)
+  u[*, *, 0] = 1.0
+  u[*, *, 1] = 3.0
+  v = fltarr(20, 10, 2)
+
+  vertices = mg_trace([2.0, 5.0], u, v, step=0.1, max_steps=50, $
+                      n_vertices=n_vertices)
+  assert, n_vertices[0] eq 11, 'incorrect number of vertices'
+  assert, abs(vertices[0, 10] - 4.0) lt 1e-4, 'incorrect final position'
+
+  return, 1
+end
+
+
+function mg_trace_ut::test_threads
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_flow'), 'MG_FLOW DLM not found', /skip
+
+  x = rebin(findgen(64), 64, 48)
+  y = rebin(reform(findgen(48), 1, 48), 64, 48)
+  u = -(y - 24.0)
+  v = x - 32.0
+  seeds = [randomu(1L, 1, 500) * 63.0, randomu(2L, 1, 500) * 47.0]
+
+  standard = mg_trace(seeds, u, v, /adaptive, n_threads=1)
+  result = mg_trace(seeds, u, v, /adaptive, n_threads=4)
+  assert, array_equal(result, standard), 'result depends on number of threads'
+
+  return, 1
+end
+
+
+function mg_trace_ut::test_error
+  compile_opt strictarr
+  @error_is_pass
+
+  assert, self->have_dlm('mg_flow'), 'MG_FLOW DLM not found', /skip
+
+  result = mg_trace([1.0, 1.0, 1.0], fltarr(10, 10), fltarr(10, 10))
+
+  return, 0
+end
+
+
+function mg_trace_ut::init, _extra=e
+  compile_opt strictarr
+
+  if (~self->MGutLibTestCase::init(_extra=e)) then return, 0
+
+  self->addTestingRoutine, 'mg_trace', /is_function
+
+  return, 1
+end
+
+
+pro mg_trace_ut__define
+  compile_opt strictarr
+
+  define = { mg_trace_ut, inherits MGutLibTestCase }
+end
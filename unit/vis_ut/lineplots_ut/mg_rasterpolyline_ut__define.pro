@@ -0,0 +1,83 @@
+; docformat = 'rst'
+
+function mg_rasterpolyline_ut::test_basic
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_lineplots'), 'MG_LINEPLOTS DLM not found', /skip
+
+  x = [0.5, 9.5, 0.5]
+  y = [0.5, 0.5, 0.5]
+
+  result = mg_rasterpolyline(x, y, dimensions=[10, 2], $
+                             xrange=[0.0, 10.0], yrange=[0.0, 2.0])
+  assert, size(result, /type) eq 3, 'incorrect type'
+  assert, array_equal(size(result, /dimensions), [10, 2]), $
+          'incorrect dimensions'
+  assert, array_equal(result[*, 0], [lonarr(9) + 2L, 1L]), 'incorrect counts'
+  assert, array_equal(result[*, 1], 0L), 'incorrect empty row'
+
+  result = mg_rasterpolyline(x, y, dimensions=[10, 2], /normalize, $
+                             xrange=[0.0, 10.0], yrange=[0.0, 2.0])
+  assert, array_equal(result[*, 0], 1L), 'incorrect normalized counts'
+
+  result = mg_rasterpolyline(x, y, dimensions=[10, 2], /antialias, $
+                             xrange=[0.0, 10.0], yrange=[0.0, 2.0])
+  assert, size(result, /type) eq 4, 'incorrect antialiased type'
+
+  return, 1
+end
+
+
+function mg_rasterpolyline_ut::test_threads
+  compile_opt strictarr
+
+  assert, self->have_dlm('mg_lineplots'), 'MG_LINEPLOTS DLM not found', /skip
+
+  nlines = 1000L
+  npoints = 50L
+  x = reform(rebin(findgen(npoints), npoints, nlines), npoints * nlines)
+  y = total(randomu(1L, npoints, nlines) - 0.5, 1, /cumulative)
+  y = reform(y, npoints * nlines)
+  polylines = lonarr(npoints + 1L, nlines)
+  polylines[0, *] = npoints
+  polylines[1:*, *] = lindgen(npoints, nlines)
+
+  standard = mg_rasterpolyline(x, y, polylines=polylines, n_threads=1)
+  assert, array_equal(size(standard, /dimensions), [400, 400]), $
+          'incorrect dimensions'
+
+  result = mg_rasterpolyline(x, y, polylines=polylines, n_threads=4)
+  assert, array_equal(result, standard), 'result depends on number of threads'
+
+  return, 1
+end
+
+
+function mg_rasterpolyline_ut::test_error
+  compile_opt strictarr
+  @error_is_pass
+
+  assert, self->have_dlm('mg_lineplots'), 'MG_LINEPLOTS DLM not found', /skip
+
+  result = mg_rasterpolyline(findgen(3), findgen(3), polylines=[3, 0, 1, 5])
+
+  return, 0
+end
+
+
+function mg_rasterpolyline_ut::init, _extra=e
+  compile_opt strictarr
+
+  if (~self->MGutLibTestCase::init(_extra=e)) then return, 0
+
+  self->addTestingRoutine, 'mg_rasterpolyline', /is_function
+
+  return, 1
+end
+
+
+pro mg_rasterpolyline_ut__define
+  compile_opt strictarr
+
+  define = { mg_rasterpolyline_ut, inherits MGutLibTestCase }
+end